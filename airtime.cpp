@@ -0,0 +1,357 @@
+/*
+ * Copyright (c) 2016 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include "de_web_plugin.h"
+#include "de_web_plugin_private.h"
+
+/*! Returns the extended address of the node whose neighbourhood \p node belongs to.
+
+    For end-devices this is the parent, for routers it's the neighbouring
+    router with the best link, through which most of its traffic is relayed.
+    End-devices in the neighbour table of a router don't relay anything and
+    are ignored. Nodes with the same neighbourhood share the airtime of one
+    part of the mesh.
+    \return the neighbourhood or the address of the node itself if no router neighbours are known
+ */
+quint64 DeRestPluginPrivate::neighbourhoodOfNode(const deCONZ::Node *node)
+{
+    if (!node)
+    {
+        return 0;
+    }
+
+    quint64 best = 0;
+    quint8 bestLqi = 0;
+
+    const std::vector<deCONZ::NodeNeighbor> &neighbors = node->neighbors();
+    std::vector<deCONZ::NodeNeighbor>::const_iterator i = neighbors.begin();
+    std::vector<deCONZ::NodeNeighbor>::const_iterator end = neighbors.end();
+
+    for (; i != end; ++i)
+    {
+        if (i->relationship() == 0x00) // neighbour is the parent
+        {
+            return i->address().ext();
+        }
+
+        if (i->deviceType() != deCONZ::Coordinator && i->deviceType() != deCONZ::Router)
+        {
+            continue;
+        }
+
+        if (i->lqi() > bestLqi)
+        {
+            bestLqi = i->lqi();
+            best = i->address().ext();
+        }
+    }
+
+    if (best == 0)
+    {
+        best = node->address().ext();
+    }
+
+    return best;
+}
+
+/*! Returns the index of the airtime bucket of \p neighbourhood, a new bucket is added if needed.
+ */
+static int airtimeBucketIndex(std::vector<AirtimeBucket> &buckets, quint64 neighbourhood, qint64 now)
+{
+    for (size_t b = 0; b < buckets.size(); b++)
+    {
+        if (buckets[b].neighbourhood == neighbourhood)
+        {
+            return (int)b;
+        }
+    }
+
+    AirtimeBucket bucket;
+    bucket.neighbourhood = neighbourhood;
+    bucket.windowStart = now;
+    buckets.push_back(bucket);
+
+    return (int)buckets.size() - 1;
+}
+
+/*! Returns the airtime bucket of the neighbourhood of \p addr.
+
+    The bucket of a node is cached by address and refreshed from time to
+    time, since neighbour tables change slowly. Nodes which aren't known by
+    the core are cached as well, so they aren't looked up on every frame.
+    \return the bucket or 0 if the node is unknown
+ */
+AirtimeBucket *DeRestPluginPrivate::airtimeBucket(const deCONZ::Address &addr)
+{
+    if (!addr.hasExt() && !addr.hasNwk())
+    {
+        return 0;
+    }
+
+    const qint64 now = starttimeRef.elapsed();
+    const int idx = addr.hasExt() ? airtimeNodeByExt.value(addr.ext(), -1)
+                                  : airtimeNodeByNwk.value(addr.nwk(), -1);
+    AirtimeNode *n = idx >= 0 ? &airtimeNodes[idx] : 0;
+
+#ifdef DECONZ_REST_SIMULATION
+    if (addr.hasExt() && simIsVirtual(addr.ext()))
+    {
+        // virtual devices have no core node, they share one neighbourhood
+        if (!n)
+        {
+            AirtimeNode node;
+            node.extAddr = addr.ext();
+            node.nwkAddr = addr.hasNwk() ? addr.nwk() : 0;
+            node.neighbourhood = SIM_EXT_PREFIX;
+            node.bucket = airtimeBucketIndex(airtimeBuckets, node.neighbourhood, now);
+            node.resolveTime = now;
+            airtimeNodes.push_back(node);
+            airtimeNodeByExt.insert(node.extAddr, (int)airtimeNodes.size() - 1);
+            n = &airtimeNodes.back();
+        }
+    }
+    else
+#endif
+    if (!n || (now - n->resolveTime) > AIRTIME_RESOLVE_INTERVAL)
+    {
+        if (!apsCtrl)
+        {
+            return 0;
+        }
+
+        int i = 0;
+        const deCONZ::Node *node = 0;
+
+        while (apsCtrl->getNode(i, &node) == 0)
+        {
+            if (addr.hasExt() ? (node->address().ext() == addr.ext()) : (node->address().nwk() == addr.nwk()))
+            {
+                break;
+            }
+            node = 0;
+            i++;
+        }
+
+        if (!n)
+        {
+            airtimeNodes.push_back(AirtimeNode());
+            n = &airtimeNodes.back();
+            n->extAddr = addr.hasExt() ? addr.ext() : 0;
+            n->nwkAddr = addr.hasNwk() ? addr.nwk() : 0;
+
+            if (addr.hasExt()) { airtimeNodeByExt.insert(n->extAddr, (int)airtimeNodes.size() - 1); }
+            else               { airtimeNodeByNwk.insert(n->nwkAddr, (int)airtimeNodes.size() - 1); }
+        }
+
+        n->resolveTime = now;
+
+        if (node)
+        {
+            const int self = (int)(n - &airtimeNodes[0]);
+            n->extAddr = node->address().ext();
+            n->nwkAddr = node->address().nwk();
+            n->neighbourhood = neighbourhoodOfNode(node);
+            n->bucket = airtimeBucketIndex(airtimeBuckets, n->neighbourhood, now);
+            airtimeNodeByExt.insert(n->extAddr, self);
+            airtimeNodeByNwk.insert(n->nwkAddr, self);
+        }
+        else
+        {
+            n->neighbourhood = 0;
+            n->bucket = -1; // unknown, looked up again after AIRTIME_RESOLVE_INTERVAL
+        }
+    }
+
+    if (n->bucket < 0)
+    {
+        return 0;
+    }
+
+    AirtimeBucket *bucket = &airtimeBuckets[n->bucket];
+    airtimeRotate(*bucket, now);
+    return bucket;
+}
+
+/*! Moves the current window of \p bucket into the previous one when it has elapsed.
+ */
+void DeRestPluginPrivate::airtimeRotate(AirtimeBucket &bucket, qint64 now)
+{
+    const qint64 elapsed = now - bucket.windowStart;
+
+    if (elapsed < AIRTIME_WINDOW)
+    {
+        return;
+    }
+
+    if (elapsed < 2 * AIRTIME_WINDOW)
+    {
+        bucket.prevBytes = bucket.bytes;
+        bucket.prevFrames = bucket.frames;
+        bucket.windowStart += AIRTIME_WINDOW;
+    }
+    else // idle for more than a window
+    {
+        bucket.prevBytes = 0;
+        bucket.prevFrames = 0;
+        bucket.windowStart = now;
+    }
+
+    bucket.bytes = 0;
+    bucket.frames = 0;
+}
+
+/*! Returns the percentage of the budget used by \p bucket over the last window.
+    The previous window is weighted by how much of it still overlaps the sliding window.
+ */
+int DeRestPluginPrivate::airtimeLoad(const AirtimeBucket &bucket) const
+{
+    const qint64 elapsed = starttimeRef.elapsed() - bucket.windowStart;
+    const int prevShare = elapsed < AIRTIME_WINDOW ? (int)(AIRTIME_WINDOW - elapsed) : 0;
+
+    const int bytes = bucket.bytes + (int)((qint64)bucket.prevBytes * prevShare / AIRTIME_WINDOW);
+    const int frames = bucket.frames + (int)((qint64)bucket.prevFrames * prevShare / AIRTIME_WINDOW);
+
+    const int byteLoad = bytes * 100 / AIRTIME_BUDGET_BYTES;
+    const int frameLoad = frames * 100 / AIRTIME_BUDGET_FRAMES;
+
+    return byteLoad > frameLoad ? byteLoad : frameLoad;
+}
+
+/*! Adds a frame of \p asduSize bytes to the airtime of a neighbourhood.
+    \param addr source or destination address of the frame
+    \param asduSize size of the APS payload
+ */
+void DeRestPluginPrivate::airtimeAccount(const deCONZ::Address &addr, int asduSize)
+{
+    if (!addr.hasExt() && addr.hasNwk() && addr.nwk() >= 0xFFF8) // broadcast
+    {
+        airtimeAccountBroadcast(asduSize);
+        return;
+    }
+
+    AirtimeBucket *bucket = airtimeBucket(addr);
+
+    if (bucket)
+    {
+        bucket->bytes += asduSize + AIRTIME_FRAME_OVERHEAD;
+        bucket->frames++;
+        bucket->totalBytes += asduSize + AIRTIME_FRAME_OVERHEAD;
+        bucket->totalFrames++;
+    }
+}
+
+/*! Adds a group- or broadcast frame to the airtime of all neighbourhoods,
+    since it is relayed through the whole mesh.
+ */
+void DeRestPluginPrivate::airtimeAccountBroadcast(int asduSize)
+{
+    const qint64 now = starttimeRef.elapsed();
+    std::vector<AirtimeBucket>::iterator b = airtimeBuckets.begin();
+    std::vector<AirtimeBucket>::iterator bend = airtimeBuckets.end();
+
+    for (; b != bend; ++b)
+    {
+        airtimeRotate(*b, now);
+        b->bytes += asduSize + AIRTIME_FRAME_OVERHEAD;
+        b->frames++;
+        b->totalBytes += asduSize + AIRTIME_FRAME_OVERHEAD;
+        b->totalFrames++;
+    }
+}
+
+/*! Returns true if the neighbourhood of \p addr has used up its airtime budget.
+    Background work like polling and bindings gives way earlier than
+    commands, so that a busy area still reacts to user interaction.
+    \param addr the destination
+    \param background true for work which can be done later
+    \param deferred flag of the waiting task or binding, it is counted in the
+           deferred statistics only once; 0 for polling, which isn't counted
+ */
+bool DeRestPluginPrivate::isNeighbourhoodCongested(const deCONZ::Address &addr, bool background, bool *deferred)
+{
+    AirtimeBucket *bucket = airtimeBucket(addr);
+
+    if (!bucket)
+    {
+        return false;
+    }
+
+    const int limit = background ? AIRTIME_BACKGROUND_SHARE : 100;
+
+    if (airtimeLoad(*bucket) < limit)
+    {
+        return false;
+    }
+
+    if (deferred && !*deferred)
+    {
+        *deferred = true;
+        bucket->deferred++;
+    }
+    return true;
+}
+
+/*! Returns true if the neighbourhood of the node with \p extAddr has used up its airtime budget.
+ */
+bool DeRestPluginPrivate::isNeighbourhoodCongested(quint64 extAddr, bool background, bool *deferred)
+{
+    deCONZ::Address addr;
+    addr.setExt(extAddr);
+    return isNeighbourhoodCongested(addr, background, deferred);
+}
+
+/*! GET /api/<apikey>/config/airtime
+    Returns the airtime used per network neighbourhood.
+    \return REQ_READY_SEND
+ */
+int DeRestPluginPrivate::getAirtime(const ApiRequest &req, ApiResponse &rsp)
+{
+    Q_UNUSED(req);
+
+    const qint64 now = starttimeRef.elapsed();
+    QVariantList list;
+
+    std::vector<AirtimeBucket>::iterator b = airtimeBuckets.begin();
+    std::vector<AirtimeBucket>::iterator bend = airtimeBuckets.end();
+
+    for (; b != bend; ++b)
+    {
+        QVariantMap item;
+        int nodeCount = 0;
+
+        std::vector<AirtimeNode>::const_iterator n = airtimeNodes.begin();
+        std::vector<AirtimeNode>::const_iterator nend = airtimeNodes.end();
+
+        for (; n != nend; ++n)
+        {
+            if (n->neighbourhood == b->neighbourhood)
+            {
+                nodeCount++;
+            }
+        }
+
+        airtimeRotate(*b, now);
+        item["neighbourhood"] = QString("%1").arg(b->neighbourhood, 16, 16, QChar('0'));
+        item["nodes"] = (double)nodeCount;
+        item["load"] = (double)airtimeLoad(*b);
+        item["bytes"] = (double)b->totalBytes;
+        item["frames"] = (double)b->totalFrames;
+        item["deferred"] = (double)b->deferred;
+        list.append(item);
+    }
+
+    rsp.map["budgetbytes"] = (double)AIRTIME_BUDGET_BYTES;
+    rsp.map["budgetframes"] = (double)AIRTIME_BUDGET_FRAMES;
+    rsp.map["window"] = (double)AIRTIME_WINDOW;
+    rsp.map["neighbourhoods"] = list;
+    rsp.httpStatus = HttpStatusOk;
+
+    return REQ_READY_SEND;
+}
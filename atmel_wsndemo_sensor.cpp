@@ -28,48 +28,17 @@ void DeRestPluginPrivate::wsnDemoDataIndication(const deCONZ::ApsDataIndication
         return;
     }
 
-    QDataStream stream(ind.asdu());
-    stream.setByteOrder(QDataStream::LittleEndian);
+    FrameReader reader(ind.asdu());
+    WsnDemoFrame frame;
 
-    uint8_t msgType;
-    uint8_t nodeType;
-    quint64 ieeeAddr;
-    uint16_t nwkAddr;
-    uint32_t version;
-    uint32_t channelMask;
-    uint16_t panId;
-    uint8_t channel;
-    uint16_t parentAddr;
-    uint8_t lqi;
-    int8_t rssi;
-    uint8_t fieldType;
-    uint8_t fieldSize;
-    // if fieldtype == 0x01 (sensor data)
-    uint32_t battery;
-    uint32_t temperature;
-    uint32_t illuminance;
-
-    stream >> msgType;
-    stream >> nodeType;
-    stream >> ieeeAddr;
-    stream >> nwkAddr;
-    stream >> version;
-    stream >> channelMask;
-    stream >> panId;
-    stream >> channel;
-    stream >> parentAddr;
-    stream >> lqi;
-    stream >> rssi;
-    stream >> fieldType;
-    stream >> fieldSize;
-
-    if (fieldType == 0x01)
+    if (!decodeWsnDemoFrame(reader, frame))
     {
-        stream >> battery;
-        stream >> temperature;
-        stream >> illuminance;
+        return;
+    }
 
-        DBG_Printf(DBG_INFO, "Sensor 0x%016llX battery: %u, temperature: %u, light: %u\n", ieeeAddr, battery, temperature, illuminance);
+    if (frame.fieldType == 0x01)
+    {
+        DBG_Printf(DBG_INFO, "Sensor 0x%016llX battery: %u, temperature: %u, light: %u\n", frame.ieeeAddr, frame.battery, frame.temperature, frame.illuminance);
 
       //  std::vector<Sensor>::iterator i = sensors.begin();
       //  std::vector<Sensor>::iterator end = sensors.end();
@@ -102,7 +71,7 @@ void DeRestPluginPrivate::wsnDemoDataIndication(const deCONZ::ApsDataIndication
         }
 */
         // does not exist yet create Sensor instance
-        DBG_Printf(DBG_INFO, "found new sensor 0x%016llX\n", ieeeAddr);
+        DBG_Printf(DBG_INFO, "found new sensor 0x%016llX\n", frame.ieeeAddr);
         Sensor sensor;
         sensor.setName(QString("Sensor %1").arg(sensors.size() + 1));
         /*
@@ -114,6 +83,7 @@ void DeRestPluginPrivate::wsnDemoDataIndication(const deCONZ::ApsDataIndication
         */
         updateEtag(sensor.etag);
         sensors.push_back(sensor);
+        indexSensor(sensors.size() - 1);
     }
 
 }
@@ -104,7 +104,7 @@ bool DeRestPluginPrivate::checkApikeyAuthentification(const ApiRequest &req, Api
     {
         if (apikey == i->apikey)
         {
-            i->lastUseDate = QDateTime::currentDateTimeUtc();
+            i->lastUseDate = clockNowUtc();
 
             // fill in useragent string if not already exist
             if (i->useragent.isEmpty())
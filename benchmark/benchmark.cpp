@@ -0,0 +1,358 @@
+/*
+ * Copyright (c) 2016 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include <QVariantMap>
+#include <stdio.h>
+#include "de_web_plugin_private.h"
+#include "colorspace.h"
+#include "json.h"
+
+/*! Default number of iterations per benchmark case. */
+#define BENCH_DEFAULT_ITERATIONS 1000
+/*! Upper limit of iterations which can be requested per case. */
+#define BENCH_MAX_ITERATIONS     100000
+/*! Relative slowdown in percent which is reported as regression. */
+#define BENCH_REGRESSION_PERCENT 20
+/*! Number of synthetic resources for the lookup cases. */
+#define BENCH_RESOURCES          200
+
+/*! Synthetic JSON document, shaped like a typical light state response. */
+static const char *benchJsonDocument =
+    "{\"etag\":\"0123456789abcdef0123456789abcdef\",\"hascolor\":true,"
+    "\"manufacturername\":\"dresden elektronik\",\"modelid\":\"FLS-PP3\","
+    "\"name\":\"Light 1\",\"pointsymbol\":{},\"swversion\":\"020C.201000A0\","
+    "\"type\":\"Extended color light\",\"uniqueid\":\"00:21:2e:ff:ff:00:aa:bb-0a\","
+    "\"state\":{\"alert\":\"none\",\"bri\":254,\"colormode\":\"xy\",\"ct\":333,"
+    "\"effect\":\"none\",\"hue\":34028,\"on\":true,\"reachable\":true,\"sat\":254,"
+    "\"xy\":[0.3130,0.3290]}}";
+
+/*! Synthetic scene lights, as stored in the scenes table. */
+static const char *benchSceneLights =
+    "[{\"lid\":\"1\",\"on\":true,\"bri\":254,\"x\":20000,\"y\":\"21000\",\"tt\":\"10\",\"cl\":\"false\",\"clTime\":\"0\"},"
+    "{\"lid\":\"2\",\"on\":false,\"bri\":100,\"x\":30000,\"y\":\"31000\",\"tt\":\"10\",\"cl\":\"false\",\"clTime\":\"0\"},"
+    "{\"lid\":\"3\",\"on\":true,\"bri\":50,\"x\":40000,\"y\":\"41000\",\"tt\":\"4\",\"cl\":\"true\",\"clTime\":\"15\"}]";
+
+/*! Synthetic rule conditions, as stored in the rules table. */
+static const char *benchRuleConditions =
+    "[{\"address\":\"/sensors/2/state/buttonevent\",\"operator\":\"eq\",\"value\":\"1002\"},"
+    "{\"address\":\"/sensors/2/state/lastupdated\",\"operator\":\"dx\"},"
+    "{\"address\":\"/sensors/1/state/daylight\",\"operator\":\"eq\",\"value\":\"false\"}]";
+
+/*! Prevents the compiler from optimizing benchmark results away. */
+static volatile quint32 benchSink = 0;
+
+/*! Appends the result of one benchmark case to \p results.
+    \param results - list of result maps
+    \param name - name of the case
+    \param iterations - number of executed iterations
+    \param nsecs - total elapsed time in nanoseconds
+ */
+static void benchAddResult(QVariantList &results, const QString &name, int iterations, qint64 nsecs)
+{
+    QVariantMap map;
+    map["name"] = name;
+    map["iterations"] = (double)iterations;
+    map["totalus"] = (double)(nsecs / 1000);
+    map["nsperop"] = (iterations > 0) ? (double)(nsecs / iterations) : 0.0;
+    results.append(map);
+}
+
+
+/*! Runs all benchmark cases.
+    The cases work on synthetic data, no network or database is needed.
+    \param iterations - number of iterations per case
+    \param results - receives one map per case
+ */
+static void runBenchmarks(int iterations, QVariantList &results)
+{
+    QElapsedTimer t;
+    bool ok;
+
+    { // Json::parse
+        const QString json = QLatin1String(benchJsonDocument);
+        t.start();
+        for (int i = 0; i < iterations; i++)
+        {
+            QVariant var = Json::parse(json, ok);
+            benchSink += ok ? 1 : 0;
+        }
+        benchAddResult(results, QLatin1String("json_parse"), iterations, t.nsecsElapsed());
+    }
+
+    { // Json::serialize
+        const QVariant var = Json::parse(QLatin1String(benchJsonDocument), ok);
+        t.start();
+        for (int i = 0; i < iterations; i++)
+        {
+            QByteArray data = Json::serialize(var, ok);
+            benchSink += data.size();
+        }
+        benchAddResult(results, QLatin1String("json_serialize"), iterations, t.nsecsElapsed());
+    }
+
+    { // colorspace conversions used by the task builders
+        num r, g, b;
+        num h, s, v;
+        num X, Y, Z;
+        t.start();
+        for (int i = 0; i < iterations; i++)
+        {
+            r = (i % 256) / 255.0f;
+            g = ((i * 7) % 256) / 255.0f;
+            b = ((i * 13) % 256) / 255.0f;
+            Rgb2Hsv(&h, &s, &v, r, g, b);
+            Hsv2Rgb(&r, &g, &b, h, s, v);
+            Rgb2Xyz(&X, &Y, &Z, r, g, b);
+            Xyz2Rgb(&r, &g, &b, X, Y, Z);
+            benchSink += (quint32)(h + s + v);
+        }
+        benchAddResult(results, QLatin1String("colorspace_convert"), iterations, t.nsecsElapsed());
+    }
+
+    { // id to handle and handle to index lookups like getLightNodeForId()
+        IdHandleTable idHandles;
+        IdHandleTable::setActive(&idHandles);
+
+        std::vector<LightNode> nodes(BENCH_RESOURCES);
+        QHash<quint32, int> indexes;
+
+        for (int i = 0; i < BENCH_RESOURCES; i++)
+        {
+            nodes[i].setId(QString::number(i + 1));
+            indexes.insert(nodes[i].handle(), i);
+        }
+
+        const QString id = nodes.back().id();
+        t.start();
+        for (int i = 0; i < iterations; i++)
+        {
+            QHash<quint32, int>::const_iterator n = indexes.find(findIdHandle(id));
+            benchSink += (n != indexes.end()) ? 1 : 0;
+        }
+        benchAddResult(results, QLatin1String("light_lookup"), iterations, t.nsecsElapsed());
+
+        // ids which aren't canonical numbers are interned
+        const QString uniqueId = QLatin1String("00:21:2e:ff:ff:00:aa:bb-0a");
+        idHandles.intern(uniqueId);
+        t.start();
+        for (int i = 0; i < iterations; i++)
+        {
+            benchSink += findIdHandle(uniqueId);
+        }
+        benchAddResult(results, QLatin1String("interned_id_lookup"), iterations, t.nsecsElapsed());
+
+        IdHandleTable::setActive(0);
+    }
+
+    { // DeviceProfileDatabase::compile() with the built-in profiles
+        DeviceProfileDatabase db;
+        db.loadBuiltin();
+        const QString modelId = QLatin1String("FLS-PP3");
+        const QString manufacturer = QLatin1String("dresden elektronik");
+        t.start();
+        for (int i = 0; i < iterations; i++)
+        {
+            benchSink += db.compile(modelId, manufacturer, 0x1135, 0).capabilities;
+        }
+        benchAddResult(results, QLatin1String("device_profile_compile"), iterations, t.nsecsElapsed());
+    }
+
+    { // RestNodeBase::setZclValue() / getZclValue() on a detached node
+        LightNode lightNode;
+        deCONZ::NumericUnion val;
+        val.u64 = 0;
+        t.start();
+        for (int i = 0; i < iterations; i++)
+        {
+            val.u8 = i & 0xff;
+            lightNode.setZclValue(NodeValue::UpdateByZclReport, ONOFF_CLUSTER_ID, 0x0000, val);
+            lightNode.setZclValue(NodeValue::UpdateByZclReport, LEVEL_CLUSTER_ID, 0x0000, val);
+            lightNode.setZclValue(NodeValue::UpdateByZclReport, COLOR_CLUSTER_ID, 0x0003, val);
+            benchSink += lightNode.getZclValue(LEVEL_CLUSTER_ID, 0x0000).value.u8;
+        }
+        benchAddResult(results, QLatin1String("zcl_value_set_get"), iterations, t.nsecsElapsed());
+    }
+
+    { // Scene::jsonToLights
+        const QString json = QLatin1String(benchSceneLights);
+        t.start();
+        for (int i = 0; i < iterations; i++)
+        {
+            benchSink += Scene::jsonToLights(json).size();
+        }
+        benchAddResult(results, QLatin1String("scene_json_to_lights"), iterations, t.nsecsElapsed());
+    }
+
+    { // Rule::jsonToConditions
+        const QString json = QLatin1String(benchRuleConditions);
+        t.start();
+        for (int i = 0; i < iterations; i++)
+        {
+            benchSink += Rule::jsonToConditions(json).size();
+        }
+        benchAddResult(results, QLatin1String("rule_json_to_conditions"), iterations, t.nsecsElapsed());
+    }
+}
+
+/*! Compares \p results against the stored \p baseline.
+    \param baseline - content of a baseline file
+    \param results - results of this run
+    \param rspMap - receives the comparison
+ */
+static void compareBaseline(const QVariantMap &baseline, const QVariantList &results, QVariantMap &rspMap)
+{
+    QVariantMap baseResults;
+    QVariantList baseList = baseline["results"].toList();
+    QVariantList::const_iterator b = baseList.begin();
+    QVariantList::const_iterator bend = baseList.end();
+
+    for (; b != bend; ++b)
+    {
+        QVariantMap m = b->toMap();
+        baseResults[m["name"].toString()] = m["nsperop"];
+    }
+
+    QVariantList comparison;
+    bool regression = false;
+    QVariantList::const_iterator i = results.begin();
+    QVariantList::const_iterator end = results.end();
+
+    for (; i != end; ++i)
+    {
+        QVariantMap m = i->toMap();
+        const QString name = m["name"].toString();
+
+        if (!baseResults.contains(name))
+        {
+            continue;
+        }
+
+        double base = baseResults[name].toDouble();
+        double cur = m["nsperop"].toDouble();
+        QVariantMap cmp;
+        cmp["name"] = name;
+        cmp["baselinensperop"] = base;
+        cmp["nsperop"] = cur;
+
+        if (base > 0)
+        {
+            double change = ((cur - base) / base) * 100.0;
+            cmp["changepercent"] = change;
+            cmp["regression"] = (change > BENCH_REGRESSION_PERCENT);
+            if (change > BENCH_REGRESSION_PERCENT)
+            {
+                regression = true;
+                fprintf(stderr, "benchmark: regression in %s %.0f ns -> %.0f ns\n", qPrintable(name), base, cur);
+            }
+        }
+        comparison.append(cmp);
+    }
+
+    rspMap["baselineversion"] = baseline["version"];
+    rspMap["comparison"] = comparison;
+    rspMap["regression"] = regression;
+}
+
+/*! Runs the benchmark suite and prints the results as JSON.
+
+    de_rest_benchmark [-n <iterations>] [-b <baseline file>] [-s]
+
+    -n  iterations per case, default BENCH_DEFAULT_ITERATIONS
+    -b  compare against the results stored in the baseline file
+    -s  store the results as new baseline in the baseline file
+
+    \return 0 on success, 1 on a regression, 2 on invalid arguments
+ */
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+
+    int iterations = BENCH_DEFAULT_ITERATIONS;
+    QString baselinePath;
+    bool storeBaseline = false;
+    bool ok = true;
+
+    for (int i = 1; ok && i < args.size(); i++)
+    {
+
+        if (args[i] == QLatin1String("-n") && i + 1 < args.size())
+        {
+            iterations = args[++i].toInt(&ok);
+            ok = ok && iterations > 0 && iterations <= BENCH_MAX_ITERATIONS;
+        }
+        else if (args[i] == QLatin1String("-b") && i + 1 < args.size())
+        {
+            baselinePath = args[++i];
+        }
+        else if (args[i] == QLatin1String("-s"))
+        {
+            storeBaseline = true;
+        }
+        else
+        {
+            ok = false;
+        }
+    }
+
+    if (!ok || (storeBaseline && baselinePath.isEmpty()))
+    {
+        fprintf(stderr, "usage: %s [-n <iterations 1..%d>] [-b <baseline file>] [-s]\n", qPrintable(args[0]), BENCH_MAX_ITERATIONS);
+        return 2;
+    }
+
+    QVariantList results;
+    runBenchmarks(iterations, results);
+
+    QVariantMap rspMap;
+    rspMap["version"] = QLatin1String(GW_SW_VERSION);
+    rspMap["iterations"] = (double)iterations;
+    rspMap["results"] = results;
+
+    QFile baselineFile(baselinePath);
+
+    if (!baselinePath.isEmpty() && !storeBaseline && baselineFile.open(QIODevice::ReadOnly))
+    {
+        QVariantMap baseline = Json::parse(QString::fromUtf8(baselineFile.readAll()), ok).toMap();
+        baselineFile.close();
+
+        if (ok)
+        {
+            compareBaseline(baseline, results, rspMap);
+        }
+    }
+
+    if (storeBaseline)
+    {
+        if (baselineFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            QVariantMap baseline;
+            baseline["version"] = rspMap["version"];
+            baseline["iterations"] = rspMap["iterations"];
+            baseline["results"] = results;
+            baselineFile.write(Json::serialize(baseline));
+            baselineFile.close();
+        }
+        else
+        {
+            fprintf(stderr, "benchmark: can't write baseline %s\n", qPrintable(baselinePath));
+            return 2;
+        }
+    }
+
+    printf("%s\n", Json::serialize(rspMap).constData());
+
+    return rspMap["regression"].toBool() ? 1 : 0;
+}
@@ -0,0 +1,50 @@
+# Benchmark suite of the REST plugin
+# Links the parsing and model code of the plugin into a console application,
+# so the benchmark doesn't run inside deCONZ.
+#
+#   qmake benchmark.pro && make
+#   ./de_rest_benchmark -n 1000 -b benchmark_baseline.json
+
+TARGET   = de_rest_benchmark
+TEMPLATE = app
+CONFIG  += console
+CONFIG  -= app_bundle
+
+QT      += core network
+
+greaterThan(QT_MAJOR_VERSION, 4) {
+    QT += gui widgets serialport
+}
+
+DEFINES += DECONZ_DLLSPEC=Q_DECL_IMPORT
+# same version as in de_web.pro, stored with the baseline
+DEFINES += GW_SW_VERSION=\\\"2.04.02\\\"
+
+QMAKE_CXXFLAGS += -Wno-attributes \
+                  -Wall
+
+CONFIG(debug, debug|release) {
+    LIBS += -L../../../debug
+}
+
+CONFIG(release, debug|release) {
+    LIBS += -L../../../release
+}
+
+win32:LIBS +=  -L../../.. -ldeCONZ1
+unix:LIBS +=  -L../../.. -ldeCONZ
+
+INCLUDEPATH += .. \
+               ../../.. \
+               ../../../common
+
+SOURCES  = benchmark.cpp \
+           ../clock.cpp \
+           ../colorspace.cpp \
+           ../device_profile.cpp \
+           ../group_info.cpp \
+           ../json.cpp \
+           ../light_node.cpp \
+           ../rest_node_base.cpp \
+           ../rule.cpp \
+           ../scene.cpp
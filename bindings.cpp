@@ -11,7 +11,8 @@
 #include "de_web_plugin.h"
 #include "de_web_plugin_private.h"
 
-#define MAX_ACTIVE_BINDING_TASKS 3
+#define MAX_ACTIVE_BINDING_TASKS 6
+#define MAX_ACTIVE_BINDING_TASKS_PER_DEVICE 1
 
 /*! Constructor. */
 Binding::Binding() :
@@ -45,32 +46,25 @@ bool Binding::operator!=(const Binding &rhs) const
     return !(*this == rhs);
 }
 
-/*! Reads a binding entry from stream. */
-bool Binding::readFromStream(QDataStream &stream)
+/*! Reads a binding entry of a Mgmt_Bind_rsp. */
+bool Binding::readFromFrame(FrameReader &reader)
 {
-    if (stream.atEnd()) return false;
-    stream >> srcAddress;
-    if (stream.atEnd()) return false;
-    stream >> srcEndpoint;
-    if (stream.atEnd()) return false;
-    stream >> clusterId;
-    if (stream.atEnd()) return false;
-    stream >> dstAddrMode;
+    srcAddress = reader.readU64();
+    srcEndpoint = reader.readU8();
+    clusterId = reader.readU16();
+    dstAddrMode = reader.readU8();
 
     if (dstAddrMode == GroupAddressMode)
     {
-        if (stream.atEnd()) return false;
-        stream >> dstAddress.group;
+        dstAddress.group = reader.readU16();
         dstEndpoint = 0; // not present
-        return true;
+        return reader.isOk();
     }
     else if (dstAddrMode == ExtendedAddressMode)
     {
-        if (stream.atEnd()) return false;
-        stream >> dstAddress.ext;
-        if (stream.atEnd()) return false;
-        stream >> dstEndpoint;
-        return true;
+        dstAddress.ext = reader.readU64();
+        dstEndpoint = reader.readU8();
+        return reader.isOk();
     }
 
     return false;
@@ -115,7 +109,7 @@ bool DeRestPluginPrivate::readBindingTable(RestNodeBase *node, quint8 startIndex
 {
     DBG_Assert(node != 0);
 
-    if (!node && node->node())
+    if (!node || !node->node())
     {
         return false;
     }
@@ -226,29 +220,33 @@ void DeRestPluginPrivate::handleMgmtBindRspIndication(const deCONZ::ApsDataIndic
         return;
     }
 
-    QDataStream stream(ind.asdu());
-    stream.setByteOrder(QDataStream::LittleEndian);
+    FrameReader reader(ind.asdu());
+    ZdpMgmtBindRsp rsp;
 
-    quint8 seqNo;
-    quint8 status;
-
-    stream >> seqNo;
-    stream >> status;
+    if (!decodeZdpMgmtBindRsp(reader, rsp))
+    {
+        DBG_Printf(DBG_INFO, "MgmtBind_rsp %s invalid frame\n", qPrintable(node->address().toStringExt()));
+        if (btReader)
+        {
+            btReader->state = BindingTableReader::StateFinished;
+        }
+        return;
+    }
 
     if (btReader)
     {
         DBG_Printf(DBG_INFO, "MgmtBind_rsp id: %d %s seq: %u, status 0x%02X \n", btReader->apsReq.id(),
-                   qPrintable(node->address().toStringExt()), seqNo, status);
+                   qPrintable(node->address().toStringExt()), rsp.seqNo, rsp.status);
     }
     else
     {
-        DBG_Printf(DBG_INFO, "MgmtBind_rsp (no BTR) %s seq: %u, status 0x%02X \n", qPrintable(node->address().toStringExt()), seqNo, status);
+        DBG_Printf(DBG_INFO, "MgmtBind_rsp (no BTR) %s seq: %u, status 0x%02X \n", qPrintable(node->address().toStringExt()), rsp.seqNo, rsp.status);
     }
 
-    if (status != deCONZ::ZdpSuccess)
+    if (rsp.status != deCONZ::ZdpSuccess)
     {
-        if (status == deCONZ::ZdpNotPermitted ||
-            status == deCONZ::ZdpNotSupported)
+        if (rsp.status == deCONZ::ZdpNotPermitted ||
+            rsp.status == deCONZ::ZdpNotSupported)
         {
             if (node->mgmtBindSupported())
             {
@@ -265,16 +263,9 @@ void DeRestPluginPrivate::handleMgmtBindRspIndication(const deCONZ::ApsDataIndic
         return;
     }
 
-    quint8 entries;
-    quint8 startIndex;
-    quint8 listCount;
     bool bend = false;
 
-    stream >> entries;
-    stream >> startIndex;
-    stream >> listCount;
-
-    if (entries > (startIndex + listCount))
+    if (rsp.entries > (rsp.startIndex + rsp.listCount))
     {
         if (btReader)
         {
@@ -282,7 +273,7 @@ void DeRestPluginPrivate::handleMgmtBindRspIndication(const deCONZ::ApsDataIndic
             {
                 // read more
                 btReader->state = BindingTableReader::StateIdle;
-                btReader->index = startIndex + listCount;
+                btReader->index = rsp.startIndex + rsp.listCount;
             }
             else
             {
@@ -299,11 +290,11 @@ void DeRestPluginPrivate::handleMgmtBindRspIndication(const deCONZ::ApsDataIndic
         }
     }
 
-    while (listCount && !stream.atEnd())
+    while (rsp.listCount && !reader.atEnd())
     {
         Binding bnd;
 
-        if (bnd.readFromStream(stream))
+        if (bnd.readFromFrame(reader))
         {
             if (bnd.dstAddrMode == deCONZ::ApsExtAddress)
             {
@@ -356,7 +347,7 @@ void DeRestPluginPrivate::handleMgmtBindRspIndication(const deCONZ::ApsDataIndic
             break;
         }
 
-        listCount--;
+        rsp.listCount--;
     }
 
     // end, check remaining tasks
@@ -397,31 +388,30 @@ void DeRestPluginPrivate::handleMgmtBindRspIndication(const deCONZ::ApsDataIndic
  */
 void DeRestPluginPrivate::handleBindAndUnbindRspIndication(const deCONZ::ApsDataIndication &ind)
 {
-    QDataStream stream(ind.asdu());
-    stream.setByteOrder(QDataStream::LittleEndian);
+    FrameReader reader(ind.asdu());
+    ZdpStatusRsp rsp;
 
-    quint8 zdpSeqNum;
-    quint8 status;
-
-    stream >> zdpSeqNum;
-    stream >> status;
+    if (!decodeZdpStatusRsp(reader, rsp))
+    {
+        return;
+    }
 
     std::list<BindingTask>::iterator i = bindingQueue.begin();
     std::list<BindingTask>::iterator end = bindingQueue.end();
 
     for (; i != end; ++i)
     {
-        if (i->zdpSeqNum == zdpSeqNum)
+        if (i->zdpSeqNum == rsp.seqNo)
         {
             const char *what = (ind.clusterId() == ZDP_BIND_RSP_CLID) ? "Bind" : "Unbind";
 
-            if (status == deCONZ::ZdpSuccess)
+            if (rsp.status == deCONZ::ZdpSuccess)
             {
                 DBG_Printf(DBG_INFO, "%s response success\n", what);
             }
             else
             {
-                DBG_Printf(DBG_INFO, "%s response failed with status 0x%02X\n", what, status);
+                DBG_Printf(DBG_INFO, "%s response failed with status 0x%02X\n", what, rsp.status);
             }
 
             i->state = BindingTask::StateFinished;
@@ -480,6 +470,7 @@ bool DeRestPluginPrivate::sendBindRequest(BindingTask &bt)
 
     if (apsCtrl && (apsCtrl->apsdeDataRequest(apsReq) == deCONZ::Success))
     {
+        airtimeAccount(apsReq.dstAddress(), apsReq.asdu().size());
         return true;
     }
 
@@ -496,10 +487,10 @@ void DeRestPluginPrivate::checkLightBindingsForAttributeReporting(LightNode *lig
 
     BindingTask::Action action = BindingTask::ActionUnbind;
 
-    // whitelist by Model ID
+    // whitelist by device profile
     if (gwReportingEnabled)
     {
-        if (lightNode->modelId().startsWith("FLS-NB"))
+        if (lightNode->hasCapability(CapAttributeReporting))
         {
             action = BindingTask::ActionBind;
         }
@@ -543,7 +534,7 @@ void DeRestPluginPrivate::checkLightBindingsForAttributeReporting(LightNode *lig
     }
 
     lightNode->enableRead(READ_BINDING_TABLE);
-    lightNode->setNextReadTime(QTime::currentTime());
+    lightNode->setNextReadTime(clockMonotonicMs());
     Q_Q(DeRestPlugin);
     q->startZclAttributeTimer(1000);
 
@@ -565,7 +556,7 @@ void DeRestPluginPrivate::checkSensorBindingsForAttributeReporting(Sensor *senso
     if (sensor->node() && sensor->node()->isEndDevice())
     {
         // whitelist
-        if (sensor->modelId() != QLatin1String("LM_00.00.03.02TC"))
+        if (!sensor->hasCapability(CapEndDeviceReporting))
         {
             DBG_Printf(DBG_INFO, "don't create binding for attribute reporting of end-device %s\n", qPrintable(sensor->name()));
             return;
@@ -574,11 +565,10 @@ void DeRestPluginPrivate::checkSensorBindingsForAttributeReporting(Sensor *senso
 
     BindingTask::Action action = BindingTask::ActionUnbind;
 
-    // whitelist by Model ID
+    // whitelist by device profile
     if (gwReportingEnabled)
     {
-        if (sensor->modelId().startsWith("FLS-NB") ||
-            sensor->modelId() == QLatin1String("LM_00.00.03.02TC"))
+        if (sensor->hasCapability(CapAttributeReporting))
         {
             action = BindingTask::ActionBind;
         }
@@ -602,8 +592,8 @@ void DeRestPluginPrivate::checkSensorBindingsForAttributeReporting(Sensor *senso
         }
 
 
-        if (val.timestampLastReport.isValid() &&
-            val.timestampLastReport.secsTo(QTime::currentTime()) < (60 * 45)) // got update in timely manner
+        if (val.timestampLastReport >= 0 &&
+            (clockMonotonicMs() - val.timestampLastReport) < (60 * 45 * 1000)) // got update in timely manner
         {
             DBG_Printf(DBG_INFO, "binding for attribute reporting of cluster 0x%04X seems to be active\n", (*i));
             continue;
@@ -653,7 +643,7 @@ void DeRestPluginPrivate::checkSensorBindingsForAttributeReporting(Sensor *senso
     if (checkBindingTable)
     {
         sensor->enableRead(READ_BINDING_TABLE);
-        sensor->setNextReadTime(QTime::currentTime());
+        sensor->setNextReadTime(clockMonotonicMs());
         Q_Q(DeRestPlugin);
         q->startZclAttributeTimer(1000);
     }
@@ -679,19 +669,49 @@ void DeRestPluginPrivate::bindingTimerFired()
         return;
     }
 
+    // running requests are spread over source devices,
+    // so that one slow device doesn't block the others
     int active = 0;
+    std::vector<quint64> busyDevices;
     std::list<BindingTask>::iterator i = bindingQueue.begin();
     std::list<BindingTask>::iterator end = bindingQueue.end();
 
     for (; i != end; ++i)
+    {
+        if (i->state == BindingTask::StateInProgress)
+        {
+            active++;
+            busyDevices.push_back(i->binding.srcAddress);
+        }
+    }
+
+    i = bindingQueue.begin();
+
+    while (i != end)
     {
         if (i->state == BindingTask::StateIdle)
         {
             if (active >= MAX_ACTIVE_BINDING_TASKS)
             { /* do nothing */ }
+            else if (std::count(busyDevices.begin(), busyDevices.end(), i->binding.srcAddress) >= MAX_ACTIVE_BINDING_TASKS_PER_DEVICE)
+            { /* do nothing */ }
+            else if (isNeighbourhoodCongested(i->binding.srcAddress, true, &i->airtimeDeferred))
+            { /* do nothing */ }
+            else if (isMailboxDeviceAsleep(i->binding.srcAddress))
+            {
+                // wait until the sleepy device polls, don't burn retries
+                i->held++;
+                if (i->held * 1000 > MAILBOX_EXPIRY_TIME)
+                {
+                    DBG_Printf(DBG_INFO, "giveup binding srcAddr: %llX (sleepy device didn't wake up)\n", i->binding.srcAddress);
+                    i->state = BindingTask::StateFinished;
+                }
+            }
             else if (sendBindRequest(*i))
             {
                 i->state = BindingTask::StateInProgress;
+                busyDevices.push_back(i->binding.srcAddress);
+                active++;
             }
             else
             {
@@ -726,15 +746,11 @@ void DeRestPluginPrivate::bindingTimerFired()
                     i->state = BindingTask::StateFinished;
                 }
             }
-            else
-            {
-                active++;
-            }
         }
         else if (i->state == BindingTask::StateFinished)
         {
-            bindingQueue.erase(i);
-            break;
+            i = bindingQueue.erase(i);
+            continue;
         }
         else if (i->state == BindingTask::StateCheck)
         {
@@ -747,7 +763,7 @@ void DeRestPluginPrivate::bindingTimerFired()
                     if (i->restNode->mgmtBindSupported())
                     {
                         i->restNode->enableRead(READ_BINDING_TABLE);
-                        i->restNode->setNextReadTime(QTime::currentTime());
+                        i->restNode->setNextReadTime(clockMonotonicMs());
                         q->startZclAttributeTimer(1000);
 
                         i->state = BindingTask::StateCheck;
@@ -761,8 +777,8 @@ void DeRestPluginPrivate::bindingTimerFired()
                     DBG_Printf(DBG_INFO, "%s check timeout, retries = %d (srcAddr: 0x%016llX cluster: 0x%04X)\n",
                                (i->action == BindingTask::ActionBind ? "bind" : "unbind"), i->retries, i->binding.srcAddress, i->binding.clusterId);
 
-                    bindingQueue.push_back(*i);
-                    bindingQueue.pop_front();
+                    // move to the end of the queue
+                    bindingQueue.splice(bindingQueue.end(), bindingQueue, i);
                     break;
                 }
                 else
@@ -774,6 +790,8 @@ void DeRestPluginPrivate::bindingTimerFired()
                 }
             }
         }
+
+        ++i;
     }
 
     if (!bindingQueue.empty())
@@ -1089,7 +1107,7 @@ void DeRestPluginPrivate::bindingToRuleTimerFired()
 
             updateEtag(rule.etag);
             rule.setOwner("deCONZ");
-            rule.setCreationtime(QDateTime::currentDateTimeUtc().toString("yyyy-MM-ddTHH:mm:ss"));
+            rule.setCreationtime(clockTimestamp());
             rule.setActions(actions);
             rule.setConditions(conditions);
 
@@ -1114,6 +1132,7 @@ void DeRestPluginPrivate::bindingToRuleTimerFired()
 
             rule.setName(QString("Rule %1").arg(rule.id()));
             rules.push_back(rule);
+            indexRule(rules.size() - 1);
 
             queSaveDb(DB_RULES, DB_SHORT_SAVE_DELAY);
 
@@ -11,6 +11,10 @@
 #ifndef BINDINGS_H
 #define BINDINGS_H
 
+#include <QElapsedTimer>
+
+class FrameReader;
+
 /*! \class Binding
 
     Represents a ZigBee ZDO Binding.
@@ -46,7 +50,7 @@ public:
     /*! Destination endpoint (if dstAddrMode = 0x03). */
     quint8 dstEndpoint;
 
-    bool readFromStream(QDataStream &stream);
+    bool readFromFrame(FrameReader &reader);
     bool writeToStream(QDataStream &stream) const;
 };
 
@@ -80,7 +84,7 @@ public:
     State state; //!< State of query
     quint8 index; //!< Current read index
     bool isEndDevice; //!< True if node is an end-device
-    QTime time; //!< State timeout reference
+    QElapsedTimer time; //!< State timeout reference
     deCONZ::ApsDataRequest apsReq; //!< The APS request to match APS confirm.id
 };
 
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2016 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef CHANGE_MASK_H
+#define CHANGE_MASK_H
+
+#include <QtGlobal>
+
+/*! Consumers of resource changes, each one keeps its own cursor.
+ */
+enum ChangeConsumer
+{
+    ChangeConsumerDb,   // database persistence
+    ChangeConsumerRest, // cached REST representation
+    ChangeConsumerCount
+};
+
+/*! \class ChangeMask
+
+    Bitmap of changed fields of a resource.
+
+    The field bits are defined by the resource class and are set by its
+    setters. Every consumer clears the bits it has processed, independent
+    of the other consumers. A new resource has all fields changed.
+ */
+class ChangeMask
+{
+public:
+    ChangeMask()
+    {
+        for (int i = 0; i < ChangeConsumerCount; i++)
+        {
+            m_pending[i] = 0xFFFFFFFFUL;
+        }
+    }
+
+    /*! Marks \p fields as changed for all consumers. */
+    void set(quint32 fields)
+    {
+        for (int i = 0; i < ChangeConsumerCount; i++)
+        {
+            m_pending[i] |= fields;
+        }
+    }
+
+    /*! Returns the fields which \p consumer hasn't processed yet. */
+    quint32 pending(ChangeConsumer consumer) const
+    {
+        return m_pending[consumer];
+    }
+
+    /*! Returns true if any of \p fields is pending for \p consumer. */
+    bool isPending(ChangeConsumer consumer, quint32 fields) const
+    {
+        return (m_pending[consumer] & fields) != 0;
+    }
+
+    /*! Marks \p fields as processed by \p consumer.
+        The cursor belongs to the consumer, so this works on const resources.
+     */
+    void clear(ChangeConsumer consumer, quint32 fields = 0xFFFFFFFFUL) const
+    {
+        m_pending[consumer] &= ~fields;
+    }
+
+    /*! Marks all fields as changed for \p consumer only, e.g. after it dropped its cache. */
+    void reset(ChangeConsumer consumer) const
+    {
+        m_pending[consumer] = 0xFFFFFFFFUL;
+    }
+
+private:
+    mutable quint32 m_pending[ChangeConsumerCount];
+};
+
+#endif // CHANGE_MASK_H
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2016 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <QElapsedTimer>
+#include "clock.h"
+
+static QElapsedTimer monotonicRef;
+static qint64 nowUtcRefreshed = -1;
+static QDateTime nowUtc;
+static QString timestamp;
+static qint64 timestampSecs = -1;
+
+/*! Returns the milliseconds since the clock was first used.
+    The value isn't affected by changes of the wall-clock time and
+    must be used for all interval and timeout measurements.
+ */
+qint64 clockMonotonicMs()
+{
+    if (!monotonicRef.isValid())
+    {
+        monotonicRef.start();
+    }
+
+    return monotonicRef.elapsed();
+}
+
+/*! Returns the current UTC date and time.
+    The value is cached and refreshed every CLOCK_TICK_MS, it must not be
+    used to measure intervals.
+ */
+const QDateTime &clockNowUtc()
+{
+    const qint64 now = clockMonotonicMs();
+
+    if (nowUtcRefreshed < 0 || (now - nowUtcRefreshed) >= CLOCK_TICK_MS)
+    {
+        nowUtc = QDateTime::currentDateTimeUtc();
+        nowUtcRefreshed = now;
+    }
+
+    return nowUtc;
+}
+
+/*! Returns the current UTC time as ISO 8601 string "yyyy-MM-ddTHH:mm:ss".
+    The string is only formatted once per second.
+ */
+const QString &clockTimestamp()
+{
+    const QDateTime &now = clockNowUtc();
+    const qint64 secs = now.toMSecsSinceEpoch() / 1000;
+
+    if (secs != timestampSecs)
+    {
+        timestamp = now.toString("yyyy-MM-ddTHH:mm:ss");
+        timestampSecs = secs;
+    }
+
+    return timestamp;
+}
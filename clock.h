@@ -0,0 +1,24 @@
+/*
+ * Copyright (c) 2016 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <QDateTime>
+#include <QString>
+
+/*! Interval in milliseconds in which the cached UTC time is refreshed. */
+#define CLOCK_TICK_MS 100
+
+qint64 clockMonotonicMs();
+const QDateTime &clockNowUtc();
+const QString &clockTimestamp();
+
+#endif // CLOCK_H
@@ -388,6 +388,13 @@ static int sqliteLoadConfigCallback(void *user, int ncols, char **colval , char
             d->gwUuid = val.replace("{", "").replace("}", "");
         }
     }
+    else if (strcmp(colval[0], "otaucampaign") == 0)
+    {
+        if (!val.isEmpty())
+        {
+            d->loadOtauCampaign(val);
+        }
+    }
     else if (strcmp(colval[0], "otauactive") == 0)
     {
         if (!val.isEmpty())
@@ -1165,6 +1172,7 @@ static int sqliteLoadAllRulesCallback(void *user, int ncols, char **colval , cha
             // append to cache if not already known
             d->updateEtag(rule.etag);
             d->rules.push_back(rule);
+            d->indexRule(d->rules.size() - 1);
         }
     }
 
@@ -1307,6 +1315,7 @@ static int sqliteLoadAllSensorsCallback(void *user, int ncols, char **colval , c
                 // append to cache if not already known
                 d->updateEtag(sensor.etag);
                 d->sensors.push_back(sensor);
+                d->indexSensor(d->sensors.size() - 1);
             }
         }
     }
@@ -1700,6 +1709,18 @@ void DeRestPluginPrivate::saveDb()
             }
             */
 
+#ifdef DECONZ_REST_SIMULATION
+            if (simIsVirtual(i->address().ext()))
+            {
+                continue; // not persisted
+            }
+#endif
+
+            if (!i->changes.isPending(ChangeConsumerDb, LightNode::FieldsDb))
+            {
+                continue; // row is up to date
+            }
+
             QString lightState((i->state() == LightNode::StateDeleted ? "deleted" : "normal"));
 
             std::vector<GroupInfo>::const_iterator gi = i->groups().begin();
@@ -1733,6 +1754,10 @@ void DeRestPluginPrivate::saveDb()
                     sqlite3_free(errmsg);
                 }
             }
+            else
+            {
+                i->changes.clear(ChangeConsumerDb);
+            }
         }
 
         saveDatabaseItems &= ~DB_LIGHTS;
@@ -1786,25 +1811,33 @@ void DeRestPluginPrivate::saveDb()
                 continue;
             }
 
-            QString grpState((i->state() == Group::StateDeleted ? "deleted" : "normal"));
+            // the group row only changes with its own fields, scenes are stored below
+            if (i->changes.isPending(ChangeConsumerDb, Group::FieldsDb))
+            {
+                QString grpState((i->state() == Group::StateDeleted ? "deleted" : "normal"));
 
-            QString sql = QString(QLatin1String("REPLACE INTO groups (gid, name, state, mids, devicemembership, lightsequence) VALUES ('%1', '%2', '%3', '%4', '%5', '%6')"))
-                    .arg(gid)
-                    .arg(i->name())
-                    .arg(grpState)
-                    .arg(i->midsToString())
-                    .arg(i->dmToString())
-                    .arg(i->lightsequenceToString());
+                QString sql = QString(QLatin1String("REPLACE INTO groups (gid, name, state, mids, devicemembership, lightsequence) VALUES ('%1', '%2', '%3', '%4', '%5', '%6')"))
+                        .arg(gid)
+                        .arg(i->name())
+                        .arg(grpState)
+                        .arg(i->midsToString())
+                        .arg(i->dmToString())
+                        .arg(i->lightsequenceToString());
 
-            errmsg = NULL;
-            rc = sqlite3_exec(db, sql.toUtf8().constData(), NULL, NULL, &errmsg);
+                errmsg = NULL;
+                rc = sqlite3_exec(db, sql.toUtf8().constData(), NULL, NULL, &errmsg);
 
-            if (rc != SQLITE_OK)
-            {
-                if (errmsg)
+                if (rc != SQLITE_OK)
                 {
-                    DBG_Printf(DBG_ERROR, "sqlite3_exec failed: %s, error: %s\n", qPrintable(sql), errmsg);
-                    sqlite3_free(errmsg);
+                    if (errmsg)
+                    {
+                        DBG_Printf(DBG_ERROR, "sqlite3_exec failed: %s, error: %s\n", qPrintable(sql), errmsg);
+                        sqlite3_free(errmsg);
+                    }
+                }
+                else
+                {
+                    i->changes.clear(ChangeConsumerDb);
                 }
             }
 
@@ -1879,6 +1912,11 @@ void DeRestPluginPrivate::saveDb()
                 continue;
             }
 
+            if (i->changes.pending(ChangeConsumerDb) == 0)
+            {
+                continue; // row is up to date
+            }
+
             QString actionsJSON = Rule::actionsToString(i->actions());
             QString conditionsJSON = Rule::conditionsToString(i->conditions());
 
@@ -1913,6 +1951,10 @@ void DeRestPluginPrivate::saveDb()
                     sqlite3_free(errmsg);
                 }
             }
+            else
+            {
+                i->changes.clear(ChangeConsumerDb);
+            }
         }
 
         saveDatabaseItems &= ~DB_RULES;
@@ -1926,7 +1968,7 @@ void DeRestPluginPrivate::saveDb()
 
         for (; i != end; ++i)
         {
-            if (i->state ==Schedule::StateNormal)
+            if (i->state ==Schedule::StateNormal && i->changes.pending(ChangeConsumerDb) != 0)
             {
                 QString sql = QString(QLatin1String("REPLACE INTO schedules (id, json) VALUES ('%1', '%2')"))
                         .arg(i->id)
@@ -1943,6 +1985,10 @@ void DeRestPluginPrivate::saveDb()
                         sqlite3_free(errmsg);
                     }
                 }
+                else
+                {
+                    i->changes.clear(ChangeConsumerDb);
+                }
             }
             else if (i->state == Schedule::StateDeleted)
             {
@@ -2000,6 +2046,19 @@ void DeRestPluginPrivate::saveDb()
                 continue;
             }
             */
+
+#ifdef DECONZ_REST_SIMULATION
+            if (simIsVirtual(i->address().ext()))
+            {
+                continue; // not persisted
+            }
+#endif
+
+            if (!i->changes.isPending(ChangeConsumerDb, Sensor::FieldsDb))
+            {
+                continue; // row is up to date
+            }
+
             QString stateJSON = Sensor::stateToString(i->state());
             QString configJSON = Sensor::configToString(i->config());
             QString fingerPrintJSON = i->fingerPrint().toString();
@@ -2030,6 +2089,10 @@ void DeRestPluginPrivate::saveDb()
                     sqlite3_free(errmsg);
                 }
             }
+            else
+            {
+                i->changes.clear(ChangeConsumerDb);
+            }
         }
 
         saveDatabaseItems &= ~DB_SENSORS;
@@ -2063,6 +2126,16 @@ void DeRestPluginPrivate::queSaveDb(int items, int msec)
 {
     saveDatabaseItems |= items;
 
+    if (transactionActive)
+    {
+        // single flush on commit
+        if (transactionSaveDelay == 0 || msec < transactionSaveDelay)
+        {
+            transactionSaveDelay = msec;
+        }
+        return;
+    }
+
     if (databaseTimer->isActive())
     {
         // prefer shorter interval
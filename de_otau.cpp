@@ -8,7 +8,9 @@
  *
  */
 
+#include <map>
 #include "de_web_plugin_private.h"
+#include "json.h"
 
 // de otau specific
 #define OTAU_IMAGE_NOTIFY_CLID                 0x0201
@@ -33,6 +35,13 @@
 #define OTAU_IDLE_TICKS_NOTIFY    60  // seconds
 #define OTAU_BUSY_TICKS           60  // seconds
 
+// campaign
+#define OTAU_CAMPAIGN_NOTIFY_TIMEOUT   (30 * 1000)  // ms to wait for the first block request
+#define OTAU_CAMPAIGN_TRANSFER_TIMEOUT (OTAU_BUSY_TICKS * 1000) // ms without block request
+#define OTAU_CAMPAIGN_VERIFY_TIMEOUT   (5 * 60 * 1000) // ms to wait for the new version after transfer
+#define OTAU_CAMPAIGN_MAX_RETRIES      3
+#define OTAU_CAMPAIGN_MAX_CONCURRENT   16
+
 /*! Inits the otau manager.
  */
 void DeRestPluginPrivate::initOtau()
@@ -41,13 +50,14 @@ void DeRestPluginPrivate::initOtau()
     otauBusyTicks = 0;
     otauNotifyIter = 0;
     otauNotifyDelay = deCONZ::appArgumentNumeric("--otau-notify-delay", OTAU_IDLE_TICKS_NOTIFY);
+    otauCampaignLastTick = 0;
 
     otauTimer = new QTimer(this);
     otauTimer->setSingleShot(false);
     connect(otauTimer, SIGNAL(timeout()),
             this, SLOT(otauTimerFired()));
 
-    if (otauNotifyDelay > 0)
+    if (otauNotifyDelay > 0 || otauCampaign.active)
     {
         otauTimer->start(1000);
     }
@@ -77,6 +87,11 @@ void DeRestPluginPrivate::otauDataIndication(const deCONZ::ApsDataIndication &in
         }
 
         otauBusyTicks = OTAU_BUSY_TICKS;
+
+        if (otauCampaign.active)
+        {
+            otauCampaignBlockRequest(ind, zclFrame);
+        }
     }
 }
 
@@ -208,7 +223,7 @@ void DeRestPluginPrivate::otauTimerFired()
         return;
     }
 
-    if (otauNotifyDelay == 0)
+    if (otauNotifyDelay == 0 && !otauCampaign.active)
     {
         return;
     }
@@ -238,6 +253,13 @@ void DeRestPluginPrivate::otauTimerFired()
         }
     }
 
+    if (otauCampaign.active)
+    {
+        // campaign takes over notifications
+        otauCampaignTick();
+        return;
+    }
+
     if (otauIdleTicks < otauNotifyDelay)
     {
         return;
@@ -259,7 +281,7 @@ void DeRestPluginPrivate::otauTimerFired()
         if (lightNode->manufacturerCode() == VENDOR_DDEL)
         {
             // whitelist active notify to some devices
-            if (lightNode->modelId().startsWith("FLS-NB"))
+            if (lightNode->hasCapability(CapOtauNotify))
             {
                 otauSendStdNotify(lightNode);
             }
@@ -273,3 +295,690 @@ void DeRestPluginPrivate::otauTimerFired()
 
     otauNotifyIter++;
 }
+
+/*! OTA campaign REST API broker.
+    \param req - request data
+    \param rsp - response data
+    \return REQ_READY_SEND
+            REQ_NOT_HANDLED
+ */
+int DeRestPluginPrivate::handleOtauCampaignApi(const ApiRequest &req, ApiResponse &rsp)
+{
+    // POST /api/<apikey>/config/otau/campaign
+    if (req.hdr.method() == "POST")
+    {
+        return createOtauCampaign(req, rsp);
+    }
+    // GET /api/<apikey>/config/otau/campaign
+    else if (req.hdr.method() == "GET")
+    {
+        return getOtauCampaign(req, rsp);
+    }
+    // PUT /api/<apikey>/config/otau/campaign
+    else if (req.hdr.method() == "PUT")
+    {
+        return modifyOtauCampaign(req, rsp);
+    }
+    // DELETE /api/<apikey>/config/otau/campaign
+    else if (req.hdr.method() == "DELETE")
+    {
+        return deleteOtauCampaign(req, rsp);
+    }
+
+    return REQ_NOT_HANDLED;
+}
+
+/*! POST /api/<apikey>/config/otau/campaign
+    Starts a campaign for all lights of a model which don't run the target version.
+    \return REQ_READY_SEND
+            REQ_NOT_HANDLED
+ */
+int DeRestPluginPrivate::createOtauCampaign(const ApiRequest &req, ApiResponse &rsp)
+{
+    bool ok;
+    QVariantMap map = Json::parse(req.content, ok).toMap();
+    const QString resource = QLatin1String("/config/otau/campaign");
+
+    rsp.httpStatus = HttpStatusBadRequest;
+
+    if (!ok || map.isEmpty())
+    {
+        rsp.list.append(errorToMap(ERR_INVALID_JSON, resource, QLatin1String("body contains invalid JSON")));
+        return REQ_READY_SEND;
+    }
+
+    if (otauCampaign.active)
+    {
+        rsp.list.append(errorToMap(ERR_DUPLICATE_EXIST, resource, QLatin1String("a campaign is already running")));
+        return REQ_READY_SEND;
+    }
+
+    if (!map.contains("modelid") || !map.contains("version"))
+    {
+        rsp.list.append(errorToMap(ERR_MISSING_PARAMETER, resource, QLatin1String("missing parameters in body")));
+        return REQ_READY_SEND;
+    }
+
+    OtauCampaign campaign;
+    campaign.modelId = map["modelid"].toString();
+    campaign.version = map["version"].toString();
+
+    if (campaign.modelId.isEmpty() || (map["modelid"].type() != QVariant::String))
+    {
+        rsp.list.append(errorToMap(ERR_INVALID_VALUE, resource, QString("invalid value, %1, for parameter, modelid").arg(map["modelid"].toString())));
+        return REQ_READY_SEND;
+    }
+
+    if (campaign.version.isEmpty() || (map["version"].type() != QVariant::String))
+    {
+        rsp.list.append(errorToMap(ERR_INVALID_VALUE, resource, QString("invalid value, %1, for parameter, version").arg(map["version"].toString())));
+        return REQ_READY_SEND;
+    }
+
+    if (map.contains("maxconcurrent"))
+    {
+        int val = map["maxconcurrent"].toInt(&ok);
+        if (!ok || val < 1 || val > OTAU_CAMPAIGN_MAX_CONCURRENT)
+        {
+            rsp.list.append(errorToMap(ERR_INVALID_VALUE, resource, QString("invalid value, %1, for parameter, maxconcurrent").arg(map["maxconcurrent"].toString())));
+            return REQ_READY_SEND;
+        }
+        campaign.maxConcurrent = val;
+    }
+
+    if (map.contains("maxperneighbourhood"))
+    {
+        int val = map["maxperneighbourhood"].toInt(&ok);
+        if (!ok || val < 1 || val > OTAU_CAMPAIGN_MAX_CONCURRENT)
+        {
+            rsp.list.append(errorToMap(ERR_INVALID_VALUE, resource, QString("invalid value, %1, for parameter, maxperneighbourhood").arg(map["maxperneighbourhood"].toString())));
+            return REQ_READY_SEND;
+        }
+        campaign.maxPerNeighbourhood = val;
+    }
+
+    if (map.contains("imagesize"))
+    {
+        uint val = map["imagesize"].toUInt(&ok);
+        if (!ok)
+        {
+            rsp.list.append(errorToMap(ERR_INVALID_VALUE, resource, QString("invalid value, %1, for parameter, imagesize").arg(map["imagesize"].toString())));
+            return REQ_READY_SEND;
+        }
+        campaign.imageSize = val;
+    }
+
+    std::vector<LightNode>::iterator i = nodes.begin();
+    std::vector<LightNode>::iterator end = nodes.end();
+
+    for (; i != end; ++i)
+    {
+        if (i->state() != LightNode::StateNormal ||
+            i->modelId() != campaign.modelId ||
+            i->otauClusterId() != OTAU_CLUSTER_ID ||
+            i->swBuildId() == campaign.version)
+        {
+            continue;
+        }
+
+        // lights with multiple endpoints share one device
+        bool found = false;
+        std::vector<OtauCampaignNode>::const_iterator c = campaign.nodes.begin();
+        std::vector<OtauCampaignNode>::const_iterator cend = campaign.nodes.end();
+        for (; c != cend; ++c)
+        {
+            if (c->extAddr == i->address().ext())
+            {
+                found = true;
+                break;
+            }
+        }
+
+        if (!found)
+        {
+            OtauCampaignNode cnode;
+            cnode.extAddr = i->address().ext();
+            cnode.neighbourhood = otauCampaignNeighbourhood(&*i);
+            campaign.nodes.push_back(cnode);
+        }
+    }
+
+    if (campaign.nodes.empty())
+    {
+        rsp.list.append(errorToMap(ERR_RESOURCE_NOT_AVAILABLE, resource, QLatin1String("no devices require an update")));
+        rsp.httpStatus = HttpStatusNotFound;
+        return REQ_READY_SEND;
+    }
+
+    campaign.active = true;
+    otauCampaign = campaign;
+    otauCampaignLastTick = starttimeRef.elapsed();
+    saveOtauCampaign();
+
+    if (!otauTimer->isActive())
+    {
+        otauTimer->start(1000);
+    }
+
+    DBG_Printf(DBG_INFO, "otau campaign for %s version %s started with %u devices\n",
+               qPrintable(campaign.modelId), qPrintable(campaign.version), (uint)campaign.nodes.size());
+
+    if (!isOtauActive())
+    {
+        DBG_Printf(DBG_INFO, "otau campaign waits until otau is activated\n");
+    }
+
+    QVariantMap rspItem;
+    QVariantMap rspItemState;
+    rspItemState["devices"] = (double)campaign.nodes.size();
+    rspItem["success"] = rspItemState;
+    rsp.list.append(rspItem);
+    rsp.httpStatus = HttpStatusOk;
+    return REQ_READY_SEND;
+}
+
+/*! GET /api/<apikey>/config/otau/campaign
+    \return REQ_READY_SEND
+            REQ_NOT_HANDLED
+ */
+int DeRestPluginPrivate::getOtauCampaign(const ApiRequest &req, ApiResponse &rsp)
+{
+    Q_UNUSED(req);
+    otauCampaignToMap(rsp.map);
+    rsp.httpStatus = HttpStatusOk;
+    return REQ_READY_SEND;
+}
+
+/*! PUT /api/<apikey>/config/otau/campaign
+    Pauses or resumes the campaign.
+    \return REQ_READY_SEND
+            REQ_NOT_HANDLED
+ */
+int DeRestPluginPrivate::modifyOtauCampaign(const ApiRequest &req, ApiResponse &rsp)
+{
+    bool ok;
+    QVariantMap map = Json::parse(req.content, ok).toMap();
+    const QString resource = QLatin1String("/config/otau/campaign");
+
+    rsp.httpStatus = HttpStatusBadRequest;
+
+    if (!ok || map.isEmpty())
+    {
+        rsp.list.append(errorToMap(ERR_INVALID_JSON, resource, QLatin1String("body contains invalid JSON")));
+        return REQ_READY_SEND;
+    }
+
+    if (!otauCampaign.active)
+    {
+        rsp.list.append(errorToMap(ERR_RESOURCE_NOT_AVAILABLE, resource, QLatin1String("no campaign running")));
+        rsp.httpStatus = HttpStatusNotFound;
+        return REQ_READY_SEND;
+    }
+
+    if (!map.contains("paused") || (map["paused"].type() != QVariant::Bool))
+    {
+        rsp.list.append(errorToMap(ERR_INVALID_VALUE, resource, QString("invalid value, %1, for parameter, paused").arg(map["paused"].toString())));
+        return REQ_READY_SEND;
+    }
+
+    otauCampaign.paused = map["paused"].toBool();
+    saveOtauCampaign();
+
+    QVariantMap rspItem;
+    QVariantMap rspItemState;
+    rspItemState[resource + QLatin1String("/paused")] = otauCampaign.paused;
+    rspItem["success"] = rspItemState;
+    rsp.list.append(rspItem);
+    rsp.httpStatus = HttpStatusOk;
+    return REQ_READY_SEND;
+}
+
+/*! DELETE /api/<apikey>/config/otau/campaign
+    \return REQ_READY_SEND
+            REQ_NOT_HANDLED
+ */
+int DeRestPluginPrivate::deleteOtauCampaign(const ApiRequest &req, ApiResponse &rsp)
+{
+    Q_UNUSED(req);
+    const QString resource = QLatin1String("/config/otau/campaign");
+
+    if (!otauCampaign.active)
+    {
+        rsp.list.append(errorToMap(ERR_RESOURCE_NOT_AVAILABLE, resource, QLatin1String("no campaign running")));
+        rsp.httpStatus = HttpStatusNotFound;
+        return REQ_READY_SEND;
+    }
+
+    DBG_Printf(DBG_INFO, "otau campaign for %s cancelled\n", qPrintable(otauCampaign.modelId));
+    otauCampaign = OtauCampaign();
+    saveOtauCampaign();
+
+    QVariantMap rspItem;
+    rspItem["success"] = resource + QLatin1String(" deleted.");
+    rsp.list.append(rspItem);
+    rsp.httpStatus = HttpStatusOk;
+    return REQ_READY_SEND;
+}
+
+/*! Returns the extended address of the router which has the best link to \p lightNode.
+    It is used to limit the number of concurrent transfers in one part of the mesh.
+ */
+quint64 DeRestPluginPrivate::otauCampaignNeighbourhood(LightNode *lightNode)
+{
+    if (!lightNode || !lightNode->node())
+    {
+        return 0;
+    }
+
+    return neighbourhoodOfNode(lightNode->node());
+}
+
+/*! Sets the state of a campaign node and remembers the time of the change.
+ */
+void DeRestPluginPrivate::otauCampaignSetState(OtauCampaignNode &cnode, OtauCampaignNode::State state)
+{
+    if (cnode.state != state)
+    {
+        cnode.state = state;
+        cnode.stateTime = starttimeRef.elapsed();
+        updateEtag(gwConfigEtag);
+
+        if (state == OtauCampaignNode::StateDone || state == OtauCampaignNode::StateFailed || state == OtauCampaignNode::StateVerify)
+        {
+            saveOtauCampaign();
+        }
+    }
+}
+
+/*! Keeps track of the transfer progress of a campaign node.
+    \param ind - the block or page request indication
+    \param zclFrame - the ZCL frame of the request
+ */
+void DeRestPluginPrivate::otauCampaignBlockRequest(const deCONZ::ApsDataIndication &ind, const deCONZ::ZclFrame &zclFrame)
+{
+    std::vector<OtauCampaignNode>::iterator i = otauCampaign.nodes.begin();
+    std::vector<OtauCampaignNode>::iterator end = otauCampaign.nodes.end();
+
+    for (; i != end; ++i)
+    {
+        if (ind.srcAddress().hasExt() && ind.srcAddress().ext() == i->extAddr)
+        {
+            break;
+        }
+
+        if (!ind.srcAddress().hasExt())
+        {
+            LightNode *lightNode = getLightNodeForAddress(i->extAddr);
+            if (lightNode && lightNode->address().nwk() == ind.srcAddress().nwk())
+            {
+                break;
+            }
+        }
+    }
+
+    if (i == end)
+    {
+        return; // not part of the campaign
+    }
+
+    const qint64 now = starttimeRef.elapsed();
+
+    if (i->state == OtauCampaignNode::StatePending || i->state == OtauCampaignNode::StateNotified)
+    {
+        i->startTime = now;
+        i->offset = 0;
+        otauCampaignSetState(*i, OtauCampaignNode::StateTransfer);
+    }
+
+    i->lastBlockTime = now;
+
+    if ((ind.clusterId() == OTAU_CLUSTER_ID) && (zclFrame.commandId() == OTAU_IMAGE_BLOCK_REQUEST_CMD_ID))
+    {
+        FrameReader reader(zclFrame.payload());
+        OtauImageBlockReq req;
+
+        if (!decodeOtauImageBlockReq(reader, req))
+        {
+            return;
+        }
+
+        if (req.fileOffset > i->offset)
+        {
+            quint32 delta = req.fileOffset - i->offset;
+            i->bytes += delta;
+            otauCampaign.bytes += delta;
+        }
+        i->offset = req.fileOffset;
+    }
+}
+
+/*! Drives the OTA campaign, called once per second by otauTimerFired().
+    Notifies the next pending devices as long as the concurrency limits allow it,
+    detects finished and stalled transfers.
+ */
+void DeRestPluginPrivate::otauCampaignTick()
+{
+    const qint64 now = starttimeRef.elapsed();
+    int active = 0;
+    int remaining = 0;
+    std::map<quint64, int> activePerNeighbourhood;
+
+    std::vector<OtauCampaignNode>::iterator i = otauCampaign.nodes.begin();
+    std::vector<OtauCampaignNode>::iterator end = otauCampaign.nodes.end();
+
+    for (; i != end; ++i)
+    {
+        LightNode *lightNode = getLightNodeForAddress(i->extAddr);
+
+        switch (i->state)
+        {
+        case OtauCampaignNode::StateNotified:
+            if ((now - i->stateTime) > OTAU_CAMPAIGN_NOTIFY_TIMEOUT)
+            {
+                DBG_Printf(DBG_INFO, "otau campaign 0x%016llX no block request after notify\n", i->extAddr);
+                i->retries++;
+                otauCampaignSetState(*i, i->retries < OTAU_CAMPAIGN_MAX_RETRIES ? OtauCampaignNode::StatePending
+                                                                                : OtauCampaignNode::StateFailed);
+            }
+            break;
+
+        case OtauCampaignNode::StateTransfer:
+            if ((now - i->lastBlockTime) > OTAU_CAMPAIGN_TRANSFER_TIMEOUT)
+            {
+                // transfer finished or aborted, the new version tells which one
+                i->duration = i->lastBlockTime - i->startTime;
+                otauCampaignSetState(*i, OtauCampaignNode::StateVerify);
+
+                if (lightNode)
+                {
+                    lightNode->enableRead(READ_SWBUILD_ID);
+                    lightNode->setNextReadTime(clockMonotonicMs());
+                }
+            }
+            break;
+
+        case OtauCampaignNode::StateVerify:
+            if (lightNode && lightNode->swBuildId() == otauCampaign.version)
+            {
+                DBG_Printf(DBG_INFO, "otau campaign 0x%016llX updated to %s\n", i->extAddr, qPrintable(otauCampaign.version));
+                otauCampaignSetState(*i, OtauCampaignNode::StateDone);
+            }
+            else if ((now - i->stateTime) > OTAU_CAMPAIGN_VERIFY_TIMEOUT)
+            {
+                DBG_Printf(DBG_INFO, "otau campaign 0x%016llX version not changed\n", i->extAddr);
+                i->retries++;
+                otauCampaignSetState(*i, i->retries < OTAU_CAMPAIGN_MAX_RETRIES ? OtauCampaignNode::StatePending
+                                                                                : OtauCampaignNode::StateFailed);
+            }
+            else if (lightNode && lightNode->isAvailable() && !lightNode->mustRead(READ_SWBUILD_ID) &&
+                     ((now - i->stateTime) % 60000) < 1000)
+            {
+                // poll version once a minute while verifying
+                lightNode->enableRead(READ_SWBUILD_ID);
+                lightNode->setNextReadTime(clockMonotonicMs());
+            }
+            break;
+
+        case OtauCampaignNode::StatePending:
+            // updated by other means
+            if (lightNode && lightNode->swBuildId() == otauCampaign.version)
+            {
+                otauCampaignSetState(*i, OtauCampaignNode::StateDone);
+            }
+            break;
+
+        default:
+            break;
+        }
+
+        if (i->state == OtauCampaignNode::StateNotified || i->state == OtauCampaignNode::StateTransfer)
+        {
+            active++;
+            activePerNeighbourhood[i->neighbourhood]++;
+        }
+
+        if (i->state != OtauCampaignNode::StateDone && i->state != OtauCampaignNode::StateFailed)
+        {
+            remaining++;
+        }
+    }
+
+    if (active > 0 && otauCampaignLastTick > 0)
+    {
+        otauCampaign.transferTime += now - otauCampaignLastTick;
+    }
+    otauCampaignLastTick = now;
+
+    if (remaining == 0)
+    {
+        DBG_Printf(DBG_INFO, "otau campaign for %s finished\n", qPrintable(otauCampaign.modelId));
+        otauCampaign.active = false;
+        saveOtauCampaign();
+        updateEtag(gwConfigEtag);
+        return;
+    }
+
+    // interactive traffic has priority, running transfers continue but no new ones are started
+    if (otauCampaign.paused || !isInNetwork() || (idleLastActivity < IDLE_USER_LIMIT) || !tasks.empty())
+    {
+        return;
+    }
+
+    if (active >= otauCampaign.maxConcurrent)
+    {
+        return;
+    }
+
+    // notify one device per tick to spread the query next image requests
+    for (i = otauCampaign.nodes.begin(); i != end; ++i)
+    {
+        if (i->state != OtauCampaignNode::StatePending)
+        {
+            continue;
+        }
+
+        if (activePerNeighbourhood[i->neighbourhood] >= otauCampaign.maxPerNeighbourhood)
+        {
+            continue;
+        }
+
+        LightNode *lightNode = getLightNodeForAddress(i->extAddr);
+
+        if (!lightNode || !lightNode->isAvailable())
+        {
+            continue;
+        }
+
+        i->neighbourhood = otauCampaignNeighbourhood(lightNode);
+        otauSendStdNotify(lightNode);
+        otauCampaignSetState(*i, OtauCampaignNode::StateNotified);
+        break;
+    }
+}
+
+/*! Puts the campaign state including throughput and ETA in a map.
+ */
+void DeRestPluginPrivate::otauCampaignToMap(QVariantMap &map)
+{
+    int pending = 0;
+    int active = 0;
+    int done = 0;
+    int failed = 0;
+    qint64 durationSum = 0;
+    QVariantList devices;
+
+    std::vector<OtauCampaignNode>::const_iterator i = otauCampaign.nodes.begin();
+    std::vector<OtauCampaignNode>::const_iterator end = otauCampaign.nodes.end();
+
+    for (; i != end; ++i)
+    {
+        QVariantMap dev;
+        QString state;
+        LightNode *lightNode = getLightNodeForAddress(i->extAddr);
+
+        switch (i->state)
+        {
+        case OtauCampaignNode::StatePending:  state = "pending"; pending++; break;
+        case OtauCampaignNode::StateNotified: state = "notified"; active++; break;
+        case OtauCampaignNode::StateTransfer: state = "transfer"; active++; break;
+        case OtauCampaignNode::StateVerify:   state = "verify"; active++; break;
+        case OtauCampaignNode::StateDone:     state = "done"; done++; durationSum += i->duration; break;
+        case OtauCampaignNode::StateFailed:   state = "failed"; failed++; break;
+        default:
+            break;
+        }
+
+        dev["state"] = state;
+        dev["bytes"] = (double)i->bytes;
+        if (lightNode)
+        {
+            dev["uniqueid"] = lightNode->uniqueId();
+            dev["swversion"] = lightNode->swBuildId();
+        }
+
+        if (otauCampaign.imageSize > 0 && i->state == OtauCampaignNode::StateTransfer)
+        {
+            dev["progress"] = (double)((quint64)qMin(i->offset, otauCampaign.imageSize) * 100 / otauCampaign.imageSize);
+        }
+        devices.append(dev);
+    }
+
+    map["active"] = otauCampaign.active;
+    map["paused"] = otauCampaign.paused;
+    map["otauactive"] = isOtauActive();
+    map["modelid"] = otauCampaign.modelId;
+    map["version"] = otauCampaign.version;
+    map["maxconcurrent"] = (double)otauCampaign.maxConcurrent;
+    map["maxperneighbourhood"] = (double)otauCampaign.maxPerNeighbourhood;
+    map["pending"] = (double)pending;
+    map["inprogress"] = (double)active;
+    map["done"] = (double)done;
+    map["failed"] = (double)failed;
+    map["bytes"] = (double)otauCampaign.bytes;
+    map["devices"] = devices;
+
+    // bytes per second while transfers were running
+    double throughput = 0;
+    if (otauCampaign.transferTime > 0)
+    {
+        throughput = (double)otauCampaign.bytes * 1000.0 / (double)otauCampaign.transferTime;
+    }
+    map["throughput"] = throughput;
+
+    // estimated seconds until all remaining devices are done
+    if (otauCampaign.active && done > 0)
+    {
+        double avgDuration = (double)durationSum / done / 1000.0;
+        double parallel = qMax(1, otauCampaign.maxConcurrent);
+        map["eta"] = (double)qRound(avgDuration * (pending + active) / parallel);
+    }
+    else if (otauCampaign.active && otauCampaign.imageSize > 0 && throughput > 0)
+    {
+        map["eta"] = (double)qRound((double)otauCampaign.imageSize * (pending + active) / throughput);
+    }
+}
+
+/*! Stores the campaign in the config table so it survives restarts.
+ */
+void DeRestPluginPrivate::saveOtauCampaign()
+{
+    if (!otauCampaign.active)
+    {
+        gwConfig["otaucampaign"] = QString();
+        queSaveDb(DB_CONFIG, DB_SHORT_SAVE_DELAY);
+        return;
+    }
+
+    QVariantMap map;
+    QVariantList list;
+
+    map["modelid"] = otauCampaign.modelId;
+    map["version"] = otauCampaign.version;
+    map["paused"] = otauCampaign.paused;
+    map["imagesize"] = (double)otauCampaign.imageSize;
+    map["maxconcurrent"] = (double)otauCampaign.maxConcurrent;
+    map["maxperneighbourhood"] = (double)otauCampaign.maxPerNeighbourhood;
+    map["bytes"] = (double)otauCampaign.bytes;
+    map["transfertime"] = (double)otauCampaign.transferTime;
+
+    std::vector<OtauCampaignNode>::const_iterator i = otauCampaign.nodes.begin();
+    std::vector<OtauCampaignNode>::const_iterator end = otauCampaign.nodes.end();
+
+    for (; i != end; ++i)
+    {
+        QVariantMap dev;
+        dev["mac"] = QString("0x%1").arg(i->extAddr, 16, 16, QChar('0'));
+        dev["state"] = (double)i->state;
+        dev["retries"] = (double)i->retries;
+        dev["bytes"] = (double)i->bytes;
+        dev["duration"] = (double)i->duration;
+        list.append(dev);
+    }
+
+    map["nodes"] = list;
+    gwConfig["otaucampaign"] = QString(Json::serialize(map));
+    queSaveDb(DB_CONFIG, DB_LONG_SAVE_DELAY);
+}
+
+/*! Restores a campaign from the config table.
+    Transfers which were running before the restart are started again.
+    \param json - the stored campaign
+ */
+void DeRestPluginPrivate::loadOtauCampaign(const QString &json)
+{
+    bool ok;
+    QVariantMap map = Json::parse(json, ok).toMap();
+
+    if (!ok || map.isEmpty())
+    {
+        return;
+    }
+
+    OtauCampaign campaign;
+    campaign.modelId = map["modelid"].toString();
+    campaign.version = map["version"].toString();
+    campaign.paused = map["paused"].toBool();
+    campaign.imageSize = map["imagesize"].toUInt();
+    campaign.maxConcurrent = qBound(1, map["maxconcurrent"].toInt(), OTAU_CAMPAIGN_MAX_CONCURRENT);
+    campaign.maxPerNeighbourhood = qBound(1, map["maxperneighbourhood"].toInt(), OTAU_CAMPAIGN_MAX_CONCURRENT);
+    campaign.bytes = map["bytes"].toLongLong();
+    campaign.transferTime = map["transfertime"].toLongLong();
+
+    QVariantList list = map["nodes"].toList();
+    QVariantList::const_iterator i = list.begin();
+    QVariantList::const_iterator end = list.end();
+
+    for (; i != end; ++i)
+    {
+        QVariantMap dev = i->toMap();
+        OtauCampaignNode cnode;
+        cnode.extAddr = dev["mac"].toString().toULongLong(&ok, 16);
+
+        if (!ok || cnode.extAddr == 0)
+        {
+            continue;
+        }
+
+        int state = dev["state"].toInt();
+        cnode.state = (state == OtauCampaignNode::StateDone) ? OtauCampaignNode::StateDone :
+                      (state == OtauCampaignNode::StateFailed) ? OtauCampaignNode::StateFailed :
+                      (state == OtauCampaignNode::StateVerify) ? OtauCampaignNode::StateVerify :
+                                                                 OtauCampaignNode::StatePending;
+        cnode.retries = dev["retries"].toInt();
+        cnode.bytes = dev["bytes"].toUInt();
+        cnode.duration = dev["duration"].toLongLong();
+        campaign.nodes.push_back(cnode);
+    }
+
+    if (campaign.modelId.isEmpty() || campaign.version.isEmpty() || campaign.nodes.empty())
+    {
+        return;
+    }
+
+    campaign.active = true;
+    otauCampaign = campaign;
+    gwConfig["otaucampaign"] = json;
+
+    DBG_Printf(DBG_INFO, "otau campaign for %s version %s restored with %u devices\n",
+               qPrintable(campaign.modelId), qPrintable(campaign.version), (uint)campaign.nodes.size());
+}
@@ -73,9 +73,13 @@ else {
 QMAKE_CXXFLAGS += -Wno-attributes
 
 HEADERS  = bindings.h \
+           change_mask.h \
+           clock.h \
            de_web_plugin.h \
            de_web_widget.h \
            connectivity.h \
+           device_profile.h \
+           frame_reader.h \
            json.h \
            colorspace.h \
            sqlite3.h \
@@ -88,16 +92,23 @@ HEADERS  = bindings.h \
            scene.h \
            sensor.h
 
-SOURCES  = authentification.cpp \
+SOURCES  = airtime.cpp \
+           authentification.cpp \
            bindings.cpp \
            change_channel.cpp \
+           clock.cpp \
            connectivity.cpp \
            database.cpp \
            discovery.cpp \
            de_web_plugin.cpp \
            de_web_widget.cpp \
            de_otau.cpp \
+           device_profile.cpp \
+           sleepy_mailbox.cpp \
+           startup.cpp \
            firmware_update.cpp \
+           frame_reader.cpp \
+           interview.cpp \
            json.cpp \
            colorspace.cpp \
            sqlite3.c \
@@ -107,21 +118,35 @@ SOURCES  = authentification.cpp \
            rest_rules.cpp \
            rest_sensors.cpp \
            rest_schedules.cpp \
+           rest_streams.cpp \
            rest_touchlink.cpp \
+           rest_transaction.cpp \
            rule.cpp \
            upnp.cpp \
            zcl_tasks.cpp \
            gw_uuid.cpp \
            permitJoin.cpp \
            rest_node_base.cpp \
+           resource_index.cpp \
            light_node.cpp \
            group.cpp \
            group_info.cpp \
+           group_plan.cpp \
+           group_verify.cpp \
            scene.cpp \
+           scene_placement.cpp \
            sensor.cpp \
+           memory.cpp \
            atmel_wsndemo_sensor.cpp \
            reset_device.cpp
 
+# Virtual devices for load tests, see initSimulation()
+# Not part of production builds, enable with: qmake CONFIG+=simulation
+simulation {
+    DEFINES += DECONZ_REST_SIMULATION
+    SOURCES += simulation.cpp
+}
+
 win32:DESTDIR  = ../../debug/plugins # TODO adjust
 unix:DESTDIR  = ..
 
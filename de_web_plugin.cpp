@@ -50,6 +50,10 @@ static int checkZclAttributesDelay = 750;
 static int ReadAttributesLongDelay = 5000;
 static int ReadAttributesLongerDelay = 60000;
 static uint MaxGroupTasks = 4;
+static int GroupReconcileBaseDelay = 2; // seconds, doubled per unconfirmed attempt
+static int GroupReconcileMaxDelay = 300; // seconds
+static uint GroupReconcileVerifyRetries = 3; // read group membership after n unconfirmed attempts
+static uint GroupReconcileMaxRetries = 6; // give up explicit add/remove requests
 
 ApiRequest::ApiRequest(const QHttpRequestHeader &h, const QStringList &p, QTcpSocket *s, const QString &c) :
     hdr(h), path(p), sock(s), content(c), version(ApiVersion_1)
@@ -87,8 +91,11 @@ DeRestPluginPrivate::DeRestPluginPrivate(QObject *parent) :
     connect(databaseTimer, SIGNAL(timeout()),
             this, SLOT(saveDatabaseTimerFired()));
 
+    IdHandleTable::setActive(&idHandles);
     db = 0;
     saveDatabaseItems = 0;
+    transactionActive = false;
+    transactionSaveDelay = 0;
 #if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
         sqliteDatabaseName = QStandardPaths::standardLocations(QStandardPaths::DataLocation).first();
 #else
@@ -98,6 +105,7 @@ DeRestPluginPrivate::DeRestPluginPrivate(QObject *parent) :
     idleLimit = 0;
     idleTotalCounter = IDLE_READ_LIMIT;
     idleLastActivity = 0;
+    groupReconcileIter = 0;
     udpSock = 0;
     haEndpoint = 0;
     gwGroupSendDelay = deCONZ::appArgumentNumeric("--group-delay", GROUP_SEND_DELAY);
@@ -243,16 +251,29 @@ DeRestPluginPrivate::DeRestPluginPrivate(QObject *parent) :
     initSchedules();
     initPermitJoin();
     initOtau();
+    initDeviceProfiles();
     initTouchlinkApi();
     initChangeChannelApi();
     initResetDeviceApi();
     initFirmwareUpdate();
+    initStartup();
+    initInterview();
+    initStreams();
+#ifdef DECONZ_REST_SIMULATION
+    initSimulation();
+#endif
+    initMemory();
 }
 
 /*! Deconstructor for pimpl.
  */
 DeRestPluginPrivate::~DeRestPluginPrivate()
 {
+    if (IdHandleTable::active() == &idHandles)
+    {
+        IdHandleTable::setActive(0);
+    }
+
     if (inetDiscoveryManager)
     {
         inetDiscoveryManager->deleteLater();
@@ -273,6 +294,9 @@ void DeRestPluginPrivate::apsdeDataIndication(const deCONZ::ApsDataIndication &i
         return;
     }
 
+    mailboxIndication(ind);
+    airtimeAccount(ind.srcAddress(), ind.asdu().size());
+
     if ((ind.profileId() == HA_PROFILE_ID) || (ind.profileId() == ZLL_PROFILE_ID))
     {
 
@@ -284,6 +308,26 @@ void DeRestPluginPrivate::apsdeDataIndication(const deCONZ::ApsDataIndication &i
             zclFrame.readFromStream(stream);
         }
 
+        if (zclFrame.isProfileWideCommand() &&
+            zclFrame.commandId() == deCONZ::ZclDefaultResponseId &&
+            !stateConfirmations.empty())
+        {
+            handleStateConfirmation(ind, zclFrame); // other handlers see the default response as well
+        }
+
+        if (ind.clusterId() == BASIC_CLUSTER_ID && zclFrame.isProfileWideCommand() &&
+            zclFrame.commandId() == deCONZ::ZclReadAttributesResponseId)
+        {
+            interviewBasicIndication(ind, zclFrame);
+        }
+
+        if (zclFrame.isProfileWideCommand() &&
+            zclFrame.commandId() == deCONZ::ZclReadAttributesResponseId &&
+            !groupVerifications.empty())
+        {
+            handleGroupVerification(ind, zclFrame); // state is updated by the regular handling
+        }
+
         TaskItem task;
 
         switch (ind.clusterId())
@@ -337,6 +381,12 @@ void DeRestPluginPrivate::apsdeDataIndication(const deCONZ::ApsDataIndication &i
             handleMgmtLeaveRspIndication(ind);
             break;
 
+        case ZDP_ACTIVE_ENDPOINTS_RSP_CLID:
+        case ZDP_SIMPLE_DESCRIPTOR_RSP_CLID:
+        case ZDP_NODE_DESCRIPTOR_RSP_CLID:
+            interviewZdpIndication(ind);
+            break;
+
         default:
             break;
         }
@@ -357,6 +407,33 @@ void DeRestPluginPrivate::apsdeDataIndication(const deCONZ::ApsDataIndication &i
     even if the APSDE-DATA.request was not issued by this plugin.
  */
 void DeRestPluginPrivate::apsdeDataConfirm(const deCONZ::ApsDataConfirm &conf)
+{
+    if (handleTaskConfirm(conf.id(), conf.status()))
+    {
+        return;
+    }
+
+    if (handleMgmtBindRspConfirm(conf))
+    {
+        return;
+    }
+
+    if (channelChangeApsRequestId == conf.id())
+    {
+        channelChangeSendConfirm(conf.status() == deCONZ::ApsSuccessStatus);
+    }
+    if (resetDeviceApsRequestId == conf.id())
+    {
+        resetDeviceSendConfirm(conf.status() == deCONZ::ApsSuccessStatus);
+    }
+}
+
+/*! Releases the running task of a confirmed APS request.
+    \param id the APS request id
+    \param status the APSDE-DATA.confirm status
+    \return true if the request belonged to a task
+ */
+bool DeRestPluginPrivate::handleTaskConfirm(quint8 id, quint8 status)
 {
     std::list<TaskItem>::iterator i = runningTasks.begin();
     std::list<TaskItem>::iterator end = runningTasks.end();
@@ -364,20 +441,20 @@ void DeRestPluginPrivate::apsdeDataConfirm(const deCONZ::ApsDataConfirm &conf)
     for (;i != end; ++i)
     {
         TaskItem &task = *i;
-        if (task.req.id() == conf.id())
+        if (task.req.id() == id)
         {
-            if (conf.status() != deCONZ::ApsSuccessStatus)
+            if (status != deCONZ::ApsSuccessStatus)
             {
-                DBG_Printf(DBG_INFO, "error APSDE-DATA.confirm: 0x%02X on task\n", conf.status());
+                DBG_Printf(DBG_INFO, "error APSDE-DATA.confirm: 0x%02X on task\n", status);
 
-                if (conf.status() == deCONZ::ApsNoAckStatus)
+                if (status == deCONZ::ApsNoAckStatus)
                 {
                     if (task.taskType == TaskGetGroupIdentifiers)
                     {
                         Sensor *s = getSensorNodeForAddress(task.req.dstAddress().ext());
                         if (s && s->isAvailable())
                         {
-                            s->setNextReadTime(QTime::currentTime().addMSecs(ReadAttributesLongDelay));
+                            s->setNextReadTime(clockMonotonicMs() + ReadAttributesLongDelay);
                             s->enableRead(READ_GROUP_IDENTIFIERS);
                             s->setLastRead(idleTotalCounter);
                         }
@@ -386,26 +463,14 @@ void DeRestPluginPrivate::apsdeDataConfirm(const deCONZ::ApsDataConfirm &conf)
             }
 
             DBG_Printf(DBG_INFO_L2, "Erase task zclSequenceNumber: %u\n", task.zclFrame.sequenceNumber());
-            runningTasks.erase(i);
+            releaseTask(runningTasks, i);
             processTasks();
 
-            return;
+            return true;
         }
     }
 
-    if (handleMgmtBindRspConfirm(conf))
-    {
-        return;
-    }
-
-    if (channelChangeApsRequestId == conf.id())
-    {
-        channelChangeSendConfirm(conf.status() == deCONZ::ApsSuccessStatus);
-    }
-    if (resetDeviceApsRequestId == conf.id())
-    {
-        resetDeviceSendConfirm(conf.status() == deCONZ::ApsSuccessStatus);
-    }
+    return false;
 }
 
 /*! Process incoming green power button event.
@@ -444,6 +509,7 @@ void DeRestPluginPrivate::gpProcessButtonEvent(const deCONZ::GpDataIndication &i
 
     sensor->state().setButtonevent(ind.gpdCommandId());
     sensor->state().updateTime();
+    sensor->changes.set(Sensor::FieldState);
     updateEtag(sensor->etag);
 
     QString address = "";
@@ -571,7 +637,7 @@ void DeRestPluginPrivate::gpProcessButtonEvent(const deCONZ::GpDataIndication &i
 
                                         for (; ls != lsend; ++ls)
                                         {
-                                            LightNode *light = getLightNodeForId(ls->lid());
+                                            LightNode *light = getLightNodeForHandle(ls->lightHandle());
                                             if (light && light->isAvailable() && light->state() != LightNode::StateDeleted)
                                             {
                                                 bool changed = false;
@@ -860,7 +926,7 @@ void DeRestPluginPrivate::gpProcessButtonEvent(const deCONZ::GpDataIndication &i
                 Rule *saveRule = getRuleForId(r->id());
                 if (saveRule)
                 {
-                    saveRule->setLastTriggered(QDateTime::currentDateTimeUtc().toString("yyyy-MM-ddTHH:mm:ss"));
+                    saveRule->setLastTriggered(clockTimestamp());
                     saveRule->setTimesTriggered(r->timesTriggered()+1);
                 }
             }
@@ -946,68 +1012,15 @@ void DeRestPluginPrivate::gpDataIndication(const deCONZ::GpDataIndication &ind)
 
     case deCONZ::GpCommandIdCommissioning:
     {
-        // 1    8-bit enum    GPD DeviceID
-        // 1    8-bit bmp     Options
-        // 0/1  8-bit bmp     Extended Options
-        // 0/16 Security Key  GPD Key
-        // 0/4  u32           GPD Key MIC
-        // 0/4  u32           GPD outgoing counter
-
-        quint8 gpdDeviceId;
-        quint8 gpdKey[16];
-        quint32 gpdMIC = 0;
-        quint32 gpdOutgoingCounter = 0;
-        deCONZ::GPCommissioningOptions options;
-        deCONZ::GpExtCommissioningOptions extOptions;
-        options.byte = 0;
-        extOptions.byte = 0;
-
-        QDataStream stream(ind.payload());
-        stream.setByteOrder(QDataStream::LittleEndian);
-
-        if (stream.atEnd()) { return; }
-        stream >> gpdDeviceId;
-
-        if (stream.atEnd()) { return; }
-        stream >> options.byte;
-
-        if (options.bits.extOptionsField)
-        {
-            if (stream.atEnd()) { return; }
-            stream >> extOptions.byte;
-        }
-
-        if (extOptions.bits.gpdKeyPresent)
-        {
-            for (int i = 0; i < 16; i++)
-            {
-                if (stream.atEnd()) { return; }
-                stream >> gpdKey[i];
-
-            }
+        FrameReader reader(ind.payload());
+        GpCommissioningFrame frame;
 
-            if (extOptions.bits.gpdKeyEncryption)
-            {
-                // TODO decrypt key
-
-                if (stream.atEnd()) { return; }
-                stream >> gpdMIC;
-            }
-        }
-
-        switch (extOptions.bits.securityLevelCapabilities)
-        {
-        case 0:
-        default:
-            break;
-        }
-
-        if (extOptions.bits.gpdOutgoingCounterPresent)
+        if (!decodeGpCommissioningFrame(reader, frame))
         {
-            if (stream.atEnd()) { return; }
-            stream >> gpdOutgoingCounter;
+            return;
         }
 
+        const quint8 gpdDeviceId = frame.deviceId;
 
         SensorFingerprint fp;
         fp.endpoint = GREEN_POWER_ENDPOINT;
@@ -1064,6 +1077,7 @@ void DeRestPluginPrivate::gpDataIndication(const deCONZ::GpDataIndication &ind)
             updateEtag(gwConfigEtag);
 
             sensors.push_back(sensorNode);
+            indexSensor(sensors.size() - 1);
             queSaveDb(DB_SENSORS , DB_SHORT_SAVE_DELAY);
         }
         else if (sensor && sensor->deletedState() == Sensor::StateDeleted)
@@ -1097,6 +1111,21 @@ bool DeRestPluginPrivate::isInNetwork()
     return false;
 }
 
+/*! Returns true if tasks can be queued and sent.
+    This is the case in a ZigBee network or, in builds with CONFIG+=simulation,
+    while virtual devices are simulated, these don't need the network.
+ */
+bool DeRestPluginPrivate::canSendTasks()
+{
+#ifdef DECONZ_REST_SIMULATION
+    if (!simDevices.empty())
+    {
+        return true;
+    }
+#endif
+    return isInNetwork();
+}
+
 /*! Creates a error map used in JSON response.
     \param id - error id
     \param ressource example: "/lights/2"
@@ -1195,7 +1224,7 @@ void DeRestPluginPrivate::addLightNode(const deCONZ::Node *node)
                 // refresh all with new values
                 DBG_Printf(DBG_INFO, "LightNode %u: %s updated\n", lightNode2->id().toUInt(), qPrintable(lightNode2->name()));
                 lightNode2->setIsAvailable(true);
-                lightNode2->setNextReadTime(QTime::currentTime().addMSecs(ReadAttributesLongDelay));
+                lightNode2->setNextReadTime(clockMonotonicMs() + ReadAttributesLongDelay);
                 lightNode2->enableRead(READ_VENDOR_NAME |
                                        READ_MODEL_ID |
                                        READ_SWBUILD_ID |
@@ -1349,7 +1378,7 @@ void DeRestPluginPrivate::addLightNode(const deCONZ::Node *node)
             }
 
             // force reading attributes
-            lightNode.setNextReadTime(QTime::currentTime().addMSecs(ReadAttributesLongDelay));
+            lightNode.setNextReadTime(clockMonotonicMs() + ReadAttributesLongDelay);
             lightNode.enableRead(READ_VENDOR_NAME |
                                  READ_MODEL_ID |
                                  READ_SWBUILD_ID |
@@ -1364,6 +1393,7 @@ void DeRestPluginPrivate::addLightNode(const deCONZ::Node *node)
 
             DBG_Printf(DBG_INFO, "LightNode %u: %s added\n", lightNode.id().toUInt(), qPrintable(lightNode.name()));
             nodes.push_back(lightNode);
+            indexLight(nodes.size() - 1);
             lightNode2 = &nodes.back();
 
             Q_Q(DeRestPlugin);
@@ -1504,48 +1534,8 @@ LightNode *DeRestPluginPrivate::updateLightNode(const deCONZ::NodeEvent &event)
             continue;
         }
 
-        if (i->profileId() == HA_PROFILE_ID)
-        {
-            switch(i->deviceId())
-            {
-            case DEV_ID_MAINS_POWER_OUTLET:
-            case DEV_ID_HA_COLOR_DIMMABLE_LIGHT:
-            case DEV_ID_ZLL_COLOR_LIGHT:
-            case DEV_ID_ZLL_EXTENDED_COLOR_LIGHT:
-            case DEV_ID_ZLL_COLOR_TEMPERATURE_LIGHT:
-            case DEV_ID_HA_DIMMABLE_LIGHT:
-            //case DEV_ID_ZLL_DIMMABLE_LIGHT: // same as DEV_ID_HA_ONOFF_LIGHT
-            case DEV_ID_ZLL_DIMMABLE_PLUGIN_UNIT:
-            case DEV_ID_HA_ONOFF_LIGHT:
-            case DEV_ID_ONOFF_OUTPUT:
-            case DEV_ID_ZLL_ONOFF_LIGHT:
-            case DEV_ID_ZLL_ONOFF_PLUGIN_UNIT:
-            case DEV_ID_ZLL_ONOFF_SENSOR:
-                break;
-
-            default:
-                continue;
-            }
-        }
-        else if (i->profileId() == ZLL_PROFILE_ID)
-        {
-            switch(i->deviceId())
-            {
-            case DEV_ID_ZLL_COLOR_LIGHT:
-            case DEV_ID_ZLL_EXTENDED_COLOR_LIGHT:
-            case DEV_ID_ZLL_COLOR_TEMPERATURE_LIGHT:
-            case DEV_ID_ZLL_DIMMABLE_LIGHT:
-            case DEV_ID_ZLL_DIMMABLE_PLUGIN_UNIT:
-            case DEV_ID_ZLL_ONOFF_LIGHT:
-            case DEV_ID_ZLL_ONOFF_PLUGIN_UNIT:
-            case DEV_ID_ZLL_ONOFF_SENSOR:
-                break;
-
-            default:
-                continue;
-            }
-        }
-        else
+        // only light device types, the same table decides which clusters are read
+        if (DeviceProfileDatabase::capabilitiesForDeviceId(i->profileId(), i->deviceId()) == 0)
         {
             continue;
         }
@@ -1731,6 +1721,11 @@ LightNode *DeRestPluginPrivate::updateLightNode(const deCONZ::NodeEvent &event)
     {
         updateEtag(lightNode->etag);
         updateEtag(gwConfigEtag);
+
+        if (!groupStatePlans.empty())
+        {
+            groupPlanVerify(lightNode);
+        }
     }
 
     return lightNode;
@@ -1780,46 +1775,73 @@ int DeRestPluginPrivate::getNumberOfEndpoints(quint64 extAddr)
  */
 LightNode *DeRestPluginPrivate::getLightNodeForId(const QString &id)
 {
-    std::vector<LightNode>::iterator i;
-    std::vector<LightNode>::iterator end = nodes.end();
+    return getLightNodeForHandle(findIdHandle(id));
+}
 
-    for (i = nodes.begin(); i != end; ++i)
+/*! Returns a LightNode for its given \p handle or 0 if not found.
+ */
+LightNode *DeRestPluginPrivate::getLightNodeForHandle(quint32 handle)
+{
+    if (handle == 0)
     {
-        if (i->id() == id)
+        return 0;
+    }
+
+    QHash<quint32, int>::const_iterator i = lightIndexes.find(handle);
+
+    if (i == lightIndexes.end())
+    {
+        return 0;
+    }
+
+    if (i.value() >= (int)nodes.size() || nodes[i.value()].handle() != handle)
+    {
+        rebuildResourceIndexes(); // stale, the vector was replaced
+        i = lightIndexes.find(handle);
+        if (i == lightIndexes.end())
         {
-            return &(*i);
+            return 0;
         }
     }
 
-    return 0;
+    return &nodes[i.value()];
 }
 
 /*! Returns a Rule for its given \p id or 0 if not found.
  */
 Rule *DeRestPluginPrivate::getRuleForId(const QString &id)
 {
-    std::vector<Rule>::iterator i;
-    std::vector<Rule>::iterator end = rules.end();
+    return getRuleForHandle(findIdHandle(id));
+}
 
-    for (i = rules.begin(); i != end; ++i)
+/*! Returns a Rule for its given \p handle or 0 if not found.
+    Rules which aren't deleted are preferred, see indexRule().
+ */
+Rule *DeRestPluginPrivate::getRuleForHandle(quint32 handle)
+{
+    if (handle == 0)
     {
-        if (i->id() == id && i->state() != Rule::StateDeleted)
-        {
-            return &(*i);
-        }
+        return 0;
     }
 
-    end = rules.end();
+    QHash<quint32, int>::const_iterator i = ruleIndexes.find(handle);
 
-    for (i = rules.begin(); i != end; ++i)
+    if (i == ruleIndexes.end())
     {
-        if (i->id() == id)
+        return 0;
+    }
+
+    if (i.value() >= (int)rules.size() || rules[i.value()].handle() != handle)
+    {
+        rebuildResourceIndexes(); // stale, the vector was replaced
+        i = ruleIndexes.find(handle);
+        if (i == ruleIndexes.end())
         {
-            return &(*i);
+            return 0;
         }
     }
 
-    return 0;
+    return &rules[i.value()];
 }
 
 /*! Returns a Rule for its given \p name or 0 if not found.
@@ -1888,7 +1910,7 @@ void DeRestPluginPrivate::checkSensorNodeReachable(Sensor *sensor)
             // refresh all with new values
             DBG_Printf(DBG_INFO, "SensorNode id: %s (%s) available\n", qPrintable(sensor->id()), qPrintable(sensor->name()));
             sensor->setIsAvailable(true);
-            sensor->setNextReadTime(QTime::currentTime().addMSecs(ReadAttributesLongDelay));
+            sensor->setNextReadTime(clockMonotonicMs() + ReadAttributesLongDelay);
             sensor->enableRead(READ_BINDING_TABLE/* | READ_GROUP_IDENTIFIERS | READ_MODEL_ID | READ_SWBUILD_ID | READ_VENDOR_NAME*/);
             sensor->setLastRead(idleTotalCounter);
             checkSensorBindingsForAttributeReporting(sensor);
@@ -1899,7 +1921,7 @@ void DeRestPluginPrivate::checkSensorNodeReachable(Sensor *sensor)
         {
             DBG_Printf(DBG_INFO, "Rediscovered deleted SensorNode %s set node %s\n", qPrintable(sensor->id()), qPrintable(sensor->address().toStringExt()));
             sensor->setDeletedState(Sensor::StateNormal);
-            sensor->setNextReadTime(QTime::currentTime().addMSecs(ReadAttributesLongDelay));
+            sensor->setNextReadTime(clockMonotonicMs() + ReadAttributesLongDelay);
             sensor->enableRead(READ_BINDING_TABLE | READ_GROUP_IDENTIFIERS | READ_MODEL_ID | READ_VENDOR_NAME);
             sensor->setLastRead(idleTotalCounter);
             updated = true;
@@ -2090,7 +2112,7 @@ void DeRestPluginPrivate::addSensorNode(const deCONZ::Node *node)
             {
                 sensor->setLastRead(idleTotalCounter);
                 sensor->enableRead(READ_OCCUPANCY_CONFIG);
-                sensor->setNextReadTime(QTime::currentTime().addMSecs(ReadAttributesLongDelay));
+                sensor->setNextReadTime(clockMonotonicMs() + ReadAttributesLongDelay);
                 checkSensorNodeReachable(sensor);
                 Q_Q(DeRestPlugin);
                 q->startZclAttributeTimer(checkZclAttributesDelay);
@@ -2167,7 +2189,7 @@ void DeRestPluginPrivate::addSensorNode(const deCONZ::Node *node, const SensorFi
     }
 
     // force reading attributes
-    sensorNode.setNextReadTime(QTime::currentTime().addMSecs(ReadAttributesLongDelay));
+    sensorNode.setNextReadTime(clockMonotonicMs() + ReadAttributesLongDelay);
     sensorNode.enableRead(READ_BINDING_TABLE);
     sensorNode.setLastRead(idleTotalCounter);
     {
@@ -2177,21 +2199,21 @@ void DeRestPluginPrivate::addSensorNode(const deCONZ::Node *node, const SensorFi
         {
             if (*ci == OCCUPANCY_SENSING_CLUSTER_ID)
             {
-                sensorNode.setNextReadTime(QTime::currentTime().addMSecs(ReadAttributesLongDelay));
+                sensorNode.setNextReadTime(clockMonotonicMs() + ReadAttributesLongDelay);
                 sensorNode.enableRead(READ_OCCUPANCY_CONFIG);
                 sensorNode.setLastRead(idleTotalCounter);
             }
             else if (*ci == COMMISSIONING_CLUSTER_ID)
             {
                 DBG_Printf(DBG_INFO, "SensorNode %u: %s read group identifiers\n", sensorNode.id().toUInt(), qPrintable(sensorNode.name()));
-                sensorNode.setNextReadTime(QTime::currentTime().addMSecs(ReadAttributesLongDelay));
+                sensorNode.setNextReadTime(clockMonotonicMs() + ReadAttributesLongDelay);
                 sensorNode.enableRead(READ_GROUP_IDENTIFIERS);
                 sensorNode.setLastRead(idleTotalCounter);
             }
             else if (*ci == BASIC_CLUSTER_ID)
             {
                 DBG_Printf(DBG_INFO, "SensorNode %u: %s read model id and vendor name\n", sensorNode.id().toUInt(), qPrintable(sensorNode.name()));
-                sensorNode.setNextReadTime(QTime::currentTime().addMSecs(ReadAttributesLongDelay));
+                sensorNode.setNextReadTime(clockMonotonicMs() + ReadAttributesLongDelay);
                 sensorNode.enableRead(READ_MODEL_ID | READ_VENDOR_NAME);
                 sensorNode.setLastRead(idleTotalCounter);
             }
@@ -2202,6 +2224,7 @@ void DeRestPluginPrivate::addSensorNode(const deCONZ::Node *node, const SensorFi
     updateEtag(sensorNode.etag);
 
     sensors.push_back(sensorNode);
+    indexSensor(sensors.size() - 1);
 
     checkSensorBindingsForAttributeReporting(&sensors.back());
 
@@ -2211,6 +2234,76 @@ void DeRestPluginPrivate::addSensorNode(const deCONZ::Node *node, const SensorFi
     queSaveDb(DB_SENSORS , DB_SHORT_SAVE_DELAY);
 }
 
+/*! Publishes a measured illuminance which passed the significance filter.
+    \param sensor - the light level sensor
+    \param lux - the ZCL attribute value, or lux for devices with QuirkRawIlluminance
+ */
+void DeRestPluginPrivate::updateSensorLux(Sensor *sensor, quint32 lux)
+{
+    if (sensor->hasQuirk(QuirkRawIlluminance))
+    {
+        // TODO check firmware version
+    }
+    else if (lux > 0 && lux < 0xffff)
+    {
+        // valid values are 1 - 0xfffe
+        // 0, too low to measure
+        // 0xffff invalid value
+
+        // ZCL Attribute = 10.000 * log10(Illuminance (lx)) + 1
+        // lux = 10^(ZCL Attribute/10.000) - 1
+        qreal exp = lux;
+        qreal l = qPow(10, exp / 10000.0f);
+
+        if (l >= 1)
+        {
+            l -= 1;
+            lux = static_cast<quint32>(l);
+        }
+        else
+        {
+            DBG_Printf(DBG_INFO, "invalid lux value %u", lux);
+            lux = 0xffff; // invalid value
+        }
+    }
+
+    sensor->state().updateTime();
+    sensor->changes.set(Sensor::FieldState);
+    if (sensor->state().lux() != lux)
+    {
+        sensor->state().setLux(lux);
+        updateEtag(sensor->etag);
+        updateEtag(gwConfigEtag);
+    }
+}
+
+/*! Publishes significant values which arrived within the minimum interval
+    of their sensor once the interval has passed. Called by the idle timer.
+ */
+void DeRestPluginPrivate::publishPendingSensorValues()
+{
+    const qint64 now = clockMonotonicMs();
+    std::vector<Sensor>::iterator i = sensors.begin();
+    std::vector<Sensor>::iterator end = sensors.end();
+
+    for (; i != end; ++i)
+    {
+        int raw;
+
+        if (!i->valueFilter().hasPending() || i->deletedState() == Sensor::StateDeleted)
+        {
+            continue;
+        }
+
+        // only the illuminance of ZHALight sensors is filtered so far
+        if (i->valueFilter().takePending(now, i->significance(), &raw))
+        {
+            DBG_Printf(DBG_INFO_L2, "publish held back illuminance of sensor %s\n", qPrintable(i->name()));
+            updateSensorLux(&*i, raw);
+        }
+    }
+}
+
 /*! Updates/adds a SensorNode from a Node.
     If the node does not exist it will be created
     otherwise the values will be checked for change
@@ -2274,9 +2367,13 @@ void DeRestPluginPrivate::updateSensorNode(const deCONZ::NodeEvent &event)
                     config.setBattery(255); // invalid
                 }
 
-                i->setConfig(config);
-                updateEtag(i->etag);
-                updateEtag(gwConfigEtag);
+                // the power descriptor only knows a few levels, publish changes only
+                if (config.battery() != i->config().battery())
+                {
+                    i->setConfig(config);
+                    updateEtag(i->etag);
+                    updateEtag(gwConfigEtag);
+                }
             }
             return;
         }
@@ -2363,40 +2460,19 @@ void DeRestPluginPrivate::updateSensorNode(const deCONZ::NodeEvent &event)
 
                                 quint32 lux = ia->numericValue().u16; // ZigBee uses a 16-bit value
 
-                                if (i->modelId().startsWith("FLS-NB"))
-                                {
-                                    // TODO check firmware version
-                                }
-                                else if (lux > 0 && lux < 0xffff)
+                                // the filter works on the log scale of the ZCL attribute, values of
+                                // devices which report lux are mapped to it, so a delta is a relative change
+                                int measured = lux;
+                                if (i->hasQuirk(QuirkRawIlluminance) && lux > 0 && lux < 0xffff)
                                 {
-                                    // valid values are 1 - 0xfffe
-                                    // 0, too low to measure
-                                    // 0xffff invalid value
-
-                                    // ZCL Attribute = 10.000 * log10(Illuminance (lx)) + 1
-                                    // lux = 10^(ZCL Attribute/10.000) - 1
-                                    qreal exp = lux;
-                                    qreal l = qPow(10, exp / 10000.0f);
-
-                                    if (l >= 1)
-                                    {
-                                        l -= 1;
-                                        lux = static_cast<quint32>(l);
-                                    }
-                                    else
-                                    {
-                                        DBG_Printf(DBG_INFO, "invalid lux value %u", lux);
-                                        lux = 0xffff; // invalid value
-                                    }
+                                    measured = qMin(0xfffe, (int)(10000.0 * qLn((qreal)lux) / qLn(10.0) + 1));
                                 }
 
-                                i->state().updateTime();
-                                if (i->state().lux() != lux)
+                                // drop noise before any state, etag, rule or database work,
+                                // a significant value within the minimum interval is published later
+                                if (i->valueFilter().accept(measured, lux, clockMonotonicMs(), i->significance()))
                                 {
-                                    i->state().setLux(lux);
-                                    updateEtag(i->etag);
-                                    updateEtag(gwConfigEtag);
-//                                    updated = true;
+                                    updateSensorLux(&*i, lux);
                                 }
                             }
                         }
@@ -2432,7 +2508,7 @@ void DeRestPluginPrivate::updateSensorNode(const deCONZ::NodeEvent &event)
                                         DBG_Printf(DBG_INFO, "occupied to unoccupied delay is %u should be %u, force rewrite\n", ia->numericValue().u16, (quint16)i->config().duration());
                                         i->enableRead(WRITE_OCCUPANCY_CONFIG);
                                         i->enableRead(READ_OCCUPANCY_CONFIG);
-                                        i->setNextReadTime(QTime::currentTime());
+                                        i->setNextReadTime(clockMonotonicMs());
                                         Q_Q(DeRestPlugin);
                                         q->startZclAttributeTimer(checkZclAttributesDelay);
                                     }
@@ -2662,18 +2738,36 @@ Sensor *DeRestPluginPrivate::getSensorNodeForUniqueId(const QString &uniqueId)
  */
 Sensor *DeRestPluginPrivate::getSensorNodeForId(const QString &id)
 {
-    std::vector<Sensor>::iterator i;
-    std::vector<Sensor>::iterator end = sensors.end();
+    return getSensorNodeForHandle(findIdHandle(id));
+}
 
-    for (i = sensors.begin(); i != end; ++i)
+/*! Returns a Sensor for its given \p handle or 0 if not found.
+ */
+Sensor *DeRestPluginPrivate::getSensorNodeForHandle(quint32 handle)
+{
+    if (handle == 0)
     {
-        if (i->id() == id)
+        return 0;
+    }
+
+    QHash<quint32, int>::const_iterator i = sensorIndexes.find(handle);
+
+    if (i == sensorIndexes.end())
+    {
+        return 0;
+    }
+
+    if (i.value() >= (int)sensors.size() || sensors[i.value()].handle() != handle)
+    {
+        rebuildResourceIndexes(); // stale, the vector was replaced
+        i = sensorIndexes.find(handle);
+        if (i == sensorIndexes.end())
         {
-            return &(*i);
+            return 0;
         }
     }
 
-    return 0;
+    return &sensors[i.value()];
 }
 
 /*! Returns a Group for a given group id or 0 if not found.
@@ -2811,6 +2905,7 @@ GroupInfo *DeRestPluginPrivate::createGroupInfo(LightNode *lightNode, uint16_t i
     GroupInfo groupInfo;
     groupInfo.id = id;
     lightNode->groups().push_back(groupInfo);
+    lightNode->changes.set(LightNode::FieldGroups);
 
     return &lightNode->groups().back();
 }
@@ -2897,7 +2992,7 @@ bool DeRestPluginPrivate::processZclAttributes(LightNode *lightNode)
     }
 
     // check if read should happen now
-    if (lightNode->nextReadTime() > QTime::currentTime())
+    if (lightNode->nextReadTime() > clockMonotonicMs())
     {
         return false;
     }
@@ -2907,6 +3002,11 @@ bool DeRestPluginPrivate::processZclAttributes(LightNode *lightNode)
         return false;
     }
 
+    if (isNeighbourhoodCongested(lightNode->address(), true))
+    {
+        return false; // read later
+    }
+
     deCONZ::ApsController *apsCtrl = deCONZ::ApsController::instance();
     DBG_Assert(apsCtrl != 0);
     if (apsCtrl && (apsCtrl->getParameter(deCONZ::ParamAutoPollingActive) == 0))
@@ -2915,66 +3015,13 @@ bool DeRestPluginPrivate::processZclAttributes(LightNode *lightNode)
     }
 
     int processed = 0;
-    bool readColor = false;
-    bool readLevel = false;
-    bool readOnOff = false;
-
-    if (lightNode->haEndpoint().profileId() == ZLL_PROFILE_ID)
-    {
-        switch(lightNode->haEndpoint().deviceId())
-        {
-        case DEV_ID_ZLL_COLOR_LIGHT:
-        case DEV_ID_ZLL_EXTENDED_COLOR_LIGHT:
-        case DEV_ID_ZLL_COLOR_TEMPERATURE_LIGHT:
-            readColor = true;
-            //fall through
-
-        case DEV_ID_ZLL_DIMMABLE_LIGHT:
-        case DEV_ID_ZLL_DIMMABLE_PLUGIN_UNIT:
-            readLevel = true;
-            //fall through
-
-        case DEV_ID_ZLL_ONOFF_LIGHT:
-        case DEV_ID_ZLL_ONOFF_PLUGIN_UNIT:
-        case DEV_ID_ZLL_ONOFF_SENSOR:
-            readOnOff = true;
-            break;
-
-        default:
-            break;
-        }
-    }
-    else if (lightNode->haEndpoint().profileId() == HA_PROFILE_ID)
-    {
-        switch(lightNode->haEndpoint().deviceId())
-        {
-        case DEV_ID_HA_COLOR_DIMMABLE_LIGHT:
-        case DEV_ID_ZLL_COLOR_LIGHT:
-        case DEV_ID_ZLL_EXTENDED_COLOR_LIGHT:
-        case DEV_ID_ZLL_COLOR_TEMPERATURE_LIGHT:
-            readColor = true;
-            //fall through
-
-        case DEV_ID_HA_DIMMABLE_LIGHT:
-        //case DEV_ID_ZLL_DIMMABLE_LIGHT: // same as DEV_ID_HA_ONOFF_LIGHT
-        case DEV_ID_ZLL_DIMMABLE_PLUGIN_UNIT:
-            readLevel = true;
-            //fall through
-
-        case DEV_ID_MAINS_POWER_OUTLET:
-        case DEV_ID_HA_ONOFF_LIGHT:
-        case DEV_ID_ZLL_ONOFF_LIGHT:
-        case DEV_ID_ZLL_ONOFF_PLUGIN_UNIT:
-        case DEV_ID_ZLL_ONOFF_SENSOR:
-            readOnOff = true;
-            break;
 
-        default:
-            break;
-        }
-    }
+    const bool readColor = lightNode->hasCapability(CapReadColor);
+    const bool readLevel = lightNode->hasCapability(CapReadLevel);
+    const bool readOnOff = lightNode->hasCapability(CapReadOnOff);
+    const uint32_t allowedReads = startupAllowedReads(); // reads of later startup stages wait
 
-    if (lightNode->mustRead(READ_BINDING_TABLE))
+    if ((allowedReads & READ_BINDING_TABLE) && lightNode->mustRead(READ_BINDING_TABLE))
     {
         if (readBindingTable(lightNode, 0))
         {
@@ -3029,31 +3076,33 @@ bool DeRestPluginPrivate::processZclAttributes(LightNode *lightNode)
         }
     }
 
-    if ((processed < 2) && readOnOff && lightNode->mustRead(READ_ON_OFF))
+    if ((processed < 2) && readOnOff && (allowedReads & READ_ON_OFF) && lightNode->mustRead(READ_ON_OFF))
     {
         std::vector<uint16_t> attributes;
         attributes.push_back(0x0000); // OnOff
 
-        if (readAttributes(lightNode, lightNode->haEndpoint().endpoint(), ONOFF_CLUSTER_ID, attributes))
+        if (verifyGroupState(lightNode, READ_ON_OFF) ||
+            readAttributes(lightNode, lightNode->haEndpoint().endpoint(), ONOFF_CLUSTER_ID, attributes))
         {
             lightNode->clearRead(READ_ON_OFF);
             processed++;
         }
     }
 
-    if ((processed < 2) && readLevel && lightNode->mustRead(READ_LEVEL))
+    if ((processed < 2) && readLevel && (allowedReads & READ_LEVEL) && lightNode->mustRead(READ_LEVEL))
     {
         std::vector<uint16_t> attributes;
         attributes.push_back(0x0000); // Level
 
-        if (readAttributes(lightNode, lightNode->haEndpoint().endpoint(), LEVEL_CLUSTER_ID, attributes))
+        if (verifyGroupState(lightNode, READ_LEVEL) ||
+            readAttributes(lightNode, lightNode->haEndpoint().endpoint(), LEVEL_CLUSTER_ID, attributes))
         {
             lightNode->clearRead(READ_LEVEL);
             processed++;
         }
     }
 
-    if ((processed < 2) && readColor && lightNode->mustRead(READ_COLOR))
+    if ((processed < 2) && readColor && (allowedReads & READ_COLOR) && lightNode->mustRead(READ_COLOR))
     {
         std::vector<uint16_t> attributes;
         attributes.push_back(0x0000); // Current hue
@@ -3065,14 +3114,15 @@ bool DeRestPluginPrivate::processZclAttributes(LightNode *lightNode)
         attributes.push_back(0x4000); // Enhanced hue
         attributes.push_back(0x4002); // Color loop active
 
-        if (readAttributes(lightNode, lightNode->haEndpoint().endpoint(), COLOR_CLUSTER_ID, attributes))
+        if (verifyGroupState(lightNode, READ_COLOR) ||
+            readAttributes(lightNode, lightNode->haEndpoint().endpoint(), COLOR_CLUSTER_ID, attributes))
         {
             lightNode->clearRead(READ_COLOR);
             processed++;
         }
     }
 
-    if ((processed < 2) && lightNode->mustRead(READ_GROUPS))
+    if ((processed < 2) && (allowedReads & READ_GROUPS) && lightNode->mustRead(READ_GROUPS))
     {
         std::vector<uint16_t> groups; // empty meaning read all groups
         if (readGroupMembership(lightNode, groups))
@@ -3082,7 +3132,7 @@ bool DeRestPluginPrivate::processZclAttributes(LightNode *lightNode)
         }
     }
 
-    if ((processed < 2) && lightNode->mustRead(READ_SCENES) && !lightNode->groups().empty())
+    if ((processed < 2) && (allowedReads & READ_SCENES) && lightNode->mustRead(READ_SCENES) && !lightNode->groups().empty())
     {
         std::vector<GroupInfo>::iterator i = lightNode->groups().begin();
         std::vector<GroupInfo>::iterator end = lightNode->groups().end();
@@ -3124,7 +3174,7 @@ bool DeRestPluginPrivate::processZclAttributes(LightNode *lightNode)
 
     }
 
-    if ((processed < 2) && lightNode->mustRead(READ_SCENE_DETAILS))
+    if ((processed < 2) && (allowedReads & READ_SCENE_DETAILS) && lightNode->mustRead(READ_SCENE_DETAILS))
     {
         std::vector<GroupInfo>::iterator g = lightNode->groups().begin();
         std::vector<GroupInfo>::iterator gend = lightNode->groups().end();
@@ -3188,7 +3238,7 @@ bool DeRestPluginPrivate::processZclAttributes(Sensor *sensorNode)
     }
 
     // check if read should happen now
-    if (sensorNode->nextReadTime() > QTime::currentTime())
+    if (sensorNode->nextReadTime() > clockMonotonicMs())
     {
         return false;
     }
@@ -3203,6 +3253,11 @@ bool DeRestPluginPrivate::processZclAttributes(Sensor *sensorNode)
         return false;
     }
 
+    if (isNeighbourhoodCongested(sensorNode->address(), true))
+    {
+        return false; // read later
+    }
+
 //    deCONZ::ApsController *apsCtrl = deCONZ::ApsController::instance();
 //    DBG_Assert(apsCtrl != 0);
 //    if (apsCtrl && (apsCtrl->getParameter(deCONZ::ParamAutoPollingActive) == 0))
@@ -3210,19 +3265,11 @@ bool DeRestPluginPrivate::processZclAttributes(Sensor *sensorNode)
 //        return false;
 //    }
 
-    if (sensorNode->mustRead(READ_BINDING_TABLE))
+    if ((startupAllowedReads() & READ_BINDING_TABLE) && sensorNode->mustRead(READ_BINDING_TABLE))
     {
-        bool ok = false;
         // only read binding table of chosen sensors
-        // whitelist by Model ID
-        if (sensorNode->modelId().startsWith("FLS-NB") ||
-            sensorNode->modelId().startsWith("D1") || sensorNode->modelId().startsWith("S1") ||
-            sensorNode->modelId().startsWith("S2") || sensorNode->manufacturer().startsWith("BEGA") ||
-            sensorNode->modelId().startsWith("C4") ||
-            sensorNode->modelId().startsWith("LM_00.00"))
-        {
-            ok = true;
-        }
+        // whitelist by device profile
+        bool ok = sensorNode->hasCapability(CapReadBindingTable);
 
         if (!ok)
         {
@@ -3638,6 +3685,7 @@ void DeRestPluginPrivate::foundGroupMembership(LightNode *lightNode, uint16_t gr
                 if (i->state != GroupInfo::StateNotInGroup)
                 {
                     i->state = GroupInfo::StateNotInGroup;
+                    lightNode->changes.set(LightNode::FieldGroups);
                     queSaveDb(DB_LIGHTS, DB_SHORT_SAVE_DELAY);
                 }
             }
@@ -3670,6 +3718,7 @@ void DeRestPluginPrivate::foundGroupMembership(LightNode *lightNode, uint16_t gr
 
     queSaveDb(DB_LIGHTS, DB_SHORT_SAVE_DELAY);
     lightNode->groups().push_back(groupInfo);
+    lightNode->changes.set(LightNode::FieldGroups);
     markForPushUpdate(lightNode);
 }
 
@@ -3714,7 +3763,7 @@ void DeRestPluginPrivate::foundGroup(uint16_t groupId)
 
 /*! Returns true if the \p lightNode is member of the group with the \p groupId.
  */
-bool DeRestPluginPrivate::isLightNodeInGroup(LightNode *lightNode, uint16_t groupId)
+bool DeRestPluginPrivate::isLightNodeInGroup(const LightNode *lightNode, uint16_t groupId)
 {
     DBG_Assert(lightNode != 0);
 
@@ -3737,33 +3786,67 @@ bool DeRestPluginPrivate::isLightNodeInGroup(LightNode *lightNode, uint16_t grou
 
 /*! Delete the light with the \p lightId from all Scenes of the Group with the given \p groupId.
     Also remove these scenes from the Device.
+
+    Since the light keeps none of the group scenes, a single Remove All Scenes
+    command is used instead of one Remove Scene command per scene. If the light
+    is also removed from the group nothing needs to be sent, Remove Group
+    removes the scenes of the group as well.
  */
-void DeRestPluginPrivate::deleteLightFromScenes(QString lightId, uint16_t groupId)
+void DeRestPluginPrivate::deleteLightFromScenes(quint32 lightHandle, uint16_t groupId)
 {
     Group *group = getGroupForId(groupId);
-    LightNode *lightNode = getLightNodeForId(lightId);
+    LightNode *lightNode = getLightNodeForHandle(lightHandle);
 
-    if (group)
+    if (!group)
     {
-        std::vector<Scene>::iterator i = group->scenes.begin();
-        std::vector<Scene>::iterator end = group->scenes.end();
-
-        for (; i != end; ++i)
-        {
-            i->deleteLight(lightId);
+        return;
+    }
 
-            // send remove scene request to lightNode
-            if (isLightNodeInGroup(lightNode, group->address()))
-            {
-                GroupInfo *groupInfo = getGroupInfo(lightNode, group->address());
+    std::vector<Scene>::iterator i = group->scenes.begin();
+    std::vector<Scene>::iterator end = group->scenes.end();
 
-                std::vector<uint8_t> &v = groupInfo->removeScenes;
+    for (; i != end; ++i)
+    {
+        i->deleteLight(lightHandle);
+    }
 
-                if (std::find(v.begin(), v.end(), i->id) == v.end())
-                {
-                    groupInfo->removeScenes.push_back(i->id);
-                }
-            }
+    if (!isLightNodeInGroup(lightNode, group->address()))
+    {
+        return;
+    }
+
+    GroupInfo *groupInfo = getGroupInfo(lightNode, group->address());
+
+    if (!groupInfo)
+    {
+        return;
+    }
+
+    // pending scene operations are obsolete
+    groupInfo->addScenes.clear();
+    groupInfo->modifyScenes.clear();
+
+    if (groupInfo->actions & GroupInfo::ActionRemoveFromGroup)
+    {
+        groupInfo->removeScenes.clear();
+        return;
+    }
+
+    if (group->scenes.size() > 1)
+    {
+        groupInfo->removeScenes.clear();
+        groupInfo->actions |= GroupInfo::ActionRemoveAllScenes;
+        return;
+    }
+
+    // send remove scene request to lightNode
+    for (i = group->scenes.begin(); i != end; ++i)
+    {
+        std::vector<uint8_t> &v = groupInfo->removeScenes;
+
+        if (std::find(v.begin(), v.end(), i->id) == v.end())
+        {
+            groupInfo->removeScenes.push_back(i->id);
         }
     }
 }
@@ -3788,7 +3871,7 @@ void DeRestPluginPrivate::readAllInGroup(Group *group)
         if (isLightNodeInGroup(lightNode, group->address()))
         {
             // force reading attributes
-            lightNode->setNextReadTime(QTime::currentTime().addMSecs(ReadAttributesLongerDelay));
+            lightNode->setNextReadTime(clockMonotonicMs() + ReadAttributesLongerDelay);
             lightNode->enableRead(READ_ON_OFF | READ_COLOR | READ_LEVEL);
         }
     }
@@ -3896,6 +3979,11 @@ void DeRestPluginPrivate::foundScene(LightNode *lightNode, Group *group, uint8_t
         return;
     }
 
+    if (isGroupPlanScene(group->address(), sceneId))
+    {
+        return; // transient scene of the group state planner
+    }
+
     std::vector<Scene>::iterator i = group->scenes.begin();
     std::vector<Scene>::iterator end = group->scenes.end();
 
@@ -3986,7 +4074,7 @@ bool DeRestPluginPrivate::storeScene(Group *group, uint8_t sceneId)
         {
             GroupInfo *groupInfo = getGroupInfo(lightNode, group->address());
 
-            if (lightNode->sceneCapacity() != 0 || groupInfo->sceneCount() != 0) //xxx workaround
+            if (canPlaceScene(lightNode, group->address(), sceneId))
             {
                 std::vector<uint8_t> &v = groupInfo->addScenes;
 
@@ -3995,6 +4083,10 @@ bool DeRestPluginPrivate::storeScene(Group *group, uint8_t sceneId)
                     groupInfo->addScenes.push_back(sceneId);
                 }
             }
+            else
+            {
+                DBG_Printf(DBG_INFO, "skip store of scene %u in light %s, scene table full\n", sceneId, qPrintable(lightNode->id()));
+            }
         }
     }
 
@@ -4170,61 +4262,152 @@ void DeRestPluginPrivate::pushClientForClose(QTcpSocket *sock, int closeTimeout)
     openClients.push_back(client);
 }
 
+/*! Returns true if \p task replaces the queued task \p older.
+    Both are sent with the same parameters to the same destination and only
+    the last one needs to be sent.
+ */
+static bool taskSupersedes(const TaskItem &task, const TaskItem &older)
+{
+    if ((task.taskType == TaskGetSceneMembership) ||
+        (task.taskType == TaskGetGroupMembership) ||
+        (task.taskType == TaskGetGroupIdentifiers) ||
+        (task.taskType == TaskStoreScene) ||
+        (task.taskType == TaskRemoveScene) ||
+        (task.taskType == TaskRemoveAllScenes) ||
+        (task.taskType == TaskReadAttributes) ||
+        (task.taskType == TaskWriteAttribute) ||
+        (task.taskType == TaskViewScene) ||
+        (task.taskType == TaskAddScene))
+    {
+        return false;
+    }
+
+    return (older.taskType == task.taskType) &&
+           (older.req.dstAddress() ==  task.req.dstAddress()) &&
+           (older.req.dstEndpoint() ==  task.req.dstEndpoint()) &&
+           (older.req.srcEndpoint() ==  task.req.srcEndpoint()) &&
+           (older.req.profileId() ==  task.req.profileId()) &&
+           (older.req.clusterId() ==  task.req.clusterId()) &&
+           (older.req.txOptions() ==  task.req.txOptions()) &&
+           (older.req.asdu().size() ==  task.req.asdu().size());
+}
+
 /*! Adds a task to the queue.
+    Committed transaction tasks which still wait in the backlog and are
+    replaced by \p task are dropped, so they can't overwrite a newer command.
     \return true - on success
  */
 bool DeRestPluginPrivate::addTask(const TaskItem &task)
 {
-    if (!isInNetwork())
+    if (!addTaskToQueue(task))
     {
         return false;
     }
 
-    const uint MaxTasks = 20;
-
-    std::list<TaskItem>::iterator i = tasks.begin();
-    std::list<TaskItem>::iterator end = tasks.end();
-
-    if ((task.taskType != TaskGetSceneMembership) &&
-        (task.taskType != TaskGetGroupMembership) &&
-        (task.taskType != TaskGetGroupIdentifiers) &&
-        (task.taskType != TaskStoreScene) &&
-        (task.taskType != TaskRemoveScene) &&
-        (task.taskType != TaskRemoveAllScenes) &&
-        (task.taskType != TaskReadAttributes) &&
-        (task.taskType != TaskWriteAttribute) &&
-        (task.taskType != TaskViewScene) &&
-        (task.taskType != TaskAddScene))
+    if (!transactionActive && !transactionBacklog.empty())
     {
-        for (; i != end; ++i)
+        std::list<TaskItem>::iterator i = transactionBacklog.begin();
+
+        while (i != transactionBacklog.end())
         {
-            if (i->taskType == task.taskType)
+            if (taskSupersedes(task, *i))
             {
-                if ((i->req.dstAddress() ==  task.req.dstAddress()) &&
-                    (i->req.dstEndpoint() ==  task.req.dstEndpoint()) &&
-                    (i->req.srcEndpoint() ==  task.req.srcEndpoint()) &&
-                    (i->req.profileId() ==  task.req.profileId()) &&
-                    (i->req.clusterId() ==  task.req.clusterId()) &&
-                    (i->req.txOptions() ==  task.req.txOptions()) &&
-                    (i->req.asdu().size() ==  task.req.asdu().size()))
-
-                {
-                    DBG_Printf(DBG_INFO, "Replace task in queue cluster 0x%04X with newer task of same type\n", task.req.clusterId());
-                    *i = task;
-                    return true;
-                }
+                DBG_Printf(DBG_INFO, "Drop transaction task cluster 0x%04X replaced by newer task\n", i->req.clusterId());
+                std::list<TaskItem>::iterator next = i;
+                ++next;
+                releaseTask(transactionBacklog, i);
+                i = next;
             }
+            else
+            {
+                ++i;
+            }
+        }
+    }
+
+    return true;
+}
+
+/*! Adds a task to the queue, see addTask().
+    Used directly by queueTransactionTasks() for the backlog itself.
+    \return true - on success
+ */
+bool DeRestPluginPrivate::addTaskToQueue(const TaskItem &task)
+{
+    if (!canSendTasks())
+    {
+        return false;
+    }
+
+    // while a transaction is applied tasks are collected separately and
+    // handed to addTask() again on commit, commands for sleepy end-devices
+    // are diverted to the mailbox then, see queueTransactionTasks()
+    if (!transactionActive && mailboxHoldTask(task))
+    {
+        return true;
+    }
+
+    std::list<TaskItem> &queue = transactionActive ? transactionTasks : tasks;
+    const uint MaxTasks = transactionActive ? TRANSACTION_MAX_TASKS : 20;
+
+    std::list<TaskItem>::iterator i = queue.begin();
+    std::list<TaskItem>::iterator end = queue.end();
+
+    for (; i != end; ++i)
+    {
+        if (taskSupersedes(task, *i))
+        {
+            DBG_Printf(DBG_INFO, "Replace task in queue cluster 0x%04X with newer task of same type\n", task.req.clusterId());
+            memTaskRemoved(queue, *i);
+            *i = task;
+            memTaskAdded(queue, *i);
+            return true;
         }
     }
 
-    if (tasks.size() < MaxTasks) {
-        tasks.push_back(task);
+    // soft memory budget, see initMemory()
+    MemoryAccount &mem = memAccounts[transactionActive ? MemTransactions : MemTasks];
+    const size_t memBytes = transactionActive ? memTransactionBytes : memTaskBytes;
+    if (mem.budget > 0 && memBytes > mem.budget)
+    {
+        DBG_Printf(DBG_INFO, "Reject task, %s exceed memory budget of %u KB\n",
+                   transactionActive ? "transaction tasks" : "tasks", (uint)(mem.budget / 1024));
+        mem.sheds++;
+        return false;
+    }
+
+    if (queue.size() < MaxTasks) {
+        queue.push_back(task);
+        taskAllocStats.allocations++;
+        memTaskAdded(queue, queue.back());
         return true;
     }
 
     return false;
 }
 
+/*! Removes a task from \p list and updates the task memory accounting.
+    \param list - the list which holds the task (tasks or runningTasks)
+    \param i - iterator to the task
+ */
+void DeRestPluginPrivate::releaseTask(std::list<TaskItem> &list, std::list<TaskItem>::iterator i)
+{
+    memTaskRemoved(list, *i);
+    list.erase(i);
+    taskAllocStats.frees++;
+}
+
+/*! Removes all tasks from \p list, see releaseTask().
+    \param list - the list which holds the tasks (tasks or runningTasks)
+ */
+void DeRestPluginPrivate::releaseAllTasks(std::list<TaskItem> &list)
+{
+    while (!list.empty())
+    {
+        releaseTask(list, list.begin());
+    }
+}
+
 /*! Fills cluster, lightNode and node fields of \p task based on the information in \p ind.
     \return true - on success
  */
@@ -4274,22 +4457,56 @@ bool DeRestPluginPrivate::obtainTaskCluster(TaskItem &task, const deCONZ::ApsDat
  */
 void DeRestPluginPrivate::processTasks()
 {
+#ifdef DECONZ_REST_SIMULATION
+    if (!apsCtrl && simDevices.empty())
+#else
     if (!apsCtrl)
+#endif
     {
         return;
     }
 
+    if (!transactionBacklog.empty())
+    {
+        if (canSendTasks())
+        {
+            queueTransactionTasks();
+        }
+        else
+        {
+            releaseAllTasks(transactionBacklog);
+        }
+    }
+
     if (tasks.empty())
     {
         return;
     }
 
-    if (!isInNetwork())
+    const bool inNetwork = isInNetwork();
+
+    if (!inNetwork)
     {
-        DBG_Printf(DBG_INFO, "Not in network cleanup %d tasks\n", (runningTasks.size() + tasks.size()));
-        runningTasks.clear();
-        tasks.clear();
-        return;
+#ifdef DECONZ_REST_SIMULATION
+        if (!simDevices.empty())
+        {
+            // only the virtual devices are reachable
+            simReleaseRealTasks(runningTasks);
+            simReleaseRealTasks(tasks);
+
+            if (tasks.empty())
+            {
+                return;
+            }
+        }
+        else
+#endif
+        {
+            DBG_Printf(DBG_INFO, "Not in network cleanup %d tasks\n", (runningTasks.size() + tasks.size()));
+            releaseAllTasks(runningTasks);
+            releaseAllTasks(tasks);
+            return;
+        }
     }
 
     if (runningTasks.size() > 4)
@@ -4307,7 +4524,7 @@ void DeRestPluginPrivate::processTasks()
         if (i->lightNode && !i->lightNode->isAvailable())
         {
             DBG_Printf(DBG_INFO, "drop request to zombie\n");
-            tasks.erase(i);
+            releaseTask(tasks, i);
             return;
         }
 
@@ -4347,19 +4564,27 @@ void DeRestPluginPrivate::processTasks()
 
                 if (group)
                 {
-                    QTime now = QTime::currentTime();
-                    int diff = group->sendTime.msecsTo(now);
+                    const qint64 now = clockMonotonicMs();
 
-                    if (!group->sendTime.isValid() || (diff <= 0) || (diff > gwGroupSendDelay))
+                    if ((now - group->sendTime) > gwGroupSendDelay)
                     {
-                        if (apsCtrl->apsdeDataRequest(i->req) == deCONZ::Success)
+#ifdef DECONZ_REST_SIMULATION
+                        simApsdeDataRequest(i->req); // virtual group members
+#endif
+
+                        if (!inNetwork || apsCtrl->apsdeDataRequest(i->req) == deCONZ::Success)
                         {
                             group->sendTime = now;
-                            if (pushRunning)
+                            airtimeAccountBroadcast(i->req.asdu().size());
+                            if (pushRunning && inNetwork) // without network nobody confirms
+                            {
+                                // move list node without copying the task
+                                runningTasks.splice(runningTasks.end(), tasks, i);
+                            }
+                            else
                             {
-                                runningTasks.push_back(*i);
+                                releaseTask(tasks, i);
                             }
-                            tasks.erase(i);
                             return;
                         }
                     }
@@ -4375,26 +4600,45 @@ void DeRestPluginPrivate::processTasks()
                 if (i->lightNode && !i->lightNode->isAvailable())
                 {
                     DBG_Printf(DBG_INFO, "drop request to zombie\n");
-                    tasks.erase(i);
+                    releaseTask(tasks, i);
                     return;
                 }
+                else if (isNeighbourhoodCongested(i->req.dstAddress(), false, &i->airtimeDeferred))
+                {
+                    // other parts of the mesh continue at full speed
+                    DBG_Printf(DBG_INFO_L2, "delay sending request %u, neighbourhood busy\n", i->req.id());
+                }
                 else
                 {
+                    setStateConfirmMode(*i);
+
+#ifdef DECONZ_REST_SIMULATION
+                    // without network only requests to virtual devices are left
+                    int ret = simApsdeDataRequest(i->req) ? deCONZ::Success : apsCtrl->apsdeDataRequest(i->req);
+#else
                     int ret = apsCtrl->apsdeDataRequest(i->req);
+#endif
 
                     if (ret == deCONZ::Success)
                     {
+                        airtimeAccount(i->req.dstAddress(), i->req.asdu().size());
+                        expectStateConfirmation(*i);
+
                         if (pushRunning)
                         {
-                            runningTasks.push_back(*i);
+                            // move list node without copying the task
+                            runningTasks.splice(runningTasks.end(), tasks, i);
+                        }
+                        else
+                        {
+                            releaseTask(tasks, i);
                         }
-                        tasks.erase(i);
                         return;
                     }
                     else if (ret == deCONZ::ErrorNodeIsZombie)
                     {
                         DBG_Printf(DBG_INFO, "drop request to zombie\n");
-                        tasks.erase(i);
+                        releaseTask(tasks, i);
                         return;
                     }
                     else
@@ -4549,6 +4793,8 @@ void DeRestPluginPrivate::processGroupTasks()
         return;
     }
 
+    reconcileGroupMembership();
+
     if (tasks.size() > MaxGroupTasks)
     {
         return;
@@ -4579,29 +4825,18 @@ void DeRestPluginPrivate::processGroupTasks()
     std::vector<GroupInfo>::iterator i = task.lightNode->groups().begin();
     std::vector<GroupInfo>::iterator end = task.lightNode->groups().end();
 
+    // removes go first, the scene placement counts their slots as free
     for (; i != end; ++i)
     {
-        if (i->actions & GroupInfo::ActionAddToGroup)
-        {
-            if (addTaskAddToGroup(task, i->id))
-            {
-                i->actions &= ~GroupInfo::ActionAddToGroup;
-            }
-            return;
-        }
-
-        if (i->actions & GroupInfo::ActionRemoveFromGroup)
+        // scene commands wait until the group membership is confirmed
+        if (i->actions & (GroupInfo::ActionAddToGroup | GroupInfo::ActionRemoveFromGroup))
         {
-            if (addTaskRemoveFromGroup(task, i->id))
-            {
-                i->actions &= ~GroupInfo::ActionRemoveFromGroup;
-            }
-            return;
+            continue;
         }
 
-        if (!i->addScenes.empty())
+        if (i->actions & GroupInfo::ActionRemoveAllScenes)
         {
-            if (addTaskStoreScene(task, i->id, i->addScenes[0]))
+            if (addTaskRemoveAllScenes(task, i->id))
             {
                 processTasks();
                 return;
@@ -4616,10 +4851,24 @@ void DeRestPluginPrivate::processGroupTasks()
                 return;
             }
         }
+    }
+
+    if (addTaskStoreScenes(task))
+    {
+        processTasks();
+        return;
+    }
+
+    for (i = task.lightNode->groups().begin(); i != end; ++i)
+    {
+        if (i->actions & (GroupInfo::ActionAddToGroup | GroupInfo::ActionRemoveFromGroup))
+        {
+            continue;
+        }
 
         if (!i->modifyScenes.empty())
         {
-            if (addTaskAddScene(task, i->id, i->modifyScenes[0], task.lightNode->id()))
+            if (addTaskAddScene(task, i->id, i->modifyScenes[0], task.lightNode->handle()))
             {
                 processTasks();
                 return;
@@ -4628,6 +4877,225 @@ void DeRestPluginPrivate::processGroupTasks()
     }
 }
 
+/*! Returns true if the group membership of \p groupInfo needs to be changed in the device.
+    \param groupInfo - the desired and last reported membership
+    \param add - set to true if the device shall be added, false if removed
+ */
+bool DeRestPluginPrivate::groupMembershipNeedsUpdate(const GroupInfo &groupInfo, bool &add)
+{
+    // explicit requests
+    if (groupInfo.actions & GroupInfo::ActionRemoveFromGroup)
+    {
+        add = false;
+        return true;
+    }
+
+    if (groupInfo.actions & GroupInfo::ActionAddToGroup)
+    {
+        add = true;
+        return true;
+    }
+
+    // drift between desired and reported membership
+    if (groupInfo.reported == GroupInfo::ReportedUnknown || groupInfo.reconcileFailed)
+    {
+        return false;
+    }
+
+    add = (groupInfo.state == GroupInfo::StateInGroup);
+
+    if (add == (groupInfo.reported == GroupInfo::ReportedInGroup))
+    {
+        return false;
+    }
+
+    Group *group = getGroupForId(groupInfo.id);
+
+    if (!group || group->m_deviceMemberships.size() > 0) // don't touch group of switch
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/*! Drives the group membership of the lights towards the desired state.
+
+    The desired membership is GroupInfo::state together with pending add/remove
+    actions, the actual one is the membership last reported by the device.
+    Add/remove group commands are sent to up to MaxGroupTasks lights in parallel
+    and repeated with exponential backoff until the device confirms them.
+ */
+void DeRestPluginPrivate::reconcileGroupMembership()
+{
+    uint active = 0;
+
+    {
+        std::list<TaskItem>::const_iterator i = tasks.begin();
+        std::list<TaskItem>::const_iterator end = tasks.end();
+
+        for (; i != end; ++i)
+        {
+            if (i->taskType == TaskAddToGroup || i->taskType == TaskRemoveFromGroup)
+            {
+                active++;
+            }
+        }
+
+        i = runningTasks.begin();
+        end = runningTasks.end();
+
+        for (; i != end; ++i)
+        {
+            if (i->taskType == TaskAddToGroup || i->taskType == TaskRemoveFromGroup)
+            {
+                active++;
+            }
+        }
+    }
+
+    if (groupReconcileIter >= nodes.size())
+    {
+        groupReconcileIter = 0;
+    }
+
+    const size_t count = nodes.size();
+
+    for (size_t n = 0; n < count && active < MaxGroupTasks; n++)
+    {
+        LightNode *lightNode = &nodes[(groupReconcileIter + n) % count];
+
+        if (!lightNode->isAvailable())
+        {
+            continue;
+        }
+
+        bool add = false;
+        const std::vector<GroupInfo> &groups = static_cast<const LightNode*>(lightNode)->groups();
+        std::vector<GroupInfo>::const_iterator i = groups.begin();
+        std::vector<GroupInfo>::const_iterator end = groups.end();
+
+        for (; i != end; ++i)
+        {
+            if (i->nextAttempt <= idleTotalCounter && groupMembershipNeedsUpdate(*i, add))
+            {
+                break;
+            }
+        }
+
+        if (i == end)
+        {
+            continue;
+        }
+
+        GroupInfo *groupInfo = &lightNode->groups()[i - groups.begin()];
+
+        if (groupInfo->reconcileFailed) // explicit request after giving up, start over
+        {
+            groupInfo->reconcileFailed = false;
+            groupInfo->retries = 0;
+        }
+
+        TaskItem task;
+        task.lightNode = lightNode;
+        task.req.dstAddress() = lightNode->address();
+        task.req.setDstEndpoint(lightNode->haEndpoint().endpoint());
+        task.req.setSrcEndpoint(getSrcEndpoint(lightNode, task.req));
+        task.req.setDstAddressMode(deCONZ::ApsExtAddress);
+
+        if (add ? !addTaskAddToGroup(task, groupInfo->id) : !addTaskRemoveFromGroup(task, groupInfo->id))
+        {
+            break; // queue full
+        }
+
+        active++;
+        groupReconcileStats.attempts++;
+
+        if (!add)
+        {
+            // remove group also removes all scenes of the group
+            groupInfo->actions &= ~GroupInfo::ActionRemoveAllScenes;
+            groupInfo->addScenes.clear();
+            groupInfo->removeScenes.clear();
+            groupInfo->modifyScenes.clear();
+        }
+
+        if (groupInfo->retries < GroupReconcileMaxRetries)
+        {
+            groupInfo->retries++;
+        }
+
+        int delay = GroupReconcileBaseDelay << groupInfo->retries;
+        groupInfo->nextAttempt = idleTotalCounter + qMin(delay, GroupReconcileMaxDelay);
+
+        DBG_Printf(DBG_INFO, "reconcile group 0x%04X %s light %s, attempt %u\n", groupInfo->id,
+                   add ? "add" : "remove", qPrintable(lightNode->id()), groupInfo->retries);
+
+        if (groupInfo->retries == GroupReconcileVerifyRetries)
+        {
+            // no confirmation yet, check what the device actually knows
+            groupReconcileStats.verifies++;
+            lightNode->enableRead(READ_GROUPS);
+            lightNode->setNextReadTime(clockMonotonicMs());
+        }
+        else if (groupInfo->retries >= GroupReconcileMaxRetries)
+        {
+            // give up, the device doesn't take the change; the membership is
+            // read once more, a confirmation or new request starts over
+            DBG_Printf(DBG_INFO, "give up group 0x%04X for light %s\n", groupInfo->id, qPrintable(lightNode->id()));
+            groupInfo->actions &= ~(GroupInfo::ActionAddToGroup | GroupInfo::ActionRemoveFromGroup);
+            groupInfo->reconcileFailed = true;
+            groupReconcileStats.failures++;
+            lightNode->enableRead(READ_GROUPS);
+            lightNode->setNextReadTime(clockMonotonicMs());
+        }
+    }
+
+    groupReconcileIter++;
+}
+
+/*! Processes the response of an add/remove group command.
+    \param lightNode - the responding light
+    \param groupId - the group
+    \param status - ZCL status of the response
+    \param add - true for add group, false for remove group response
+ */
+void DeRestPluginPrivate::confirmGroupMembership(LightNode *lightNode, uint16_t groupId, uint8_t status, bool add)
+{
+    GroupInfo *groupInfo = getGroupInfo(lightNode, groupId);
+
+    if (!groupInfo)
+    {
+        return;
+    }
+
+    const uint8_t action = add ? GroupInfo::ActionAddToGroup : GroupInfo::ActionRemoveFromGroup;
+
+    if (status == deCONZ::ZclSuccessStatus ||
+        (add && status == 0x8A) ||  // duplicate exists
+        (!add && status == 0x8B))   // not found
+    {
+        groupInfo->reported = add ? GroupInfo::ReportedInGroup : GroupInfo::ReportedNotInGroup;
+        groupInfo->actions &= ~action;
+        groupInfo->retries = 0;
+        groupInfo->reconcileFailed = false;
+        groupInfo->nextAttempt = 0;
+        groupReconcileStats.confirmed++;
+    }
+    else if (groupInfo->actions & action)
+    {
+        if (add && status == 0x89) // insufficient space
+        {
+            lightNode->setGroupCapacity(0); // further requests are rejected by canPlaceInGroup()
+        }
+
+        // e.g. insufficient space, retry later with backoff
+        DBG_Printf(DBG_INFO, "%s group 0x%04X rejected by light %s, status 0x%02X\n",
+                   add ? "add" : "remove", groupId, qPrintable(lightNode->id()), status);
+        groupReconcileStats.failures++;
+    }
+}
+
 /*! Handle packets related to the ZCL group cluster.
     \param task the task which belongs to this response
     \param ind the APS level data indication containing the ZCL packet
@@ -4655,37 +5123,28 @@ void DeRestPluginPrivate::handleGroupClusterIndication(TaskItem &task, const deC
     }
     else if (zclFrame.commandId() == 0x02) // Get group membership response
     {
-        DBG_Assert(zclFrame.payload().size() >= 2);
-
-        QDataStream stream(zclFrame.payload());
-        stream.setByteOrder(QDataStream::LittleEndian);
+        FrameReader reader(zclFrame.payload());
+        ZclGroupMembershipRsp rsp;
 
-        uint8_t capacity;
-        uint8_t count;
+        if (!decodeZclGroupMembershipRsp(reader, rsp))
+        {
+            return;
+        }
 
-        stream >> capacity;
-        stream >> count;
+        lightNode->setGroupCapacity(rsp.capacity);
+        lightNode->setGroupCount(rsp.count);
 
-        lightNode->setGroupCapacity(capacity);
-        lightNode->setGroupCount(count);
+        DBG_Printf(DBG_INFO, "verified group capacity: %u and group count: %u of LightNode %s\n", rsp.capacity, rsp.count, qPrintable(lightNode->address().toStringExt()));
 
-        DBG_Printf(DBG_INFO, "verified group capacity: %u and group count: %u of LightNode %s\n", capacity, count, qPrintable(lightNode->address().toStringExt()));
+        std::vector<quint16>::const_iterator g = rsp.groups.begin();
+        std::vector<quint16>::const_iterator gend = rsp.groups.end();
 
-        QVector<quint16> responseGroups;
-        for (uint i = 0; i < count; i++)
+        for (; g != gend; ++g)
         {
-            if (!stream.atEnd())
-            {
-                uint16_t groupId;
-                stream >> groupId;
+            DBG_Printf(DBG_INFO, "%s found group 0x%04X\n", qPrintable(lightNode->address().toStringExt()), *g);
 
-                responseGroups.push_back(groupId);
-
-                DBG_Printf(DBG_INFO, "%s found group 0x%04X\n", qPrintable(lightNode->address().toStringExt()), groupId);
-
-                foundGroup(groupId);
-                foundGroupMembership(lightNode, groupId);
-            }
+            foundGroup(*g);
+            foundGroupMembership(lightNode, *g);
         }
 
         std::vector<GroupInfo>::iterator i = lightNode->groups().begin();
@@ -4694,42 +5153,46 @@ void DeRestPluginPrivate::handleGroupClusterIndication(TaskItem &task, const deC
         for (; i != end; ++i)
         {
             Group *group = getGroupForId(i->id);
+            const bool inGroup = std::find(rsp.groups.begin(), rsp.groups.end(), i->id) != rsp.groups.end();
 
-            if (group && group->state() == Group::StateNormal
-                && group->m_deviceMemberships.size() == 0 //no switch group
-                && !responseGroups.contains(i->id)
-                && i->state == GroupInfo::StateInGroup)
+            // actual membership, differences to the desired one are
+            // corrected by reconcileGroupMembership()
+            i->reported = inGroup ? GroupInfo::ReportedInGroup : GroupInfo::ReportedNotInGroup;
+
+            if ((i->state == GroupInfo::StateInGroup) == (i->reported == GroupInfo::ReportedInGroup))
             {
-                    DBG_Printf(DBG_INFO, "restore group  0x%04X for lightNode %s\n", i->id, qPrintable(lightNode->address().toStringExt()));
-                    i->actions &= ~GroupInfo::ActionRemoveFromGroup; // sanity
-                    i->actions |= GroupInfo::ActionAddToGroup;
-                    i->state = GroupInfo::StateInGroup;
-                    updateEtag(group->etag);
-                    updateEtag(gwConfigEtag);
-                    queSaveDb(DB_LIGHTS, DB_SHORT_SAVE_DELAY);
+                // in sync, also if a add/remove response was lost
+                i->actions &= ~(GroupInfo::ActionAddToGroup | GroupInfo::ActionRemoveFromGroup);
+                i->retries = 0;
+                i->reconcileFailed = false;
+                i->nextAttempt = 0;
             }
-            else if (group && group->state() == Group::StateNormal
+
+            if (group && group->state() == Group::StateNormal
                 && group->m_deviceMemberships.size() > 0) //a switch group
             {
-                if (responseGroups.contains(i->id)
+                if (inGroup
                     && i->state == GroupInfo::StateNotInGroup) // light was added by a switch -> add it to deCONZ group)
                 {
                     i->state = GroupInfo::StateInGroup;
+                    lightNode->changes.set(LightNode::FieldGroups);
                     std::vector<QString> &v = group->m_multiDeviceIds;
                     std::vector<QString>::iterator fi = std::find(v.begin(), v.end(), lightNode->id());
                     if (fi != v.end())
                     {
                         group->m_multiDeviceIds.erase(fi);
+                        group->changes.set(Group::FieldMembers);
                         queSaveDb(DB_GROUPS, DB_SHORT_SAVE_DELAY);
                     }
                     updateEtag(group->etag);
                     updateEtag(gwConfigEtag);
                     queSaveDb(DB_LIGHTS, DB_SHORT_SAVE_DELAY);
                 }
-                else if (!responseGroups.contains(i->id)
+                else if (!inGroup
                     && i->state == GroupInfo::StateInGroup) // light was removed from group by switch -> remove it from deCONZ group)
                 {
                     i->state = GroupInfo::StateNotInGroup;
+                    lightNode->changes.set(LightNode::FieldGroups);
                     updateEtag(group->etag);
                     updateEtag(gwConfigEtag);
                     queSaveDb(DB_LIGHTS, DB_SHORT_SAVE_DELAY);
@@ -4739,18 +5202,15 @@ void DeRestPluginPrivate::handleGroupClusterIndication(TaskItem &task, const deC
     }
     else if (zclFrame.commandId() == 0x00) // Add group response
     {
-        DBG_Assert(zclFrame.payload().size() >= 2);
-
-        QDataStream stream(zclFrame.payload());
-        stream.setByteOrder(QDataStream::LittleEndian);
-
-        uint8_t status;
-        uint16_t groupId;
+        FrameReader reader(zclFrame.payload());
+        ZclGroupStatusRsp rsp;
 
-        stream >> status;
-        stream >> groupId;
+        if (!decodeZclGroupStatusRsp(reader, rsp))
+        {
+            return;
+        }
 
-        if (status == 0x00)
+        if (rsp.status == 0x00)
         {
             uint8_t capacity = lightNode->groupCapacity();
             if (capacity >= endpointCount)
@@ -4767,25 +5227,26 @@ void DeRestPluginPrivate::handleGroupClusterIndication(TaskItem &task, const deC
             lightNode->setGroupCount(count);
         }
 
-        DBG_Printf(DBG_INFO, "Add to group response for light %s. Status:0x%02X, capacity: %u\n", qPrintable(lightNode->id()), status, lightNode->groupCapacity());
+        DBG_Printf(DBG_INFO, "Add to group response for light %s. Status:0x%02X, capacity: %u\n", qPrintable(lightNode->id()), rsp.status, lightNode->groupCapacity());
+
+        confirmGroupMembership(lightNode, rsp.groupId, rsp.status, true);
 
     }
     else if (zclFrame.commandId() == 0x03) // Remove group response
     {
-        DBG_Assert(zclFrame.payload().size() >= 2);
+        FrameReader reader(zclFrame.payload());
+        ZclGroupStatusRsp rsp;
 
-        QDataStream stream(zclFrame.payload());
-        stream.setByteOrder(QDataStream::LittleEndian);
-
-        uint8_t status;
-        uint16_t groupId;
+        if (!decodeZclGroupStatusRsp(reader, rsp))
+        {
+            return;
+        }
 
-        stream >> status;
-        stream >> groupId;
+        confirmGroupMembership(lightNode, rsp.groupId, rsp.status, false);
 
-        if (status == 0x00)
+        if (rsp.status == 0x00)
         {
-            GroupInfo *groupInfo = getGroupInfo(lightNode, groupId);
+            GroupInfo *groupInfo = getGroupInfo(lightNode, rsp.groupId);
             DBG_Assert(groupInfo != 0);
 
             if (groupInfo)
@@ -4819,7 +5280,7 @@ void DeRestPluginPrivate::handleGroupClusterIndication(TaskItem &task, const deC
             }
         }
 
-        DBG_Printf(DBG_INFO, "Remove from group response for light %s. Status: 0x%02X, capacity: %u\n", qPrintable(lightNode->id()), status, lightNode->groupCapacity());
+        DBG_Printf(DBG_INFO, "Remove from group response for light %s. Status: 0x%02X, capacity: %u\n", qPrintable(lightNode->id()), rsp.status, lightNode->groupCapacity());
     }
 }
 
@@ -4837,47 +5298,32 @@ void DeRestPluginPrivate::handleSceneClusterIndication(TaskItem &task, const deC
     }
     else if (zclFrame.commandId() == 0x06) // Get scene membership response
     {
-        DBG_Assert(zclFrame.payload().size() >= 4);
-
-        QDataStream stream(zclFrame.payload());
-        stream.setByteOrder(QDataStream::LittleEndian);
-
-        uint8_t status;
-        uint8_t capacity;
-        uint16_t groupId;
-        uint8_t count;
+        FrameReader reader(zclFrame.payload());
+        ZclSceneMembershipRsp rsp;
 
-        stream >> status;
-        stream >> capacity;
-        stream >> groupId;
+        if (!decodeZclSceneMembershipRsp(reader, rsp))
+        {
+            return;
+        }
 
-        if (status == deCONZ::ZclSuccessStatus)
+        if (rsp.status == deCONZ::ZclSuccessStatus)
         {
-            Group *group = getGroupForId(groupId);
+            Group *group = getGroupForId(rsp.groupId);
             LightNode *lightNode = getLightNodeForAddress(ind.srcAddress().ext(), ind.srcEndpoint());
-            GroupInfo *groupInfo = getGroupInfo(lightNode, group->address());
-
-            stream >> count;
+            GroupInfo *groupInfo = lightNode ? getGroupInfo(lightNode, rsp.groupId) : 0;
 
             if (group && lightNode && groupInfo)
             {
-                lightNode->setSceneCapacity(capacity);
-                groupInfo->setSceneCount(count);
-
-                for (uint i = 0; i < count; i++)
-                {
-                    if (!stream.atEnd())
-                    {
-                        uint8_t sceneId;
-                        stream >> sceneId;
+                lightNode->setSceneCapacity(rsp.capacity);
+                groupInfo->setSceneCount(rsp.count);
 
-                        DBG_Printf(DBG_INFO, "found scene 0x%02X for group 0x%04X\n", sceneId, groupId);
+                std::vector<quint8>::const_iterator i = rsp.scenes.begin();
+                std::vector<quint8>::const_iterator end = rsp.scenes.end();
 
-                        if (group && lightNode)
-                        {
-                            foundScene(lightNode, group, sceneId);
-                        }
-                    }
+                for (; i != end; ++i)
+                {
+                    DBG_Printf(DBG_INFO, "found scene 0x%02X for group 0x%04X\n", *i, rsp.groupId);
+                    foundScene(lightNode, group, *i);
                 }
 
                 lightNode->enableRead(READ_SCENE_DETAILS);
@@ -4888,38 +5334,37 @@ void DeRestPluginPrivate::handleSceneClusterIndication(TaskItem &task, const deC
     }
     else if (zclFrame.commandId() == 0x04) // Store scene response
     {
-        DBG_Assert(zclFrame.payload().size() >= 3);
-
-        QDataStream stream(zclFrame.payload());
-        stream.setByteOrder(QDataStream::LittleEndian);
-
-        uint8_t status;
-        uint16_t groupId;
-        uint8_t sceneId;
+        FrameReader reader(zclFrame.payload());
+        ZclSceneStatusRsp rsp;
 
-        stream >> status;
-        stream >> groupId;
-        stream >> sceneId;
+        if (!decodeZclSceneStatusRsp(reader, rsp))
+        {
+            return;
+        }
 
         LightNode *lightNode = getLightNodeForAddress(ind.srcAddress().ext(), ind.srcEndpoint());
 
         if (lightNode)
         {
-            GroupInfo *groupInfo = getGroupInfo(lightNode, groupId);
+            GroupInfo *groupInfo = getGroupInfo(lightNode, rsp.groupId);
 
             if (groupInfo)
             {
                 std::vector<uint8_t> &v = groupInfo->addScenes;
-                std::vector<uint8_t>::iterator i = std::find(v.begin(), v.end(), sceneId);
+                std::vector<uint8_t>::iterator i = std::find(v.begin(), v.end(), rsp.sceneId);
 
                 if (i != v.end())
                 {
-                    DBG_Printf(DBG_INFO, "Added/stored scene %u in node %s Response. Status: 0x%02X\n", sceneId, qPrintable(lightNode->id()), status);
+                    DBG_Printf(DBG_INFO, "Added/stored scene %u in node %s Response. Status: 0x%02X\n", rsp.sceneId, qPrintable(lightNode->id()), rsp.status);
                     groupInfo->addScenes.erase(i);
 
-                    if (status == 0x00)
+                    if (rsp.status == 0x89) // insufficient space
+                    {
+                        rejectScenePlacements(lightNode);
+                    }
+                    else if (rsp.status == 0x00)
                     {
-                        Scene *scene = getSceneForId(groupId, sceneId);
+                        Scene *scene = getSceneForId(rsp.groupId, rsp.sceneId);
 
                         if (scene)
                         {
@@ -4929,7 +5374,7 @@ void DeRestPluginPrivate::handleSceneClusterIndication(TaskItem &task, const deC
                             std::vector<LightState>::iterator lend = scene->lights().end();
                             for (; li != lend; ++li)
                             {
-                                if (li->lid() == lightNode->id())
+                                if (li->lightHandle() == lightNode->handle())
                                 {
                                     li->setOn(lightNode->isOn());
                                     li->setBri((uint8_t)lightNode->level());
@@ -4981,38 +5426,33 @@ void DeRestPluginPrivate::handleSceneClusterIndication(TaskItem &task, const deC
     }
     else if (zclFrame.commandId() == 0x02) // Remove scene response
     {
-        DBG_Assert(zclFrame.payload().size() >= 4);
-
-        QDataStream stream(zclFrame.payload());
-        stream.setByteOrder(QDataStream::LittleEndian);
+        FrameReader reader(zclFrame.payload());
+        ZclSceneStatusRsp rsp;
 
-        uint8_t status;
-        uint16_t groupId;
-        uint8_t sceneId;
-
-        stream >> status;
-        stream >> groupId;
-        stream >> sceneId;
+        if (!decodeZclSceneStatusRsp(reader, rsp))
+        {
+            return;
+        }
 
         LightNode *lightNode = getLightNodeForAddress(ind.srcAddress().ext(), ind.srcEndpoint());
 
         if (lightNode)
         {
-            GroupInfo *groupInfo = getGroupInfo(lightNode, groupId);
+            GroupInfo *groupInfo = getGroupInfo(lightNode, rsp.groupId);
 
             if (groupInfo)
             {
                 std::vector<uint8_t> &v = groupInfo->removeScenes;
-                std::vector<uint8_t>::iterator i = std::find(v.begin(), v.end(), sceneId);
+                std::vector<uint8_t>::iterator i = std::find(v.begin(), v.end(), rsp.sceneId);
 
                 if (i != v.end())
                 {
-                    DBG_Printf(DBG_INFO, "Removed scene %u from node %s status 0x%02X\n", sceneId, qPrintable(lightNode->id()), status);
+                    DBG_Printf(DBG_INFO, "Removed scene %u from node %s status 0x%02X\n", rsp.sceneId, qPrintable(lightNode->id()), rsp.status);
                     groupInfo->removeScenes.erase(i);
 
-                    if (status == 0x00)
+                    if (rsp.status == 0x00)
                     {
-                        Scene *scene = getSceneForId(groupId, sceneId);
+                        Scene *scene = getSceneForId(rsp.groupId, rsp.sceneId);
 
                         if (scene)
                         {
@@ -5020,9 +5460,9 @@ void DeRestPluginPrivate::handleSceneClusterIndication(TaskItem &task, const deC
                             std::vector<LightState>::const_iterator lend = scene->lights().end();
                             for (; li != lend; ++li)
                             {
-                                if (li->lid() == lightNode->id())
+                                if (li->lightHandle() == lightNode->handle())
                                 {
-                                    scene->deleteLight(lightNode->id());
+                                    scene->deleteLight(lightNode->handle());
                                     break;
                                 }
                             }
@@ -5048,35 +5488,64 @@ void DeRestPluginPrivate::handleSceneClusterIndication(TaskItem &task, const deC
             }
         }
     }
-    else if (zclFrame.commandId() == 0x00) // Add scene response // will only be created by modifying scene, yet.
+    else if (zclFrame.commandId() == 0x03) // Remove all scenes response
     {
-        DBG_Assert(zclFrame.payload().size() >= 4);
+        FrameReader reader(zclFrame.payload());
+        ZclGroupStatusRsp rsp;
 
-        QDataStream stream(zclFrame.payload());
-        stream.setByteOrder(QDataStream::LittleEndian);
+        if (!decodeZclGroupStatusRsp(reader, rsp))
+        {
+            return;
+        }
 
-        uint8_t status;
-        uint16_t groupId;
-        uint8_t sceneId;
+        LightNode *lightNode = getLightNodeForAddress(ind.srcAddress().ext(), ind.srcEndpoint());
+
+        if (lightNode)
+        {
+            GroupInfo *groupInfo = getGroupInfo(lightNode, rsp.groupId);
+
+            if (groupInfo && (groupInfo->actions & GroupInfo::ActionRemoveAllScenes))
+            {
+                DBG_Printf(DBG_INFO, "Removed all scenes of group 0x%04X from node %s status 0x%02X\n", rsp.groupId, qPrintable(lightNode->id()), rsp.status);
+                groupInfo->actions &= ~GroupInfo::ActionRemoveAllScenes;
+
+                if (rsp.status == 0x00)
+                {
+                    groupInfo->removeScenes.clear();
+
+                    uint sceneCapacity = lightNode->sceneCapacity() + groupInfo->sceneCount();
+                    lightNode->setSceneCapacity(sceneCapacity < 255 ? sceneCapacity : 255);
+                    groupInfo->setSceneCount(0);
+
+                    DBG_Printf(DBG_INFO, "scene capacity: %u\n", lightNode->sceneCapacity());
+                }
+            }
+        }
+    }
+    else if (zclFrame.commandId() == 0x00) // Add scene response // will only be created by modifying scene, yet.
+    {
+        FrameReader reader(zclFrame.payload());
+        ZclSceneStatusRsp rsp;
 
-        stream >> status;
-        stream >> groupId;
-        stream >> sceneId;
+        if (!decodeZclSceneStatusRsp(reader, rsp))
+        {
+            return;
+        }
 
         LightNode *lightNode = getLightNodeForAddress(ind.srcAddress().ext(), ind.srcEndpoint());
 
         if (lightNode)
         {
-            GroupInfo *groupInfo = getGroupInfo(lightNode, groupId);
+            GroupInfo *groupInfo = getGroupInfo(lightNode, rsp.groupId);
 
             if (groupInfo)
             {
                 std::vector<uint8_t> &v = groupInfo->modifyScenes;
-                std::vector<uint8_t>::iterator i = std::find(v.begin(), v.end(), sceneId);
+                std::vector<uint8_t>::iterator i = std::find(v.begin(), v.end(), rsp.sceneId);
 
                 if (i != v.end())
                 {
-                    DBG_Printf(DBG_INFO, "Modified scene %u in node %s status 0x%02X\n", sceneId, qPrintable(lightNode->address().toStringExt()), status);
+                    DBG_Printf(DBG_INFO, "Modified scene %u in node %s status 0x%02X\n", rsp.sceneId, qPrintable(lightNode->address().toStringExt()), rsp.status);
                     groupInfo->modifyScenes.erase(i);
                 }
             }
@@ -5084,72 +5553,44 @@ void DeRestPluginPrivate::handleSceneClusterIndication(TaskItem &task, const deC
     }
     else if (zclFrame.commandId() == 0x01) // View scene response
     {
-        DBG_Assert(zclFrame.payload().size() >= 4);
-
         LightNode *lightNode = getLightNodeForAddress(ind.srcAddress().ext(), ind.srcEndpoint());
 
-        QDataStream stream(zclFrame.payload());
-        stream.setByteOrder(QDataStream::LittleEndian);
-
-        uint8_t status;
-        uint16_t groupId;
-        uint8_t sceneId;
-        uint16_t transitiontime;
-        uint8_t length;
-        QString sceneName = "";
-        LightState light;
+        if (!lightNode)
+        {
+            return;
+        }
 
-        light.setLid(lightNode->id());
+        FrameReader reader(zclFrame.payload());
+        ZclViewSceneRsp rsp;
 
-        stream >> status;
-        if (status == 0x00)
+        if (!decodeZclViewSceneRsp(reader, rsp))
         {
-            stream >> groupId;
-            stream >> sceneId;
-            stream >> transitiontime;
-            stream >> length;
+            return;
+        }
 
-            light.setTransitiontime(transitiontime*10);
+        if (rsp.status == 0x00)
+        {
+            LightState light;
+            light.setLid(lightNode->id());
+            light.setTransitiontime(rsp.transitionTime * 10);
 
-            for (int i = 0; i < length; i++)
+            if (rsp.hasOnOff)
             {
-                char *c;
-                stream >> c;
-                sceneName.append(c);
+                light.setOn(rsp.onOff == 0x01);
             }
 
-            while (!stream.atEnd())
+            if (rsp.hasLevel)
             {
-                uint16_t clusterId;
-                uint8_t l;
-                uint8_t fs8;
-                uint16_t fs16;
-
-                stream >> clusterId;
-                stream >> l;
-
-                if (clusterId == 0x0006)
-                {
-                    stream >> fs8;
-                    bool on = (fs8 == 0x01) ? true : false;
-                    light.setOn(on);
-                }
-                else if (clusterId == 0x0008)
-                {
-                    stream >> fs8;
-                    light.setBri(fs8);
-                }
-                else if (clusterId == 0x0300)
-                {
-                    stream >> fs16;
-                    light.setX(fs16);
+                light.setBri(rsp.level);
+            }
 
-                    stream >> fs16;
-                    light.setY(fs16);
-                }
+            if (rsp.hasXy)
+            {
+                light.setX(rsp.x);
+                light.setY(rsp.y);
             }
 
-            DBG_Printf(DBG_INFO_L2, "Validaded Scene (gid: %u, sid: %u) for Light %s\n", groupId, sceneId, qPrintable(lightNode->id()));
+            DBG_Printf(DBG_INFO_L2, "Validaded Scene (gid: %u, sid: %u) for Light %s\n", rsp.groupId, rsp.sceneId, qPrintable(lightNode->id()));
             DBG_Printf(DBG_INFO_L2, "On: %u, Bri: %u, X: %u, Y: %u, Transitiontime: %u\n",
                     light.on(), light.bri(), light.x(), light.y(), light.transitiontime());
         }
@@ -5168,23 +5609,19 @@ void DeRestPluginPrivate::handleSceneClusterIndication(TaskItem &task, const deC
         {
             if (sensorNode->deletedState() != Sensor::StateDeleted)
             {
-                DBG_Assert(zclFrame.payload().size() >= 3);
-
-                QDataStream stream(zclFrame.payload());
-                stream.setByteOrder(QDataStream::LittleEndian);
+                FrameReader reader(zclFrame.payload());
+                ZclSceneStatusRsp cmd;
 
-                uint16_t groupId;
-                uint8_t sceneId;
-
-                //stream >> status;
-                stream >> groupId;
-                stream >> sceneId;
+                if (!decodeZclRecallScene(reader, cmd))
+                {
+                    return;
+                }
 
                 // check if scene exists
                 Scene scene;
                 TaskItem task2;
                 bool colorloopDeactivated = false;
-                Group *group = getGroupForId(groupId);
+                Group *group = getGroupForId(cmd.groupId);
 
                 if (group && group->state() != Group::StateDeleted && group->state() != Group::StateDeleteFromDB)
                 {
@@ -5193,7 +5630,7 @@ void DeRestPluginPrivate::handleSceneClusterIndication(TaskItem &task, const deC
 
                     for (; i != end; ++i)
                     {
-                        if ((i->id == sceneId) && (i->state != Scene::StateDeleted))
+                        if ((i->id == cmd.sceneId) && (i->state != Scene::StateDeleted))
                         {
                             scene = *i;
 
@@ -5202,7 +5639,7 @@ void DeRestPluginPrivate::handleSceneClusterIndication(TaskItem &task, const deC
 
                             for (; ls != lsend; ++ls)
                             {
-                                LightNode *light = getLightNodeForId(ls->lid());
+                                LightNode *light = getLightNodeForHandle(ls->lightHandle());
                                 if (light && light->isAvailable() && light->state() != LightNode::StateDeleted)
                                 {
                                     bool changed = false;
@@ -5262,7 +5699,7 @@ void DeRestPluginPrivate::handleSceneClusterIndication(TaskItem &task, const deC
                             //recall scene again
                             if (colorloopDeactivated)
                             {
-                                callScene(group, sceneId);
+                                callScene(group, cmd.sceneId);
                             }
                             break;
                         }
@@ -5458,27 +5895,25 @@ void DeRestPluginPrivate::handleCommissioningClusterIndication(TaskItem &task, c
     }
     else if (zclFrame.commandId() == 0x41) // Get group identifiers response
     {
-        DBG_Assert(zclFrame.payload().size() >= 4);
-
-        QDataStream stream(zclFrame.payload());
-        stream.setByteOrder(QDataStream::LittleEndian);
+        FrameReader reader(zclFrame.payload());
+        ZclGroupIdentifiersRsp rsp;
 
-        uint8_t total;
-        uint8_t startIndex;
-        uint8_t count;
-        uint16_t groupId;
-        uint8_t type;
+        if (!decodeZclGroupIdentifiersRsp(reader, rsp))
+        {
+            return;
+        }
 
-        stream >> total;
-        stream >> startIndex;
-        stream >> count;
+        const uint8_t count = rsp.count;
 
         DBG_Printf(DBG_INFO, "Get group identifiers response of sensor %s. Count: %u\n", qPrintable(sensorNode->address().toStringExt()), count);
 
-        while (!stream.atEnd())
+        std::vector<ZclGroupIdentifiersRsp::Record>::const_iterator rec = rsp.records.begin();
+        std::vector<ZclGroupIdentifiersRsp::Record>::const_iterator recEnd = rsp.records.end();
+
+        for (; rec != recEnd; ++rec)
         {
-            stream >> groupId;
-            stream >> type;
+            const uint16_t groupId = rec->groupId;
+            const uint8_t type = rec->type;
             DBG_Printf(DBG_INFO, " - Id: %u, type: %u\n", groupId, type);
 
             Group *group1 = getGroupForId(groupId);
@@ -5509,6 +5944,7 @@ void DeRestPluginPrivate::handleCommissioningClusterIndication(TaskItem &task, c
                     {
                         //not found
                         group1->m_deviceMemberships.push_back(sensorNode->id());
+                        group1->changes.set(Group::FieldMembers);
                     }
 
                     // put coordinator into group
@@ -5593,6 +6029,16 @@ void DeRestPluginPrivate::handleCommissioningClusterIndication(TaskItem &task, c
  */
 void DeRestPluginPrivate::handleDeviceAnnceIndication(const deCONZ::ApsDataIndication &ind)
 {
+    {
+        FrameReader reader(ind.asdu());
+        ZdpDeviceAnnce annce;
+
+        if (decodeZdpDeviceAnnce(reader, annce))
+        {
+            interviewStart(annce);
+        }
+    }
+
     if (!ind.srcAddress().hasExt())
     {
         return;
@@ -5622,7 +6068,7 @@ void DeRestPluginPrivate::handleDeviceAnnceIndication(const deCONZ::ApsDataIndic
             DBG_Printf(DBG_INFO, "DeviceAnnce of LightNode: %s\n", qPrintable(ind.srcAddress().toStringExt()));
 
             // force reading attributes
-            i->setNextReadTime(QTime::currentTime().addMSecs(ReadAttributesLongDelay));
+            i->setNextReadTime(clockMonotonicMs() + ReadAttributesLongDelay);
             i->setLastRead(idleTotalCounter);
 
             i->enableRead(READ_MODEL_ID |
@@ -5650,7 +6096,7 @@ void DeRestPluginPrivate::handleDeviceAnnceIndication(const deCONZ::ApsDataIndic
             if (si->deletedState() == Sensor::StateDeleted)
             {
                 si->setIsAvailable(true);
-                si->setNextReadTime(QTime::currentTime().addMSecs(ReadAttributesLongDelay));
+                si->setNextReadTime(clockMonotonicMs() + ReadAttributesLongDelay);
                 si->enableRead(READ_BINDING_TABLE | READ_GROUP_IDENTIFIERS | READ_MODEL_ID | READ_SWBUILD_ID);
                 si->setLastRead(idleTotalCounter);
                 si->setDeletedState(Sensor::StateNormal);
@@ -6134,6 +6580,10 @@ void DeRestPlugin::idleTimerFired()
         d->idleLimit--;
     }
 
+    d->checkStateConfirmations();
+    d->checkGroupVerifications();
+    d->publishPendingSensorValues();
+
     if (d->idleLastActivity < IDLE_USER_LIMIT)
     {
         return;
@@ -6181,7 +6631,8 @@ void DeRestPlugin::idleTimerFired()
     {
         DBG_Printf(DBG_INFO_L2, "Idle timer triggered\n");
 
-        if (!d->nodes.empty())
+        // until the startup pipeline is done it decides what is read from lights
+        if (!d->nodes.empty() && d->isStartupReady())
         {
             if (d->lightIter >= d->nodes.size())
             {
@@ -6205,7 +6656,10 @@ void DeRestPlugin::idleTimerFired()
 
                 if (lightNode->lastRead() < (d->idleTotalCounter - IDLE_READ_LIMIT))
                 {
-                    lightNode->enableRead(READ_ON_OFF | READ_LEVEL | READ_COLOR | READ_GROUPS | READ_SCENES /*| READ_BINDING_TABLE*/);
+                    // state confirmed by the light since the last pass doesn't need to be read
+                    const uint32_t stateFlags = READ_ON_OFF | READ_LEVEL | READ_COLOR;
+                    lightNode->enableRead((stateFlags & ~lightNode->confirmedState()) | READ_GROUPS | READ_SCENES /*| READ_BINDING_TABLE*/);
+                    lightNode->clearStateConfirmed(stateFlags);
 
                     if (lightNode->modelId().isEmpty() && !lightNode->mustRead(READ_MODEL_ID))
                     {
@@ -6222,7 +6676,7 @@ void DeRestPlugin::idleTimerFired()
                         lightNode->enableRead(READ_VENDOR_NAME);
                         processLights = true;
                     }
-                    lightNode->setNextReadTime(QTime::currentTime());
+                    lightNode->setNextReadTime(clockMonotonicMs());
                     lightNode->setLastRead(d->idleTotalCounter);
                     DBG_Printf(DBG_INFO, "Force read attributes for node %s\n", qPrintable(lightNode->name()));
                 }
@@ -6286,7 +6740,7 @@ void DeRestPlugin::idleTimerFired()
                 {
                     bool checkBindingTable = false;
                     sensorNode->setLastRead(d->idleTotalCounter);
-                    sensorNode->setNextReadTime(QTime::currentTime());
+                    sensorNode->setNextReadTime(clockMonotonicMs());
 
                     {
                         std::vector<quint16>::const_iterator ci = sensorNode->fingerPrint().inClusters.begin();
@@ -6304,8 +6758,8 @@ void DeRestPlugin::idleTimerFired()
                                 val = sensorNode->getZclValue(*ci, 0x0000); // occupied state
                             }
 
-                            if (val.timestampLastReport.isValid() &&
-                                val.timestampLastReport.secsTo(QTime::currentTime()) < (60 * 45)) // got update in timely manner
+                            if (val.timestampLastReport >= 0 &&
+                                (clockMonotonicMs() - val.timestampLastReport) < (60 * 45 * 1000)) // got update in timely manner
                             {
                                 DBG_Printf(DBG_INFO, "binding for attribute reporting SensorNode %s of cluster 0x%04X seems to be active\n", qPrintable(sensorNode->name()), *ci);
                             }
@@ -6355,7 +6809,7 @@ void DeRestPlugin::idleTimerFired()
             for (; i != end; ++i)
             {
                 // older FLS which do not have correct support for color mode xy has atmel vendor id
-                if (i->isAvailable() && (i->manufacturerCode() == VENDOR_ATMEL))
+                if (i->isAvailable() && i->hasQuirk(QuirkNoColorXy))
                 {
                     countNoColorXySupport++;
                 }
@@ -6405,8 +6859,8 @@ void DeRestPlugin::refreshAll()
 
     d->idleLimit = 0;
     d->idleLastActivity = IDLE_USER_LIMIT;
-    d->runningTasks.clear();
-    d->tasks.clear();
+    d->releaseAllTasks(d->runningTasks);
+    d->releaseAllTasks(d->tasks);
 }
 
 /*! Starts the read attributes timer with a given \p delay.
@@ -6571,6 +7025,7 @@ bool DeRestPlugin::isHttpTarget(const QHttpRequestHeader &hdr)
                 (ls[2] == "sensors") ||
                 (ls[2] == "touchlink") ||
                 (ls[2] == "rules") ||
+                (ls[2] == "transaction") ||
                 (hdr.path().at(4) != '/') /* Bug in some clients */)
             {
                 return true;
@@ -6696,6 +7151,14 @@ int DeRestPlugin::handleHttpRequest(const QHttpRequestHeader &hdr, QTcpSocket *s
         {
             ret = d->handleRulesApi(req, rsp);
         }
+        else if (path[2] == "transaction")
+        {
+            ret = d->handleTransactionApi(req, rsp);
+        }
+        else if (path[2] == "streams")
+        {
+            ret = d->handleStreamsApi(req, rsp);
+        }
     }
 
     if (ret == REQ_NOT_HANDLED)
@@ -15,8 +15,10 @@
 #include <QTime>
 #include <QTimer>
 #include <QElapsedTimer>
+#include <QHash>
 #include <stdint.h>
 #include <queue>
+#include <map>
 #if QT_VERSION < 0x050000
 #include <QHttpRequestHeader>
 #endif
@@ -30,6 +32,9 @@
 #include "sensor.h"
 #include "rule.h"
 #include "bindings.h"
+#include "clock.h"
+#include "frame_reader.h"
+#include "device_profile.h"
 #include <math.h>
 
 /*! JSON generic error message codes */
@@ -206,6 +211,89 @@
 #define DB_LONG_SAVE_DELAY  (15 * 60 * 1000) // 15 minutes
 #define DB_SHORT_SAVE_DELAY (5 *  1 * 1000) // 5 seconds
 
+// transactions
+#define TRANSACTION_MAX_OPERATIONS 64
+#define TRANSACTION_MAX_TASKS      128
+
+// confirmed light state
+#define STATE_CONFIRM_TIMEOUT    5 // seconds to wait for a default response
+#define STATE_CONFIRM_MAX_ITEMS  64
+
+// groupcast verification of light state
+#define GROUP_VERIFY_MIN_MEMBERS 2 // lights which need the same read
+#define GROUP_VERIFY_TIMEOUT     5 // seconds to wait for the responses of the members
+#define GROUP_VERIFY_MAX_ITEMS   16
+
+// group state planner
+#define GROUP_PLAN_SCENE_BASE    0xF0 // transient scenes 0xF0..0xF3, not handed out by createScene()
+#define GROUP_PLAN_SCENES        4 // transient scenes per group
+#define GROUP_PLAN_MIN_USES      3 // requests of a combination until it gets a transient scene
+#define GROUP_PLAN_MAX_ITEMS     64 // combinations of all groups
+#define GROUP_PLAN_VERIFY_DELAY  2000 // ms after a new transient scene is recalled until it is verified
+#define GROUP_PLAN_VERIFY_BRI    2 // max. level difference of the read back state
+#define GROUP_PLAN_VERIFY_XY     300 // max. x and y difference of the read back state
+
+// scene placement
+#define SCENE_PLACE_BATCH        4 // store scene requests in flight per light
+
+// sleepy end-device mailbox
+#define MAILBOX_AWAKE_WINDOW  3000 // ms after an indication a device is considered awake
+#define MAILBOX_EXPIRY_TIME   (60 * 60 * 1000) // 1 hour
+#define MAILBOX_MAX_ITEMS     8 // per device
+
+// airtime accounting per network neighbourhood
+#define AIRTIME_WINDOW            1000 // ms
+#define AIRTIME_BUDGET_BYTES      1500 // per window and neighbourhood
+#define AIRTIME_BUDGET_FRAMES     20 // per window and neighbourhood
+#define AIRTIME_BACKGROUND_SHARE  50 // % of the budget usable by polling and bindings
+#define AIRTIME_FRAME_OVERHEAD    30 // MAC, NWK and APS header bytes
+#define AIRTIME_RESOLVE_INTERVAL  (5 * 60 * 1000) // ms until the neighbourhood of a node is looked up again
+
+// interview of newly joined devices
+#define INTERVIEW_TICK            100 // ms
+#define INTERVIEW_MAX_ACTIVE      16 // devices with a request in flight
+#define INTERVIEW_MAX_PER_PARENT  2 // devices with a request in flight per neighbourhood
+#define INTERVIEW_TIMEOUT         2000 // ms to wait for a response
+#define INTERVIEW_TIMEOUT_SLEEPY  6000 // ms, end-devices receive via their parent
+#define INTERVIEW_MAX_RETRIES     3 // per request
+#define INTERVIEW_SEND_BACKOFF    500 // ms after a failed send, doubled per retry
+#define INTERVIEW_KEEP_FINISHED   (10 * 60 * 1000) // ms a finished interview is reported
+
+// real-time light streaming
+#define STREAM_UDP_PORT           2100
+#define STREAM_VERSION            0x01 // of the UDP frame format
+#define STREAM_TICK               40 // ms, 25 Hz
+#define STREAM_MAX_STREAMS        4
+#define STREAM_MAX_CHANNELS       32 // lights per stream
+#define STREAM_MAX_SENDS          4 // ZCL commands per tick and stream
+#define STREAM_IDLE_TIMEOUT       10000 // ms without frames until a stream is inactive
+#define STREAM_STATS_WINDOW       1000 // ms
+#define STREAM_EQUAL_BRI          2 // max. brightness difference of channels sent as groupcast
+#define STREAM_EQUAL_XY           64 // max. color difference of channels sent as groupcast
+
+// simulated devices for load testing
+#define SIM_EXT_PREFIX            0x5A00000000000000ULL // extended address range of virtual devices
+#define SIM_EXT_MASK              0xFF00000000000000ULL
+#define SIM_NWK_BASE              0x8000
+#define SIM_ID_BASE               10000 // first REST id of virtual devices
+#define SIM_ENDPOINT              0x0B
+#define SIM_TICK                  10 // ms
+#define SIM_MAX_HOPS              5
+#define SIM_APS_RETRIES           3 // of acknowledged requests
+#define SIM_GROUP_CAPACITY        16 // groups per virtual light
+#define SIM_DEFAULT_LATENCY       30 // ms per hop
+#define SIM_DEFAULT_EVENT_INTERVAL 60000 // ms, mean interval of switch events
+
+// memory accounting
+#define MEM_CHECK_INTERVAL        (60 * 1000) // ms
+#define MEM_HEAP_OVERHEAD         16 // bytes per heap allocation
+#define MEM_LIST_NODE_OVERHEAD    (2 * sizeof(void*)) // std::list
+#define MEM_MAP_NODE_OVERHEAD     (4 * sizeof(void*)) // std::map, QMap
+#define MEM_DEFAULT_BUDGET_TASKS  64 // KB
+#define MEM_DEFAULT_BUDGET_TRANSACTIONS 128 // KB
+#define MEM_DEFAULT_BUDGET_CLIENTS 1024 // KB
+#define MEM_DEFAULT_BUDGET_RESTCACHE 1024 // KB
+
 // internet discovery
 
 // HTTP status codes
@@ -261,6 +349,12 @@ struct Schedule
         StateDeleted
     };
 
+    /*! Change mask bits, the schedule is stored as JSON string. */
+    enum Field
+    {
+        FieldJson = 0x0001
+    };
+
     Schedule() :
         type(TypeInvalid),
         state(StateNormal),
@@ -309,6 +403,8 @@ struct Schedule
     int timeout;
     /*! Current timeout counting down to ::timeout. */
     int currentTimeout;
+    /*! Changed fields per consumer. */
+    ChangeMask changes;
 };
 
 enum TaskType
@@ -361,6 +457,7 @@ struct TaskItem
         colorY = 0;
         colorTemperature = 0;
         transitionTime = DEFAULT_TRANSITION_TIME;
+        airtimeDeferred = false;
     }
 
     TaskType taskType;
@@ -383,6 +480,7 @@ struct TaskItem
     QString etag;
     uint16_t transitionTime;
     QTcpSocket *client;
+    bool airtimeDeferred; // counted as deferred by the airtime accounting
 
     bool autoMode; // true then this is a automode task
     deCONZ::Node *node;
@@ -390,6 +488,613 @@ struct TaskItem
     deCONZ::ZclCluster *cluster;
 };
 
+/*! Allocation counters of the task lists.
+    Task items move between the tasks and runningTasks lists by splicing
+    list nodes, so each queued task is allocated and freed exactly once.
+ */
+struct TaskAllocStats
+{
+    TaskAllocStats() :
+        allocations(0),
+        frees(0)
+    { }
+
+    quint32 allocations; // list nodes created by addTask()
+    quint32 frees; // list nodes destroyed by releaseTask()
+};
+
+/*! Counters of the group membership reconciler.
+ */
+struct GroupReconcileStats
+{
+    GroupReconcileStats() :
+        attempts(0),
+        confirmed(0),
+        failures(0),
+        verifies(0)
+    { }
+
+    quint32 attempts; // add/remove group commands sent
+    quint32 confirmed; // confirmed by the device
+    quint32 failures; // rejected by the device or given up
+    quint32 verifies; // group membership reads due to missing confirmation
+};
+
+/*! A unicast state command which waits for the default response of a light.
+ */
+struct StateConfirmation
+{
+    StateConfirmation() :
+        extAddr(0),
+        nwkAddr(0),
+        endpoint(0),
+        clusterId(0),
+        zclSeq(0),
+        commandId(0),
+        readFlags(0),
+        timeout(0)
+    { }
+
+    quint64 extAddr;
+    quint16 nwkAddr;
+    quint8 endpoint;
+    quint16 clusterId;
+    quint8 zclSeq;
+    quint8 commandId;
+    uint32_t readFlags; // READ_* flags of the changed attributes
+    int timeout; // idleTotalCounter
+};
+
+/*! A groupcast Read Attributes request which waits for the responses of the group members.
+ */
+struct GroupVerification
+{
+    struct Member
+    {
+        quint64 extAddr;
+        quint16 nwkAddr;
+        quint8 endpoint;
+    };
+
+    GroupVerification() :
+        groupId(0),
+        clusterId(0),
+        zclSeq(0),
+        readFlags(0),
+        timeout(0)
+    { }
+
+    uint16_t groupId;
+    quint16 clusterId;
+    quint8 zclSeq;
+    uint32_t readFlags; // READ_* flag of the read attributes
+    int timeout; // idleTotalCounter
+    std::vector<Member> members; // which haven't answered yet
+};
+
+/*! A combination of group state attributes and its transient scene.
+ */
+struct GroupStatePlan
+{
+    GroupStatePlan() :
+        groupId(0),
+        sceneId(0),
+        hasOn(false),
+        on(false),
+        hasBri(false),
+        bri(0),
+        hasXy(false),
+        x(0),
+        y(0),
+        transitionTime(DEFAULT_TRANSITION_TIME),
+        uses(0),
+        lastUse(0),
+        stored(false),
+        verifyPending(false),
+        verifyTime(0),
+        members(0)
+    { }
+
+    uint16_t groupId;
+    quint8 sceneId; // GROUP_PLAN_SCENE_BASE based
+    bool hasOn;
+    bool on;
+    bool hasBri;
+    quint8 bri;
+    bool hasXy;
+    quint16 x;
+    quint16 y;
+    quint16 transitionTime; // 1/10 seconds
+    int uses;
+    qint64 lastUse; // clockMonotonicMs()
+    bool stored; // Add Scene was sent
+    bool verifyPending; // the read back state of the members is compared with the plan
+    qint64 verifyTime; // clockMonotonicMs() from which the read back state is compared
+    quint32 members; // checksum of the members which got the scene
+};
+
+/*! A light which didn't answer a groupcast verification and is read by unicast next time.
+ */
+struct GroupVerifyFallback
+{
+    quint64 extAddr;
+    quint8 endpoint;
+    uint32_t readFlags;
+};
+
+/*! A command held back until a sleepy end-device wakes up.
+    The task holds no pointers, the light and node are looked up on delivery.
+ */
+struct MailboxItem
+{
+    MailboxItem() : expires(0), lightHandle(0) { }
+
+    qint64 expires; // starttimeRef
+    quint32 lightHandle; // handle of task.lightNode or 0
+    TaskItem task;
+};
+
+/*! Pending commands of a sleepy end-device.
+    The commands are delivered in one burst on the next indication
+    received from the device.
+ */
+struct DeviceMailbox
+{
+    DeviceMailbox() :
+        extAddr(0),
+        nwkAddr(0),
+        lastRx(-1)
+    { }
+
+    quint64 extAddr;
+    quint16 nwkAddr;
+    qint64 lastRx; // starttimeRef of last indication, -1 if none since startup
+    std::list<MailboxItem> items;
+};
+
+/*! The neighbourhood of a node, cached for airtime accounting.
+ */
+struct AirtimeNode
+{
+    AirtimeNode() :
+        extAddr(0),
+        nwkAddr(0),
+        neighbourhood(0),
+        bucket(-1),
+        resolveTime(0)
+    { }
+
+    quint64 extAddr;
+    quint16 nwkAddr;
+    quint64 neighbourhood; // parent or router with the best link to the node
+    int bucket; // index in airtimeBuckets, -1 if the node isn't known by the core
+    qint64 resolveTime; // starttimeRef
+};
+
+/*! Airtime used in one neighbourhood of the mesh.
+    Traffic is counted in fixed windows, the load over a sliding window
+    is estimated from the current and the previous one.
+ */
+struct AirtimeBucket
+{
+    AirtimeBucket() :
+        neighbourhood(0),
+        windowStart(0),
+        bytes(0),
+        frames(0),
+        prevBytes(0),
+        prevFrames(0),
+        totalBytes(0),
+        totalFrames(0),
+        deferred(0)
+    { }
+
+    quint64 neighbourhood;
+    qint64 windowStart; // starttimeRef
+    int bytes;
+    int frames;
+    int prevBytes;
+    int prevFrames;
+    qint64 totalBytes;
+    qint64 totalFrames;
+    qint64 deferred; // tasks and bindings which had to wait for airtime, counted once each
+};
+
+/*! Cached parts of the REST representation of a light or sensor.
+    Only the parts with changed fields are rebuilt on a request.
+ */
+struct RestMapCache
+{
+    QVariantMap attr; // top level attributes without state, config and etag
+    QVariantMap state;
+    QVariantMap config;
+};
+
+/*! Copies of the resources which the operations of a transaction may change.
+    Only the addressed resources and the lights and groups they affect are
+    copied. Resources created by the operations are removed by restoring
+    the previous size of their vector.
+ */
+struct TransactionSnapshot
+{
+    TransactionSnapshot() :
+        nodeCount(0),
+        sensorCount(0),
+        ruleCount(0),
+        scheduleCount(0),
+        allGroups(false),
+        hasGroupState(false),
+        hasBindings(false),
+        saveDatabaseItems(0)
+    { }
+
+    size_t nodeCount;
+    size_t sensorCount;
+    size_t ruleCount;
+    size_t scheduleCount;
+    std::map<size_t, LightNode> nodes; // key is the index in nodes
+    std::map<size_t, Sensor> sensors;
+    std::map<size_t, Rule> rules;
+    std::map<size_t, Schedule> schedules;
+    std::map<size_t, Group> groups;
+    bool allGroups; // groups holds all groups, creating a group may replace a deleted one
+    std::map<quint32, RestMapCache> lightMapCache; // entries of the copied lights
+    std::map<quint32, RestMapCache> sensorMapCache; // entries of the copied sensors
+    bool hasGroupState; // group plans, verifications and mailboxes were copied
+    std::vector<GroupStatePlan> groupStatePlans;
+    std::vector<quint32> groupPlanScenes;
+    std::list<GroupVerification> groupVerifications;
+    std::vector<GroupVerifyFallback> groupVerifyFallbacks;
+    std::vector<DeviceMailbox> mailboxes;
+    bool hasBindings; // binding queues were copied
+    std::list<BindingTask> bindingQueue;
+    std::list<Binding> bindingToRuleQueue;
+    int saveDatabaseItems;
+    QString gwConfigEtag;
+};
+
+/*! A device which takes part in an OTA upgrade campaign.
+ */
+struct OtauCampaignNode
+{
+    enum State
+    {
+        StatePending,
+        StateNotified,
+        StateTransfer,
+        StateVerify,
+        StateDone,
+        StateFailed
+    };
+
+    OtauCampaignNode() :
+        extAddr(0),
+        neighbourhood(0),
+        state(StatePending),
+        retries(0),
+        offset(0),
+        bytes(0),
+        stateTime(0),
+        startTime(0),
+        lastBlockTime(0),
+        duration(0)
+    { }
+
+    quint64 extAddr;
+    quint64 neighbourhood; // ext address of the router with the best link
+    State state;
+    int retries;
+    quint32 offset; // last requested file offset
+    quint32 bytes; // bytes transferred to this node
+    qint64 stateTime; // uptime ms of last state change
+    qint64 startTime; // uptime ms of first block request
+    qint64 lastBlockTime; // uptime ms of last block request
+    qint64 duration; // transfer duration in ms when done
+};
+
+/*! An OTA upgrade campaign for all devices of a model.
+ */
+struct OtauCampaign
+{
+    OtauCampaign() :
+        active(false),
+        paused(false),
+        imageSize(0),
+        maxConcurrent(4),
+        maxPerNeighbourhood(1),
+        bytes(0),
+        transferTime(0)
+    { }
+
+    bool active;
+    bool paused;
+    QString modelId;
+    QString version; // target software version
+    quint32 imageSize; // optional, used for per device progress
+    int maxConcurrent;
+    int maxPerNeighbourhood;
+    qint64 bytes; // total bytes transferred
+    qint64 transferTime; // ms where at least one transfer was running
+    std::vector<OtauCampaignNode> nodes;
+};
+
+/*! Interview of a newly joined device.
+
+    Queries the descriptors and Basic cluster attributes which are
+    needed to create the REST resources of the device.
+ */
+struct Interview
+{
+    enum Stage
+    {
+        StageActiveEndpoints,
+        StageSimpleDescriptors,
+        StageBasic,
+        StageNodeDescriptor,
+        StageDone,
+        StageFailed
+    };
+
+    Interview() :
+        extAddr(0),
+        nwkAddr(0),
+        neighbourhood(0),
+        rxOnWhenIdle(true),
+        stage(StageActiveEndpoints),
+        epIter(0),
+        seq(0),
+        waiting(false),
+        retries(0),
+        requests(0),
+        startTime(0),
+        sendTime(0),
+        nextSendTime(0),
+        finishTime(0)
+    { }
+
+    quint64 extAddr;
+    quint16 nwkAddr;
+    quint64 neighbourhood; // see neighbourhoodOfNode()
+    bool rxOnWhenIdle;
+    Stage stage;
+    std::vector<quint8> endpoints;
+    size_t epIter; // next endpoint to query the simple descriptor
+    quint8 seq; // ZDP or ZCL sequence number of the request in flight
+    bool waiting; // true while a request is in flight
+    int retries; // of the current request
+    int requests; // sent in total
+    qint64 startTime; // starttimeRef
+    qint64 sendTime;
+    qint64 nextSendTime; // earliest time of the next request after a failed send
+    qint64 finishTime;
+};
+
+/*! A light of a real-time stream.
+ */
+struct StreamChannel
+{
+    StreamChannel() :
+        extAddr(0),
+        nwkAddr(0),
+        endpoint(0),
+        hasColor(false),
+        dirty(0),
+        bri(0),
+        x(0),
+        y(0),
+        sentBri(0),
+        sentX(0),
+        sentY(0),
+        hasSent(false)
+    { }
+
+    enum Dirty
+    {
+        DirtyLevel = 0x01,
+        DirtyColor = 0x02
+    };
+
+    QString lightId;
+    quint64 extAddr;
+    quint16 nwkAddr;
+    quint8 endpoint;
+    bool hasColor;
+    quint8 dirty; // bitmap of Dirty, values not sent yet
+    quint8 bri; // latest received values
+    quint16 x;
+    quint16 y;
+    quint8 sentBri;
+    quint16 sentX;
+    quint16 sentY;
+    bool hasSent;
+};
+
+/*! A real-time stream which drives the lights of a group
+    from frames received on the stream UDP port.
+ */
+struct LightStream
+{
+    LightStream() :
+        id(0),
+        token(0),
+        groupAddress(0),
+        lastSeq(0),
+        hasSeq(false),
+        lastRx(-1),
+        nextChannel(0),
+        frames(0),
+        dropped(0),
+        coalesced(0),
+        groupcasts(0),
+        unicasts(0),
+        windowStart(0),
+        windowFrames(0),
+        windowSends(0),
+        frameRate(0),
+        sendRate(0)
+    { }
+
+    quint8 id;
+    quint32 token; // must be in every frame
+    quint16 groupAddress;
+    QString groupId;
+    std::vector<StreamChannel> channels;
+    quint16 lastSeq;
+    bool hasSeq;
+    qint64 lastRx; // clockMonotonicMs() of the last frame, -1 if none
+    size_t nextChannel; // round robin for unicasts
+    // statistics
+    qint64 frames;
+    qint64 dropped; // invalid or out of order frames
+    qint64 coalesced; // values overwritten before they were sent
+    qint64 groupcasts;
+    qint64 unicasts;
+    qint64 windowStart;
+    int windowFrames;
+    int windowSends;
+    double frameRate; // received frames per second
+    double sendRate; // ZCL commands per second
+};
+
+/*! A virtual device of the load test simulation.
+ */
+struct SimDevice
+{
+    SimDevice() :
+        extAddr(0),
+        nwkAddr(0),
+        hops(1),
+        isSwitch(false),
+        on(false),
+        level(0),
+        x(0),
+        y(0),
+        nextEvent(0)
+    { }
+
+    quint64 extAddr;
+    quint16 nwkAddr;
+    int hops; // distance to the coordinator
+    bool isSwitch; // switch or light
+    bool on;
+    quint8 level;
+    quint16 x;
+    quint16 y;
+    qint64 nextEvent; // clockMonotonicMs() of the next switch event
+    std::vector<quint16> groups;
+};
+
+/*! A simulated confirm or indication which is delivered when due.
+ */
+struct SimEvent
+{
+    enum Type
+    {
+        TypeConfirm,
+        TypeIndication
+    };
+
+    SimEvent() :
+        type(TypeConfirm),
+        apsId(0),
+        status(0),
+        device(0),
+        srcEndpoint(0),
+        profileId(0),
+        clusterId(0)
+    { }
+
+    Type type;
+    quint8 apsId; // confirm
+    quint8 status;
+    size_t device; // indication
+    quint8 srcEndpoint;
+    quint16 profileId;
+    quint16 clusterId;
+    QByteArray asdu;
+};
+
+/*! Subsystems of the memory accounting.
+ */
+enum MemorySubsystem
+{
+    MemLights,
+    MemSensors,
+    MemGroups,    // including scenes
+    MemRules,
+    MemSchedules,
+    MemTasks,
+    MemTransactions, // collected and committed transaction tasks
+    MemClients,   // HTTP connections and their buffers
+    MemRestCache,
+    MemOther,     // interviews, streams and simulation
+    MemSubsystemCount
+};
+
+/*! Estimated memory of a subsystem and its soft budget.
+ */
+struct MemoryAccount
+{
+    MemoryAccount() :
+        bytes(0),
+        peak(0),
+        items(0),
+        budget(0),
+        sheds(0)
+    { }
+
+    size_t bytes;
+    size_t peak;
+    size_t items;
+    size_t budget; // 0 if unlimited
+    quint32 sheds; // times memory was freed or a task rejected
+};
+
+/*! Progress of a stage of the startup pipeline.
+ */
+struct StartupStageInfo
+{
+    StartupStageInfo() :
+        startTime(-1),
+        duration(-1),
+        budget(0),
+        items(0),
+        timedOut(false)
+    { }
+
+    qint64 startTime; // starttimeRef
+    qint64 duration; // ms, -1 while not finished
+    int budget; // max. lights with pending reads at a time, 0 if not limited
+    int items; // nodes handled by the stage
+    bool timedOut;
+};
+
+/*! Deployment of the bindings required by the whole rule set.
+ */
+struct RuleDeployment
+{
+    RuleDeployment() :
+        active(false),
+        rules(0),
+        requested(0),
+        devices(0),
+        pending(0),
+        checking(0),
+        startTime(0),
+        duration(0)
+    { }
+
+    bool active;
+    int rules; // rules which need bindings
+    int requested; // bindings requested by all rules, including shared ones
+    int devices; // source devices
+    int pending; // planned bindings which are still in the binding queue
+    int checking; // pending bindings which wait for the binding table
+    qint64 startTime; // starttimeRef
+    qint64 duration; // ms
+    std::vector<BindingTask> tasks; // deduplicated plan
+};
+
 /*! \class ApiAuth
 
     Helper to combine serval authentification parameters.
@@ -497,6 +1202,15 @@ public:
 
     void configToMap(const ApiRequest &req, QVariantMap &map);
 
+    // REST API transactions
+    int handleTransactionApi(const ApiRequest &req, ApiResponse &rsp);
+    bool validateTransactionOperation(const QVariantList &ops, int index, const QString &apikey, QStringList &path, ApiResponse &rsp);
+    void transactionSnapshotLight(TransactionSnapshot &snap, LightNode *lightNode);
+    void transactionSnapshotGroup(TransactionSnapshot &snap, Group *group);
+    void transactionSnapshot(TransactionSnapshot &snap, const QStringList &path, const QVariantMap &op);
+    void transactionRestore(TransactionSnapshot &snap);
+    void queueTransactionTasks();
+
     // REST API lights
     int handleLightsApi(ApiRequest &req, ApiResponse &rsp);
     int getAllLights(const ApiRequest &req, ApiResponse &rsp);
@@ -520,6 +1234,7 @@ public:
     int setGroupAttributes(const ApiRequest &req, ApiResponse &rsp);
     int setGroupState(const ApiRequest &req, ApiResponse &rsp);
     int deleteGroup(const ApiRequest &req, ApiResponse &rsp);
+    int getGroupMembershipState(const ApiRequest &req, ApiResponse &rsp);
 
     // REST API groups > scenes
     int createScene(const ApiRequest &req, ApiResponse &rsp);
@@ -574,6 +1289,10 @@ public:
     int updateRule(const ApiRequest &req, ApiResponse &rsp);
     int deleteRule(const ApiRequest &req, ApiResponse &rsp);
     void queueCheckRuleBindings(const Rule &rule);
+    Sensor *compileRuleBindings(const Rule &rule, std::vector<BindingTask> &bindingTasks);
+    int planRuleDeployment();
+    void updateRuleDeployment();
+    int handleRuleDeploymentApi(const ApiRequest &req, ApiResponse &rsp);
     void triggerRuleIfNeeded(Rule &rule);
 
     bool checkActions(QVariantList actionsList, ApiResponse &rsp);
@@ -598,6 +1317,18 @@ public:
     void otauSendStdNotify(LightNode *node);
     bool isOtauBusy();
     bool isOtauActive();
+    int handleOtauCampaignApi(const ApiRequest &req, ApiResponse &rsp);
+    int createOtauCampaign(const ApiRequest &req, ApiResponse &rsp);
+    int getOtauCampaign(const ApiRequest &req, ApiResponse &rsp);
+    int modifyOtauCampaign(const ApiRequest &req, ApiResponse &rsp);
+    int deleteOtauCampaign(const ApiRequest &req, ApiResponse &rsp);
+    void otauCampaignTick();
+    void otauCampaignBlockRequest(const deCONZ::ApsDataIndication &ind, const deCONZ::ZclFrame &zclFrame);
+    void otauCampaignSetState(OtauCampaignNode &cnode, OtauCampaignNode::State state);
+    quint64 otauCampaignNeighbourhood(LightNode *lightNode);
+    void otauCampaignToMap(QVariantMap &map);
+    void saveOtauCampaign();
+    void loadOtauCampaign(const QString &json);
 
     // WSNDemo sensor
     void wsnDemoDataIndication(const deCONZ::ApsDataIndication &ind);
@@ -609,6 +1340,9 @@ public:
     //reset Device
     void initResetDeviceApi();
 
+    // device profiles
+    void initDeviceProfiles();
+
     //Timezone
     std::string getTimezone();
 
@@ -623,6 +1357,9 @@ public Q_SLOTS:
     int taskCountForAddress(const deCONZ::Address &address);
     void processTasks();
     void processGroupTasks();
+    void reconcileGroupMembership();
+    bool groupMembershipNeedsUpdate(const GroupInfo &groupInfo, bool &add);
+    void confirmGroupMembership(LightNode *lightNode, uint16_t groupId, uint8_t status, bool add);
     void nodeEvent(const deCONZ::NodeEvent &event);
     void internetDiscoveryTimerFired();
     void internetDiscoveryFinishedRequest(QNetworkReply *reply);
@@ -677,6 +1414,29 @@ public Q_SLOTS:
     void checkResetState();
     void resetDeviceSendConfirm(bool success);
 
+    // startup pipeline
+    void initStartup();
+    void startupTimerFired();
+
+    // interview of newly joined devices
+    void initInterview();
+    void interviewTimerFired();
+
+#ifdef DECONZ_REST_SIMULATION
+    // simulated devices, only in builds with CONFIG+=simulation
+    void initSimulation();
+    void simTimerFired();
+#endif
+
+    // memory accounting
+    void initMemory();
+    void memTimerFired();
+
+    // real-time light streaming
+    void initStreams();
+    void streamReadyRead();
+    void streamTimerFired();
+
     // firmware update
     void initFirmwareUpdate();
     void firmwareUpdateTimerFired();
@@ -685,11 +1445,15 @@ public Q_SLOTS:
     void updateFirmwareDisconnectDevice();
     void updateFirmware();
     void updateFirmwareWaitFinished();
+    void firmwareUpdateReadOutput();
+    void firmwareUpdateFinished(int exitCode);
+    void firmwareUpdateError();
     bool startUpdateFirmware();
 
 public:
     void checkRfConnectState();
     bool isInNetwork();
+    bool canSendTasks();
     void generateGatewayUuid();
     void updateEtag(QString &etag);
     qint64 getUptime();
@@ -699,18 +1463,28 @@ public:
     LightNode *getLightNodeForAddress(quint64 extAddr, quint8 endpoint = 0);
     int getNumberOfEndpoints(quint64 extAddr);
     LightNode *getLightNodeForId(const QString &id);
+    LightNode *getLightNodeForHandle(quint32 handle);
     Rule *getRuleForId(const QString &id);
+    Rule *getRuleForHandle(quint32 handle);
     Rule *getRuleForName(const QString &name);
     void addSensorNode(const deCONZ::Node *node);
     void addSensorNode(const deCONZ::Node *node, const SensorFingerprint &fingerPrint, const QString &type);
     void checkSensorNodeReachable(Sensor *sensor);
     void updateSensorNode(const deCONZ::NodeEvent &event);
+    void updateSensorLux(Sensor *sensor, quint32 lux);
+    void publishPendingSensorValues();
     void checkAllSensorsAvailable();
     Sensor *getSensorNodeForAddressAndEndpoint(quint64 extAddr, quint8 ep);
     Sensor *getSensorNodeForAddress(quint64 extAddr);
     Sensor *getSensorNodeForFingerPrint(quint64 extAddr, const SensorFingerprint &fingerPrint, const QString &type);
     Sensor *getSensorNodeForUniqueId(const QString &uniqueId);
     Sensor *getSensorNodeForId(const QString &id);
+    Sensor *getSensorNodeForHandle(quint32 handle);
+    void indexLight(int index);
+    void indexSensor(int index);
+    void indexRule(int index);
+    void rebuildResourceIndexes();
+    void pruneIdHandles();
     Group *getGroupForName(const QString &name);
     Group *getGroupForId(uint16_t id);
     Group *getGroupForId(const QString &id);
@@ -730,8 +1504,8 @@ public:
     bool readGroupMembership(LightNode *lightNode, const std::vector<uint16_t> &groups);
     void foundGroupMembership(LightNode *lightNode, uint16_t groupId);
     void foundGroup(uint16_t groupId);
-    bool isLightNodeInGroup(LightNode *lightNode, uint16_t groupId);
-    void deleteLightFromScenes(QString lightId, uint16_t groupId);
+    bool isLightNodeInGroup(const LightNode *lightNode, uint16_t groupId);
+    void deleteLightFromScenes(quint32 lightHandle, uint16_t groupId);
     void readAllInGroup(Group *group);
     void setAttributeOnOffGroup(Group *group, uint8_t onOff);
     bool readSceneMembership(LightNode *lightNode, Group *group);
@@ -741,6 +1515,17 @@ public:
     bool modifyScene(Group *group, uint8_t sceneId);
     bool removeScene(Group *group, uint8_t sceneId);
     bool callScene(Group *group, uint8_t sceneId);
+    bool planGroupState(Group *group, const QVariantMap &map, TaskItem &task, ApiResponse &rsp);
+    bool groupPlanSupported(Group *group, const GroupStatePlan &plan, quint32 &members, bool store);
+    bool addTaskAddGroupPlanScene(Group *group, const GroupStatePlan &plan);
+    bool isGroupPlanScene(uint16_t groupId, uint8_t sceneId) const;
+    void groupPlanVerify(LightNode *lightNode);
+    int sceneSlotsFree(const LightNode *lightNode);
+    bool canPlaceScene(LightNode *lightNode, uint16_t groupId, uint8_t sceneId);
+    bool canPlaceInGroup(const LightNode *lightNode, uint16_t groupId);
+    int checkScenePlacement(Group *group, uint8_t sceneId, ApiResponse &rsp, int &rejected);
+    bool addTaskStoreScenes(TaskItem &task);
+    void rejectScenePlacements(LightNode *lightNode);
     bool removeAllScenes(Group *group);
 
     bool pushState(QString json, QTcpSocket *sock);
@@ -751,6 +1536,25 @@ public:
 
     // Task interface
     bool addTask(const TaskItem &task);
+    bool addTaskToQueue(const TaskItem &task);
+    void releaseTask(std::list<TaskItem> &list, std::list<TaskItem>::iterator i);
+    void releaseAllTasks(std::list<TaskItem> &list);
+    bool isSleepyEndDevice(const deCONZ::Node *node);
+    DeviceMailbox *getMailbox(quint64 extAddr);
+    bool isMailboxDeviceAsleep(quint64 extAddr);
+    bool mailboxHoldTask(const TaskItem &task);
+    void mailboxPurgeExpired(DeviceMailbox &mb, qint64 now);
+    bool mailboxRestoreTask(const DeviceMailbox &mb, MailboxItem &item);
+    void mailboxIndication(const deCONZ::ApsDataIndication &ind);
+    quint64 neighbourhoodOfNode(const deCONZ::Node *node);
+    AirtimeBucket *airtimeBucket(const deCONZ::Address &addr);
+    void airtimeRotate(AirtimeBucket &bucket, qint64 now);
+    int airtimeLoad(const AirtimeBucket &bucket) const;
+    void airtimeAccount(const deCONZ::Address &addr, int asduSize);
+    void airtimeAccountBroadcast(int asduSize);
+    bool isNeighbourhoodCongested(const deCONZ::Address &addr, bool background, bool *deferred = 0);
+    bool isNeighbourhoodCongested(quint64 extAddr, bool background, bool *deferred = 0);
+    int getAirtime(const ApiRequest &req, ApiResponse &rsp);
     bool addTaskMoveLevel(TaskItem &task, bool withOnOff, bool upDirection, quint8 rate);
     bool addTaskSetOnOff(TaskItem &task, quint8 cmd, quint16 ontime);
     bool addTaskSetBrightness(TaskItem &task, uint8_t bri, bool withOnOff);
@@ -767,13 +1571,23 @@ public:
     bool addTaskViewGroup(TaskItem &task, uint16_t groupId);
     bool addTaskRemoveFromGroup(TaskItem &task, uint16_t groupId);
     bool addTaskStoreScene(TaskItem &task, uint16_t groupId, uint8_t sceneId);
-    bool addTaskAddScene(TaskItem &task, uint16_t groupId, uint8_t sceneId, QString lightId);
+    bool addTaskAddScene(TaskItem &task, uint16_t groupId, uint8_t sceneId, quint32 lightHandle);
     bool addTaskRemoveScene(TaskItem &task, uint16_t groupId, uint8_t sceneId);
+    bool addTaskRemoveAllScenes(TaskItem &task, uint16_t groupId);
+    uint32_t taskStateFlags(const TaskItem &task);
+    void setStateConfirmMode(TaskItem &task);
+    void expectStateConfirmation(const TaskItem &task);
+    bool handleStateConfirmation(const deCONZ::ApsDataIndication &ind, const deCONZ::ZclFrame &zclFrame);
+    void checkStateConfirmations();
+    bool verifyGroupState(LightNode *lightNode, uint32_t readFlag);
+    bool handleGroupVerification(const deCONZ::ApsDataIndication &ind, const deCONZ::ZclFrame &zclFrame);
+    void checkGroupVerifications();
     bool obtainTaskCluster(TaskItem &task, const deCONZ::ApsDataIndication &ind);
     void handleGroupClusterIndication(TaskItem &task, const deCONZ::ApsDataIndication &ind, deCONZ::ZclFrame &zclFrame);
     void handleSceneClusterIndication(TaskItem &task, const deCONZ::ApsDataIndication &ind, deCONZ::ZclFrame &zclFrame);
     void handleOnOffClusterIndication(TaskItem &task, const deCONZ::ApsDataIndication &ind, deCONZ::ZclFrame &zclFrame);
     void handleCommissioningClusterIndication(TaskItem &task, const deCONZ::ApsDataIndication &ind, deCONZ::ZclFrame &zclFrame);
+    bool handleTaskConfirm(quint8 id, quint8 status);
     bool handleMgmtBindRspConfirm(const deCONZ::ApsDataConfirm &conf);
     void handleDeviceAnnceIndication(const deCONZ::ApsDataIndication &ind);
     void handleMgmtBindRspIndication(const deCONZ::ApsDataIndication &ind);
@@ -819,6 +1633,12 @@ public:
     std::vector<int> sensorIds;
     QTimer *databaseTimer;
 
+    // transactions
+    bool transactionActive;
+    int transactionSaveDelay; // shortest delay requested by queSaveDb() while active
+    std::list<TaskItem> transactionTasks; // tasks deferred until commit
+    std::list<TaskItem> transactionBacklog; // committed tasks which didn't fit into the queue yet
+
     // authentification
     std::vector<ApiAuth> apiAuths;
     QString gwAdminUserName;
@@ -852,6 +1672,90 @@ public:
     bool gwDeleteUnknownRules;
     bool groupDeviceMembershipChecked;
 
+    // startup pipeline
+    enum StartupStage {
+        StartupLoadDb,
+        StartupReachability,
+        StartupCriticalState,
+        StartupMembership,
+        StartupBindings,
+        StartupReady,
+        StartupStageCount
+    };
+    bool isStartupReady() const;
+    static uint32_t startupStageReadFlags(StartupStage stage);
+    uint32_t startupAllowedReads() const;
+    static const char *startupStageToString(StartupStage stage);
+    uint32_t startupPendingReads(LightNode *lightNode);
+    void startupNextStage(bool timedOut);
+    int getStartupReadiness(const ApiRequest &req, ApiResponse &rsp);
+    StartupStage startupStage;
+    size_t startupIter; // next light to hand out reads
+    int startupNodeCount; // nodes and sensors at last tick of the load stage
+    StartupStageInfo startupStages[StartupStageCount];
+    QTimer *startupTimer;
+
+    // interview of newly joined devices
+    void interviewStart(const ZdpDeviceAnnce &annce);
+    bool interviewSendRequest(Interview &iv);
+    void interviewAdvance(Interview &iv, bool success);
+    void interviewZdpIndication(const deCONZ::ApsDataIndication &ind);
+    void interviewBasicIndication(const deCONZ::ApsDataIndication &ind, const deCONZ::ZclFrame &zclFrame);
+    static const char *interviewStageToString(Interview::Stage stage);
+    int getInterviews(const ApiRequest &req, ApiResponse &rsp);
+    std::vector<Interview> interviews;
+    QTimer *interviewTimer;
+
+    // real-time light streaming
+    int handleStreamsApi(ApiRequest &req, ApiResponse &rsp);
+    int createStream(const ApiRequest &req, ApiResponse &rsp);
+    int getAllStreams(const ApiRequest &req, ApiResponse &rsp);
+    int getStream(const ApiRequest &req, ApiResponse &rsp);
+    int deleteStream(const ApiRequest &req, ApiResponse &rsp);
+    QVariantMap streamToMap(const LightStream &stream);
+    LightStream *getStreamForId(const QString &id);
+    void streamFrame(const QByteArray &datagram);
+    quint8 streamSend(LightStream &stream, const deCONZ::Address &addr, deCONZ::ApsAddressMode mode, quint8 dstEndpoint, quint8 dirty, const StreamChannel &values);
+    void streamProcess(LightStream &stream, qint64 now);
+    void streamUpdateLight(const StreamChannel &channel, quint8 sent, const StreamChannel &values);
+    std::vector<LightStream> streams;
+    QUdpSocket *streamSock;
+    QTimer *streamTimer;
+
+#ifdef DECONZ_REST_SIMULATION
+    // simulated devices
+    bool simIsVirtual(quint64 extAddr) const;
+    bool simApsdeDataRequest(const deCONZ::ApsDataRequest &req);
+    void simReleaseRealTasks(std::list<TaskItem> &list);
+    qint64 simHopDelay(const SimDevice &dev);
+    bool simHandleZcl(SimDevice &dev, const deCONZ::ApsDataRequest &req, QByteArray &rsp);
+    void simQueueIndication(size_t device, quint16 clusterId, const QByteArray &asdu, qint64 due);
+    int getSimulation(const ApiRequest &req, ApiResponse &rsp);
+    std::vector<SimDevice> simDevices;
+    std::multimap<qint64, SimEvent> simEvents; // by due time
+    int simLatency; // ms per hop
+    int simLoss; // % of lost transmissions
+    int simEventInterval;
+    qint64 simRequests;
+    qint64 simLost;
+    qint64 simIndications;
+    qint64 simLatencySum;
+    QTimer *simTimer;
+#endif
+
+    // memory accounting
+    void memUpdate();
+    void memShed(MemorySubsystem subsystem);
+    size_t *memTaskCounter(const std::list<TaskItem> &list);
+    void memTaskAdded(const std::list<TaskItem> &list, const TaskItem &task);
+    void memTaskRemoved(const std::list<TaskItem> &list, const TaskItem &task);
+    static const char *memSubsystemToString(MemorySubsystem subsystem);
+    int getMemory(const ApiRequest &req, ApiResponse &rsp);
+    MemoryAccount memAccounts[MemSubsystemCount];
+    size_t memTaskBytes; // running estimate of tasks and runningTasks
+    size_t memTransactionBytes; // running estimate of transactionTasks and transactionBacklog
+    QTimer *memTimer;
+
     // firmware update
     enum FW_UpdateState {
         FW_Idle,
@@ -862,12 +1766,29 @@ public:
         FW_Update,
         FW_UpdateWaitFinished
     };
+    enum FW_UpdatePhase { // ordered as reported by the flasher
+        FW_PhaseNone,
+        FW_PhaseStart,
+        FW_PhaseReset,
+        FW_PhaseBootloader,
+        FW_PhaseFlash,
+        FW_PhaseVerify,
+        FW_PhaseDone,
+        FW_PhaseFailed
+    };
+    void parseFirmwareUpdateOutput(const QByteArray &line);
+    void setFirmwareUpdatePhase(FW_UpdatePhase phase, int progress);
+    static const char *firmwareUpdatePhaseToString(FW_UpdatePhase phase);
+    bool verifyFirmwareImage(const QString &path);
     QTimer *fwUpdateTimer;
     int fwUpdateIdleTimeout;
     FW_UpdateState fwUpdateState;
+    FW_UpdatePhase fwUpdatePhase;
+    int fwUpdateProgress; // 0..100 of the current phase
     QString fwUpdateFile;
     QProcess *fwProcess;
     QStringList fwProcessArgs;
+    QByteArray fwProcessOutput; // incomplete output line of the flasher
 
     // upnp
     QByteArray descriptionXml;
@@ -878,7 +1799,7 @@ public:
     // permit join
     // used by searchLights()
     QTimer *permitJoinTimer;
-    QTime permitJoinLastSendTime;
+    qint64 permitJoinLastSendTime; // clockMonotonicMs() based, -1 to send now
     bool permitJoinFlag; // indicates that permitJoin changed from greater than 0 to 0
 
     // schedules
@@ -898,6 +1819,8 @@ public:
     int otauBusyTicks;
     uint otauNotifyIter; // iterator over nodes
     int otauNotifyDelay;
+    OtauCampaign otauCampaign;
+    qint64 otauCampaignLastTick;
 
     // touchlink
 
@@ -987,12 +1910,17 @@ public:
     // sensors
     QString lastscan;
 
+    // device profiles
+    DeviceProfileDatabase deviceProfiles;
+
     // rules
 
     QTimer *saveCurrentRuleInDbTimer;
     // general
     deCONZ::ApsController *apsCtrl;
     uint groupTaskNodeIter; // Iterates through nodes array
+    size_t groupReconcileIter; // start node of the next reconcile pass
+    GroupReconcileStats groupReconcileStats;
     int idleTotalCounter; // sys timer
     int idleLimit;
     int idleLastActivity; // delta in seconds
@@ -1005,9 +1933,26 @@ public:
     std::vector<LightNode> nodes;
     std::vector<Rule> rules;
     std::vector<Sensor> sensors;
+    IdHandleTable idHandles; // interned non-numeric resource ids
+    QHash<quint32, int> lightIndexes; // handle -> index in nodes
+    QHash<quint32, int> sensorIndexes; // handle -> index in sensors
+    QHash<quint32, int> ruleIndexes; // handle -> index in rules
     std::list<LightNode*> broadCastUpdateNodes;
     std::list<TaskItem> tasks;
     std::list<TaskItem> runningTasks;
+    TaskAllocStats taskAllocStats;
+    std::vector<DeviceMailbox> mailboxes; // held back commands for sleepy end-devices
+    std::vector<AirtimeNode> airtimeNodes;
+    std::vector<AirtimeBucket> airtimeBuckets;
+    QHash<quint64, int> airtimeNodeByExt; // index in airtimeNodes
+    QHash<quint16, int> airtimeNodeByNwk;
+    std::map<quint32, RestMapCache> lightMapCache; // key is the light handle
+    std::map<quint32, RestMapCache> sensorMapCache; // key is the sensor handle
+    std::list<StateConfirmation> stateConfirmations; // unicast state commands waiting for default response
+    std::list<GroupVerification> groupVerifications; // groupcast reads waiting for the responses of the members
+    std::vector<GroupVerifyFallback> groupVerifyFallbacks;
+    std::vector<GroupStatePlan> groupStatePlans; // recurring group state combinations
+    std::vector<quint32> groupPlanScenes; // group address << 8 | scene id of the stored transient scenes
     QTimer *verifyRulesTimer;
     QTimer *taskTimer;
     QTimer *groupTaskTimer;
@@ -1025,6 +1970,7 @@ public:
     QTimer *bindingTableReaderTimer;
     std::list<Binding> bindingToRuleQueue; // check if rule exists for discovered bindings
     std::list<BindingTask> bindingQueue; // bind/unbind queue
+    RuleDeployment ruleDeployment;
     std::vector<BindingTableReader> bindingTableReaders;
 
     // TCP connection watcher
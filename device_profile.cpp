@@ -0,0 +1,381 @@
+/*
+ * Copyright (c) 2016 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <QFile>
+#include "de_web_plugin_private.h"
+#include "device_profile.h"
+#include "json.h"
+
+static const DeviceProfileDatabase *activeDatabase = 0;
+
+/*! Built-in device descriptions, these replace the former hard-coded whitelists.
+ */
+static const char *builtinDeviceProfiles =
+    "{\"profiles\": ["
+    "{\"name\": \"interim FLS-H\", \"modelid\": \"FLS-H\", \"manufacturercode\": \"0x1014\","
+     "\"quirks\": [\"noxy\", \"ctassaturation\"], \"ctmin\": 153, \"ctmax\": 500},"
+    "{\"name\": \"legacy FLS\", \"manufacturercode\": \"0x1014\", \"quirks\": [\"noxy\"]},"
+    "{\"name\": \"FLS-NB\", \"modelid\": \"FLS-NB*\","
+     "\"capabilities\": [\"bindingtable\", \"reporting\", \"otaunotify\"], \"quirks\": [\"rawilluminance\"]},"
+    "{\"name\": \"LM TC\", \"modelid\": \"LM_00.00.03.02TC\","
+     "\"capabilities\": [\"bindingtable\", \"reporting\", \"enddevicereporting\"]},"
+    "{\"name\": \"LM\", \"modelid\": \"LM_00.00*\", \"capabilities\": [\"bindingtable\"]},"
+    "{\"name\": \"D1\", \"modelid\": \"D1*\", \"capabilities\": [\"bindingtable\"]},"
+    "{\"name\": \"S1\", \"modelid\": \"S1*\", \"capabilities\": [\"bindingtable\"]},"
+    "{\"name\": \"S2\", \"modelid\": \"S2*\", \"capabilities\": [\"bindingtable\"]},"
+    "{\"name\": \"C4\", \"modelid\": \"C4*\", \"capabilities\": [\"bindingtable\"]},"
+    "{\"name\": \"BEGA\", \"manufacturername\": \"BEGA*\", \"capabilities\": [\"bindingtable\"]}"
+    "]}";
+
+/*! Maps a capability name of the description format to its flag.
+    \return the flag or 0 if unknown
+ */
+static quint32 capabilityFromString(const QString &str)
+{
+    if      (str == QLatin1String("onoff"))              { return CapReadOnOff; }
+    else if (str == QLatin1String("level"))              { return CapReadLevel; }
+    else if (str == QLatin1String("color"))              { return CapReadColor; }
+    else if (str == QLatin1String("bindingtable"))       { return CapReadBindingTable; }
+    else if (str == QLatin1String("reporting"))          { return CapAttributeReporting; }
+    else if (str == QLatin1String("enddevicereporting")) { return CapEndDeviceReporting; }
+    else if (str == QLatin1String("otaunotify"))         { return CapOtauNotify; }
+    return 0;
+}
+
+/*! Maps a quirk name of the description format to its flag.
+    \return the flag or 0 if unknown
+ */
+static quint32 quirkFromString(const QString &str)
+{
+    if      (str == QLatin1String("noxy"))            { return QuirkNoColorXy; }
+    else if (str == QLatin1String("ctassaturation"))  { return QuirkCtAsSaturation; }
+    else if (str == QLatin1String("rawilluminance"))  { return QuirkRawIlluminance; }
+    return 0;
+}
+
+/*! Constructor.
+ */
+DeviceProfile::DeviceProfile() :
+    modelIdPrefix(false),
+    manufacturerPrefix(false),
+    manufacturerCode(0),
+    capabilities(0),
+    capabilitiesMask(0),
+    quirks(0),
+    hasCtRange(false),
+    ctMin(153),
+    ctMax(500)
+{
+}
+
+/*! Returns true if the profile applies to a device.
+    \param modelId - the model identifier of the device
+    \param manufacturer - the manufacturer name of the device
+    \param manufacturerCode - the manufacturer code of the device
+ */
+bool DeviceProfile::matches(const QString &modelId, const QString &manufacturer, quint16 manufacturerCode) const
+{
+    if (this->manufacturerCode != 0 && this->manufacturerCode != manufacturerCode)
+    {
+        return false;
+    }
+
+    if (!this->modelId.isEmpty())
+    {
+        if (modelIdPrefix ? !modelId.startsWith(this->modelId) : (modelId != this->modelId))
+        {
+            return false;
+        }
+    }
+
+    if (!this->manufacturer.isEmpty())
+    {
+        if (manufacturerPrefix ? !manufacturer.startsWith(this->manufacturer) : (manufacturer != this->manufacturer))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*! Constructor.
+ */
+DeviceProfileDatabase::DeviceProfileDatabase()
+{
+}
+
+/*! Compiles a profile from its description and appends it.
+    \return true on success
+ */
+bool DeviceProfileDatabase::addProfile(const QVariantMap &map)
+{
+    bool ok;
+    DeviceProfile profile;
+
+    profile.name = map["name"].toString();
+    profile.modelId = map["modelid"].toString();
+    profile.manufacturer = map["manufacturername"].toString();
+
+    if (profile.modelId.endsWith('*'))
+    {
+        profile.modelId.chop(1);
+        profile.modelIdPrefix = true;
+    }
+
+    if (profile.manufacturer.endsWith('*'))
+    {
+        profile.manufacturer.chop(1);
+        profile.manufacturerPrefix = true;
+    }
+
+    if (map.contains("manufacturercode"))
+    {
+        profile.manufacturerCode = map["manufacturercode"].toString().toUShort(&ok, 0);
+        if (!ok)
+        {
+            DBG_Printf(DBG_ERROR, "device profile %s has invalid manufacturercode\n", qPrintable(profile.name));
+            return false;
+        }
+    }
+
+    if (profile.modelId.isEmpty() && profile.manufacturer.isEmpty() && profile.manufacturerCode == 0)
+    {
+        DBG_Printf(DBG_ERROR, "device profile %s matches any device, ignored\n", qPrintable(profile.name));
+        return false;
+    }
+
+    QStringList caps = map["capabilities"].toStringList();
+    for (int i = 0; i < caps.size(); i++)
+    {
+        quint32 cap = capabilityFromString(caps[i]);
+        if (cap == 0)
+        {
+            DBG_Printf(DBG_ERROR, "device profile %s has unknown capability %s\n", qPrintable(profile.name), qPrintable(caps[i]));
+            continue;
+        }
+        profile.capabilities |= cap;
+        profile.capabilitiesMask |= cap;
+    }
+
+    caps = map["nocapabilities"].toStringList();
+    for (int i = 0; i < caps.size(); i++)
+    {
+        quint32 cap = capabilityFromString(caps[i]);
+        profile.capabilities &= ~cap;
+        profile.capabilitiesMask |= cap;
+    }
+
+    QStringList quirks = map["quirks"].toStringList();
+    for (int i = 0; i < quirks.size(); i++)
+    {
+        quint32 quirk = quirkFromString(quirks[i]);
+        if (quirk == 0)
+        {
+            DBG_Printf(DBG_ERROR, "device profile %s has unknown quirk %s\n", qPrintable(profile.name), qPrintable(quirks[i]));
+            continue;
+        }
+        profile.quirks |= quirk;
+    }
+
+    if (map.contains("ctmin"))
+    {
+        profile.ctMin = map["ctmin"].toUInt();
+        profile.hasCtRange = true;
+    }
+
+    if (map.contains("ctmax"))
+    {
+        profile.ctMax = map["ctmax"].toUInt();
+        profile.hasCtRange = true;
+    }
+
+    m_profiles.push_back(profile);
+    return true;
+}
+
+/*! Loads device profiles from a JSON description, the profiles are appended.
+    \param json - the description
+    \return true on success
+ */
+bool DeviceProfileDatabase::load(const QString &json)
+{
+    bool ok;
+    QVariantMap map = Json::parse(json, ok).toMap();
+
+    if (!ok || !map.contains("profiles"))
+    {
+        return false;
+    }
+
+    QVariantList ls = map["profiles"].toList();
+    QVariantList::const_iterator i = ls.begin();
+    QVariantList::const_iterator end = ls.end();
+
+    for (; i != end; ++i)
+    {
+        addProfile(i->toMap());
+    }
+
+    return true;
+}
+
+/*! Appends the built-in profiles.
+ */
+void DeviceProfileDatabase::loadBuiltin()
+{
+    bool ok = load(QLatin1String(builtinDeviceProfiles));
+    DBG_Assert(ok);
+}
+
+/*! Merges all profiles which match a device.
+    The profiles are applied from last to first, so an earlier profile
+    overrides the capabilities and color temperature range of a later one.
+    \param defaultCapabilities - capabilities of the device type, see capabilitiesForDeviceId()
+ */
+CompiledDeviceProfile DeviceProfileDatabase::compile(const QString &modelId, const QString &manufacturer, quint16 manufacturerCode,
+                                                     quint32 defaultCapabilities) const
+{
+    CompiledDeviceProfile result;
+    result.capabilities = defaultCapabilities;
+
+    std::vector<DeviceProfile>::const_reverse_iterator i = m_profiles.rbegin();
+    std::vector<DeviceProfile>::const_reverse_iterator end = m_profiles.rend();
+
+    for (; i != end; ++i)
+    {
+        if (!i->matches(modelId, manufacturer, manufacturerCode))
+        {
+            continue;
+        }
+
+        result.matches++;
+        result.capabilities = (result.capabilities & ~i->capabilitiesMask) | i->capabilities;
+        result.quirks |= i->quirks;
+
+        if (i->hasCtRange)
+        {
+            result.ctMin = i->ctMin;
+            result.ctMax = i->ctMax;
+        }
+
+        DBG_Printf(DBG_INFO_L2, "device %s uses device profile %s\n", qPrintable(modelId), qPrintable(i->name));
+    }
+
+    return result;
+}
+
+/*! Returns the number of profiles.
+ */
+size_t DeviceProfileDatabase::size() const
+{
+    return m_profiles.size();
+}
+
+/*! Returns the database used to resolve the profiles of lights and sensors or 0.
+ */
+const DeviceProfileDatabase *DeviceProfileDatabase::active()
+{
+    return activeDatabase;
+}
+
+/*! Sets the database used to resolve the profiles of lights and sensors, see RestNodeBase::hasCapability().
+ */
+void DeviceProfileDatabase::setActive(const DeviceProfileDatabase *db)
+{
+    activeDatabase = db;
+}
+
+/*! Returns the default read capabilities of a light device type.
+    \param profileId - ZLL or HA profile
+    \param deviceId - the device id of the endpoint
+ */
+quint32 DeviceProfileDatabase::capabilitiesForDeviceId(quint16 profileId, quint16 deviceId)
+{
+    if (profileId == ZLL_PROFILE_ID)
+    {
+        switch (deviceId)
+        {
+        case DEV_ID_ZLL_COLOR_LIGHT:
+        case DEV_ID_ZLL_EXTENDED_COLOR_LIGHT:
+        case DEV_ID_ZLL_COLOR_TEMPERATURE_LIGHT:
+            return CapReadOnOff | CapReadLevel | CapReadColor;
+
+        case DEV_ID_ZLL_DIMMABLE_LIGHT:
+        case DEV_ID_ZLL_DIMMABLE_PLUGIN_UNIT:
+            return CapReadOnOff | CapReadLevel;
+
+        case DEV_ID_ZLL_ONOFF_LIGHT:
+        case DEV_ID_ZLL_ONOFF_PLUGIN_UNIT:
+        case DEV_ID_ZLL_ONOFF_SENSOR:
+            return CapReadOnOff;
+
+        default:
+            break;
+        }
+    }
+    else if (profileId == HA_PROFILE_ID)
+    {
+        switch (deviceId)
+        {
+        case DEV_ID_HA_COLOR_DIMMABLE_LIGHT:
+        case DEV_ID_ZLL_COLOR_LIGHT:
+        case DEV_ID_ZLL_EXTENDED_COLOR_LIGHT:
+        case DEV_ID_ZLL_COLOR_TEMPERATURE_LIGHT:
+            return CapReadOnOff | CapReadLevel | CapReadColor;
+
+        case DEV_ID_HA_DIMMABLE_LIGHT:
+        //case DEV_ID_ZLL_DIMMABLE_LIGHT: // same as DEV_ID_HA_ONOFF_LIGHT
+        case DEV_ID_ZLL_DIMMABLE_PLUGIN_UNIT:
+            return CapReadOnOff | CapReadLevel;
+
+        case DEV_ID_MAINS_POWER_OUTLET:
+        case DEV_ID_HA_ONOFF_LIGHT:
+        case DEV_ID_ONOFF_OUTPUT:
+        case DEV_ID_ZLL_ONOFF_LIGHT:
+        case DEV_ID_ZLL_ONOFF_PLUGIN_UNIT:
+        case DEV_ID_ZLL_ONOFF_SENSOR:
+            return CapReadOnOff;
+
+        default:
+            break;
+        }
+    }
+
+    return 0;
+}
+
+/*! Loads the device profiles.
+    Profiles from device_profiles.json in the application data directory
+    are listed before the built-in ones so they take precedence over them.
+ */
+void DeRestPluginPrivate::initDeviceProfiles()
+{
+    QString path = sqliteDatabaseName;
+    int pos = path.lastIndexOf('/');
+    path.truncate(pos + 1);
+    path.append(QLatin1String("device_profiles.json"));
+
+    QFile file(path);
+
+    if (file.open(QIODevice::ReadOnly))
+    {
+        if (!deviceProfiles.load(QString::fromUtf8(file.readAll())))
+        {
+            DBG_Printf(DBG_ERROR, "failed to load device profiles from %s\n", qPrintable(path));
+        }
+        file.close();
+    }
+
+    deviceProfiles.loadBuiltin();
+    DeviceProfileDatabase::setActive(&deviceProfiles);
+
+    DBG_Printf(DBG_INFO, "loaded %u device profiles\n", (uint)deviceProfiles.size());
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2016 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef DEVICE_PROFILE_H
+#define DEVICE_PROFILE_H
+
+#include <vector>
+#include <QString>
+#include <QVariant>
+
+/*! Capabilities of a device, used to decide what to read and bind. */
+enum DeviceCapability
+{
+    CapReadOnOff           = 0x00000001, // read on/off cluster
+    CapReadLevel           = 0x00000002, // read level cluster
+    CapReadColor           = 0x00000004, // read color cluster
+    CapReadBindingTable    = 0x00000008, // read binding table (mgmt bind)
+    CapAttributeReporting  = 0x00000010, // bind for attribute reporting to the gateway
+    CapEndDeviceReporting  = 0x00000020, // attribute reporting also for end-devices
+    CapOtauNotify          = 0x00000040  // actively notify about new firmware
+};
+
+/*! Known deviations from the ZigBee specification. */
+enum DeviceQuirk
+{
+    QuirkNoColorXy         = 0x00000001, // doesn't support color mode xy, use hue and saturation
+    QuirkCtAsSaturation    = 0x00000002, // doesn't support color temperature command, map to saturation
+    QuirkRawIlluminance    = 0x00000004  // illuminance is reported in lux and not as 10000 log10(lux) + 1
+};
+
+/*! \class DeviceProfile
+
+    A compiled entry of the device description database.
+ */
+class DeviceProfile
+{
+public:
+    DeviceProfile();
+    bool matches(const QString &modelId, const QString &manufacturer, quint16 manufacturerCode) const;
+
+    QString name;
+    QString modelId;
+    bool modelIdPrefix; // modelId ends with '*'
+    QString manufacturer;
+    bool manufacturerPrefix; // manufacturer ends with '*'
+    quint16 manufacturerCode; // 0 matches any
+    quint32 capabilities; // bitmap of DeviceCapability
+    quint32 capabilitiesMask; // capabilities which are set explicitly by the profile
+    quint32 quirks; // bitmap of DeviceQuirk
+    bool hasCtRange; // ctmin or ctmax is set
+    quint16 ctMin; // color temperature range in mired
+    quint16 ctMax;
+};
+
+/*! The capabilities and quirks of a device merged from all matching profiles.
+ */
+struct CompiledDeviceProfile
+{
+    CompiledDeviceProfile() :
+        matches(0),
+        capabilities(0),
+        quirks(0),
+        ctMin(153),
+        ctMax(500)
+    { }
+
+    int matches; // number of matching profiles
+    quint32 capabilities; // bitmap of DeviceCapability
+    quint32 quirks; // bitmap of DeviceQuirk
+    quint16 ctMin; // color temperature range in mired
+    quint16 ctMax;
+};
+
+/*! \class DeviceProfileDatabase
+
+    Holds device profiles which are compiled from a declarative JSON description:
+
+    { "profiles": [ { "name": "..", "modelid": "FLS-NB*", "manufacturername": "BEGA*",
+                      "manufacturercode": "0x1135", "capabilities": ["bindingtable", ..],
+                      "nocapabilities": [..], "quirks": ["noxy", ..], "ctmin": 153, "ctmax": 500 } ] }
+
+    All matching profiles are merged: quirks add up, and for capabilities and
+    the color temperature range an earlier profile takes precedence over a
+    later one. Specific entries can therefore be listed before catch-all
+    entries like a manufacturer code without losing the catch-all quirks.
+ */
+class DeviceProfileDatabase
+{
+public:
+    DeviceProfileDatabase();
+    bool load(const QString &json);
+    void loadBuiltin();
+    CompiledDeviceProfile compile(const QString &modelId, const QString &manufacturer, quint16 manufacturerCode,
+                                  quint32 defaultCapabilities) const;
+    size_t size() const;
+
+    static quint32 capabilitiesForDeviceId(quint16 profileId, quint16 deviceId);
+    static const DeviceProfileDatabase *active();
+    static void setActive(const DeviceProfileDatabase *db);
+
+private:
+    bool addProfile(const QVariantMap &map);
+    std::vector<DeviceProfile> m_profiles;
+};
+
+#endif // DEVICE_PROFILE_H
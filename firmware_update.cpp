@@ -9,17 +9,24 @@
  */
 
 #include <QApplication>
+#include <QCryptographicHash>
 #include <QDesktopServices>
 #include <QFile>
 #include <QDir>
 #include <QString>
 #include <QProcess>
+#include <QRegExp>
 #include "de_web_plugin.h"
 #include "de_web_plugin_private.h"
 
 #define FW_IDLE_TIMEOUT (10 * 1000)
 #define FW_IDLE_TIMEOUT_LONG (240 * 1000)
 #define FW_WAIT_USER_TIMEOUT (60 * 1000)
+#define FW_UPDATE_TIMEOUT (5 * 60 * 1000) // watchdog for the flasher process
+
+// GCF image header: magic (4), file type (1), target address (4), file size (4), crc (1)
+#define FW_GCF_HEADER_SIZE 14
+#define FW_GCF_MAGIC 0xCAFEFEEDUL
 
 /*! Inits the firmware update manager.
  */
@@ -27,6 +34,8 @@ void DeRestPluginPrivate::initFirmwareUpdate()
 {
     fwProcess = 0;
     fwUpdateState = FW_Idle;
+    fwUpdatePhase = FW_PhaseNone;
+    fwUpdateProgress = 0;
 
     Q_ASSERT(apsCtrl);
     apsCtrl->setParameter(deCONZ::ParamFirmwareUpdateActive, 0);
@@ -53,6 +62,7 @@ void DeRestPluginPrivate::updateFirmware()
         apsCtrl->getParameter(deCONZ::ParamDeviceConnected) == 1)
     {
         DBG_Printf(DBG_INFO, "GW firmware update conditions not met, abort\n");
+        setFirmwareUpdatePhase(FW_PhaseFailed, 0);
         fwUpdateState = FW_Idle;
         fwUpdateTimer->start(FW_IDLE_TIMEOUT);
         return;
@@ -70,65 +80,293 @@ void DeRestPluginPrivate::updateFirmware()
     if (!fwProcess)
     {
         fwProcess = new QProcess(this);
+        fwProcess->setProcessChannelMode(QProcess::MergedChannels);
+        connect(fwProcess, SIGNAL(readyReadStandardOutput()),
+                this, SLOT(firmwareUpdateReadOutput()));
+        connect(fwProcess, SIGNAL(finished(int,QProcess::ExitStatus)),
+                this, SLOT(firmwareUpdateFinished(int)));
+        connect(fwProcess, SIGNAL(error(QProcess::ProcessError)),
+                this, SLOT(firmwareUpdateError()));
     }
 
     fwProcessArgs << "-f" << fwUpdateFile;
+    fwProcessOutput.clear();
 
     fwUpdateState = FW_UpdateWaitFinished;
-    fwUpdateTimer->start(1000);
+    setFirmwareUpdatePhase(FW_PhaseStart, 0);
+    fwUpdateTimer->start(FW_UPDATE_TIMEOUT);
 
     fwProcess->start(bin, fwProcessArgs);
 }
 
-/*! Observes the firmware update process.
+/*! Called when the flasher didn't finish in time, the process is killed.
+    The regular cleanup happens in firmwareUpdateFinished().
  */
 void DeRestPluginPrivate::updateFirmwareWaitFinished()
 {
-    if (fwProcess)
+    if (fwProcess && fwProcess->state() != QProcess::NotRunning)
     {
-        if (fwProcess->bytesAvailable())
+        DBG_Printf(DBG_INFO, "GW firmware update timeout, kill process\n");
+        fwProcess->kill();
+        return;
+    }
+
+    firmwareUpdateFinished(-1);
+}
+
+/*! Handles new output of the flasher process.
+    The output is split in lines, progress bars are updated with carriage returns.
+ */
+void DeRestPluginPrivate::firmwareUpdateReadOutput()
+{
+    if (!fwProcess)
+    {
+        return;
+    }
+
+    fwProcessOutput.append(fwProcess->readAllStandardOutput());
+
+    for (;;)
+    {
+        int pos = -1;
+        for (int i = 0; i < fwProcessOutput.size(); i++)
         {
-            QByteArray data = fwProcess->readAllStandardOutput();
-            DBG_Printf(DBG_INFO, "%s", qPrintable(data));
+            if (fwProcessOutput[i] == '\n' || fwProcessOutput[i] == '\r')
+            {
+                pos = i;
+                break;
+            }
         }
 
-        if (fwProcess->state() == QProcess::Starting)
+        if (pos < 0)
         {
-            DBG_Printf(DBG_INFO, "GW firmware update starting ..\n");
+            break;
         }
-        else if (fwProcess->state() == QProcess::Running)
+
+        parseFirmwareUpdateOutput(fwProcessOutput.left(pos));
+        fwProcessOutput.remove(0, pos + 1);
+    }
+
+    if (fwProcessOutput.size() > 1024) // no line end in sight
+    {
+        parseFirmwareUpdateOutput(fwProcessOutput);
+        fwProcessOutput.clear();
+    }
+}
+
+/*! Translates a line of flasher output into phase and progress.
+    \param line - a line of output without line end
+ */
+void DeRestPluginPrivate::parseFirmwareUpdateOutput(const QByteArray &line)
+{
+    const QString str = QString::fromLatin1(line).trimmed();
+
+    if (str.isEmpty())
+    {
+        return;
+    }
+
+    DBG_Printf(DBG_INFO, "GCFFlasher: %s\n", qPrintable(str));
+
+    const QString lower = str.toLower();
+    FW_UpdatePhase phase = fwUpdatePhase;
+    int progress = fwUpdateProgress;
+
+    if (lower.contains(QLatin1String("verif")))
+    {
+        phase = FW_PhaseVerify;
+    }
+    else if (lower.contains(QLatin1String("flash")) || lower.contains(QLatin1String("upload")) ||
+             lower.contains(QLatin1String("download")) || lower.contains(QLatin1String("write")))
+    {
+        phase = FW_PhaseFlash;
+    }
+    else if (lower.contains(QLatin1String("bootloader")))
+    {
+        phase = FW_PhaseBootloader;
+    }
+    else if (lower.contains(QLatin1String("reset")) || lower.contains(QLatin1String("reboot")))
+    {
+        phase = FW_PhaseReset;
+    }
+
+    // phases only move forward, the flasher repeats some messages
+    if (phase < fwUpdatePhase)
+    {
+        phase = fwUpdatePhase;
+    }
+    else if (phase > fwUpdatePhase)
+    {
+        progress = 0;
+    }
+
+    QRegExp percent(QLatin1String("(\\d{1,3})\\s*%"));
+    QRegExp fraction(QLatin1String("(\\d+)\\s*/\\s*(\\d+)"));
+
+    if (percent.indexIn(str) != -1)
+    {
+        progress = percent.cap(1).toInt();
+    }
+    else if (fraction.indexIn(str) != -1 && fraction.cap(2).toInt() > 0)
+    {
+        progress = (int)((qint64)fraction.cap(1).toInt() * 100 / fraction.cap(2).toInt());
+    }
+
+    if (progress > 100)
+    {
+        progress = 100;
+    }
+
+    setFirmwareUpdatePhase(phase, progress);
+}
+
+/*! Handles the end of the flasher process.
+    \param exitCode - the exit code of the process, -1 if it couldn't be started
+ */
+void DeRestPluginPrivate::firmwareUpdateFinished(int exitCode)
+{
+    bool success = false;
+
+    if (fwProcess)
+    {
+        firmwareUpdateReadOutput();
+
+        if (fwProcess->exitStatus() == QProcess::NormalExit && exitCode != -1)
         {
-            DBG_Printf(DBG_INFO, "GW firmware update running ..\n");
+            DBG_Printf(DBG_INFO, "GW firmware update exit code %d\n", exitCode);
+            success = (exitCode == 0);
         }
-        else if (fwProcess->state() == QProcess::NotRunning)
+        else
         {
-            if (fwProcess->exitStatus() == QProcess::NormalExit)
-            {
-                DBG_Printf(DBG_INFO, "GW firmware update exit code %d\n", fwProcess->exitCode());
-            }
-            else if (fwProcess->exitStatus() == QProcess::CrashExit)
-            {
-                DBG_Printf(DBG_INFO, "GW firmware update crashed %s\n", qPrintable(fwProcess->errorString()));
-            }
-
-            fwProcess->deleteLater();
-            fwProcess = 0;
+            DBG_Printf(DBG_INFO, "GW firmware update crashed %s\n", qPrintable(fwProcess->errorString()));
         }
+
+        fwProcess->deleteLater();
+        fwProcess = 0;
     }
 
-    // done
-    if (fwProcess == 0)
+    setFirmwareUpdatePhase(success ? FW_PhaseDone : FW_PhaseFailed, success ? 100 : fwUpdateProgress);
+
+    apsCtrl->setParameter(deCONZ::ParamFirmwareUpdateActive, 0);
+    fwUpdateState = FW_Idle;
+    fwUpdateTimer->start(FW_IDLE_TIMEOUT);
+}
+
+/*! Handles errors of the flasher process.
+    If the process couldn't be started no finished() signal will follow.
+ */
+void DeRestPluginPrivate::firmwareUpdateError()
+{
+    if (!fwProcess)
     {
-        apsCtrl->setParameter(deCONZ::ParamFirmwareUpdateActive, 0);
-        fwUpdateState = FW_Idle;
-        fwUpdateTimer->start(FW_IDLE_TIMEOUT);
+        return;
     }
-    else // recheck
+
+    DBG_Printf(DBG_INFO, "GW firmware update process error %d: %s\n", fwProcess->error(), qPrintable(fwProcess->errorString()));
+
+    if (fwProcess->error() == QProcess::FailedToStart)
     {
-        fwUpdateTimer->start(1000);
+        firmwareUpdateFinished(-1);
     }
 }
 
+/*! Sets the phase and progress of the firmware update shown in the configuration.
+ */
+void DeRestPluginPrivate::setFirmwareUpdatePhase(FW_UpdatePhase phase, int progress)
+{
+    if (fwUpdatePhase == phase && fwUpdateProgress == progress)
+    {
+        return;
+    }
+
+    if (fwUpdatePhase != phase)
+    {
+        DBG_Printf(DBG_INFO, "GW firmware update phase %s\n", firmwareUpdatePhaseToString(phase));
+    }
+
+    fwUpdatePhase = phase;
+    fwUpdateProgress = progress;
+    updateEtag(gwConfigEtag);
+}
+
+/*! Returns the name of a firmware update phase as used in the configuration.
+ */
+const char *DeRestPluginPrivate::firmwareUpdatePhaseToString(FW_UpdatePhase phase)
+{
+    switch (phase)
+    {
+    case FW_PhaseStart:      return "start";
+    case FW_PhaseReset:      return "reset";
+    case FW_PhaseBootloader: return "bootloader";
+    case FW_PhaseFlash:      return "flash";
+    case FW_PhaseVerify:     return "verify";
+    case FW_PhaseDone:       return "done";
+    case FW_PhaseFailed:     return "failed";
+    default:
+        break;
+    }
+
+    return "none";
+}
+
+/*! Checks the firmware image before the device is touched.
+    The GCF header must be intact and the image size must match the header.
+    If a md5sum file (<image>.md5) is placed next to the image it's checked too.
+    \param path - the image file
+    \return true if the image can be used
+ */
+bool DeRestPluginPrivate::verifyFirmwareImage(const QString &path)
+{
+    QFile file(path);
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        DBG_Printf(DBG_ERROR, "GW firmware image %s can't be opened\n", qPrintable(path));
+        return false;
+    }
+
+    const QByteArray data = file.readAll();
+
+    if (data.size() <= FW_GCF_HEADER_SIZE)
+    {
+        DBG_Printf(DBG_ERROR, "GW firmware image %s too small\n", qPrintable(path));
+        return false;
+    }
+
+    const uchar *p = reinterpret_cast<const uchar*>(data.constData());
+    const quint32 magic = p[0] | (p[1] << 8) | (p[2] << 16) | ((quint32)p[3] << 24);
+    const quint32 size = p[9] | (p[10] << 8) | (p[11] << 16) | ((quint32)p[12] << 24);
+
+    if (magic != FW_GCF_MAGIC)
+    {
+        DBG_Printf(DBG_ERROR, "GW firmware image %s invalid header\n", qPrintable(path));
+        return false;
+    }
+
+    if (size != (quint32)(data.size() - FW_GCF_HEADER_SIZE))
+    {
+        DBG_Printf(DBG_ERROR, "GW firmware image %s size mismatch %u/%d\n", qPrintable(path), size, data.size() - FW_GCF_HEADER_SIZE);
+        return false;
+    }
+
+    QFile sumFile(path + QLatin1String(".md5"));
+
+    if (sumFile.open(QIODevice::ReadOnly))
+    {
+        const QByteArray expected = sumFile.readLine().trimmed().left(32).toLower();
+        const QByteArray actual = QCryptographicHash::hash(data, QCryptographicHash::Md5).toHex();
+
+        if (expected != actual)
+        {
+            DBG_Printf(DBG_ERROR, "GW firmware image %s checksum mismatch\n", qPrintable(path));
+            return false;
+        }
+    }
+
+    DBG_Printf(DBG_INFO, "GW firmware image %s verified\n", qPrintable(path));
+    return true;
+}
+
 /*! Starts the device disconnect so that the serial port is released.
  */
 void DeRestPluginPrivate::updateFirmwareDisconnectDevice()
@@ -161,6 +399,14 @@ bool DeRestPluginPrivate::startUpdateFirmware()
 {
     if (fwUpdateState == FW_WaitUserConfirm)
     {
+        setFirmwareUpdatePhase(FW_PhaseNone, 0);
+
+        if (!verifyFirmwareImage(fwUpdateFile))
+        {
+            setFirmwareUpdatePhase(FW_PhaseFailed, 0);
+            return false;
+        }
+
         fwUpdateState = FW_DisconnectDevice;
         fwUpdateTimer->start(100);
         return true;
@@ -0,0 +1,397 @@
+/*
+ * Copyright (c) 2016 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <deconz.h>
+#include "frame_reader.h"
+
+/*! Decodes a ZDP response which only carries a status.
+    \return false if the frame is too short
+ */
+bool decodeZdpStatusRsp(FrameReader &reader, ZdpStatusRsp &rsp)
+{
+    rsp.seqNo = reader.readU8();
+    rsp.status = reader.readU8();
+    return reader.isOk();
+}
+
+/*! Decodes the header of a ZDP Mgmt_Bind_rsp.
+    The reader is left at the first binding entry.
+    \return false if the frame is too short
+ */
+bool decodeZdpMgmtBindRsp(FrameReader &reader, ZdpMgmtBindRsp &rsp)
+{
+    rsp.seqNo = reader.readU8();
+    rsp.status = reader.readU8();
+    rsp.entries = 0;
+    rsp.startIndex = 0;
+    rsp.listCount = 0;
+
+    if (reader.isOk() && rsp.status == deCONZ::ZdpSuccess)
+    {
+        rsp.entries = reader.readU8();
+        rsp.startIndex = reader.readU8();
+        rsp.listCount = reader.readU8();
+    }
+
+    return reader.isOk();
+}
+
+/*! Decodes a ZDP Device_annce.
+    \return false if the frame is too short
+ */
+bool decodeZdpDeviceAnnce(FrameReader &reader, ZdpDeviceAnnce &annce)
+{
+    annce.seqNo = reader.readU8();
+    annce.nwkAddr = reader.readU16();
+    annce.extAddr = reader.readU64();
+    annce.capability = reader.readU8();
+    return reader.isOk();
+}
+
+/*! Decodes the header of a ZDP descriptor response.
+    The reader is left at the descriptor.
+    \return false if the frame is too short
+ */
+bool decodeZdpDescriptorRsp(FrameReader &reader, ZdpDescriptorRsp &rsp)
+{
+    rsp.seqNo = reader.readU8();
+    rsp.status = reader.readU8();
+    rsp.nwkAddr = reader.readU16();
+    return reader.isOk();
+}
+
+/*! Decodes a ZDP Active_EP_rsp.
+    \return false if the frame is too short
+ */
+bool decodeZdpActiveEndpointsRsp(FrameReader &reader, ZdpActiveEndpointsRsp &rsp)
+{
+    rsp.seqNo = reader.readU8();
+    rsp.status = reader.readU8();
+    rsp.nwkAddr = reader.readU16();
+    rsp.endpoints.clear();
+
+    if (reader.isOk() && rsp.status == deCONZ::ZdpSuccess)
+    {
+        const quint8 count = reader.readU8();
+
+        for (uint i = 0; i < count; i++)
+        {
+            rsp.endpoints.push_back(reader.readU8());
+        }
+    }
+
+    return reader.isOk();
+}
+
+/*! Decodes an Atmel WSNDemo frame.
+    \return false if the frame is too short
+ */
+bool decodeWsnDemoFrame(FrameReader &reader, WsnDemoFrame &frame)
+{
+    frame.msgType = reader.readU8();
+    frame.nodeType = reader.readU8();
+    frame.ieeeAddr = reader.readU64();
+    frame.nwkAddr = reader.readU16();
+    frame.version = reader.readU32();
+    frame.channelMask = reader.readU32();
+    frame.panId = reader.readU16();
+    frame.channel = reader.readU8();
+    frame.parentAddr = reader.readU16();
+    frame.lqi = reader.readU8();
+    frame.rssi = reader.readS8();
+    frame.fieldType = reader.readU8();
+    frame.fieldSize = reader.readU8();
+    frame.battery = 0;
+    frame.temperature = 0;
+    frame.illuminance = 0;
+
+    if (reader.isOk() && frame.fieldType == 0x01)
+    {
+        frame.battery = reader.readU32();
+        frame.temperature = reader.readU32();
+        frame.illuminance = reader.readU32();
+    }
+
+    return reader.isOk();
+}
+
+/*! Decodes a Green Power commissioning command.
+
+    1    8-bit enum    GPD DeviceID
+    1    8-bit bmp     Options
+    0/1  8-bit bmp     Extended Options
+    0/16 Security Key  GPD Key
+    0/4  u32           GPD Key MIC
+    0/4  u32           GPD outgoing counter
+
+    \return false if the frame is too short
+ */
+bool decodeGpCommissioningFrame(FrameReader &reader, GpCommissioningFrame &frame)
+{
+    deCONZ::GPCommissioningOptions options;
+    deCONZ::GpExtCommissioningOptions extOptions;
+    options.byte = 0;
+    extOptions.byte = 0;
+
+    frame.keyPresent = false;
+    frame.keyMic = 0;
+    frame.outgoingCounter = 0;
+
+    frame.deviceId = reader.readU8();
+    options.byte = reader.readU8();
+
+    if (options.bits.extOptionsField)
+    {
+        extOptions.byte = reader.readU8();
+    }
+
+    if (extOptions.bits.gpdKeyPresent)
+    {
+        frame.keyPresent = true;
+        for (int i = 0; i < 16; i++)
+        {
+            frame.key[i] = reader.readU8();
+        }
+
+        if (extOptions.bits.gpdKeyEncryption)
+        {
+            // TODO decrypt key
+            frame.keyMic = reader.readU32();
+        }
+    }
+
+    if (extOptions.bits.gpdOutgoingCounterPresent)
+    {
+        frame.outgoingCounter = reader.readU32();
+    }
+
+    frame.options = options.byte;
+    frame.extOptions = extOptions.byte;
+
+    return reader.isOk();
+}
+
+/*! Decodes an interpan frame, the ASDU refers to the data of the frame.
+    \return false if the frame is too short
+ */
+bool decodeInterpanFrame(FrameReader &reader, InterpanFrame &frame)
+{
+    frame.srcPanId = reader.readU16();
+    frame.srcAddress = reader.readU64();
+    frame.dstPanId = reader.readU16();
+    frame.dstAddressMode = reader.readU8();
+    frame.dstExtAddress = 0;
+    frame.dstNwkAddress = 0;
+
+    if (frame.dstAddressMode == 0x03)
+    {
+        frame.dstExtAddress = reader.readU64();
+    }
+    else
+    {
+        frame.dstNwkAddress = reader.readU16();
+    }
+
+    frame.profileId = reader.readU16();
+    frame.clusterId = reader.readU16();
+    frame.asdu = reader.readBytes(reader.readU8());
+    frame.lqi = 0;
+    frame.rssi = 0;
+
+    if (reader.remaining() >= 2) // not appended by all firmware versions
+    {
+        frame.lqi = reader.readU8();
+        frame.rssi = reader.readS8();
+    }
+
+    return reader.isOk();
+}
+
+/*! Decodes a Get group membership response.
+    Groups which don't fit in the frame are ignored.
+    \return false if the frame is too short
+ */
+bool decodeZclGroupMembershipRsp(FrameReader &reader, ZclGroupMembershipRsp &rsp)
+{
+    rsp.capacity = reader.readU8();
+    rsp.count = reader.readU8();
+    rsp.groups.clear();
+
+    if (!reader.isOk())
+    {
+        return false;
+    }
+
+    for (uint i = 0; i < rsp.count && reader.remaining() >= 2; i++)
+    {
+        rsp.groups.push_back(reader.readU16());
+    }
+
+    return true;
+}
+
+/*! Decodes a response with status and group id.
+    \return false if the frame is too short
+ */
+bool decodeZclGroupStatusRsp(FrameReader &reader, ZclGroupStatusRsp &rsp)
+{
+    rsp.status = reader.readU8();
+    rsp.groupId = reader.readU16();
+    return reader.isOk();
+}
+
+/*! Decodes a response with status, group id and scene id.
+    \return false if the frame is too short
+ */
+bool decodeZclSceneStatusRsp(FrameReader &reader, ZclSceneStatusRsp &rsp)
+{
+    rsp.status = reader.readU8();
+    rsp.groupId = reader.readU16();
+    rsp.sceneId = reader.readU8();
+    return reader.isOk();
+}
+
+/*! Decodes a Recall scene command.
+    \return false if the frame is too short
+ */
+bool decodeZclRecallScene(FrameReader &reader, ZclSceneStatusRsp &cmd)
+{
+    cmd.status = deCONZ::ZclSuccessStatus; // not part of the command
+    cmd.groupId = reader.readU16();
+    cmd.sceneId = reader.readU8();
+    return reader.isOk();
+}
+
+/*! Decodes a Get scene membership response.
+    Scenes which don't fit in the frame are ignored.
+    \return false if the frame is too short
+ */
+bool decodeZclSceneMembershipRsp(FrameReader &reader, ZclSceneMembershipRsp &rsp)
+{
+    rsp.status = reader.readU8();
+    rsp.capacity = reader.readU8();
+    rsp.groupId = reader.readU16();
+    rsp.count = 0;
+    rsp.scenes.clear();
+
+    if (reader.isOk() && rsp.status == deCONZ::ZclSuccessStatus)
+    {
+        rsp.count = reader.readU8();
+
+        for (uint i = 0; i < rsp.count && !reader.atEnd(); i++)
+        {
+            rsp.scenes.push_back(reader.readU8());
+        }
+    }
+
+    return reader.isOk();
+}
+
+/*! Decodes a View scene response.
+    Extension fields of unknown clusters are skipped.
+    \return false if the frame is too short
+ */
+bool decodeZclViewSceneRsp(FrameReader &reader, ZclViewSceneRsp &rsp)
+{
+    rsp.groupId = 0;
+    rsp.sceneId = 0;
+    rsp.transitionTime = 0;
+    rsp.name.clear();
+    rsp.hasOnOff = false;
+    rsp.hasLevel = false;
+    rsp.hasXy = false;
+
+    rsp.status = reader.readU8();
+
+    if (!reader.isOk() || rsp.status != deCONZ::ZclSuccessStatus)
+    {
+        return reader.isOk();
+    }
+
+    rsp.groupId = reader.readU16();
+    rsp.sceneId = reader.readU8();
+    rsp.transitionTime = reader.readU16();
+    rsp.name = QString::fromLatin1(reader.readBytes(reader.readU8()));
+
+    if (!reader.isOk())
+    {
+        return false;
+    }
+
+    while (reader.remaining() >= 3)
+    {
+        const quint16 clusterId = reader.readU16();
+        const quint8 length = reader.readU8();
+        const int end = reader.pos() + length;
+
+        if (clusterId == 0x0006 && length >= 1)
+        {
+            rsp.onOff = reader.readU8();
+            rsp.hasOnOff = true;
+        }
+        else if (clusterId == 0x0008 && length >= 1)
+        {
+            rsp.level = reader.readU8();
+            rsp.hasLevel = true;
+        }
+        else if (clusterId == 0x0300 && length >= 4)
+        {
+            rsp.x = reader.readU16();
+            rsp.y = reader.readU16();
+            rsp.hasXy = true;
+        }
+
+        if (!reader.skip(end - reader.pos()))
+        {
+            break; // truncated extension field, keep what was decoded so far
+        }
+    }
+
+    return true;
+}
+
+/*! Decodes a Get group identifiers response.
+    \return false if the frame is too short
+ */
+bool decodeZclGroupIdentifiersRsp(FrameReader &reader, ZclGroupIdentifiersRsp &rsp)
+{
+    rsp.total = reader.readU8();
+    rsp.startIndex = reader.readU8();
+    rsp.count = reader.readU8();
+    rsp.records.clear();
+
+    if (!reader.isOk())
+    {
+        return false;
+    }
+
+    while (reader.remaining() >= 3)
+    {
+        ZclGroupIdentifiersRsp::Record rec;
+        rec.groupId = reader.readU16();
+        rec.type = reader.readU8();
+        rsp.records.push_back(rec);
+    }
+
+    return true;
+}
+
+/*! Decodes the fixed part of an OTAU Image block request.
+    \return false if the frame is too short
+ */
+bool decodeOtauImageBlockReq(FrameReader &reader, OtauImageBlockReq &req)
+{
+    req.fieldControl = reader.readU8();
+    req.manufacturerCode = reader.readU16();
+    req.imageType = reader.readU16();
+    req.fileVersion = reader.readU32();
+    req.fileOffset = reader.readU32();
+    return reader.isOk();
+}
@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2016 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef FRAME_READER_H
+#define FRAME_READER_H
+
+#include <QByteArray>
+#include <QString>
+#include <vector>
+
+/*! \class FrameReader
+
+    Reads little-endian values from a received frame.
+
+    The reader works directly on the data of the frame and doesn't copy it,
+    the frame must outlive the reader. Reading past the end of the frame
+    returns 0 and marks the reader as failed, so a decoder can read all
+    fields first and check isOk() once.
+ */
+class FrameReader
+{
+public:
+    explicit FrameReader(const QByteArray &data) :
+        m_data(reinterpret_cast<const quint8*>(data.constData())),
+        m_size(data.size()),
+        m_pos(0),
+        m_ok(true)
+    { }
+
+    /*! Returns false if a read went past the end of the frame. */
+    bool isOk() const { return m_ok; }
+    /*! Returns true if all bytes were read. */
+    bool atEnd() const { return m_pos >= m_size; }
+    /*! Returns the number of unread bytes. */
+    int remaining() const { return m_size - m_pos; }
+    /*! Returns the read position. */
+    int pos() const { return m_pos; }
+
+    quint8 readU8()
+    {
+        if (!check(1)) { return 0; }
+        return m_data[m_pos++];
+    }
+
+    qint8 readS8()
+    {
+        return static_cast<qint8>(readU8());
+    }
+
+    quint16 readU16()
+    {
+        if (!check(2)) { return 0; }
+        quint16 val = m_data[m_pos] | (m_data[m_pos + 1] << 8);
+        m_pos += 2;
+        return val;
+    }
+
+    quint32 readU32()
+    {
+        if (!check(4)) { return 0; }
+        quint32 val = static_cast<quint32>(m_data[m_pos]) |
+                      (static_cast<quint32>(m_data[m_pos + 1]) << 8) |
+                      (static_cast<quint32>(m_data[m_pos + 2]) << 16) |
+                      (static_cast<quint32>(m_data[m_pos + 3]) << 24);
+        m_pos += 4;
+        return val;
+    }
+
+    quint64 readU64()
+    {
+        quint64 lo = readU32();
+        quint64 hi = readU32();
+        return lo | (hi << 32);
+    }
+
+    /*! Returns \p len bytes of the frame without copying them.
+        \return the bytes or an empty array if the frame is too short
+     */
+    QByteArray readBytes(int len)
+    {
+        if (len < 0 || !check(len)) { return QByteArray(); }
+        QByteArray val = QByteArray::fromRawData(reinterpret_cast<const char*>(m_data + m_pos), len);
+        m_pos += len;
+        return val;
+    }
+
+    /*! Skips \p len bytes.
+        \return false if the frame is too short
+     */
+    bool skip(int len)
+    {
+        if (len < 0 || !check(len)) { return false; }
+        m_pos += len;
+        return true;
+    }
+
+private:
+    bool check(int len)
+    {
+        if (m_ok && len <= (m_size - m_pos))
+        {
+            return true;
+        }
+
+        m_ok = false;
+        m_pos = m_size;
+        return false;
+    }
+
+    const quint8 *m_data;
+    int m_size;
+    int m_pos;
+    bool m_ok;
+};
+
+/*! ZDP response which only carries a status: Bind_rsp, Unbind_rsp, Mgmt_Leave_rsp. */
+struct ZdpStatusRsp
+{
+    quint8 seqNo;
+    quint8 status;
+};
+
+/*! Header of a ZDP Mgmt_Bind_rsp, the binding entries follow. */
+struct ZdpMgmtBindRsp
+{
+    quint8 seqNo;
+    quint8 status;
+    quint8 entries; // only if status is success
+    quint8 startIndex;
+    quint8 listCount;
+};
+
+/*! ZDP Device_annce. */
+struct ZdpDeviceAnnce
+{
+    quint8 seqNo;
+    quint16 nwkAddr;
+    quint64 extAddr;
+    quint8 capability; // MAC capability flags
+};
+
+/*! Header of a ZDP response which refers to a NWK address of interest:
+    Node_Desc_rsp, Simple_Desc_rsp, the descriptor follows.
+ */
+struct ZdpDescriptorRsp
+{
+    quint8 seqNo;
+    quint8 status;
+    quint16 nwkAddr;
+};
+
+/*! ZDP Active_EP_rsp. */
+struct ZdpActiveEndpointsRsp
+{
+    quint8 seqNo;
+    quint8 status;
+    quint16 nwkAddr;
+    std::vector<quint8> endpoints; // only if status is success
+};
+
+/*! Atmel WSNDemo sensor frame. */
+struct WsnDemoFrame
+{
+    quint8 msgType;
+    quint8 nodeType;
+    quint64 ieeeAddr;
+    quint16 nwkAddr;
+    quint32 version;
+    quint32 channelMask;
+    quint16 panId;
+    quint8 channel;
+    quint16 parentAddr;
+    quint8 lqi;
+    qint8 rssi;
+    quint8 fieldType;
+    quint8 fieldSize;
+    // if fieldType == 0x01 (sensor data)
+    quint32 battery;
+    quint32 temperature;
+    quint32 illuminance;
+};
+
+/*! Green Power commissioning command. */
+struct GpCommissioningFrame
+{
+    quint8 deviceId;
+    quint8 options;
+    quint8 extOptions;
+    bool keyPresent;
+    quint8 key[16];
+    quint32 keyMic;
+    quint32 outgoingCounter;
+};
+
+/*! Interpan frame as delivered by the firmware. */
+struct InterpanFrame
+{
+    quint16 srcPanId;
+    quint64 srcAddress;
+    quint16 dstPanId;
+    quint8 dstAddressMode;
+    quint64 dstExtAddress; // if dstAddressMode is 0x03
+    quint16 dstNwkAddress; // if dstAddressMode is 0x02 or 0x01
+    quint16 profileId;
+    quint16 clusterId;
+    QByteArray asdu; // refers to the data of the frame
+    quint8 lqi;
+    qint8 rssi;
+};
+
+/*! Groups cluster: Get group membership response. */
+struct ZclGroupMembershipRsp
+{
+    quint8 capacity;
+    quint8 count;
+    std::vector<quint16> groups;
+};
+
+/*! Groups and scenes cluster: Add group, Remove group and Remove all scenes response. */
+struct ZclGroupStatusRsp
+{
+    quint8 status;
+    quint16 groupId;
+};
+
+/*! Scenes cluster: Add scene, Store scene and Remove scene response,
+    also used for the Recall scene command (without status).
+ */
+struct ZclSceneStatusRsp
+{
+    quint8 status;
+    quint16 groupId;
+    quint8 sceneId;
+};
+
+/*! Scenes cluster: Get scene membership response. */
+struct ZclSceneMembershipRsp
+{
+    quint8 status;
+    quint8 capacity;
+    quint16 groupId;
+    quint8 count; // only if status is success
+    std::vector<quint8> scenes;
+};
+
+/*! Scenes cluster: View scene response. */
+struct ZclViewSceneRsp
+{
+    quint8 status;
+    quint16 groupId;
+    quint8 sceneId;
+    quint16 transitionTime;
+    QString name;
+    bool hasOnOff;
+    quint8 onOff;
+    bool hasLevel;
+    quint8 level;
+    bool hasXy;
+    quint16 x;
+    quint16 y;
+};
+
+/*! ZLL commissioning cluster: Get group identifiers response. */
+struct ZclGroupIdentifiersRsp
+{
+    struct Record
+    {
+        quint16 groupId;
+        quint8 type;
+    };
+
+    quint8 total;
+    quint8 startIndex;
+    quint8 count;
+    std::vector<Record> records;
+};
+
+/*! OTAU cluster: Image block request. */
+struct OtauImageBlockReq
+{
+    quint8 fieldControl;
+    quint16 manufacturerCode;
+    quint16 imageType;
+    quint32 fileVersion;
+    quint32 fileOffset;
+};
+
+bool decodeZdpStatusRsp(FrameReader &reader, ZdpStatusRsp &rsp);
+bool decodeZdpMgmtBindRsp(FrameReader &reader, ZdpMgmtBindRsp &rsp);
+bool decodeZdpDeviceAnnce(FrameReader &reader, ZdpDeviceAnnce &annce);
+bool decodeZdpDescriptorRsp(FrameReader &reader, ZdpDescriptorRsp &rsp);
+bool decodeZdpActiveEndpointsRsp(FrameReader &reader, ZdpActiveEndpointsRsp &rsp);
+bool decodeWsnDemoFrame(FrameReader &reader, WsnDemoFrame &frame);
+bool decodeGpCommissioningFrame(FrameReader &reader, GpCommissioningFrame &frame);
+bool decodeInterpanFrame(FrameReader &reader, InterpanFrame &frame);
+bool decodeZclGroupMembershipRsp(FrameReader &reader, ZclGroupMembershipRsp &rsp);
+bool decodeZclGroupStatusRsp(FrameReader &reader, ZclGroupStatusRsp &rsp);
+bool decodeZclSceneStatusRsp(FrameReader &reader, ZclSceneStatusRsp &rsp);
+bool decodeZclRecallScene(FrameReader &reader, ZclSceneStatusRsp &cmd);
+bool decodeZclSceneMembershipRsp(FrameReader &reader, ZclSceneMembershipRsp &rsp);
+bool decodeZclViewSceneRsp(FrameReader &reader, ZclViewSceneRsp &rsp);
+bool decodeZclGroupIdentifiersRsp(FrameReader &reader, ZclGroupIdentifiersRsp &rsp);
+bool decodeOtauImageBlockReq(FrameReader &reader, OtauImageBlockReq &req);
+
+#endif // FRAME_READER_H
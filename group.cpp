@@ -8,6 +8,7 @@
  *
  */
 
+#include "clock.h"
 #include "group.h"
 #include <QStringList>
 
@@ -20,7 +21,7 @@ Group::Group() :
     m_on(false),
     m_colorLoopActive(false)
 {
-   sendTime = QTime::currentTime();
+   sendTime = clockMonotonicMs();
    hueReal = 0;
    hue = 0;
    sat = 127;
@@ -42,6 +43,10 @@ uint16_t Group::address() const
  */
 void Group::setAddress(uint16_t address)
 {
+    if (m_addr != address)
+    {
+        changes.set(FieldAddress);
+    }
     m_addr = address;
     m_id = QString::number(address);
 }
@@ -64,6 +69,10 @@ const QString &Group::name() const
  */
 void Group::setName(const QString &name)
 {
+    if (m_name != name)
+    {
+        changes.set(FieldName);
+    }
     m_name = name;
 }
 
@@ -79,6 +88,10 @@ Group::State Group::state() const
  */
 void Group::setState(State state)
 {
+    if (m_state != state)
+    {
+        changes.set(FieldState);
+    }
     m_state = state;
 }
 
@@ -93,6 +106,10 @@ bool Group::isOn() const
  */
 void Group::setIsOn(bool on)
 {
+    if (m_on != on)
+    {
+        changes.set(FieldOn);
+    }
     m_on = on;
 }
 
@@ -101,6 +118,10 @@ void Group::setIsOn(bool on)
  */
 void Group::setColorLoopActive(bool colorLoopActive)
 {
+    if (m_colorLoopActive != colorLoopActive)
+    {
+        changes.set(FieldColorLoop);
+    }
     m_colorLoopActive = colorLoopActive;
 }
 
@@ -133,6 +154,7 @@ const QString Group::midsToString() const
 /*! multiDeviceIds String to vector. */
 void Group::setMidsFromString(const QString mids)
 {
+    changes.set(FieldMembers);
     QStringList list = mids.split(",", QString::SkipEmptyParts);
 
     QStringList::const_iterator i = list.begin();
@@ -167,6 +189,7 @@ const QString Group::dmToString() const
 /*! deviceMembership String to vector. */
 void Group::setDmFromString(const QString deviceIds)
 {
+    changes.set(FieldMembers);
     QStringList list = deviceIds.split(",", QString::SkipEmptyParts);
 
     QStringList::const_iterator i = list.begin();
@@ -201,6 +224,7 @@ const QString Group::lightsequenceToString() const
 /*! lightsequence String to vector. */
 void Group::setLightsequenceFromString(const QString lightsequence)
 {
+    changes.set(FieldMembers);
     QStringList list = lightsequence.split(",", QString::SkipEmptyParts);
 
     QStringList::const_iterator i = list.begin();
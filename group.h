@@ -13,9 +13,9 @@
 
 #include <stdint.h>
 #include <QString>
-#include <QTime>
 #include <vector>
 #include "scene.h"
+#include "change_mask.h"
 
 /*! \class Group
 
@@ -31,6 +31,20 @@ public:
         StateDeleteFromDB
     };
 
+    /*! Change mask bits of the group fields. */
+    enum Field
+    {
+        FieldAddress   = 0x0001,
+        FieldName      = 0x0002,
+        FieldState     = 0x0004,
+        FieldOn        = 0x0008,
+        FieldColorLoop = 0x0010,
+        FieldMembers   = 0x0020, // multi device ids, device memberships and light sequence
+
+        // fields which are stored in the database
+        FieldsDb = FieldAddress | FieldName | FieldState | FieldMembers
+    };
+
     Group();
     uint16_t address() const;
     void setAddress(uint16_t address);
@@ -59,10 +73,11 @@ public:
     uint16_t colorTemperature;
     QString etag;
     std::vector<Scene> scenes;
-    QTime sendTime;
+    qint64 sendTime; // clockMonotonicMs() based
     std::vector<QString> m_multiDeviceIds;
     std::vector<QString> m_lightsequence;
     std::vector<QString> m_deviceMemberships;
+    ChangeMask changes;
 
 private:
     State m_state;
@@ -16,6 +16,10 @@ GroupInfo::GroupInfo() :
    state(StateInGroup),
    actions(ActionNone),
    id(0),
+   reported(ReportedUnknown),
+   retries(0),
+   reconcileFailed(false),
+   nextAttempt(0),
    m_sceneCount(0)
 {
 }
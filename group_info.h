@@ -22,7 +22,8 @@ public:
         ActionNone            = 0x00,
         ActionReadScenes      = 0x01,
         ActionAddToGroup      = 0x02,
-        ActionRemoveFromGroup = 0x04
+        ActionRemoveFromGroup = 0x04,
+        ActionRemoveAllScenes = 0x08
     };
 
     enum State
@@ -31,11 +32,22 @@ public:
         StateNotInGroup
     };
 
+    enum Reported
+    {
+        ReportedUnknown,
+        ReportedInGroup,
+        ReportedNotInGroup
+    };
+
     GroupInfo();
 
-    State state;
+    State state; // desired membership
     uint8_t actions;
     uint16_t id;
+    Reported reported; // membership last reported by the device
+    uint8_t retries; // unconfirmed add/remove attempts
+    bool reconcileFailed; // drift isn't corrected anymore, until the membership is confirmed or requested again
+    int nextAttempt; // idleTotalCounter from which the next attempt is allowed
     std::vector<uint8_t> addScenes;
     std::vector<uint8_t> removeScenes;
     std::vector<uint8_t> modifyScenes;
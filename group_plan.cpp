@@ -0,0 +1,458 @@
+/*
+ * Copyright (c) 2016 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <algorithm>
+#include <QDataStream>
+#include "de_web_plugin.h"
+#include "de_web_plugin_private.h"
+
+/*! Checks if the members of \p group can take a transient scene for \p plan.
+
+    All members must have confirmed their membership and be reachable,
+    since a member which misses the Add Scene command wouldn't follow the
+    recall. Color members must support xy, transition times which aren't
+    whole seconds require the ZLL Enhanced Add Scene command.
+
+    \param members set to a checksum of the members, changes if a light joins or leaves the group
+    \param store true if a new scene must be stored, then the members need free scene table space
+ */
+bool DeRestPluginPrivate::groupPlanSupported(Group *group, const GroupStatePlan &plan, quint32 &members, bool store)
+{
+    bool zll = true;
+    int count = 0;
+    members = 0;
+
+    std::vector<LightNode>::iterator i = nodes.begin();
+    std::vector<LightNode>::iterator end = nodes.end();
+
+    for (; i != end; ++i)
+    {
+        if (i->state() == LightNode::StateDeleted || !isLightNodeInGroup(&(*i), group->address()))
+        {
+            continue;
+        }
+
+        GroupInfo *groupInfo = getGroupInfo(&(*i), group->address());
+
+        if (!i->isAvailable() || !groupInfo || groupInfo->reported != GroupInfo::ReportedInGroup)
+        {
+            return false;
+        }
+
+        if (i->isColorLoopActive())
+        {
+            return false;
+        }
+
+        if (store && sceneSlotsFree(&(*i)) <= 0) // remaining scene table space, see scene_placement.cpp
+        {
+            return false;
+        }
+
+        if (plan.hasXy)
+        {
+            if (!i->hasColor() || i->hasQuirk(QuirkNoColorXy))
+            {
+                return false;
+            }
+        }
+
+        if (i->haEndpoint().profileId() != ZLL_PROFILE_ID)
+        {
+            zll = false;
+        }
+
+        const quint64 ext = i->address().ext();
+        members = members * 31 + (quint32)(ext ^ (ext >> 32)) + i->haEndpoint().endpoint();
+        count++;
+    }
+
+    if (count == 0)
+    {
+        return false;
+    }
+
+    if ((plan.transitionTime % 10) != 0 && !zll)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/*! Stores the state of \p plan as transient scene in all members of \p group by one groupcast.
+    \return true if the request is queued
+ */
+bool DeRestPluginPrivate::addTaskAddGroupPlanScene(Group *group, const GroupStatePlan &plan)
+{
+    const bool enhanced = (plan.transitionTime % 10) != 0;
+
+    TaskItem task;
+    task.taskType = TaskAddScene;
+
+    task.req.setTxOptions(0);
+    task.req.setDstEndpoint(0xFF);
+    task.req.setDstAddressMode(deCONZ::ApsGroupAddress);
+    task.req.dstAddress().setGroup(group->address());
+    task.req.setClusterId(SCENE_CLUSTER_ID);
+    task.req.setProfileId(HA_PROFILE_ID);
+    task.req.setSrcEndpoint(getSrcEndpoint(0, task.req));
+
+    task.zclFrame.setSequenceNumber(zclSeq++);
+    task.zclFrame.setCommandId(enhanced ? 0x40 : 0x00); // enhanced add scene, add scene
+    task.zclFrame.setFrameControl(deCONZ::ZclFCClusterCommand |
+                             deCONZ::ZclFCDirectionClientToServer |
+                             deCONZ::ZclFCDisableDefaultResponse);
+
+    { // payload
+        QDataStream stream(&task.zclFrame.payload(), QIODevice::WriteOnly);
+        stream.setByteOrder(QDataStream::LittleEndian);
+
+        stream << group->address();
+        stream << plan.sceneId;
+        stream << (uint16_t)(enhanced ? plan.transitionTime : plan.transitionTime / 10); // 1/10 s, s
+        stream << (uint8_t)0x00; // length of name
+
+        if (plan.hasOn)
+        {
+            stream << (uint16_t)ONOFF_CLUSTER_ID;
+            stream << (uint8_t)0x01;
+            stream << (uint8_t)(plan.on ? 0x01 : 0x00);
+        }
+
+        if (plan.hasBri)
+        {
+            stream << (uint16_t)LEVEL_CLUSTER_ID;
+            stream << (uint8_t)0x01;
+            stream << plan.bri;
+        }
+
+        if (plan.hasXy)
+        {
+            stream << (uint16_t)COLOR_CLUSTER_ID;
+            stream << (uint8_t)0x04;
+            stream << plan.x;
+            stream << plan.y;
+        }
+    }
+
+    { // ZCL frame
+        QDataStream stream(&task.req.asdu(), QIODevice::WriteOnly);
+        stream.setByteOrder(QDataStream::LittleEndian);
+        task.zclFrame.writeToStream(stream);
+    }
+
+    return addTask(task);
+}
+
+/*! Plans the frames of a group state request.
+
+    The regular path of setGroupState() already merges on and bri into
+    Move to level (with on/off) and hue with sat, but a color always costs
+    a separate groupcast. Combinations of on/bri with xy which are requested
+    repeatedly for a group get a transient scene, after it is stored by one
+    Add Scene groupcast each further request is a single Recall Scene.
+
+    \return true if the request was sent as scene recall and \p rsp is complete,
+            false if the regular path must send it
+ */
+bool DeRestPluginPrivate::planGroupState(Group *group, const QVariantMap &map, TaskItem &task, ApiResponse &rsp)
+{
+    if (!group || task.req.dstAddressMode() != deCONZ::ApsGroupAddress || group->isColorLoopActive())
+    {
+        return false;
+    }
+
+    GroupStatePlan plan;
+    plan.groupId = group->address();
+    plan.transitionTime = task.transitionTime;
+
+    std::vector<GroupStatePlan>::iterator p = groupStatePlans.begin();
+    std::vector<GroupStatePlan>::iterator pend = groupStatePlans.end();
+
+    for (; p != pend; ++p)
+    {
+        if (p->groupId == plan.groupId)
+        {
+            p->verifyPending = false; // the new state supersedes the verification
+        }
+    }
+
+    QVariantMap::const_iterator i = map.begin();
+    QVariantMap::const_iterator end = map.end();
+
+    for (; i != end; ++i)
+    {
+        bool ok = false;
+
+        if (i.key() == "on")
+        {
+            // off with a scene would need the level of each light, leave it to the regular path
+            ok = i.value().type() == QVariant::Bool && i.value().toBool();
+            plan.hasOn = true;
+            plan.on = true;
+        }
+        else if (i.key() == "bri")
+        {
+            const uint bri = i.value().toUInt(&ok);
+            ok = ok && i.value().type() == QVariant::Double && bri < 256;
+            plan.hasBri = true;
+            plan.bri = bri;
+        }
+        else if (i.key() == "xy")
+        {
+            const QVariantList ls = i.value().toList();
+            if (supportColorModeXyForGroups && ls.size() == 2 &&
+                ls[0].type() == QVariant::Double && ls[1].type() == QVariant::Double)
+            {
+                const double x = ls[0].toDouble();
+                const double y = ls[1].toDouble();
+                ok = x >= 0.0 && x <= 1.0 && y >= 0.0 && y <= 1.0;
+                plan.hasXy = true;
+                plan.x = x * 65279.0f; // same range as addTaskSetXyColor()
+                plan.y = y * 65279.0f;
+            }
+        }
+        else if (i.key() == "transitiontime")
+        {
+            ok = true;
+        }
+
+        if (!ok)
+        {
+            return false; // not plannable or invalid, errors are reported by the regular path
+        }
+    }
+
+    if (!plan.hasXy || !(plan.hasOn || plan.hasBri))
+    {
+        return false; // the regular path sends a single frame anyway
+    }
+
+    for (p = groupStatePlans.begin(); p != pend; ++p)
+    {
+        if (p->groupId == plan.groupId && p->hasOn == plan.hasOn && p->on == plan.on &&
+            p->hasBri == plan.hasBri && p->bri == plan.bri && p->hasXy == plan.hasXy &&
+            p->x == plan.x && p->y == plan.y && p->transitionTime == plan.transitionTime)
+        {
+            break;
+        }
+    }
+
+    const qint64 now = clockMonotonicMs();
+
+    if (p == pend)
+    {
+        // remember the combination in a free transient scene of the group
+        // or replace the least recently used one
+        quint8 used = 0; // bitmap of scene slots
+        std::vector<GroupStatePlan>::iterator lru = pend;
+        std::vector<GroupStatePlan>::iterator lruGroup = pend;
+
+        for (p = groupStatePlans.begin(); p != pend; ++p)
+        {
+            if (p->groupId == plan.groupId)
+            {
+                used |= 1 << (p->sceneId - GROUP_PLAN_SCENE_BASE);
+                if (lruGroup == pend || p->lastUse < lruGroup->lastUse) { lruGroup = p; }
+            }
+            if (lru == pend || p->lastUse < lru->lastUse) { lru = p; }
+        }
+
+        plan.sceneId = 0;
+        for (int n = 0; n < GROUP_PLAN_SCENES; n++)
+        {
+            // don't overwrite scenes which were created by someone else
+            if (!(used & (1 << n)) &&
+                (isGroupPlanScene(plan.groupId, GROUP_PLAN_SCENE_BASE + n) || !getSceneForId(plan.groupId, GROUP_PLAN_SCENE_BASE + n)))
+            {
+                plan.sceneId = GROUP_PLAN_SCENE_BASE + n;
+                break;
+            }
+        }
+
+        plan.uses = 1;
+        plan.lastUse = now;
+
+        if (plan.sceneId == 0 && lruGroup == pend)
+        {
+            return false; // the transient scene ids are taken by other scenes
+        }
+        else if (plan.sceneId == 0) // all scenes of the group in use
+        {
+            plan.sceneId = lruGroup->sceneId;
+            *lruGroup = plan;
+        }
+        else if (groupStatePlans.size() >= GROUP_PLAN_MAX_ITEMS)
+        {
+            // slot of another group is left behind, it is overwritten by the next Add Scene there
+            *lru = plan;
+        }
+        else
+        {
+            groupStatePlans.push_back(plan);
+        }
+        return false;
+    }
+
+    p->uses++;
+    p->lastUse = now;
+
+    if (p->uses < GROUP_PLAN_MIN_USES)
+    {
+        return false;
+    }
+
+    quint32 members = 0;
+
+    if (!groupPlanSupported(group, *p, members, false))
+    {
+        return false;
+    }
+
+    if (!p->stored || p->members != members)
+    {
+        if (!groupPlanSupported(group, *p, members, true) || !addTaskAddGroupPlanScene(group, *p))
+        {
+            return false;
+        }
+
+        p->stored = true;
+        p->members = members;
+        p->verifyPending = true;
+        p->verifyTime = now + p->transitionTime * 100 + GROUP_PLAN_VERIFY_DELAY;
+
+        const quint32 key = ((quint32)p->groupId << 8) | p->sceneId;
+        if (std::find(groupPlanScenes.begin(), groupPlanScenes.end(), key) == groupPlanScenes.end())
+        {
+            groupPlanScenes.push_back(key);
+        }
+
+        // check once that all members took the scene, the read is done by groupcast
+        std::vector<LightNode>::iterator l = nodes.begin();
+        std::vector<LightNode>::iterator lend = nodes.end();
+
+        for (; l != lend; ++l)
+        {
+            if (isLightNodeInGroup(&(*l), group->address()))
+            {
+                l->enableRead(READ_ON_OFF | READ_LEVEL | READ_COLOR);
+                l->setNextReadTime(p->verifyTime);
+            }
+        }
+
+        DBG_Printf(DBG_INFO, "store transient scene 0x%02X for group 0x%04X\n", p->sceneId, p->groupId);
+    }
+
+    if (!callScene(group, p->sceneId))
+    {
+        p->stored = false; // store again next time, the Add Scene may be queued already
+        return false;
+    }
+
+    DBG_Printf(DBG_INFO_L2, "send group 0x%04X state as recall of transient scene 0x%02X\n", p->groupId, p->sceneId);
+
+    const QString id = group->id();
+
+    if (p->hasOn)
+    {
+        QVariantMap rspItem;
+        QVariantMap rspItemState;
+        rspItemState[QString("/groups/%1/action/on").arg(id)] = true;
+        rspItem["success"] = rspItemState;
+        rsp.list.append(rspItem);
+
+        task.taskType = TaskSendOnOffToggle;
+        task.onOff = true;
+        taskToLocalData(task);
+    }
+
+    if (p->hasBri)
+    {
+        QVariantMap rspItem;
+        QVariantMap rspItemState;
+        rspItemState[QString("/groups/%1/action/bri").arg(id)] = map["bri"];
+        rspItem["success"] = rspItemState;
+        rsp.list.append(rspItem);
+
+        task.taskType = TaskSetLevel;
+        task.level = p->bri;
+        taskToLocalData(task);
+    }
+
+    {
+        QVariantMap rspItem;
+        QVariantMap rspItemState;
+        rspItemState[QString("/groups/%1/action/xy").arg(id)] = map["xy"];
+        rspItem["success"] = rspItemState;
+        rsp.list.append(rspItem);
+
+        task.taskType = TaskSetXyColor;
+        task.colorX = p->x;
+        task.colorY = p->y;
+        taskToLocalData(task);
+    }
+
+    return true;
+}
+
+/*! Returns true if scene \p sceneId of group \p groupId was stored by the group state planner.
+ */
+bool DeRestPluginPrivate::isGroupPlanScene(uint16_t groupId, uint8_t sceneId) const
+{
+    const quint32 key = ((quint32)groupId << 8) | sceneId;
+    return std::find(groupPlanScenes.begin(), groupPlanScenes.end(), key) != groupPlanScenes.end();
+}
+
+/*! Compares the read back state of \p lightNode with the transient scenes recalled for its groups.
+    A member which missed the Add Scene command doesn't follow the recall,
+    the scene is stored again on the next request then.
+ */
+void DeRestPluginPrivate::groupPlanVerify(LightNode *lightNode)
+{
+    const qint64 now = clockMonotonicMs();
+
+    std::vector<GroupStatePlan>::iterator p = groupStatePlans.begin();
+    std::vector<GroupStatePlan>::iterator pend = groupStatePlans.end();
+
+    for (; p != pend; ++p)
+    {
+        if (!p->verifyPending || now < p->verifyTime || !isLightNodeInGroup(lightNode, p->groupId))
+        {
+            continue;
+        }
+
+        bool match = true;
+
+        if (p->hasOn && lightNode->isOn() != p->on)
+        {
+            match = false;
+        }
+
+        if (p->hasBri && qAbs((int)lightNode->level() - (int)p->bri) > GROUP_PLAN_VERIFY_BRI)
+        {
+            match = false;
+        }
+
+        if (p->hasXy && (qAbs((int)lightNode->colorX() - (int)p->x) > GROUP_PLAN_VERIFY_XY ||
+                         qAbs((int)lightNode->colorY() - (int)p->y) > GROUP_PLAN_VERIFY_XY))
+        {
+            match = false;
+        }
+
+        if (!match)
+        {
+            DBG_Printf(DBG_INFO, "light %s didn't follow transient scene 0x%02X of group 0x%04X, store again\n",
+                       qPrintable(lightNode->id()), p->sceneId, p->groupId);
+            p->stored = false;
+            p->verifyPending = false;
+        }
+    }
+}
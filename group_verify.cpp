@@ -0,0 +1,379 @@
+/*
+ * Copyright (c) 2016 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <QDataStream>
+#include "de_web_plugin.h"
+#include "de_web_plugin_private.h"
+
+/*! Returns the cluster and attributes which are read for a READ_* state flag.
+    \return false if \p readFlag isn't a light state flag
+ */
+static bool groupVerifyAttributes(uint32_t readFlag, quint16 &clusterId, std::vector<uint16_t> &attributes)
+{
+    switch (readFlag)
+    {
+    case READ_ON_OFF:
+        clusterId = ONOFF_CLUSTER_ID;
+        attributes.push_back(0x0000); // OnOff
+        return true;
+
+    case READ_LEVEL:
+        clusterId = LEVEL_CLUSTER_ID;
+        attributes.push_back(0x0000); // Level
+        return true;
+
+    case READ_COLOR:
+        clusterId = COLOR_CLUSTER_ID;
+        attributes.push_back(0x0000); // Current hue
+        attributes.push_back(0x0001); // Current saturation
+        attributes.push_back(0x0003); // Current x
+        attributes.push_back(0x0004); // Current y
+        attributes.push_back(0x0007); // Color temperature
+        attributes.push_back(0x0008); // Color mode
+        attributes.push_back(0x4000); // Enhanced hue
+        attributes.push_back(0x4002); // Color loop active
+        return true;
+
+    default:
+        break;
+    }
+
+    return false;
+}
+
+/*! Verifies a state attribute of \p lightNode together with the other members of one of its groups.
+
+    Instead of reading the attribute from each light by unicast, a single
+    groupcast Read Attributes request is sent to the group with the most
+    members which need the same read. Every member answers with a unicast
+    response, members which stay silent are read by unicast later on.
+
+    \param lightNode the light whose \p readFlag is pending
+    \param readFlag READ_ON_OFF, READ_LEVEL or READ_COLOR
+    \return true if the read is covered by a groupcast, the flag of all members is cleared
+ */
+bool DeRestPluginPrivate::verifyGroupState(LightNode *lightNode, uint32_t readFlag)
+{
+    if (!lightNode || groupVerifications.size() >= GROUP_VERIFY_MAX_ITEMS)
+    {
+        return false;
+    }
+
+    {   // silent in an earlier groupcast, read by unicast once
+        std::vector<GroupVerifyFallback>::iterator i = groupVerifyFallbacks.begin();
+        std::vector<GroupVerifyFallback>::iterator end = groupVerifyFallbacks.end();
+
+        for (; i != end; ++i)
+        {
+            if (i->extAddr == lightNode->address().ext() &&
+                i->endpoint == lightNode->haEndpoint().endpoint() &&
+                (i->readFlags & readFlag))
+            {
+                i->readFlags &= ~readFlag;
+                if (i->readFlags == 0)
+                {
+                    groupVerifyFallbacks.erase(i);
+                }
+                return false;
+            }
+        }
+    }
+
+    quint16 clusterId = 0;
+    std::vector<uint16_t> attributes;
+
+    if (!groupVerifyAttributes(readFlag, clusterId, attributes))
+    {
+        return false;
+    }
+
+    // groups of the light which can be verified
+    std::vector<GroupVerification> candidates;
+    const std::vector<GroupInfo> &groups = static_cast<const LightNode*>(lightNode)->groups();
+
+    std::vector<GroupInfo>::const_iterator gi = groups.begin();
+    std::vector<GroupInfo>::const_iterator gend = groups.end();
+
+    for (; gi != gend; ++gi)
+    {
+        if (gi->state != GroupInfo::StateInGroup || gi->reported != GroupInfo::ReportedInGroup)
+        {
+            continue;
+        }
+
+        Group *group = getGroupForId(gi->id);
+
+        if (!group || group->state() != Group::StateNormal)
+        {
+            continue;
+        }
+
+        bool pending = false;
+        std::list<GroupVerification>::const_iterator v = groupVerifications.begin();
+        std::list<GroupVerification>::const_iterator vend = groupVerifications.end();
+
+        for (; v != vend && !pending; ++v)
+        {
+            pending = v->groupId == gi->id && v->clusterId == clusterId;
+        }
+
+        if (!pending)
+        {
+            GroupVerification ver;
+            ver.groupId = gi->id;
+            candidates.push_back(ver);
+        }
+    }
+
+    if (candidates.empty())
+    {
+        return false;
+    }
+
+    // one pass over the lights, their group memberships are matched with the candidates
+    std::vector<LightNode>::iterator i = nodes.begin();
+    std::vector<LightNode>::iterator end = nodes.end();
+
+    for (; i != end; ++i)
+    {
+        if (!i->isAvailable() || !i->mustRead(readFlag))
+        {
+            continue;
+        }
+
+        if ((readFlag == READ_ON_OFF && !i->hasCapability(CapReadOnOff)) ||
+            (readFlag == READ_LEVEL && !i->hasCapability(CapReadLevel)) ||
+            (readFlag == READ_COLOR && !i->hasCapability(CapReadColor)))
+        {
+            continue;
+        }
+
+        const std::vector<GroupInfo> &memberGroups = static_cast<const LightNode&>(*i).groups();
+        std::vector<GroupInfo>::const_iterator mg = memberGroups.begin();
+        std::vector<GroupInfo>::const_iterator mgend = memberGroups.end();
+
+        for (; mg != mgend; ++mg)
+        {
+            if (mg->state != GroupInfo::StateInGroup || mg->reported != GroupInfo::ReportedInGroup)
+            {
+                continue;
+            }
+
+            std::vector<GroupVerification>::iterator c = candidates.begin();
+            std::vector<GroupVerification>::iterator cend = candidates.end();
+
+            for (; c != cend; ++c)
+            {
+                if (c->groupId == mg->id)
+                {
+                    GroupVerification::Member member;
+                    member.extAddr = i->address().ext();
+                    member.nwkAddr = i->address().nwk();
+                    member.endpoint = i->haEndpoint().endpoint();
+                    c->members.push_back(member);
+                    break;
+                }
+            }
+        }
+    }
+
+    GroupVerification best;
+
+    std::vector<GroupVerification>::const_iterator c = candidates.begin();
+    std::vector<GroupVerification>::const_iterator cend = candidates.end();
+
+    for (; c != cend; ++c)
+    {
+        if (c->members.size() > best.members.size())
+        {
+            best = *c;
+        }
+    }
+
+    if (best.members.size() < GROUP_VERIFY_MIN_MEMBERS)
+    {
+        return false;
+    }
+
+    TaskItem task;
+    task.taskType = TaskReadAttributes;
+
+    task.req.setDstEndpoint(0xFF);
+    task.req.setDstAddressMode(deCONZ::ApsGroupAddress);
+    task.req.dstAddress().setGroup(best.groupId);
+    task.req.setClusterId(clusterId);
+    task.req.setProfileId(HA_PROFILE_ID);
+    task.req.setSrcEndpoint(getSrcEndpoint(0, task.req));
+
+    task.zclFrame.setSequenceNumber(zclSeq++);
+    task.zclFrame.setCommandId(deCONZ::ZclReadAttributesId);
+    task.zclFrame.setFrameControl(deCONZ::ZclFCProfileCommand |
+                             deCONZ::ZclFCDirectionClientToServer |
+                             deCONZ::ZclFCDisableDefaultResponse);
+
+    { // payload
+        QDataStream stream(&task.zclFrame.payload(), QIODevice::WriteOnly);
+        stream.setByteOrder(QDataStream::LittleEndian);
+
+        for (uint i = 0; i < attributes.size(); i++)
+        {
+            stream << attributes[i];
+        }
+    }
+
+    { // ZCL frame
+        QDataStream stream(&task.req.asdu(), QIODevice::WriteOnly);
+        stream.setByteOrder(QDataStream::LittleEndian);
+        task.zclFrame.writeToStream(stream);
+    }
+
+    if (!addTask(task))
+    {
+        return false;
+    }
+
+    best.clusterId = clusterId;
+    best.zclSeq = task.zclFrame.sequenceNumber();
+    best.readFlags = readFlag;
+    best.timeout = idleTotalCounter + GROUP_VERIFY_TIMEOUT;
+
+    std::vector<GroupVerification::Member>::const_iterator m = best.members.begin();
+    std::vector<GroupVerification::Member>::const_iterator mend = best.members.end();
+
+    for (; m != mend; ++m)
+    {
+        LightNode *member = getLightNodeForAddress(m->extAddr, m->endpoint);
+        if (member)
+        {
+            member->clearRead(readFlag);
+        }
+    }
+
+    DBG_Printf(DBG_INFO_L2, "verify cluster 0x%04X of %u lights by groupcast to group 0x%04X\n",
+               clusterId, (uint)best.members.size(), best.groupId);
+
+    groupVerifications.push_back(best);
+    return true;
+}
+
+/*! Matches a Read Attributes response to a pending groupcast verification.
+    The state itself is updated by the regular attribute handling.
+    \return true if the response belonged to a verification
+ */
+bool DeRestPluginPrivate::handleGroupVerification(const deCONZ::ApsDataIndication &ind, const deCONZ::ZclFrame &zclFrame)
+{
+    std::list<GroupVerification>::iterator i = groupVerifications.begin();
+    std::list<GroupVerification>::iterator end = groupVerifications.end();
+
+    for (; i != end; ++i)
+    {
+        if (i->zclSeq != zclFrame.sequenceNumber() || i->clusterId != ind.clusterId())
+        {
+            continue;
+        }
+
+        std::vector<GroupVerification::Member>::iterator m = i->members.begin();
+        std::vector<GroupVerification::Member>::iterator mend = i->members.end();
+
+        for (; m != mend; ++m)
+        {
+            if (m->endpoint != ind.srcEndpoint())
+            {
+                continue;
+            }
+
+            if (ind.srcAddress().hasExt() ? (m->extAddr != ind.srcAddress().ext())
+                                          : (m->nwkAddr != ind.srcAddress().nwk()))
+            {
+                continue;
+            }
+
+            i->members.erase(m);
+            if (i->members.empty())
+            {
+                groupVerifications.erase(i);
+            }
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*! Reads the members which didn't answer a groupcast verification in time by unicast.
+    Called every second by the idle timer.
+ */
+void DeRestPluginPrivate::checkGroupVerifications()
+{
+    bool readBack = false;
+    std::list<GroupVerification>::iterator i = groupVerifications.begin();
+
+    while (i != groupVerifications.end())
+    {
+        if (i->timeout > idleTotalCounter)
+        {
+            ++i;
+            continue;
+        }
+
+        if (!i->members.empty())
+        {
+            DBG_Printf(DBG_INFO_L2, "%u lights of group 0x%04X didn't answer cluster 0x%04X verification, read by unicast\n",
+                       (uint)i->members.size(), i->groupId, i->clusterId);
+        }
+
+        std::vector<GroupVerification::Member>::const_iterator m = i->members.begin();
+        std::vector<GroupVerification::Member>::const_iterator mend = i->members.end();
+
+        for (; m != mend; ++m)
+        {
+            LightNode *lightNode = getLightNodeForAddress(m->extAddr, m->endpoint);
+
+            if (!lightNode || !lightNode->isAvailable())
+            {
+                continue;
+            }
+
+            lightNode->enableRead(i->readFlags);
+            lightNode->setNextReadTime(clockMonotonicMs());
+            readBack = true;
+
+            GroupVerifyFallback fallback;
+            fallback.extAddr = m->extAddr;
+            fallback.endpoint = m->endpoint;
+            fallback.readFlags = i->readFlags;
+
+            std::vector<GroupVerifyFallback>::iterator f = groupVerifyFallbacks.begin();
+            std::vector<GroupVerifyFallback>::iterator fend = groupVerifyFallbacks.end();
+
+            for (; f != fend; ++f)
+            {
+                if (f->extAddr == fallback.extAddr && f->endpoint == fallback.endpoint)
+                {
+                    f->readFlags |= fallback.readFlags;
+                    break;
+                }
+            }
+
+            if (f == fend)
+            {
+                groupVerifyFallbacks.push_back(fallback);
+            }
+        }
+
+        i = groupVerifications.erase(i);
+    }
+
+    if (readBack)
+    {
+        Q_Q(DeRestPlugin);
+        q->startZclAttributeTimer(0);
+    }
+}
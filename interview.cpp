@@ -0,0 +1,509 @@
+/*
+ * Copyright (c) 2016 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include "de_web_plugin.h"
+#include "de_web_plugin_private.h"
+
+/*! Inits the interview of newly joined devices.
+
+    Devices which join while permit join is enabled are interviewed right
+    after their Device_annce, in parallel and independent of the task queue
+    and the idle timer. The information needed to create the REST resource
+    is queried first:
+
+    1. active endpoints
+    2. simple descriptors
+    3. Basic cluster: model id, manufacturer name and sw build id
+    4. node descriptor
+
+    The number of devices with a request in flight is limited overall
+    and per neighbourhood, so that a single router isn't flooded.
+ */
+void DeRestPluginPrivate::initInterview()
+{
+    interviewTimer = new QTimer(this);
+    interviewTimer->setSingleShot(true);
+    connect(interviewTimer, SIGNAL(timeout()),
+            this, SLOT(interviewTimerFired()));
+}
+
+/*! Returns the name of a stage as used in the interviews endpoint.
+ */
+const char *DeRestPluginPrivate::interviewStageToString(Interview::Stage stage)
+{
+    switch (stage)
+    {
+    case Interview::StageActiveEndpoints:   return "endpoints";
+    case Interview::StageSimpleDescriptors: return "descriptors";
+    case Interview::StageBasic:             return "basic";
+    case Interview::StageNodeDescriptor:    return "node";
+    case Interview::StageDone:              return "done";
+    case Interview::StageFailed:            return "failed";
+    default:
+        break;
+    }
+
+    return "unknown";
+}
+
+/*! Starts the interview of a device which has joined the network.
+    \param annce the Device_annce of the device
+ */
+void DeRestPluginPrivate::interviewStart(const ZdpDeviceAnnce &annce)
+{
+    if (gwPermitJoinDuration == 0)
+    {
+        return; // only devices which just joined
+    }
+
+    {
+        std::vector<LightNode>::const_iterator i = nodes.begin();
+        std::vector<LightNode>::const_iterator end = nodes.end();
+
+        for (; i != end; ++i)
+        {
+            if (i->address().ext() == annce.extAddr)
+            {
+                return; // known device, rejoined
+            }
+        }
+    }
+
+    {
+        std::vector<Sensor>::const_iterator i = sensors.begin();
+        std::vector<Sensor>::const_iterator end = sensors.end();
+
+        for (; i != end; ++i)
+        {
+            if (i->address().ext() == annce.extAddr)
+            {
+                return; // known device, rejoined
+            }
+        }
+    }
+
+    const qint64 now = starttimeRef.elapsed();
+    std::vector<Interview>::iterator i = interviews.begin();
+    std::vector<Interview>::iterator end = interviews.end();
+
+    for (; i != end; ++i)
+    {
+        if (i->extAddr == annce.extAddr)
+        {
+            break;
+        }
+    }
+
+    if (i == end)
+    {
+        interviews.push_back(Interview());
+        i = interviews.end() - 1;
+    }
+    else if (i->stage < Interview::StageDone)
+    {
+        i->nwkAddr = annce.nwkAddr; // in progress, keep going
+        return;
+    }
+    else
+    {
+        *i = Interview(); // announced again, start over
+    }
+
+    i->extAddr = annce.extAddr;
+    i->nwkAddr = annce.nwkAddr;
+    i->neighbourhood = annce.extAddr;
+    i->rxOnWhenIdle = (annce.capability & 0x08) != 0; // receiver on when idle
+    i->startTime = now;
+
+    DBG_Printf(DBG_INFO, "interview 0x%016llX: start\n", annce.extAddr);
+
+    if (!interviewTimer->isActive())
+    {
+        interviewTimer->start(0);
+    }
+}
+
+/*! Returns the first application endpoint of an interviewed device, 0 if there is none.
+ */
+static quint8 interviewAppEndpoint(const Interview &iv)
+{
+    for (size_t i = 0; i < iv.endpoints.size(); i++)
+    {
+        if (iv.endpoints[i] != GREEN_POWER_ENDPOINT)
+        {
+            return iv.endpoints[i];
+        }
+    }
+
+    return 0;
+}
+
+/*! Sends the next request of an interview.
+    \return true if the request was sent
+ */
+bool DeRestPluginPrivate::interviewSendRequest(Interview &iv)
+{
+    if (!apsCtrl)
+    {
+        return false;
+    }
+
+    deCONZ::ApsDataRequest req;
+
+    req.setDstAddressMode(deCONZ::ApsNwkAddress);
+    req.dstAddress().setNwk(iv.nwkAddr);
+    req.dstAddress().setExt(iv.extAddr);
+    req.setTxOptions(deCONZ::ApsTxAcknowledgedTransmission);
+
+    QDataStream stream(&req.asdu(), QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    if (iv.stage == Interview::StageBasic)
+    {
+        deCONZ::ZclFrame zclFrame;
+        iv.seq = zclSeq++;
+        zclFrame.setSequenceNumber(iv.seq);
+        zclFrame.setCommandId(deCONZ::ZclReadAttributesId);
+        zclFrame.setFrameControl(deCONZ::ZclFCProfileCommand |
+                                 deCONZ::ZclFCDirectionClientToServer |
+                                 deCONZ::ZclFCDisableDefaultResponse);
+
+        { // payload
+            QDataStream payload(&zclFrame.payload(), QIODevice::WriteOnly);
+            payload.setByteOrder(QDataStream::LittleEndian);
+            payload << (quint16)0x0005; // Model identifier
+            payload << (quint16)0x0004; // Manufacturer name
+            payload << (quint16)0x4000; // Software build identifier
+        }
+
+        req.setProfileId(HA_PROFILE_ID);
+        req.setClusterId(BASIC_CLUSTER_ID);
+        req.setDstEndpoint(interviewAppEndpoint(iv));
+        req.setSrcEndpoint(endpoint());
+        zclFrame.writeToStream(stream);
+    }
+    else
+    {
+        iv.seq = (quint8)qrand();
+
+        req.setProfileId(ZDP_PROFILE_ID);
+        req.setDstEndpoint(ZDO_ENDPOINT);
+        req.setSrcEndpoint(ZDO_ENDPOINT);
+
+        stream << iv.seq;
+        stream << iv.nwkAddr; // NWK address of interest
+
+        switch (iv.stage)
+        {
+        case Interview::StageActiveEndpoints:
+            req.setClusterId(ZDP_ACTIVE_ENDPOINTS_CLID);
+            break;
+
+        case Interview::StageSimpleDescriptors:
+            req.setClusterId(ZDP_SIMPLE_DESCRIPTOR_CLID);
+            stream << iv.endpoints[iv.epIter];
+            break;
+
+        case Interview::StageNodeDescriptor:
+            req.setClusterId(ZDP_NODE_DESCRIPTOR_CLID);
+            break;
+
+        default:
+            return false;
+        }
+    }
+
+    if (apsCtrl->apsdeDataRequest(req) != deCONZ::Success)
+    {
+        return false;
+    }
+
+    // accounted, but not limited by the airtime budget of the steady state
+    airtimeAccount(req.dstAddress(), req.asdu().size());
+    iv.requests++;
+    return true;
+}
+
+/*! Moves an interview to its next request.
+    \param success false if the current request failed, the remaining
+           information is then left to the regular polling
+ */
+void DeRestPluginPrivate::interviewAdvance(Interview &iv, bool success)
+{
+    const Interview::Stage prevStage = iv.stage;
+
+    iv.waiting = false;
+    iv.retries = 0;
+    iv.nextSendTime = 0;
+
+    switch (iv.stage)
+    {
+    case Interview::StageActiveEndpoints:
+        iv.stage = (success && !iv.endpoints.empty()) ? Interview::StageSimpleDescriptors : Interview::StageFailed;
+        iv.epIter = 0;
+        break;
+
+    case Interview::StageSimpleDescriptors:
+        iv.epIter++;
+        if (iv.epIter >= iv.endpoints.size())
+        {
+            // Basic cluster needs an application endpoint
+            iv.stage = interviewAppEndpoint(iv) != 0 ? Interview::StageBasic : Interview::StageNodeDescriptor;
+        }
+        break;
+
+    case Interview::StageBasic:
+        iv.stage = Interview::StageNodeDescriptor;
+        break;
+
+    case Interview::StageNodeDescriptor:
+        iv.stage = Interview::StageDone;
+        break;
+
+    default:
+        break;
+    }
+
+    if (!success)
+    {
+        DBG_Printf(DBG_INFO, "interview 0x%016llX: no response in stage %s\n", iv.extAddr, interviewStageToString(prevStage));
+    }
+
+    if (iv.stage != prevStage)
+    {
+        DBG_Printf(DBG_INFO, "interview 0x%016llX: %s after %d ms\n", iv.extAddr, interviewStageToString(iv.stage),
+                   (int)(starttimeRef.elapsed() - iv.startTime));
+    }
+
+    if (iv.stage >= Interview::StageDone)
+    {
+        iv.finishTime = starttimeRef.elapsed();
+        updateEtag(gwConfigEtag);
+    }
+}
+
+/*! Drives the interviews.
+ */
+void DeRestPluginPrivate::interviewTimerFired()
+{
+    const qint64 now = starttimeRef.elapsed();
+    int active = 0;
+    bool pending = false;
+
+    std::vector<Interview>::iterator i = interviews.begin();
+
+    while (i != interviews.end())
+    {
+        if (i->stage >= Interview::StageDone)
+        {
+            if ((now - i->finishTime) > INTERVIEW_KEEP_FINISHED)
+            {
+                i = interviews.erase(i);
+                continue;
+            }
+        }
+        else if (i->waiting)
+        {
+            const qint64 timeout = i->rxOnWhenIdle ? INTERVIEW_TIMEOUT : INTERVIEW_TIMEOUT_SLEEPY;
+
+            if ((now - i->sendTime) > timeout)
+            {
+                i->waiting = false;
+                i->retries++;
+
+                if (i->retries > INTERVIEW_MAX_RETRIES)
+                {
+                    interviewAdvance(*i, false);
+                }
+            }
+            else
+            {
+                active++;
+            }
+        }
+
+        if (i->stage < Interview::StageDone)
+        {
+            pending = true;
+        }
+
+        ++i;
+    }
+
+    // hand out requests within the limits
+    for (i = interviews.begin(); i != interviews.end() && active < INTERVIEW_MAX_ACTIVE; ++i)
+    {
+        if (i->waiting || i->stage >= Interview::StageDone || now < i->nextSendTime)
+        {
+            continue;
+        }
+
+        deCONZ::Address addr;
+        addr.setExt(i->extAddr);
+        AirtimeBucket *bucket = airtimeBucket(addr);
+
+        if (bucket)
+        {
+            i->neighbourhood = bucket->neighbourhood;
+        }
+
+        int inNeighbourhood = 0;
+        std::vector<Interview>::const_iterator j = interviews.begin();
+        std::vector<Interview>::const_iterator jend = interviews.end();
+
+        for (; j != jend; ++j)
+        {
+            if (j->waiting && j->neighbourhood == i->neighbourhood)
+            {
+                inNeighbourhood++;
+            }
+        }
+
+        if (inNeighbourhood >= INTERVIEW_MAX_PER_PARENT)
+        {
+            continue;
+        }
+
+        if (interviewSendRequest(*i))
+        {
+            i->waiting = true;
+            i->sendTime = now;
+            active++;
+        }
+        else
+        {
+            // a failed send counts as retry, e.g. the APS queue is full
+            i->retries++;
+
+            if (i->retries > INTERVIEW_MAX_RETRIES)
+            {
+                interviewAdvance(*i, false);
+            }
+            else
+            {
+                i->nextSendTime = now + (INTERVIEW_SEND_BACKOFF << (i->retries - 1));
+            }
+        }
+    }
+
+    if (pending)
+    {
+        interviewTimer->start(INTERVIEW_TICK);
+    }
+}
+
+/*! Handles ZDP responses to interview requests.
+ */
+void DeRestPluginPrivate::interviewZdpIndication(const deCONZ::ApsDataIndication &ind)
+{
+    std::vector<Interview>::iterator i = interviews.begin();
+    std::vector<Interview>::iterator end = interviews.end();
+
+    for (; i != end; ++i)
+    {
+        if (!i->waiting)
+        {
+            continue;
+        }
+
+        if ((ind.srcAddress().hasExt() && ind.srcAddress().ext() == i->extAddr) ||
+            (ind.srcAddress().hasNwk() && ind.srcAddress().nwk() == i->nwkAddr))
+        {
+            break;
+        }
+    }
+
+    if (i == end)
+    {
+        return;
+    }
+
+    FrameReader reader(ind.asdu());
+
+    if (ind.clusterId() == ZDP_ACTIVE_ENDPOINTS_RSP_CLID && i->stage == Interview::StageActiveEndpoints)
+    {
+        ZdpActiveEndpointsRsp rsp;
+
+        if (decodeZdpActiveEndpointsRsp(reader, rsp) && rsp.seqNo == i->seq)
+        {
+            i->endpoints = rsp.endpoints;
+            interviewAdvance(*i, rsp.status == deCONZ::ZdpSuccess);
+        }
+    }
+    else if ((ind.clusterId() == ZDP_SIMPLE_DESCRIPTOR_RSP_CLID && i->stage == Interview::StageSimpleDescriptors) ||
+             (ind.clusterId() == ZDP_NODE_DESCRIPTOR_RSP_CLID && i->stage == Interview::StageNodeDescriptor))
+    {
+        ZdpDescriptorRsp rsp;
+
+        // the descriptor itself is taken over by the core
+        if (decodeZdpDescriptorRsp(reader, rsp) && rsp.seqNo == i->seq)
+        {
+            interviewAdvance(*i, rsp.status == deCONZ::ZdpSuccess);
+        }
+    }
+}
+
+/*! Handles the Basic cluster read attributes response of an interview.
+    The attribute values are taken over by the core and the regular node events.
+ */
+void DeRestPluginPrivate::interviewBasicIndication(const deCONZ::ApsDataIndication &ind, const deCONZ::ZclFrame &zclFrame)
+{
+    std::vector<Interview>::iterator i = interviews.begin();
+    std::vector<Interview>::iterator end = interviews.end();
+
+    for (; i != end; ++i)
+    {
+        if (i->waiting && i->stage == Interview::StageBasic && i->seq == zclFrame.sequenceNumber() &&
+            ((ind.srcAddress().hasExt() && ind.srcAddress().ext() == i->extAddr) ||
+             (ind.srcAddress().hasNwk() && ind.srcAddress().nwk() == i->nwkAddr)))
+        {
+            interviewAdvance(*i, true);
+            return;
+        }
+    }
+}
+
+/*! GET /api/<apikey>/config/interviews
+    Returns the progress of the interviews of newly joined devices.
+    \return REQ_READY_SEND
+ */
+int DeRestPluginPrivate::getInterviews(const ApiRequest &req, ApiResponse &rsp)
+{
+    Q_UNUSED(req);
+
+    const qint64 now = starttimeRef.elapsed();
+    QVariantMap devices;
+
+    std::vector<Interview>::const_iterator i = interviews.begin();
+    std::vector<Interview>::const_iterator end = interviews.end();
+
+    for (; i != end; ++i)
+    {
+        QVariantMap item;
+        item["stage"] = interviewStageToString(i->stage);
+        item["duration"] = (double)((i->stage >= Interview::StageDone ? i->finishTime : now) - i->startTime);
+        item["requests"] = (double)i->requests;
+        item["endpoints"] = (double)i->endpoints.size();
+
+        if (i->stage == Interview::StageSimpleDescriptors)
+        {
+            item["descriptors"] = (double)i->epIter;
+        }
+
+        devices[QString("%1").arg(i->extAddr, 16, 16, QChar('0'))] = item;
+    }
+
+    rsp.map["maxactive"] = (double)INTERVIEW_MAX_ACTIVE;
+    rsp.map["maxperneighbourhood"] = (double)INTERVIEW_MAX_PER_PARENT;
+    rsp.map["devices"] = devices;
+    rsp.httpStatus = HttpStatusOk;
+
+    return REQ_READY_SEND;
+}
@@ -34,7 +34,9 @@ LightNode::LightNode() :
    m_colorLoopActive(false),
    m_colorLoopSpeed(0),
    m_groupCount(0),
-   m_sceneCapacity(16)
+   m_sceneCapacity(16),
+   m_confirmed(0),
+   m_unconfirmed(0)
 
 {
 }
@@ -51,6 +53,10 @@ LightNode::State LightNode::state() const
  */
 void LightNode::setState(State state)
 {
+    if (m_state != state)
+    {
+        changes.set(FieldDeleted);
+    }
     m_state = state;
 }
 
@@ -69,6 +75,8 @@ void LightNode::setManufacturerCode(uint16_t code)
     if (m_manufacturerCode != code)
     {
         m_manufacturerCode = code;
+        resetDeviceProfile();
+        changes.set(FieldInfo);
 
         if (!m_manufacturer.isEmpty() && (m_manufacturer != "Unknown"))
         {
@@ -100,7 +108,12 @@ const QString &LightNode::manufacturer() const
  */
 void LightNode::setManufacturerName(const QString &name)
 {
-    m_manufacturer = name.trimmed();
+    if (m_manufacturer != name.trimmed())
+    {
+        m_manufacturer = name.trimmed();
+        resetDeviceProfile();
+    }
+    changes.set(FieldInfo);
 }
 
 /*! Returns the model indentifier.
@@ -115,7 +128,21 @@ const QString &LightNode::modelId() const
  */
 void LightNode::setModelId(const QString &modelId)
 {
-    m_modelId = modelId.trimmed();
+    if (m_modelId != modelId.trimmed())
+    {
+        m_modelId = modelId.trimmed();
+        changes.set(FieldInfo);
+        resetDeviceProfile();
+    }
+}
+
+/*! Compiles the light capabilities from the device type and the matching profiles.
+ */
+bool LightNode::compileDeviceProfile(const DeviceProfileDatabase &db, CompiledDeviceProfile &profile) const
+{
+    const quint32 caps = DeviceProfileDatabase::capabilitiesForDeviceId(m_haEndpoint.profileId(), m_haEndpoint.deviceId());
+    profile = db.compile(m_modelId, m_manufacturer, m_manufacturerCode, caps);
+    return true;
 }
 
 /*! Returns the software build identifier.
@@ -130,6 +157,10 @@ const QString LightNode::swBuildId() const
  */
 void LightNode::setSwBuildId(const QString &swBuildId)
 {
+    if (m_swBuildId != swBuildId)
+    {
+        changes.set(FieldInfo);
+    }
     m_swBuildId = swBuildId;
 }
 
@@ -145,6 +176,10 @@ const QString &LightNode::name() const
  */
 void LightNode::setName(const QString &name)
 {
+    if (m_name != name)
+    {
+        changes.set(FieldName);
+    }
     m_name = name;
 }
 
@@ -156,6 +191,7 @@ const QString &LightNode::type() const
 }
 
 /*! Returns the modifiable list of groups in which the light is a member.
+    Callers which change the membership mark FieldGroups as changed.
  */
 std::vector<GroupInfo> &LightNode::groups()
 {
@@ -203,6 +239,10 @@ bool LightNode::hasColor() const
  */
 void LightNode::setIsOn(bool on)
 {
+    if (m_isOn != on)
+    {
+        changes.set(FieldOn | FieldLevel);
+    }
     m_isOn = on;
 
     switch (m_haEndpoint.deviceId())
@@ -255,6 +295,10 @@ void LightNode::setLevel(uint16_t level)
     DBG_Assert(level <= 255);
     if (level <= 255)
     {
+        if (m_level != level)
+        {
+            changes.set(FieldLevel);
+        }
         m_level = level;
     }
 }
@@ -274,6 +318,10 @@ void LightNode::setHue(uint8_t hue)
     DBG_Assert(hue <= 254);
     if (hue <= 254)
     {
+        if (m_hue != hue)
+        {
+            changes.set(FieldHue);
+        }
         m_hue = hue;
 
         m_normHue = ((double)hue * 360.0f / 254.0f) / 360.0f;
@@ -306,6 +354,10 @@ uint16_t LightNode::enhancedHue() const
  */
 void LightNode::setEnhancedHue(uint16_t ehue)
 {
+    if (m_ehue != ehue)
+    {
+        changes.set(FieldHue);
+    }
     m_normHue = (((double)ehue) / 65535.0f);
     DBG_Assert(m_normHue >= 0.0f);
     DBG_Assert(m_normHue <= 1.0f);
@@ -336,6 +388,10 @@ uint8_t LightNode::saturation() const
  */
 void LightNode::setSaturation(uint8_t sat)
 {
+    if (m_sat != sat)
+    {
+        changes.set(FieldSaturation);
+    }
     m_sat = sat;
 }
 
@@ -358,6 +414,10 @@ void LightNode::setColorXY(uint16_t x, uint16_t y)
         y = 65279;
     }
 
+    if (m_colorX != x || m_colorY != y)
+    {
+        changes.set(FieldColorXY);
+    }
     m_colorX = x;
     m_colorY = y;
 }
@@ -390,6 +450,10 @@ uint16_t LightNode::colorTemperature() const
  */
 void LightNode::setColorTemperature(uint16_t colorTemperature)
 {
+    if (m_colorTemperature != colorTemperature)
+    {
+        changes.set(FieldColorTemperature);
+    }
     m_colorTemperature = colorTemperature;
 }
 
@@ -406,6 +470,10 @@ const QString &LightNode::colorMode() const
 void LightNode::setColorMode(const QString &colorMode)
 {
     DBG_Assert((colorMode == "hs") || (colorMode == "xy") || (colorMode == "ct"));
+    if (m_colorMode != colorMode)
+    {
+        changes.set(FieldColorMode);
+    }
     m_colorMode = colorMode;
 }
 
@@ -414,6 +482,10 @@ void LightNode::setColorMode(const QString &colorMode)
  */
 void LightNode::setColorLoopActive(bool colorLoopActive)
 {
+    if (m_colorLoopActive != colorLoopActive)
+    {
+        changes.set(FieldColorLoop);
+    }
     m_colorLoopActive = colorLoopActive;
 }
 
@@ -450,6 +522,8 @@ const deCONZ::SimpleDescriptor &LightNode::haEndpoint() const
 void LightNode::setHaEndpoint(const deCONZ::SimpleDescriptor &endpoint)
 {
     m_haEndpoint = endpoint;
+    resetDeviceProfile();
+    changes.set(FieldEndpoint);
 
     // check if std otau cluster present in endpoint
     if (otauClusterId() == 0)
@@ -585,3 +659,43 @@ void LightNode::setSceneCapacity(uint8_t sceneCapacity)
     m_sceneCapacity = sceneCapacity;
 }
 
+/*! Returns the READ_* flags of state attributes which were confirmed by the device
+    and have no unconfirmed commands pending.
+ */
+uint32_t LightNode::confirmedState() const
+{
+    return m_confirmed & ~m_unconfirmed;
+}
+
+/*! Returns the READ_* flags of state attributes with unconfirmed commands.
+ */
+uint32_t LightNode::unconfirmedState() const
+{
+    return m_unconfirmed;
+}
+
+/*! Marks state attributes as confirmed by the device.
+    \param readFlags the READ_* flags of the attributes
+ */
+void LightNode::setStateConfirmed(uint32_t readFlags)
+{
+    m_unconfirmed &= ~readFlags;
+    m_confirmed |= readFlags;
+}
+
+/*! Marks state attributes as changed by a command which isn't confirmed yet.
+    \param readFlags the READ_* flags of the attributes
+ */
+void LightNode::setStateUnconfirmed(uint32_t readFlags)
+{
+    m_unconfirmed |= readFlags;
+    m_confirmed &= ~readFlags;
+}
+
+/*! Forgets earlier confirmations of state attributes.
+    \param readFlags the READ_* flags of the attributes
+ */
+void LightNode::clearStateConfirmed(uint32_t readFlags)
+{
+    m_confirmed &= ~readFlags;
+}
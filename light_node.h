@@ -29,6 +29,32 @@ public:
         StateDeleted
     };
 
+    /*! Change mask bits of the light fields. */
+    enum Field
+    {
+        FieldDeleted          = 0x0001,
+        FieldName             = 0x0002,
+        FieldInfo             = 0x0004, // manufacturer, model id and sw version
+        FieldEndpoint         = 0x0008, // endpoint, type and color capability
+        FieldGroups           = 0x0010,
+        FieldOn               = 0x0020,
+        FieldLevel            = 0x0040,
+        FieldHue              = 0x0080,
+        FieldSaturation       = 0x0100,
+        FieldColorXY          = 0x0200,
+        FieldColorTemperature = 0x0400,
+        FieldColorMode        = 0x0800,
+        FieldColorLoop        = 0x1000,
+
+        // fields which are stored in the database
+        FieldsDb = FieldId | FieldUniqueId | FieldDeleted | FieldName | FieldEndpoint | FieldGroups,
+        // fields which appear in the REST state object
+        FieldsRestState = FieldAvailable | FieldEndpoint | FieldOn | FieldLevel | FieldHue | FieldSaturation |
+                          FieldColorXY | FieldColorTemperature | FieldColorMode | FieldColorLoop,
+        // fields which appear as REST attributes
+        FieldsRestAttr = FieldUniqueId | FieldName | FieldInfo | FieldEndpoint
+    };
+
     LightNode();
     State state() const;
     void setState(State state);
@@ -81,9 +107,17 @@ public:
     void setGroupCount(uint8_t groupCount);
     uint8_t sceneCapacity() const;
     void setSceneCapacity(uint8_t sceneCapacity);
+    uint32_t confirmedState() const;
+    uint32_t unconfirmedState() const;
+    void setStateConfirmed(uint32_t readFlags);
+    void setStateUnconfirmed(uint32_t readFlags);
+    void clearStateConfirmed(uint32_t readFlags);
 
     QString etag;
 
+protected:
+    bool compileDeviceProfile(const DeviceProfileDatabase &db, CompiledDeviceProfile &profile) const;
+
 private:
     State m_state;
     uint8_t m_resetRetryCount;
@@ -113,6 +147,8 @@ private:
     deCONZ::SimpleDescriptor m_haEndpoint;
     uint8_t m_groupCount;
     uint8_t m_sceneCapacity;
+    uint32_t m_confirmed; // READ_* flags of state attributes confirmed by the device
+    uint32_t m_unconfirmed; // READ_* flags of state attributes with unconfirmed commands
 };
 
 #endif // LIGHT_NODE_H
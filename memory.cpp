@@ -0,0 +1,568 @@
+/*
+ * Copyright (c) 2016 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <QString>
+#include <QTcpSocket>
+#include <QVariantMap>
+#include "de_web_plugin.h"
+#include "de_web_plugin_private.h"
+
+/*! Returns the estimated heap usage of a string. */
+static size_t memString(const QString &str)
+{
+    if (str.isNull())
+    {
+        return 0;
+    }
+    return MEM_HEAP_OVERHEAD + (size_t)str.capacity() * sizeof(QChar);
+}
+
+/*! Returns the estimated heap usage of a byte array. */
+static size_t memBytes(const QByteArray &arr)
+{
+    if (arr.isNull())
+    {
+        return 0;
+    }
+    return MEM_HEAP_OVERHEAD + (size_t)arr.capacity();
+}
+
+/*! Returns the estimated heap usage of a variant and its nested maps and lists,
+    without the variant itself.
+ */
+static size_t memVariant(const QVariant &var)
+{
+    size_t bytes = 0;
+
+    switch (var.type())
+    {
+    case QVariant::Map:
+    {
+        const QVariantMap map = var.toMap(); // shared, no deep copy
+        QVariantMap::const_iterator i = map.constBegin();
+        QVariantMap::const_iterator end = map.constEnd();
+
+        for (; i != end; ++i)
+        {
+            bytes += MEM_MAP_NODE_OVERHEAD + sizeof(QString) + sizeof(QVariant);
+            bytes += memString(i.key()) + memVariant(i.value());
+        }
+    }
+        break;
+
+    case QVariant::List:
+    {
+        const QVariantList list = var.toList();
+        QVariantList::const_iterator i = list.constBegin();
+        QVariantList::const_iterator end = list.constEnd();
+
+        for (; i != end; ++i)
+        {
+            bytes += sizeof(void*) + sizeof(QVariant) + memVariant(*i);
+        }
+    }
+        break;
+
+    case QVariant::String:
+        bytes += memString(var.toString());
+        break;
+
+    default:
+        break;
+    }
+
+    return bytes;
+}
+
+/*! Returns the estimated heap usage of a map without the map itself. */
+static size_t memVariantMap(const QVariantMap &map)
+{
+    return memVariant(QVariant(map));
+}
+
+/*! Returns the estimated heap usage of a task item in a std::list. */
+static size_t memTaskItem(const TaskItem &task)
+{
+    return MEM_LIST_NODE_OVERHEAD + sizeof(TaskItem) +
+           memBytes(task.req.asdu()) + memString(task.etag);
+}
+
+/*! Returns the estimated heap usage of all task items in \p list. */
+static size_t memTaskList(const std::list<TaskItem> &list)
+{
+    size_t bytes = 0;
+    std::list<TaskItem>::const_iterator i = list.begin();
+    std::list<TaskItem>::const_iterator end = list.end();
+
+    for (; i != end; ++i)
+    {
+        bytes += memTaskItem(*i);
+    }
+
+    return bytes;
+}
+
+/*! Inits the memory accounting.
+
+    The memory of the larger subsystems is estimated periodically from the
+    sizes of their containers and strings, this doesn't include allocator
+    internals but is good enough to see which subsystem grows.
+
+    Each subsystem can have a soft budget in KB, 0 means report only:
+
+    --mem-budget-<subsystem>=<KB>  e.g. --mem-budget-tasks=64
+
+    A subsystem above its budget sheds memory which can be rebuilt:
+    the REST cache is dropped, the task queue rejects new tasks, idle
+    HTTP connections are closed and finished interviews are removed.
+ */
+void DeRestPluginPrivate::initMemory()
+{
+    memTaskBytes = 0;
+    memTransactionBytes = 0;
+
+    for (int i = 0; i < MemSubsystemCount; i++)
+    {
+        MemorySubsystem subsystem = static_cast<MemorySubsystem>(i);
+        int defaultBudget = 0;
+
+        switch (subsystem)
+        {
+        case MemTasks:     defaultBudget = MEM_DEFAULT_BUDGET_TASKS; break;
+        case MemTransactions: defaultBudget = MEM_DEFAULT_BUDGET_TRANSACTIONS; break;
+        case MemClients:   defaultBudget = MEM_DEFAULT_BUDGET_CLIENTS; break;
+        case MemRestCache: defaultBudget = MEM_DEFAULT_BUDGET_RESTCACHE; break;
+        default:
+            break;
+        }
+
+        const QByteArray arg = QByteArray("--mem-budget-") + memSubsystemToString(subsystem);
+        const int budget = deCONZ::appArgumentNumeric(arg.constData(), defaultBudget);
+        memAccounts[i].budget = (size_t)qMax(0, budget) * 1024;
+    }
+
+    memTimer = new QTimer(this);
+    memTimer->setSingleShot(true);
+    connect(memTimer, SIGNAL(timeout()),
+            this, SLOT(memTimerFired()));
+    memTimer->start(MEM_CHECK_INTERVAL);
+}
+
+/*! Returns the name of \p subsystem as used in the API and arguments. */
+const char *DeRestPluginPrivate::memSubsystemToString(MemorySubsystem subsystem)
+{
+    switch (subsystem)
+    {
+    case MemLights:    return "lights";
+    case MemSensors:   return "sensors";
+    case MemGroups:    return "groups";
+    case MemRules:     return "rules";
+    case MemSchedules: return "schedules";
+    case MemTasks:     return "tasks";
+    case MemTransactions: return "transactions";
+    case MemClients:   return "clients";
+    case MemRestCache: return "restcache";
+    case MemOther:     return "other";
+    default:
+        break;
+    }
+
+    return "unknown";
+}
+
+/*! Returns the running memory counter of the task list \p list or 0 if it isn't accounted.
+    addTask() checks the counters against the budgets without walking the lists.
+ */
+size_t *DeRestPluginPrivate::memTaskCounter(const std::list<TaskItem> &list)
+{
+    if (&list == &tasks || &list == &runningTasks)
+    {
+        return &memTaskBytes;
+    }
+
+    if (&list == &transactionTasks || &list == &transactionBacklog)
+    {
+        return &memTransactionBytes;
+    }
+
+    return 0;
+}
+
+/*! Accounts \p task which was put into \p list. */
+void DeRestPluginPrivate::memTaskAdded(const std::list<TaskItem> &list, const TaskItem &task)
+{
+    size_t *bytes = memTaskCounter(list);
+
+    if (bytes)
+    {
+        *bytes += memTaskItem(task);
+    }
+}
+
+/*! Accounts \p task which is about to be removed from \p list. */
+void DeRestPluginPrivate::memTaskRemoved(const std::list<TaskItem> &list, const TaskItem &task)
+{
+    size_t *bytes = memTaskCounter(list);
+
+    if (bytes)
+    {
+        const size_t taskBytes = memTaskItem(task);
+        *bytes = (*bytes > taskBytes) ? *bytes - taskBytes : 0;
+    }
+}
+
+/*! Updates the estimated memory of all subsystems.
+ */
+void DeRestPluginPrivate::memUpdate()
+{
+    for (int i = 0; i < MemSubsystemCount; i++)
+    {
+        memAccounts[i].bytes = 0;
+        memAccounts[i].items = 0;
+    }
+
+    {
+        MemoryAccount &mem = memAccounts[MemLights];
+        mem.bytes = nodes.capacity() * sizeof(LightNode);
+        mem.items = nodes.size();
+
+        std::vector<LightNode>::const_iterator i = nodes.begin();
+        std::vector<LightNode>::const_iterator end = nodes.end();
+
+        for (; i != end; ++i)
+        {
+            mem.bytes += memString(i->id()) + memString(i->uniqueId()) + memString(i->name()) +
+                         memString(i->manufacturer()) + memString(i->modelId()) + memString(i->etag);
+            mem.bytes += i->zclValueCount() * sizeof(NodeValue);
+        }
+    }
+
+    {
+        MemoryAccount &mem = memAccounts[MemSensors];
+        mem.bytes = sensors.capacity() * sizeof(Sensor);
+        mem.items = sensors.size();
+
+        std::vector<Sensor>::const_iterator i = sensors.begin();
+        std::vector<Sensor>::const_iterator end = sensors.end();
+
+        for (; i != end; ++i)
+        {
+            mem.bytes += memString(i->id()) + memString(i->uniqueId()) + memString(i->name()) +
+                         memString(i->type()) + memString(i->modelId()) + memString(i->manufacturer()) +
+                         memString(i->swVersion()) + memString(i->etag);
+            mem.bytes += i->zclValueCount() * sizeof(NodeValue);
+        }
+    }
+
+    {
+        MemoryAccount &mem = memAccounts[MemGroups];
+        mem.bytes = groups.capacity() * sizeof(Group);
+        mem.items = groups.size();
+
+        std::vector<Group>::const_iterator i = groups.begin();
+        std::vector<Group>::const_iterator end = groups.end();
+
+        for (; i != end; ++i)
+        {
+            mem.bytes += memString(i->id()) + memString(i->name()) + memString(i->etag);
+            mem.bytes += (i->m_multiDeviceIds.capacity() + i->m_lightsequence.capacity() +
+                          i->m_deviceMemberships.capacity()) * sizeof(QString);
+            mem.bytes += i->scenes.capacity() * sizeof(Scene);
+
+            std::vector<Scene>::const_iterator s = i->scenes.begin();
+            std::vector<Scene>::const_iterator send = i->scenes.end();
+
+            for (; s != send; ++s)
+            {
+                mem.bytes += memString(s->name) + s->lights().capacity() * sizeof(LightState);
+                mem.items++;
+            }
+        }
+    }
+
+    {
+        MemoryAccount &mem = memAccounts[MemRules];
+        mem.bytes = rules.capacity() * sizeof(Rule);
+        mem.items = rules.size();
+
+        std::vector<Rule>::const_iterator i = rules.begin();
+        std::vector<Rule>::const_iterator end = rules.end();
+
+        for (; i != end; ++i)
+        {
+            mem.bytes += memString(i->id()) + memString(i->name()) + memString(i->etag) +
+                         memString(i->owner()) + memString(i->status()) +
+                         memString(i->creationtime()) + memString(i->lastTriggered());
+
+            std::vector<RuleCondition>::const_iterator c = i->conditions().begin();
+            std::vector<RuleCondition>::const_iterator cend = i->conditions().end();
+
+            mem.bytes += i->conditions().capacity() * sizeof(RuleCondition);
+            for (; c != cend; ++c)
+            {
+                mem.bytes += memString(c->address()) + memString(c->ooperator()) + memString(c->value());
+            }
+
+            std::vector<RuleAction>::const_iterator a = i->actions().begin();
+            std::vector<RuleAction>::const_iterator aend = i->actions().end();
+
+            mem.bytes += i->actions().capacity() * sizeof(RuleAction);
+            for (; a != aend; ++a)
+            {
+                mem.bytes += memString(a->address()) + memString(a->method()) + memString(a->body());
+            }
+        }
+    }
+
+    {
+        MemoryAccount &mem = memAccounts[MemSchedules];
+        mem.bytes = schedules.capacity() * sizeof(Schedule);
+        mem.items = schedules.size();
+
+        std::vector<Schedule>::const_iterator i = schedules.begin();
+        std::vector<Schedule>::const_iterator end = schedules.end();
+
+        for (; i != end; ++i)
+        {
+            mem.bytes += memString(i->id) + memString(i->etag) + memString(i->name) +
+                         memString(i->description) + memString(i->command) + memString(i->time) +
+                         memString(i->starttime) + memString(i->status);
+            mem.bytes += memString(i->jsonString) + memVariantMap(i->jsonMap);
+        }
+    }
+
+    {
+        MemoryAccount &mem = memAccounts[MemTasks];
+        // resync the running counter, ASDUs might be rebuilt after queuing
+        memTaskBytes = memTaskList(tasks) + memTaskList(runningTasks);
+        mem.bytes = memTaskBytes;
+        mem.items = tasks.size() + runningTasks.size();
+    }
+
+    {
+        MemoryAccount &mem = memAccounts[MemTransactions];
+        memTransactionBytes = memTaskList(transactionTasks) + memTaskList(transactionBacklog);
+        mem.bytes = memTransactionBytes;
+        mem.items = transactionTasks.size() + transactionBacklog.size();
+    }
+
+    {
+        MemoryAccount &mem = memAccounts[MemClients];
+        std::list<TcpClient>::const_iterator i = openClients.begin();
+        std::list<TcpClient>::const_iterator end = openClients.end();
+
+        for (; i != end; ++i)
+        {
+            mem.bytes += MEM_LIST_NODE_OVERHEAD + sizeof(TcpClient);
+            if (i->sock)
+            {
+                mem.bytes += sizeof(QTcpSocket) + (size_t)(i->sock->bytesAvailable() + i->sock->bytesToWrite());
+            }
+            mem.items++;
+        }
+    }
+
+    {
+        MemoryAccount &mem = memAccounts[MemRestCache];
+        const std::map<quint32, RestMapCache> *caches[] = { &lightMapCache, &sensorMapCache };
+
+        for (size_t n = 0; n < sizeof(caches) / sizeof(caches[0]); n++)
+        {
+            std::map<quint32, RestMapCache>::const_iterator i = caches[n]->begin();
+            std::map<quint32, RestMapCache>::const_iterator end = caches[n]->end();
+
+            for (; i != end; ++i)
+            {
+                mem.bytes += MEM_MAP_NODE_OVERHEAD + sizeof(RestMapCache);
+                mem.bytes += memVariantMap(i->second.attr) + memVariantMap(i->second.state) +
+                             memVariantMap(i->second.config);
+                mem.items++;
+            }
+        }
+    }
+
+    {
+        MemoryAccount &mem = memAccounts[MemOther];
+        mem.bytes = interviews.capacity() * sizeof(Interview) +
+                    streams.capacity() * sizeof(LightStream);
+        mem.items = interviews.size() + streams.size();
+
+        for (size_t i = 0; i < streams.size(); i++)
+        {
+            mem.bytes += streams[i].channels.capacity() * sizeof(StreamChannel);
+        }
+
+#ifdef DECONZ_REST_SIMULATION
+        mem.bytes += simDevices.capacity() * sizeof(SimDevice);
+        mem.items += simDevices.size() + simEvents.size();
+
+        for (size_t i = 0; i < simDevices.size(); i++)
+        {
+            mem.bytes += simDevices[i].groups.capacity() * sizeof(quint16);
+        }
+
+        std::multimap<qint64, SimEvent>::const_iterator i = simEvents.begin();
+        std::multimap<qint64, SimEvent>::const_iterator end = simEvents.end();
+
+        for (; i != end; ++i)
+        {
+            mem.bytes += MEM_MAP_NODE_OVERHEAD + sizeof(SimEvent) + memBytes(i->second.asdu);
+        }
+#endif
+    }
+
+    for (int i = 0; i < MemSubsystemCount; i++)
+    {
+        MemoryAccount &mem = memAccounts[i];
+        if (mem.bytes > mem.peak)
+        {
+            mem.peak = mem.bytes;
+        }
+    }
+}
+
+/*! Frees memory of \p subsystem which can be rebuilt on demand.
+ */
+void DeRestPluginPrivate::memShed(MemorySubsystem subsystem)
+{
+    MemoryAccount &mem = memAccounts[subsystem];
+
+    switch (subsystem)
+    {
+    case MemRestCache:
+    {
+        // all REST fields must be rebuilt on the next request
+        lightMapCache.clear();
+        sensorMapCache.clear();
+
+        std::vector<LightNode>::const_iterator i = nodes.begin();
+        std::vector<LightNode>::const_iterator end = nodes.end();
+        for (; i != end; ++i)
+        {
+            i->changes.reset(ChangeConsumerRest);
+        }
+
+        std::vector<Sensor>::const_iterator s = sensors.begin();
+        std::vector<Sensor>::const_iterator send = sensors.end();
+        for (; s != send; ++s)
+        {
+            s->changes.reset(ChangeConsumerRest);
+        }
+    }
+        break;
+
+    case MemTasks:
+    case MemTransactions:
+        // addTask() rejects new tasks until the queue is below the budget
+        break;
+
+    case MemClients:
+    {
+        // close idle keep-alive connections on the next tick of openClientTimer
+        std::list<TcpClient>::iterator i = openClients.begin();
+        std::list<TcpClient>::iterator end = openClients.end();
+        for (; i != end; ++i)
+        {
+            if (i->closeTimeout > 1 && i->sock && i->sock->bytesToWrite() == 0)
+            {
+                i->closeTimeout = 1;
+            }
+        }
+    }
+        break;
+
+    case MemOther:
+    {
+        std::vector<Interview>::iterator i = interviews.begin();
+        while (i != interviews.end())
+        {
+            if (i->stage >= Interview::StageDone)
+            {
+                i = interviews.erase(i);
+                continue;
+            }
+            ++i;
+        }
+    }
+        break;
+
+    default:
+        // persistent data, report only
+        return;
+    }
+
+    mem.sheds++;
+}
+
+/*! Timer handler for the periodic memory check.
+ */
+void DeRestPluginPrivate::memTimerFired()
+{
+    pruneIdHandles();
+    memUpdate();
+
+    size_t total = 0;
+
+    for (int i = 0; i < MemSubsystemCount; i++)
+    {
+        MemorySubsystem subsystem = static_cast<MemorySubsystem>(i);
+        MemoryAccount &mem = memAccounts[i];
+        const bool overBudget = mem.budget > 0 && mem.bytes > mem.budget;
+        total += mem.bytes;
+
+        DBG_Printf(overBudget ? DBG_INFO : DBG_INFO_L2, "memory %s: %u KB, %u items, budget %u KB%s\n",
+                   memSubsystemToString(subsystem), (uint)(mem.bytes / 1024), (uint)mem.items,
+                   (uint)(mem.budget / 1024), overBudget ? ", over budget" : "");
+
+        if (overBudget)
+        {
+            memShed(subsystem);
+        }
+    }
+
+    DBG_Printf(DBG_INFO_L2, "memory total: %u KB\n", (uint)(total / 1024));
+
+    memTimer->start(MEM_CHECK_INTERVAL);
+}
+
+/*! GET /api/<apikey>/config/memory
+    \return REQ_READY_SEND
+ */
+int DeRestPluginPrivate::getMemory(const ApiRequest &req, ApiResponse &rsp)
+{
+    Q_UNUSED(req);
+
+    memUpdate();
+
+    double total = 0;
+
+    for (int i = 0; i < MemSubsystemCount; i++)
+    {
+        const MemoryAccount &mem = memAccounts[i];
+        QVariantMap map;
+        map["bytes"] = (double)mem.bytes;
+        map["peak"] = (double)mem.peak;
+        map["items"] = (double)mem.items;
+        map["budget"] = (double)mem.budget;
+        map["overbudget"] = mem.budget > 0 && mem.bytes > mem.budget;
+        map["sheds"] = (double)mem.sheds;
+        if (i == MemTasks)
+        {
+            map["allocations"] = (double)taskAllocStats.allocations;
+            map["frees"] = (double)taskAllocStats.frees;
+        }
+        rsp.map[memSubsystemToString(static_cast<MemorySubsystem>(i))] = map;
+        total += mem.bytes;
+    }
+
+    rsp.map["total"] = total;
+    rsp.httpStatus = HttpStatusOk;
+    return REQ_READY_SEND;
+}
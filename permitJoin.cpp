@@ -22,7 +22,7 @@ void DeRestPluginPrivate::initPermitJoin()
     connect(permitJoinTimer, SIGNAL(timeout()),
             this, SLOT(permitJoinTimerFired()));
     permitJoinTimer->start(1000);
-    permitJoinLastSendTime = QTime::currentTime();
+    permitJoinLastSendTime = clockMonotonicMs();
 }
 
 /*! Sets the permit join interval
@@ -42,7 +42,7 @@ bool DeRestPluginPrivate::setPermitJoinDuration(uint8_t duration)
     }
 
     // force resend
-    permitJoinLastSendTime = QTime();
+    permitJoinLastSendTime = -1;
     return true;
 }
 
@@ -77,10 +77,9 @@ void DeRestPluginPrivate::permitJoinTimerFired()
         return;
     }
 
-    QTime now = QTime::currentTime();
-    int diff = permitJoinLastSendTime.msecsTo(now);
+    const qint64 now = clockMonotonicMs();
 
-    if (!permitJoinLastSendTime.isValid() || (diff > PERMIT_JOIN_SEND_INTERVAL))
+    if (permitJoinLastSendTime < 0 || (now - permitJoinLastSendTime) > PERMIT_JOIN_SEND_INTERVAL)
     {
         deCONZ::ApsDataRequest apsReq;
         quint8 tcSignificance = 0x01;
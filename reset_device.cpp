@@ -158,18 +158,13 @@ void DeRestPluginPrivate::handleMgmtLeaveRspIndication(const deCONZ::ApsDataIndi
 
         resetDeviceTimer->stop();
 
-        QDataStream stream(ind.asdu());
-        stream.setByteOrder(QDataStream::LittleEndian);
+        FrameReader reader(ind.asdu());
+        ZdpStatusRsp rsp;
+        decodeZdpStatusRsp(reader, rsp); // size checked above
 
-        quint8 seqNo;
-        quint8 status;
+        DBG_Printf(DBG_INFO, "MgmtLeave_rsp %s seq: %u, status 0x%02X \n", qPrintable(node->address().toStringExt()), rsp.seqNo, rsp.status);
 
-        stream >> seqNo;    // use SeqNo ?
-        stream >> status;
-
-        DBG_Printf(DBG_INFO, "MgmtLeave_rsp %s seq: %u, status 0x%02X \n", qPrintable(node->address().toStringExt()), seqNo, status);
-
-        if (status == deCONZ::ZdpSuccess || status == deCONZ::ZdpNotSupported)
+        if (rsp.status == deCONZ::ZdpSuccess || rsp.status == deCONZ::ZdpNotSupported)
         {
             node->setResetRetryCount(0);
         }
@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2016 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include "de_web_plugin.h"
+#include "de_web_plugin_private.h"
+
+/*! Adds the light at \p index of nodes to the handle index.
+    If several lights have the same handle the first one is kept.
+ */
+void DeRestPluginPrivate::indexLight(int index)
+{
+    const quint32 handle = nodes[index].handle();
+
+    if (handle == 0)
+    {
+        return;
+    }
+
+    QHash<quint32, int>::iterator i = lightIndexes.find(handle);
+
+    if (i == lightIndexes.end() || i.value() >= (int)nodes.size() ||
+        nodes[i.value()].handle() != handle)
+    {
+        lightIndexes.insert(handle, index);
+    }
+}
+
+/*! Adds the sensor at \p index of sensors to the handle index.
+    If several sensors have the same handle the first one is kept.
+ */
+void DeRestPluginPrivate::indexSensor(int index)
+{
+    const quint32 handle = sensors[index].handle();
+
+    if (handle == 0)
+    {
+        return;
+    }
+
+    QHash<quint32, int>::iterator i = sensorIndexes.find(handle);
+
+    if (i == sensorIndexes.end() || i.value() >= (int)sensors.size() ||
+        sensors[i.value()].handle() != handle)
+    {
+        sensorIndexes.insert(handle, index);
+    }
+}
+
+/*! Adds the rule at \p index of rules to the handle index.
+    A deleted rule is replaced by a later rule with the same id.
+ */
+void DeRestPluginPrivate::indexRule(int index)
+{
+    const quint32 handle = rules[index].handle();
+
+    if (handle == 0)
+    {
+        return;
+    }
+
+    QHash<quint32, int>::iterator i = ruleIndexes.find(handle);
+
+    if (i == ruleIndexes.end() || i.value() >= (int)rules.size() ||
+        rules[i.value()].handle() != handle ||
+        (rules[i.value()].state() == Rule::StateDeleted && rules[index].state() != Rule::StateDeleted))
+    {
+        ruleIndexes.insert(handle, index);
+    }
+}
+
+/*! Rebuilds the handle indexes of lights, sensors and rules.
+    Needed after the vectors were replaced, e.g. by a transaction rollback.
+ */
+void DeRestPluginPrivate::rebuildResourceIndexes()
+{
+    lightIndexes.clear();
+    sensorIndexes.clear();
+    ruleIndexes.clear();
+
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        indexLight((int)i);
+    }
+
+    for (size_t i = 0; i < sensors.size(); i++)
+    {
+        indexSensor((int)i);
+    }
+
+    for (size_t i = 0; i < rules.size(); i++)
+    {
+        indexRule((int)i);
+    }
+}
+
+/*! Drops the interned ids which are no longer used by a resource.
+    Deleted sensors and rules don't keep their id, a new resource with the
+    same id gets a new handle. Called by the periodic memory check.
+ */
+void DeRestPluginPrivate::pruneIdHandles()
+{
+    QSet<quint32> used;
+
+    {
+        std::vector<LightNode>::const_iterator i = nodes.begin();
+        std::vector<LightNode>::const_iterator end = nodes.end();
+
+        for (; i != end; ++i)
+        {
+            used.insert(i->handle()); // deleted lights come back on rejoin
+        }
+    }
+
+    {
+        std::vector<Sensor>::const_iterator i = sensors.begin();
+        std::vector<Sensor>::const_iterator end = sensors.end();
+
+        for (; i != end; ++i)
+        {
+            if (i->deletedState() != Sensor::StateDeleted)
+            {
+                used.insert(i->handle());
+            }
+        }
+    }
+
+    {
+        std::vector<Rule>::const_iterator i = rules.begin();
+        std::vector<Rule>::const_iterator end = rules.end();
+
+        for (; i != end; ++i)
+        {
+            if (i->state() != Rule::StateDeleted)
+            {
+                used.insert(i->handle());
+            }
+        }
+    }
+
+    {
+        std::vector<Group>::const_iterator g = groups.begin();
+        std::vector<Group>::const_iterator gend = groups.end();
+
+        for (; g != gend; ++g)
+        {
+            std::vector<Scene>::const_iterator s = g->scenes.begin();
+            std::vector<Scene>::const_iterator send = g->scenes.end();
+
+            for (; s != send; ++s)
+            {
+                std::vector<LightState>::const_iterator l = s->lights().begin();
+                std::vector<LightState>::const_iterator lend = s->lights().end();
+
+                for (; l != lend; ++l)
+                {
+                    used.insert(l->lightHandle());
+                }
+            }
+        }
+    }
+
+    const int before = idHandles.size();
+    idHandles.retain(used);
+
+    if (idHandles.size() == before)
+    {
+        return;
+    }
+
+    DBG_Printf(DBG_INFO_L2, "pruned %d interned resource ids\n", before - idHandles.size());
+
+    // drop cache entries of the released handles
+    std::map<quint32, RestMapCache>::iterator c = sensorMapCache.begin();
+
+    while (c != sensorMapCache.end())
+    {
+        if (c->first > HANDLE_INTERN_BASE && !used.contains(c->first))
+        {
+            sensorMapCache.erase(c++);
+        }
+        else
+        {
+            ++c;
+        }
+    }
+}
@@ -64,6 +64,38 @@ int DeRestPluginPrivate::handleConfigurationApi(const ApiRequest &req, ApiRespon
     {
         return updateFirmware(req, rsp);
     }
+    // GET /api/<apikey>/config/readiness
+    else if ((req.path.size() == 4) && (req.hdr.method() == "GET") && (req.path[2] == "config") && (req.path[3] == "readiness"))
+    {
+        return getStartupReadiness(req, rsp);
+    }
+    // GET /api/<apikey>/config/airtime
+    else if ((req.path.size() == 4) && (req.hdr.method() == "GET") && (req.path[2] == "config") && (req.path[3] == "airtime"))
+    {
+        return getAirtime(req, rsp);
+    }
+    // GET /api/<apikey>/config/interviews
+    else if ((req.path.size() == 4) && (req.hdr.method() == "GET") && (req.path[2] == "config") && (req.path[3] == "interviews"))
+    {
+        return getInterviews(req, rsp);
+    }
+#ifdef DECONZ_REST_SIMULATION
+    // GET /api/<apikey>/config/simulation
+    else if ((req.path.size() == 4) && (req.hdr.method() == "GET") && (req.path[2] == "config") && (req.path[3] == "simulation"))
+    {
+        return getSimulation(req, rsp);
+    }
+#endif
+    // GET /api/<apikey>/config/memory
+    else if ((req.path.size() == 4) && (req.hdr.method() == "GET") && (req.path[2] == "config") && (req.path[3] == "memory"))
+    {
+        return getMemory(req, rsp);
+    }
+    // /api/<apikey>/config/otau/campaign
+    else if ((req.path.size() == 5) && (req.path[2] == "config") && (req.path[3] == "otau") && (req.path[4] == "campaign"))
+    {
+        return handleOtauCampaignApi(req, rsp);
+    }
     // PUT /api/<apikey>/config/password
     else if ((req.path.size() == 4) && (req.hdr.method() == "PUT") && (req.path[2] == "config") && (req.path[3] == "password"))
     {
@@ -276,6 +308,11 @@ void DeRestPluginPrivate::configToMap(const ApiRequest &req, QVariantMap &map)
         {
             map["fwversionupdate"] = gwFirmwareVersionUpdate;
         }
+        if (fwUpdatePhase != FW_PhaseNone)
+        {
+            map["fwupdatephase"] = firmwareUpdatePhaseToString(fwUpdatePhase);
+            map["fwupdateprogress"] = (double)fwUpdateProgress;
+        }
         map["announceurl"] = gwAnnounceUrl;
         map["announceinterval"] = (double)gwAnnounceInterval;
         map["swversion"] = GW_SW_VERSION;
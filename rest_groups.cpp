@@ -44,6 +44,11 @@ int DeRestPluginPrivate::handleGroupsApi(ApiRequest &req, ApiResponse &rsp)
     {
         return createGroup(req, rsp);
     }
+    // GET /api/<apikey>/groups/membership
+    else if ((req.path.size() == 4) && (req.hdr.method() == "GET") && (req.path[3] == "membership"))
+    {
+        return getGroupMembershipState(req, rsp);
+    }
     // GET /api/<apikey>/groups/<id>
     else if ((req.path.size() == 4) && (req.hdr.method() == "GET"))
     {
@@ -531,8 +536,6 @@ int DeRestPluginPrivate::setGroupAttributes(const ApiRequest &req, ApiResponse &
     if (map.contains("lights"))
     {
         QVariantList lights = map["lights"].toList();
-        uint8_t groupCount;
-        uint8_t groupCapacity;
 
         // for each node in the list send a add to group request (unicast)
         // note: nodes which are currently switched off will not be added to the group
@@ -555,10 +558,7 @@ int DeRestPluginPrivate::setGroupAttributes(const ApiRequest &req, ApiResponse &
 
                 if (lightNode)
                 {
-                    groupCount = lightNode->groupCount();
-                    groupCapacity = lightNode->groupCapacity();
-
-                    if (groupCapacity > 0 || (groupCapacity == 0 && groupCount == 0)) // xxx workaround
+                    if (canPlaceInGroup(lightNode, group->address()))
                     {
                         GroupInfo *groupInfo = getGroupInfo(lightNode, group->address());
 
@@ -573,6 +573,7 @@ int DeRestPluginPrivate::setGroupAttributes(const ApiRequest &req, ApiResponse &
                             groupInfo->actions &= ~GroupInfo::ActionRemoveFromGroup; // sanity
                             groupInfo->actions |= GroupInfo::ActionAddToGroup;
                             groupInfo->state = GroupInfo::StateInGroup;
+                            lightNode->changes.set(LightNode::FieldGroups);
                         }
 
                         changed = true; // necessary for adding last available light to group from main view.
@@ -625,9 +626,10 @@ int DeRestPluginPrivate::setGroupAttributes(const ApiRequest &req, ApiResponse &
                         k->actions &= ~GroupInfo::ActionAddToGroup; // sanity
                         k->actions |= GroupInfo::ActionRemoveFromGroup;
                         k->state = GroupInfo::StateNotInGroup;
+                        j->changes.set(LightNode::FieldGroups);
 
                         //delete Light from all scenes
-                        deleteLightFromScenes(j->id(), k->id);
+                        deleteLightFromScenes(j->handle(), k->id);
 
                         changed = true;
                     }
@@ -639,6 +641,7 @@ int DeRestPluginPrivate::setGroupAttributes(const ApiRequest &req, ApiResponse &
         if (map.contains("multideviceids"))
         {
             group->m_multiDeviceIds.clear();
+            group->changes.set(Group::FieldMembers);
 
             QStringList multiIds = map["multideviceids"].toStringList();
 
@@ -658,6 +661,7 @@ int DeRestPluginPrivate::setGroupAttributes(const ApiRequest &req, ApiResponse &
     {
         changed = true;
         group->m_lightsequence.clear();
+        group->changes.set(Group::FieldMembers);
 
         QStringList lightsequence = map["lightsequence"].toStringList();
 
@@ -702,7 +706,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
 
     userActivity();
 
-    if (!isInNetwork())
+    if (!canSendTasks())
     {
         rsp.list.append(errorToMap(ERR_NOT_CONNECTED, QString("/groups/%1/action").arg(id), "Not connected"));
         rsp.httpStatus = HttpStatusServiceUnavailable;
@@ -772,6 +776,14 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
         }
     }
 
+    // recurring combinations are sent as one scene recall
+    if (planGroupState(group, map, task, rsp))
+    {
+        hasOn = false; // sent already, only the common tail is left
+        hasBri = false;
+        hasXy = false;
+    }
+
     // on/off
     if (hasOn)
     {
@@ -1228,6 +1240,7 @@ int DeRestPluginPrivate::deleteGroup(const ApiRequest &req, ApiResponse &rsp)
             groupInfo->actions &= ~GroupInfo::ActionAddToGroup; // sanity
             groupInfo->actions |= GroupInfo::ActionRemoveFromGroup;
             groupInfo->state = GroupInfo::StateNotInGroup;
+            i->changes.set(LightNode::FieldGroups);
         }
     }
 
@@ -1237,6 +1250,93 @@ int DeRestPluginPrivate::deleteGroup(const ApiRequest &req, ApiResponse &rsp)
     return REQ_READY_SEND;
 }
 
+/*! GET /api/<apikey>/groups/membership
+
+    Drift between the desired group membership of the lights and the
+    membership last reported by the devices.
+    \return REQ_READY_SEND
+            REQ_NOT_HANDLED
+ */
+int DeRestPluginPrivate::getGroupMembershipState(const ApiRequest &req, ApiResponse &rsp)
+{
+    Q_UNUSED(req);
+
+    int memberships = 0;
+    int insync = 0;
+    int drift = 0;
+    int unknown = 0;
+    int pending = 0;
+    int retrying = 0;
+    QVariantList driftLights;
+
+    std::vector<LightNode>::iterator i = nodes.begin();
+    std::vector<LightNode>::iterator end = nodes.end();
+
+    for (; i != end; ++i)
+    {
+        if (i->state() == LightNode::StateDeleted)
+        {
+            continue;
+        }
+
+        bool lightDrift = false;
+        std::vector<GroupInfo>::const_iterator g = i->groups().begin();
+        std::vector<GroupInfo>::const_iterator gend = i->groups().end();
+
+        for (; g != gend; ++g)
+        {
+            memberships++;
+
+            bool add;
+            const bool needsUpdate = groupMembershipNeedsUpdate(*g, add);
+
+            if (g->actions & (GroupInfo::ActionAddToGroup | GroupInfo::ActionRemoveFromGroup))
+            {
+                pending++;
+            }
+
+            if (g->retries > 0)
+            {
+                retrying++;
+            }
+
+            if (g->reported == GroupInfo::ReportedUnknown)
+            {
+                unknown++;
+            }
+            else if (needsUpdate)
+            {
+                drift++;
+                lightDrift = true;
+            }
+            else
+            {
+                insync++;
+            }
+        }
+
+        if (lightDrift)
+        {
+            driftLights.append(i->id());
+        }
+    }
+
+    rsp.map["memberships"] = (double)memberships;
+    rsp.map["insync"] = (double)insync;
+    rsp.map["drift"] = (double)drift;
+    rsp.map["unknown"] = (double)unknown;
+    rsp.map["pending"] = (double)pending;
+    rsp.map["retrying"] = (double)retrying;
+    rsp.map["driftlights"] = driftLights;
+    rsp.map["attempts"] = (double)groupReconcileStats.attempts;
+    rsp.map["confirmed"] = (double)groupReconcileStats.confirmed;
+    rsp.map["failures"] = (double)groupReconcileStats.failures;
+    rsp.map["verifies"] = (double)groupReconcileStats.verifies;
+    rsp.httpStatus = HttpStatusOk;
+
+    return REQ_READY_SEND;
+}
+
 /*! Put all parameters in a map for later json serialization.
     \return true - on success
             false - on error
@@ -1382,7 +1482,7 @@ int DeRestPluginPrivate::createScene(const ApiRequest &req, ApiResponse &rsp)
 
     userActivity();
 
-    if (!isInNetwork())
+    if (!canSendTasks())
     {
         rsp.list.append(errorToMap(ERR_NOT_CONNECTED, QString("/groups/%1/scenes").arg(id), "Not connected"));
         rsp.httpStatus = HttpStatusServiceUnavailable;
@@ -1403,23 +1503,6 @@ int DeRestPluginPrivate::createScene(const ApiRequest &req, ApiResponse &rsp)
         return REQ_READY_SEND;
     }
 
-    // search for lights that have their scenes capacity reached
-    std::vector<LightNode>::iterator ni = nodes.begin();
-    std::vector<LightNode>::iterator nend = nodes.end();
-    for (; ni != nend; ++ni)
-    {
-        LightNode *lightNode = &(*ni);
-
-        if (lightNode->isAvailable() &&
-            isLightNodeInGroup(lightNode, group->address()))
-        {
-            if (lightNode->sceneCapacity() <= 0)
-            {
-                rsp.list.append(errorToMap(ERR_DEVICE_SCENES_TABLE_FULL, QString("/groups/%1/scenes/lights/%2").arg(id).arg(lightNode->id()), QString("Could not set scene for %1. Scene capacity of the device is reached.").arg(qPrintable(lightNode->name()))));
-            }
-        }
-    }
-
     // name
     if (map.contains("name")) // required
     {
@@ -1502,6 +1585,22 @@ int DeRestPluginPrivate::createScene(const ApiRequest &req, ApiResponse &rsp)
         }
     } while (!ok);
 
+    if (scene.id >= GROUP_PLAN_SCENE_BASE) // reserved for transient scenes
+    {
+        rsp.list.append(errorToMap(ERR_RESOURCE_NOT_AVAILABLE, QString("/groups/%1/scenes").arg(id), QString("no free scene id")));
+        rsp.httpStatus = HttpStatusServiceUnavailable;
+        return REQ_READY_SEND;
+    }
+
+    // lights without free scene table space are left out, if none has space the scene isn't created
+    int rejected = 0;
+    if (checkScenePlacement(group, scene.id, rsp, rejected) == 0 && rejected > 0)
+    {
+        rsp.list.append(errorToMap(ERR_DEVICE_SCENES_TABLE_FULL, QString("/groups/%1/scenes").arg(id), QString("Could not create scene. Scene capacity of all devices is reached.")));
+        rsp.httpStatus = HttpStatusServiceUnavailable;
+        return REQ_READY_SEND;
+    }
+
     scene.groupAddress = group->address();
 
     if (scene.name.isEmpty())
@@ -1739,7 +1838,7 @@ int DeRestPluginPrivate::storeScene(const ApiRequest &req, ApiResponse &rsp)
 
     userActivity();
 
-    if (!isInNetwork())
+    if (!canSendTasks())
     {
         rsp.list.append(errorToMap(ERR_NOT_CONNECTED, QString("/groups/%1/scenes/%2").arg(gid).arg(sid), "not connected"));
         rsp.httpStatus = HttpStatusServiceUnavailable;
@@ -1781,43 +1880,13 @@ int DeRestPluginPrivate::storeScene(const ApiRequest &req, ApiResponse &rsp)
         return REQ_READY_SEND;
     }
 
-    // search for lights that have their scenes capacity reached
-    std::vector<LightNode>::iterator ni = nodes.begin();
-    std::vector<LightNode>::iterator nend = nodes.end();
-    for (; ni != nend; ++ni)
+    // lights which hold the scene already overwrite it, others need free scene table space
+    int rejected = 0;
+    if (checkScenePlacement(group, scene.id, rsp, rejected) == 0 && rejected > 0)
     {
-        LightNode *lightNode = &(*ni);
-        if (lightNode->isAvailable() &&
-            isLightNodeInGroup(lightNode, group->address()))
-        {
-            std::vector<Scene>::const_iterator si = group->scenes.begin();
-            std::vector<Scene>::const_iterator send = group->scenes.end();
-            for (; si != send; ++si)
-            {
-                if (si->id == sceneId)
-                {
-                    bool foundLight = false;
-                    std::vector<LightState>::const_iterator ls = si->lights().begin();
-                    std::vector<LightState>::const_iterator lsend = si->lights().end();
-                    for (; ls != lsend; ++ls)
-                    {
-                        if (ls->lid() == lightNode->id())
-                        {
-                            foundLight = true;
-                            break;
-                        }
-                    }
-                    if (!foundLight)
-                    {
-                        if (lightNode->sceneCapacity() <= 0)
-                        {
-                            rsp.list.append(errorToMap(ERR_DEVICE_SCENES_TABLE_FULL, QString("/groups/%1/scenes/lights/%2").arg(gid).arg(lightNode->id()), QString("Could not set scene for %1. Scene capacity of the device is reached.").arg(qPrintable(lightNode->name()))));
-                        }
-                    }
-                    break;
-                }
-            }
-        }
+        rsp.list.append(errorToMap(ERR_DEVICE_SCENES_TABLE_FULL, QString("/groups/%1/scenes/%2").arg(gid).arg(sid), QString("Could not store scene. Scene capacity of all devices is reached.")));
+        rsp.httpStatus = HttpStatusServiceUnavailable;
+        return REQ_READY_SEND;
     }
 
     if (!storeScene(group, scene.id))
@@ -1851,7 +1920,7 @@ int DeRestPluginPrivate::recallScene(const ApiRequest &req, ApiResponse &rsp)
 
     userActivity();
 
-    if (!isInNetwork())
+    if (!canSendTasks())
     {
         rsp.list.append(errorToMap(ERR_NOT_CONNECTED, QString("/groups/%1/scenes/%2").arg(gid).arg(sid), "not connected"));
         rsp.httpStatus = HttpStatusServiceUnavailable;
@@ -1889,7 +1958,7 @@ int DeRestPluginPrivate::recallScene(const ApiRequest &req, ApiResponse &rsp)
 
                 for (; ls != lsend; ++ls)
                 {
-                    LightNode *light = getLightNodeForId(ls->lid());
+                    LightNode *light = getLightNodeForHandle(ls->lightHandle());
 
                     if (light &&
                         light->isAvailable() && light->state() != LightNode::StateDeleted &&
@@ -1941,7 +2010,7 @@ int DeRestPluginPrivate::recallScene(const ApiRequest &req, ApiResponse &rsp)
 
     for (; ls != lsend; ++ls)
     {
-        LightNode *light = getLightNodeForId(ls->lid());
+        LightNode *light = getLightNodeForHandle(ls->lightHandle());
 
         if (light && light->isAvailable() && light->state() != LightNode::StateDeleted)
         {
@@ -2015,7 +2084,7 @@ int DeRestPluginPrivate::modifyScene(const ApiRequest &req, ApiResponse &rsp)
 
     userActivity();
 
-    if (!isInNetwork())
+    if (!canSendTasks())
     {
         rsp.list.append(errorToMap(ERR_NOT_CONNECTED, QString("/groups/%1/scenes/%2/lights/%3/state").arg(gid).arg(sid).arg(lid), "Not connected"));
         rsp.httpStatus = HttpStatusServiceUnavailable;
@@ -2157,7 +2226,7 @@ int DeRestPluginPrivate::modifyScene(const ApiRequest &req, ApiResponse &rsp)
 
             for ( ;l != lend; ++l)
             {
-                if (l->lid() == lid)
+                if (l->lightHandle() == light->handle())
                 {
                     foundLightState = true;
 
@@ -2265,7 +2334,7 @@ int DeRestPluginPrivate::deleteScene(const ApiRequest &req, ApiResponse &rsp)
 
     userActivity();
 
-    if (!isInNetwork())
+    if (!canSendTasks())
     {
         rsp.list.append(errorToMap(ERR_NOT_CONNECTED, QString("/groups/%1/scenes/%2").arg(gid).arg(sid), "Not connected"));
         rsp.httpStatus = HttpStatusServiceUnavailable;
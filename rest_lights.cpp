@@ -106,7 +106,6 @@ int DeRestPluginPrivate::handleLightsApi(ApiRequest &req, ApiResponse &rsp)
  */
 int DeRestPluginPrivate::getAllLights(const ApiRequest &req, ApiResponse &rsp)
 {
-    Q_UNUSED(req);
     rsp.httpStatus = HttpStatusOk;
 
     std::vector<LightNode>::const_iterator i = nodes.begin();
@@ -120,64 +119,10 @@ int DeRestPluginPrivate::getAllLights(const ApiRequest &req, ApiResponse &rsp)
         }
 
         QVariantMap mnode;
-        QVariantMap state;
-        state["on"] = i->isOn();
-        state["effect"] = "none";
-        state["alert"] = "none"; // TODO
-        state["bri"] = (double)i->level();
-        state["reachable"] = i->isAvailable();
-
-        if (i->hasColor())
+        if (lightToMap(req, &(*i), mnode))
         {
-            state["hue"] = (double)i->enhancedHue();
-            state["sat"] = (double)i->saturation();
-            state["ct"] = (double)i->colorTemperature();
-            state["effect"] = (i->isColorLoopActive() ? "colorloop" : "none");
-            QVariantList xy;
-            uint16_t colorX = i->colorX();
-            uint16_t colorY = i->colorY();
-            // sanity for colorX
-            if (colorX > 65279)
-            {
-                colorX = 65279;
-            }
-            // sanity for colorY
-            if (colorY > 65279)
-            {
-                colorY = 65279;
-            }
-            double x = (double)colorX / 65279.0f; // normalize 0 .. 65279 to 0 .. 1
-            double y = (double)colorY / 65279.0f; // normalize 0 .. 65279 to 0 .. 1
-            xy.append(x);
-            xy.append(y);
-            state["xy"] = xy;
-            state["colormode"] = i->colorMode();
+            rsp.map[i->id()] = mnode;
         }
-
-        mnode["uniqueid"] = i->uniqueId();
-        mnode["type"] = i->type();
-        mnode["name"] = i->name();
-        mnode["modelid"] = i->modelId(); // real model id
-        //mnode["modelid"] = "LCT001"; // for Amazon Echo
-        mnode["hascolor"] = i->hasColor();
-        mnode["type"] = i->type();
-        mnode["swversion"] = i->swBuildId();
-        mnode["manufacturer"] = i->manufacturer();
-        QVariantMap pointsymbol;
-        mnode["pointsymbol"] = pointsymbol; // dummy
-        pointsymbol["1"] = QString("none");
-        pointsymbol["2"] = QString("none");
-        pointsymbol["3"] = QString("none");
-        pointsymbol["4"] = QString("none");
-        pointsymbol["5"] = QString("none");
-        pointsymbol["6"] = QString("none");
-        pointsymbol["7"] = QString("none");
-        pointsymbol["8"] = QString("none");
-        QString etag = i->etag;
-        etag.remove('"'); // no quotes allowed in string
-        mnode["etag"] = etag;
-        mnode["state"] = state;
-        rsp.map[i->id()] = mnode;
     }
 
     if (rsp.map.isEmpty())
@@ -231,6 +176,8 @@ int DeRestPluginPrivate::getNewLights(const ApiRequest &req, ApiResponse &rsp)
 }
 
 /*! Put all parameters in a map for later json serialization.
+    The state and the attributes are cached per light and only rebuilt
+    if one of their fields has changed since the last call.
     \return true - on success
             false - on error
  */
@@ -243,62 +190,75 @@ bool DeRestPluginPrivate::lightToMap(const ApiRequest &req, const LightNode *lig
         return false;
     }
 
-    QVariantMap state;
-    state["on"] = lightNode->isOn();
-    state["effect"] = "none";
-    state["alert"] = "none"; // TODO
-    state["bri"] = (double)lightNode->level();
-    state["reachable"] = lightNode->isAvailable();
-
-    if (lightNode->hasColor())
-    {
-        state["hue"] = (double)lightNode->enhancedHue();
-        state["sat"] = (double)lightNode->saturation();
-        state["ct"] = (double)lightNode->colorTemperature();
-        state["effect"] = (lightNode->isColorLoopActive() ? "colorloop" : "none");
-        QVariantList xy;
-        uint16_t colorX = lightNode->colorX();
-        uint16_t colorY = lightNode->colorY();
-        // sanity for colorX
-        if (colorX > 65279)
-        {
-            colorX = 65279;
-        }
-        // sanity for colorY
-        if (colorY > 65279)
+    RestMapCache uncached;
+    RestMapCache *cache = &uncached;
+    quint32 changed = 0xFFFFFFFFUL;
+
+    if (lightNode->handle() != 0)
+    {
+        cache = &lightMapCache[lightNode->handle()];
+        changed = lightNode->changes.pending(ChangeConsumerRest);
+        lightNode->changes.clear(ChangeConsumerRest);
+    }
+
+    if (changed & LightNode::FieldsRestState)
+    {
+        QVariantMap &state = cache->state;
+        state.clear();
+        state["on"] = lightNode->isOn();
+        state["effect"] = "none";
+        state["alert"] = "none"; // TODO
+        state["bri"] = (double)lightNode->level();
+        state["reachable"] = lightNode->isAvailable();
+
+        if (lightNode->hasColor())
         {
-            colorY = 65279;
+            state["hue"] = (double)lightNode->enhancedHue();
+            state["sat"] = (double)lightNode->saturation();
+            state["ct"] = (double)lightNode->colorTemperature();
+            state["effect"] = (lightNode->isColorLoopActive() ? "colorloop" : "none");
+            QVariantList xy;
+            uint16_t colorX = lightNode->colorX();
+            uint16_t colorY = lightNode->colorY();
+            // sanity for colorX
+            if (colorX > 65279)
+            {
+                colorX = 65279;
+            }
+            // sanity for colorY
+            if (colorY > 65279)
+            {
+                colorY = 65279;
+            }
+            double x = (double)colorX / 65279.0f; // normalize 0 .. 65279 to 0 .. 1
+            double y = (double)colorY / 65279.0f; // normalize 0 .. 65279 to 0 .. 1
+            xy.append(x);
+            xy.append(y);
+            state["xy"] = xy;
+            state["colormode"] = lightNode->colorMode();
         }
-        double x = (double)colorX / 65279.0f; // normalize 0 .. 65279 to 0 .. 1
-        double y = (double)colorY / 65279.0f; // normalize 0 .. 65279 to 0 .. 1
-        xy.append(x);
-        xy.append(y);
-        state["xy"] = xy;
-        state["colormode"] = lightNode->colorMode();
-    }
-
-    map["uniqueid"] = lightNode->uniqueId();
-    map["type"] = lightNode->type();
-    map["name"] = lightNode->name();
-    map["modelid"] = lightNode->modelId(); // real model id
-    map["hascolor"] = lightNode->hasColor();
-    map["type"] = lightNode->type();
-    map["swversion"] = lightNode->swBuildId();
-    map["manufacturer"] = lightNode->manufacturer();
-    QVariantMap pointsymbol;
-    map["pointsymbol"] = pointsymbol; // dummy
-    pointsymbol["1"] = QString("none");
-    pointsymbol["2"] = QString("none");
-    pointsymbol["3"] = QString("none");
-    pointsymbol["4"] = QString("none");
-    pointsymbol["5"] = QString("none");
-    pointsymbol["6"] = QString("none");
-    pointsymbol["7"] = QString("none");
-    pointsymbol["8"] = QString("none");
+    }
+
+    if (changed & LightNode::FieldsRestAttr)
+    {
+        QVariantMap &attr = cache->attr;
+        attr.clear();
+        attr["uniqueid"] = lightNode->uniqueId();
+        attr["name"] = lightNode->name();
+        attr["modelid"] = lightNode->modelId(); // real model id
+        attr["hascolor"] = lightNode->hasColor();
+        attr["type"] = lightNode->type();
+        attr["swversion"] = lightNode->swBuildId();
+        attr["manufacturer"] = lightNode->manufacturer();
+        QVariantMap pointsymbol;
+        attr["pointsymbol"] = pointsymbol; // dummy
+    }
+
+    map = cache->attr;
     QString etag = lightNode->etag;
     etag.remove('"'); // no quotes allowed in string
     map["etag"] = etag;
-    map["state"] = state;
+    map["state"] = cache->state;
     return true;
 }
 
@@ -334,22 +294,24 @@ int DeRestPluginPrivate::getLightState(const ApiRequest &req, ApiResponse &rsp)
         QString attrs = req.hdr.value("Query-State");
 
         // only read if time since last read is not too short
+        // and the light hasn't confirmed the state anyway
         if (diff > 3)
         {
+            const uint32_t confirmed = lightNode->confirmedState();
 
-            if (attrs.contains("on"))
+            if (attrs.contains("on") && !(confirmed & READ_ON_OFF))
             {
                 lightNode->enableRead(READ_ON_OFF);
                 enabled = true;
             }
 
-            if (attrs.contains("bri"))
+            if (attrs.contains("bri") && !(confirmed & READ_LEVEL))
             {
                 lightNode->enableRead(READ_LEVEL);
                 enabled = true;
             }
 
-            if (attrs.contains("color") && lightNode->hasColor())
+            if (attrs.contains("color") && lightNode->hasColor() && !(confirmed & READ_COLOR))
             {
                 lightNode->enableRead(READ_COLOR);
                 enabled = true;
@@ -442,7 +404,7 @@ int DeRestPluginPrivate::setLightState(const ApiRequest &req, ApiResponse &rsp)
     bool hasEffectColorLoop = false;
     bool hasAlert = map.contains("alert");
 
-    if (task.lightNode->manufacturerCode() == VENDOR_ATMEL)
+    if (task.lightNode->hasQuirk(QuirkNoColorXy))
     {
         hasXy = false;
     }
@@ -1023,7 +985,7 @@ int DeRestPluginPrivate::deleteLight(const ApiRequest &req, ApiResponse &rsp)
     for (; g != gend; ++g)
     {
         //delete Light from all scenes.
-        deleteLightFromScenes(id, g->id);
+        deleteLightFromScenes(lightNode->handle(), g->id);
 
         //delete Light from all groups
         g->actions &= ~GroupInfo::ActionAddToGroup;
@@ -1031,6 +993,7 @@ int DeRestPluginPrivate::deleteLight(const ApiRequest &req, ApiResponse &rsp)
         if (g->state != GroupInfo::StateNotInGroup)
         {
             g->state = GroupInfo::StateNotInGroup;
+            lightNode->changes.set(LightNode::FieldGroups);
         }
     }
 
@@ -1084,7 +1047,7 @@ int DeRestPluginPrivate::removeAllScenes(const ApiRequest &req, ApiResponse &rsp
 
     for (; g != gend; ++g)
     {
-        deleteLightFromScenes(id, g->id);
+        deleteLightFromScenes(lightNode->handle(), g->id);
     }
 
     queSaveDb(DB_SCENES, DB_SHORT_SAVE_DELAY);
@@ -1131,7 +1094,7 @@ int DeRestPluginPrivate::removeAllGroups(const ApiRequest &req, ApiResponse &rsp
     for (; g != gend; ++g)
     {
         //delete Light from all scenes.
-        deleteLightFromScenes(id, g->id);
+        deleteLightFromScenes(lightNode->handle(), g->id);
 
         //delete Light from all groups
         g->actions &= ~GroupInfo::ActionAddToGroup;
@@ -1139,6 +1102,7 @@ int DeRestPluginPrivate::removeAllGroups(const ApiRequest &req, ApiResponse &rsp
         if (g->state != GroupInfo::StateNotInGroup)
         {
             g->state = GroupInfo::StateNotInGroup;
+            lightNode->changes.set(LightNode::FieldGroups);
         }
     }
 
@@ -8,18 +8,154 @@
  *
  */
 
+#include <QHash>
 #include <QTime>
 #include "de_web_plugin_private.h"
 
+static IdHandleTable *activeHandleTable = 0;
+
+/*! Returns the handle of a canonical number id like "12" or 0 for other ids.
+ */
+static quint32 numericIdHandle(const QString &id)
+{
+    if (id.isEmpty())
+    {
+        return 0;
+    }
+
+    const QChar c = id.at(0);
+    if (id.size() <= 10 && c >= QLatin1Char('1') && c <= QLatin1Char('9')) // no leading zero, sign or whitespace
+    {
+        bool ok;
+        quint32 handle = id.toUInt(&ok, 10);
+        if (ok && handle < HANDLE_INTERN_BASE)
+        {
+            return handle;
+        }
+    }
+
+    return 0;
+}
+
+/*! Converts a public resource id into a compact integer handle.
+
+    Lights, sensors and rules are numbered "1", "2", ... by the gateway,
+    internal lookups and comparisons use the numeric form instead of the string.
+    Other ids are interned in the active IdHandleTable, the same id gets the
+    same handle as long as it is in use.
+    \param id the public id
+    \return the handle or 0 if the id is empty
+ */
+quint32 idToHandle(const QString &id)
+{
+    const quint32 handle = numericIdHandle(id);
+
+    if (handle != 0 || id.isEmpty() || !activeHandleTable)
+    {
+        return handle;
+    }
+
+    return activeHandleTable->intern(id);
+}
+
+/*! Returns the handle of an existing resource id without interning it.
+    Used to look up ids of requests, unknown ids don't grow the table.
+    \return the handle or 0 if the id is unknown
+ */
+quint32 findIdHandle(const QString &id)
+{
+    const quint32 handle = numericIdHandle(id);
+
+    if (handle != 0 || id.isEmpty() || !activeHandleTable)
+    {
+        return handle;
+    }
+
+    return activeHandleTable->find(id);
+}
+
+/*! Constructor.
+ */
+IdHandleTable::IdHandleTable() :
+    m_next(HANDLE_INTERN_BASE + 1)
+{
+}
+
+/*! Returns the handle of \p id, a new one is assigned if the id isn't known.
+ */
+quint32 IdHandleTable::intern(const QString &id)
+{
+    QHash<QString, quint32>::const_iterator i = m_handles.find(id);
+
+    if (i != m_handles.end())
+    {
+        return i.value();
+    }
+
+    const quint32 handle = m_next++;
+    m_handles.insert(id, handle);
+    return handle;
+}
+
+/*! Returns the handle of \p id or 0 if the id isn't known.
+ */
+quint32 IdHandleTable::find(const QString &id) const
+{
+    return m_handles.value(id, 0);
+}
+
+/*! Removes all ids whose handle isn't in \p handles.
+ */
+void IdHandleTable::retain(const QSet<quint32> &handles)
+{
+    QHash<QString, quint32>::iterator i = m_handles.begin();
+
+    while (i != m_handles.end())
+    {
+        if (handles.contains(i.value()))
+        {
+            ++i;
+        }
+        else
+        {
+            i = m_handles.erase(i);
+        }
+    }
+}
+
+/*! Returns the number of interned ids.
+ */
+int IdHandleTable::size() const
+{
+    return m_handles.size();
+}
+
+/*! Returns the table used by idToHandle() or 0.
+ */
+IdHandleTable *IdHandleTable::active()
+{
+    return activeHandleTable;
+}
+
+/*! Sets the table used by idToHandle().
+ */
+void IdHandleTable::setActive(IdHandleTable *table)
+{
+    activeHandleTable = table;
+}
+
 /*! Constructor.
  */
 RestNodeBase::RestNodeBase() :
     m_node(0),
+    m_handle(0),
     m_available(false),
     m_mgmtBindSupported(true),
     m_read(0),
     m_lastRead(0),
-    m_lastAttributeReportBind(0)
+    m_lastAttributeReportBind(0),
+    m_nextReadTime(0),
+    m_profileResolved(false)
 {
 
 }
@@ -37,12 +173,23 @@ deCONZ::Node *RestNodeBase::node()
     return m_node;
 }
 
+/*! Returns the core node object.
+ */
+const deCONZ::Node *RestNodeBase::node() const
+{
+    return m_node;
+}
+
 /*! Sets the core node object.
     \param node the core node
  */
 void RestNodeBase::setNode(deCONZ::Node *node)
 {
-    m_node = node;
+    if (m_node != node)
+    {
+        m_node = node;
+        resetDeviceProfile(); // profile match may depend on the node descriptor
+    }
 }
 
 /*! Returns the modifiable address.
@@ -71,6 +218,10 @@ bool RestNodeBase::isAvailable() const
  */
 void RestNodeBase::setIsAvailable(bool available)
 {
+    if (m_available != available)
+    {
+        changes.set(FieldAvailable);
+    }
     m_available = available;
 }
 
@@ -86,7 +237,19 @@ const QString &RestNodeBase::id() const
  */
 void RestNodeBase::setId(const QString &id)
 {
+    if (m_id != id)
+    {
+        changes.set(FieldId);
+    }
     m_id = id;
+    m_handle = idToHandle(id);
+}
+
+/*! Returns the compact handle of the node, unique per id, 0 if the id isn't set.
+ */
+quint32 RestNodeBase::handle() const
+{
+    return m_handle;
 }
 
 /*! Returns the nodes unique Id.
@@ -103,6 +266,10 @@ const QString &RestNodeBase::uniqueId() const
  */
 void RestNodeBase::setUniqueId(const QString &uid)
 {
+    if (m_uid != uid)
+    {
+        changes.set(FieldUniqueId);
+    }
     m_uid = uid;
 }
 
@@ -138,15 +305,15 @@ void RestNodeBase::clearRead(uint32_t readFlags)
 
 /*! Returns the time than the next auto reading is queued.
  */
-const QTime &RestNodeBase::nextReadTime() const
+qint64 RestNodeBase::nextReadTime() const
 {
     return m_nextReadTime;
 }
 
 /*! Sets the time than the next auto reading should be queued.
-    \param time the time for reading
+    \param time the time for reading as returned by clockMonotonicMs()
  */
-void RestNodeBase::setNextReadTime(const QTime &time)
+void RestNodeBase::setNextReadTime(qint64 time)
 {
     m_nextReadTime = time;
 }
@@ -214,13 +381,15 @@ void RestNodeBase::setZclValue(NodeValue::UpdateType updateType, quint16 cluster
         if (i->clusterId == clusterId &&
             i->attributeId == attributeId)
         {
+            const qint64 now = clockMonotonicMs();
             i->updateType = updateType;
             i->value = value;
-            int dt = i->timestamp.restart();
+            int dt = (int)(now - i->timestamp);
+            i->timestamp = now;
 
             if (updateType == NodeValue::UpdateByZclReport)
             {
-                i->timestampLastReport.start();
+                i->timestampLastReport = now;
             }
             DBG_Printf(DBG_INFO, "update ZCL value 0x%04X/0x%04X for 0x%016llX after %d ms\n", clusterId, attributeId, address().ext(), dt);
             return;
@@ -228,10 +397,10 @@ void RestNodeBase::setZclValue(NodeValue::UpdateType updateType, quint16 cluster
     }
 
     NodeValue val;
-    val.timestamp.start();
+    val.timestamp = clockMonotonicMs();
     if (updateType == NodeValue::UpdateByZclReport)
     {
-        val.timestampLastReport.start();
+        val.timestampLastReport = val.timestamp;
     }
     val.clusterId = clusterId;
     val.attributeId = attributeId;
@@ -245,7 +414,7 @@ void RestNodeBase::setZclValue(NodeValue::UpdateType updateType, quint16 cluster
 
 /*! Returns a numeric ZCL attribute value.
 
-    If the value couldn't be found the NodeValue::timestamp field holds a invalid QTime.
+    If the value couldn't be found the NodeValue::timestamp field is -1.
     \param clusterId - the cluster id of the value
     \param attributeId - the attribute id of the value
  */
@@ -268,7 +437,7 @@ const NodeValue &RestNodeBase::getZclValue(quint16 clusterId, quint16 attributeI
 
 /*! Returns a numeric ZCL attribute value.
 
-    If the value couldn't be found the NodeValue::timestamp field holds a invalid QTime.
+    If the value couldn't be found the NodeValue::timestamp field is -1.
     \param clusterId - the cluster id of the value
     \param attributeId - the attribute id of the value
  */
@@ -288,3 +457,67 @@ NodeValue &RestNodeBase::getZclValue(quint16 clusterId, quint16 attributeId)
 
     return m_invalidValue;
 }
+
+/*! Returns the number of stored ZCL attribute values. */
+size_t RestNodeBase::zclValueCount() const
+{
+    return m_values.size();
+}
+
+/*! Returns true if the device profile was already resolved.
+ */
+bool RestNodeBase::deviceProfileResolved() const
+{
+    return m_profileResolved;
+}
+
+/*! Returns the capabilities and quirks compiled from the matching device profiles.
+    The profile is resolved on first use and again after resetDeviceProfile().
+ */
+const CompiledDeviceProfile &RestNodeBase::deviceProfile() const
+{
+    if (!m_profileResolved)
+    {
+        const DeviceProfileDatabase *db = DeviceProfileDatabase::active();
+
+        if (db)
+        {
+            m_profile = CompiledDeviceProfile();
+            m_profileResolved = compileDeviceProfile(*db, m_profile);
+        }
+    }
+
+    return m_profile;
+}
+
+/*! Compiles the device profile from \p db into \p profile.
+    Derived classes provide the device type capabilities and identifiers.
+    \return false if the result must not be cached because information is still missing
+ */
+bool RestNodeBase::compileDeviceProfile(const DeviceProfileDatabase &db, CompiledDeviceProfile &profile) const
+{
+    Q_UNUSED(db);
+    Q_UNUSED(profile);
+    return true;
+}
+
+/*! Forces the device profile to be resolved again, e.g. after the model identifier changed.
+ */
+void RestNodeBase::resetDeviceProfile()
+{
+    m_profileResolved = false;
+}
+
+/*! Returns true if the device has the DeviceCapability \p capability.
+ */
+bool RestNodeBase::hasCapability(quint32 capability) const
+{
+    return (deviceProfile().capabilities & capability) == capability;
+}
+
+/*! Returns true if the device has the DeviceQuirk \p quirk.
+ */
+bool RestNodeBase::hasQuirk(quint32 quirk) const
+{
+    return (deviceProfile().quirks & quirk) == quirk;
+}
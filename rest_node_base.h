@@ -11,8 +11,40 @@
 #ifndef REST_NODE_BASE_H
 #define REST_NODE_BASE_H
 
+#include <QHash>
+#include <QSet>
 #include <QTime>
 #include "deconz.h"
+#include "change_mask.h"
+#include "device_profile.h"
+
+/*! Handles of ids which aren't canonical numbers start here. */
+#define HANDLE_INTERN_BASE 0x80000000UL
+
+quint32 idToHandle(const QString &id);
+quint32 findIdHandle(const QString &id);
+
+/*! \class IdHandleTable
+
+    Handles of resource ids which aren't canonical numbers, see idToHandle().
+    The table is owned by the plugin and pruned when resources are deleted.
+ */
+class IdHandleTable
+{
+public:
+    IdHandleTable();
+    quint32 intern(const QString &id);
+    quint32 find(const QString &id) const;
+    void retain(const QSet<quint32> &handles);
+    int size() const;
+
+    static IdHandleTable *active();
+    static void setActive(IdHandleTable *table);
+
+private:
+    QHash<QString, quint32> m_handles;
+    quint32 m_next; // handles are never reused
+};
 
 /*! \class NodeValue
 
@@ -24,6 +56,9 @@ public:
     enum UpdateType { UpdateInvalid, UpdateByZclReport, UpdateByZclRead };
 
     NodeValue() :
+        timestamp(-1),
+        timestampLastReport(-1),
+        timestampLastReadRequest(-1),
         updateType(UpdateInvalid),
         clusterId(0),
         attributeId(0)
@@ -31,9 +66,9 @@ public:
         value.u64 = 0;
     }
 
-    QTime timestamp;
-    QTime timestampLastReport;
-    QTime timestampLastReadRequest;
+    qint64 timestamp; // clockMonotonicMs() of the last update, -1 if none
+    qint64 timestampLastReport; // clockMonotonicMs(), -1 if none
+    qint64 timestampLastReadRequest; // clockMonotonicMs(), -1 if none
     UpdateType updateType;
     quint16 clusterId;
     quint16 attributeId;
@@ -48,9 +83,18 @@ public:
 class RestNodeBase
 {
 public:
+    /*! Change mask bits shared by all nodes, subclasses use the lower bits. */
+    enum BaseField
+    {
+        FieldId        = 0x10000000,
+        FieldUniqueId  = 0x20000000,
+        FieldAvailable = 0x40000000
+    };
+
     RestNodeBase();
     virtual ~RestNodeBase();
     deCONZ::Node *node();
+    const deCONZ::Node *node() const;
     void setNode(deCONZ::Node *node);
     deCONZ::Address &address();
     const deCONZ::Address &address() const;
@@ -58,13 +102,14 @@ public:
     void setIsAvailable(bool available);
     const QString &id() const;
     void setId(const QString &id);
+    quint32 handle() const;
     const QString &uniqueId() const;
     void setUniqueId(const QString &uid);
     bool mustRead(uint32_t readFlags);
     void enableRead(uint32_t readFlags);
     void clearRead(uint32_t readFlags);
-    const QTime &nextReadTime() const;
-    void setNextReadTime(const QTime &time);
+    qint64 nextReadTime() const;
+    void setNextReadTime(qint64 time);
     int lastRead() const;
     void setLastRead(int lastRead);
     int lastAttributeReportBind() const;
@@ -74,11 +119,23 @@ public:
     void setZclValue(NodeValue::UpdateType updateType, quint16 clusterId, quint16 attributeId, const deCONZ::NumericUnion &value);
     const NodeValue &getZclValue(quint16 clusterId, quint16 attributeId) const;
     NodeValue &getZclValue(quint16 clusterId, quint16 attributeId);
+    size_t zclValueCount() const;
+    bool deviceProfileResolved() const;
+    const CompiledDeviceProfile &deviceProfile() const;
+    void resetDeviceProfile();
+    bool hasCapability(quint32 capability) const;
+    bool hasQuirk(quint32 quirk) const;
+
+    ChangeMask changes;
+
+protected:
+    virtual bool compileDeviceProfile(const DeviceProfileDatabase &db, CompiledDeviceProfile &profile) const;
 
 private:
     deCONZ::Node *m_node;
     deCONZ::Address m_addr;
     QString m_id;
+    quint32 m_handle; // see idToHandle()
     QString m_uid;
     bool m_available;
     bool m_mgmtBindSupported;
@@ -86,7 +143,10 @@ private:
     uint32_t m_read; // bitmap of READ_* flags
     int m_lastRead; // copy of idleTotalCounter
     int m_lastAttributeReportBind; // copy of idleTotalCounter
-    QTime m_nextReadTime;
+    qint64 m_nextReadTime; // clockMonotonicMs() based
+
+    mutable bool m_profileResolved;
+    mutable CompiledDeviceProfile m_profile; // resolved on first use, see deviceProfile()
 
     NodeValue m_invalidValue;
     std::vector<NodeValue> m_values;
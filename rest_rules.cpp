@@ -37,6 +37,11 @@ int DeRestPluginPrivate::handleRulesApi(const ApiRequest &req, ApiResponse &rsp)
     {
         return getAllRules(req, rsp);
     }
+    // GET, POST /api/<apikey>/rules/deployment
+    else if ((req.path.size() == 4) && (req.path[2] == "rules") && (req.path[3] == "deployment"))
+    {
+        return handleRuleDeploymentApi(req, rsp);
+    }
     // GET /api/<apikey>/rules/<id>
     else if ((req.path.size() == 4) && (req.hdr.method() == "GET") && (req.path[2] == "rules"))
     {
@@ -367,7 +372,7 @@ int DeRestPluginPrivate::createRule(const ApiRequest &req, ApiResponse &rsp)
             //setName
             rule.setName(name);
             rule.setOwner(apikey);
-            rule.setCreationtime(QDateTime::currentDateTimeUtc().toString("yyyy-MM-ddTHH:mm:ss"));
+            rule.setCreationtime(clockTimestamp());
 
             //setStatus optional
             if (map.contains("status"))
@@ -447,6 +452,7 @@ int DeRestPluginPrivate::createRule(const ApiRequest &req, ApiResponse &rsp)
                 if (!found)
                 {
                     rules.push_back(rule);
+                    indexRule(rules.size() - 1);
                     queueCheckRuleBindings(rule);
                 }
             }
@@ -1045,18 +1051,51 @@ void DeRestPluginPrivate::queueBindingTask(const BindingTask &bindingTask)
  */
 void DeRestPluginPrivate::queueCheckRuleBindings(const Rule &rule)
 {
-    quint64 srcAddress = 0;
-    quint8 srcEndpoint = 0;
-    BindingTask bindingTask;
-    bindingTask.state = BindingTask::StateCheck;
-    Sensor *sensorNode = 0;
-
     Q_Q(DeRestPlugin);
     if (!q->pluginActive())
     {
         return;
     }
 
+    std::vector<BindingTask> bindingTasks;
+    Sensor *sensorNode = compileRuleBindings(rule, bindingTasks);
+
+    if (!sensorNode)
+    {
+        return;
+    }
+
+    sensorNode->enableRead(READ_BINDING_TABLE);
+    sensorNode->setNextReadTime(clockMonotonicMs());
+    q->startZclAttributeTimer(1000);
+
+    std::vector<BindingTask>::const_iterator i = bindingTasks.begin();
+    std::vector<BindingTask>::const_iterator end = bindingTasks.end();
+
+    for (; i != end; ++i)
+    {
+        queueBindingTask(*i);
+    }
+
+    if (!bindingTimer->isActive())
+    {
+        bindingTimer->start();
+    }
+}
+
+/*! Compiles the ZigBee bindings which are required by a rule.
+    \param rule the rule
+    \param bindingTasks - the bind or unbind tasks of the rule are appended here
+    \return the source sensor or 0 if no valid source addressing was found
+ */
+Sensor *DeRestPluginPrivate::compileRuleBindings(const Rule &rule, std::vector<BindingTask> &bindingTasks)
+{
+    quint64 srcAddress = 0;
+    quint8 srcEndpoint = 0;
+    BindingTask bindingTask;
+    bindingTask.state = BindingTask::StateCheck;
+    Sensor *sensorNode = 0;
+
     if (rule.state() == Rule::StateNormal && rule.status() == "enabled")
     {
         bindingTask.action = BindingTask::ActionBind;
@@ -1068,7 +1107,7 @@ void DeRestPluginPrivate::queueCheckRuleBindings(const Rule &rule)
     else
     {
         DBG_Printf(DBG_INFO, "ignored checking of rule %s\n", qPrintable(rule.name()));
-        return;
+        return 0;
     }
 
     {   // search in conditions for binding srcAddress and srcEndpoint
@@ -1123,9 +1162,6 @@ void DeRestPluginPrivate::queueCheckRuleBindings(const Rule &rule)
                             {
                                 srcAddress = sensorNode->address().ext();
                                 srcEndpoint = ep;
-                                sensorNode->enableRead(READ_BINDING_TABLE);
-                                sensorNode->setNextReadTime(QTime::currentTime());
-                                q->startZclAttributeTimer(1000);
                                 break;
                             }
                         }
@@ -1157,14 +1193,14 @@ void DeRestPluginPrivate::queueCheckRuleBindings(const Rule &rule)
 
     if (!sensorNode)
     {
-        return;
+        return 0;
     }
 
 
     // found source addressing?
     if ((srcAddress == 0) || (srcEndpoint == 0))
     {
-        return;
+        return 0;
     }
 
     bindingTask.restNode = sensorNode;
@@ -1235,40 +1271,270 @@ void DeRestPluginPrivate::queueCheckRuleBindings(const Rule &rule)
                 if (i->body().contains("on"))
                 {
                     bnd.clusterId = ONOFF_CLUSTER_ID;
-                    queueBindingTask(bindingTask);
+                    bindingTasks.push_back(bindingTask);
                 }
 
                 if (i->body().contains("bri"))
                 {
                     bnd.clusterId = LEVEL_CLUSTER_ID;
-                    queueBindingTask(bindingTask);
+                    bindingTasks.push_back(bindingTask);
                 }
 
                 if (i->body().contains("scene"))
                 {
                     bnd.clusterId = SCENE_CLUSTER_ID;
-                    queueBindingTask(bindingTask);
+                    bindingTasks.push_back(bindingTask);
                 }
 
                 if (i->body().contains("illum"))
                 {
                     bnd.clusterId = ILLUMINANCE_MEASUREMENT_CLUSTER_ID;
-                    queueBindingTask(bindingTask);
+                    bindingTasks.push_back(bindingTask);
                 }
 
                 if (i->body().contains("occ"))
                 {
                     bnd.clusterId = OCCUPANCY_SENSING_CLUSTER_ID;
-                    queueBindingTask(bindingTask);
+                    bindingTasks.push_back(bindingTask);
                 }
             }
         }
     }
 
-    if (!bindingTimer->isActive())
+    return sensorNode;
+}
+
+/*! Compiles the whole rule set into the minimal set of required bindings
+    and queues them at once.
+
+    Bindings which are needed by several rules are only checked once. A binding
+    which is required by one rule is never unbound because another rule is
+    disabled. One binding table read per source device serves all its rules,
+    the binding queue processes different devices in parallel.
+    \return the number of planned bindings
+ */
+int DeRestPluginPrivate::planRuleDeployment()
+{
+    Q_Q(DeRestPlugin);
+    if (!q->pluginActive() || !apsCtrl || (apsCtrl->networkState() != deCONZ::InNetwork))
+    {
+        return 0;
+    }
+
+    std::vector<BindingTask> plan;
+    std::vector<Sensor*> sources;
+    int requested = 0;
+    int ruleCount = 0;
+
+    std::vector<Rule>::iterator r = rules.begin();
+    std::vector<Rule>::iterator rend = rules.end();
+
+    for (; r != rend; ++r)
+    {
+        if (r->state() != Rule::StateNormal)
+        {
+            continue;
+        }
+
+        r->lastVerify = idleTotalCounter;
+
+        std::vector<BindingTask> bindingTasks;
+        Sensor *sensorNode = compileRuleBindings(*r, bindingTasks);
+
+        if (!sensorNode || bindingTasks.empty())
+        {
+            continue;
+        }
+
+        ruleCount++;
+
+        if (std::find(sources.begin(), sources.end(), sensorNode) == sources.end())
+        {
+            sources.push_back(sensorNode);
+        }
+
+        std::vector<BindingTask>::const_iterator i = bindingTasks.begin();
+        std::vector<BindingTask>::const_iterator end = bindingTasks.end();
+
+        for (; i != end; ++i)
+        {
+            requested++;
+
+            std::vector<BindingTask>::iterator p = plan.begin();
+            std::vector<BindingTask>::iterator pend = plan.end();
+
+            for (; p != pend; ++p)
+            {
+                if (p->binding == i->binding)
+                {
+                    break;
+                }
+            }
+
+            if (p == pend)
+            {
+                plan.push_back(*i);
+            }
+            else if (i->action == BindingTask::ActionBind)
+            {
+                p->action = BindingTask::ActionBind; // still needed by this rule
+            }
+        }
+    }
+
+    // drop queued tasks which contradict the plan
+    {
+        std::list<BindingTask>::iterator i = bindingQueue.begin();
+        std::list<BindingTask>::iterator end = bindingQueue.end();
+
+        for (; i != end; ++i)
+        {
+            if (i->state == BindingTask::StateInProgress || i->state == BindingTask::StateFinished)
+            {
+                continue;
+            }
+
+            std::vector<BindingTask>::const_iterator p = plan.begin();
+            std::vector<BindingTask>::const_iterator pend = plan.end();
+
+            for (; p != pend; ++p)
+            {
+                if (p->binding == i->binding && p->action != i->action)
+                {
+                    i->state = BindingTask::StateFinished;
+                    break;
+                }
+            }
+        }
+    }
+
+    // one binding table read per source device
+    std::vector<Sensor*>::iterator s = sources.begin();
+    std::vector<Sensor*>::iterator send = sources.end();
+
+    for (; s != send; ++s)
+    {
+        (*s)->enableRead(READ_BINDING_TABLE);
+        (*s)->setNextReadTime(clockMonotonicMs());
+    }
+
+    if (!sources.empty())
+    {
+        q->startZclAttributeTimer(1000);
+    }
+
+    std::vector<BindingTask>::const_iterator i = plan.begin();
+    std::vector<BindingTask>::const_iterator end = plan.end();
+
+    for (; i != end; ++i)
+    {
+        queueBindingTask(*i);
+    }
+
+    if (!bindingTimer->isActive() && !bindingQueue.empty())
     {
         bindingTimer->start();
     }
+
+    ruleDeployment.active = !plan.empty();
+    ruleDeployment.rules = ruleCount;
+    ruleDeployment.requested = requested;
+    ruleDeployment.devices = sources.size();
+    ruleDeployment.startTime = starttimeRef.elapsed();
+    ruleDeployment.duration = 0;
+    ruleDeployment.tasks = plan;
+    updateRuleDeployment();
+
+    DBG_Printf(DBG_INFO, "rule deployment: %d rules, %d bindings (%d shared) on %d devices\n",
+               ruleCount, (int)plan.size(), requested - (int)plan.size(), (int)sources.size());
+
+    return plan.size();
+}
+
+/*! Updates the progress of the rule deployment.
+ */
+void DeRestPluginPrivate::updateRuleDeployment()
+{
+    if (!ruleDeployment.active)
+    {
+        return;
+    }
+
+    ruleDeployment.pending = 0;
+    ruleDeployment.checking = 0;
+
+    std::vector<BindingTask>::const_iterator i = ruleDeployment.tasks.begin();
+    std::vector<BindingTask>::const_iterator end = ruleDeployment.tasks.end();
+
+    for (; i != end; ++i)
+    {
+        std::list<BindingTask>::const_iterator q = std::find(bindingQueue.begin(), bindingQueue.end(), *i);
+
+        if (q != bindingQueue.end() && q->state != BindingTask::StateFinished)
+        {
+            ruleDeployment.pending++;
+
+            if (q->state == BindingTask::StateCheck)
+            {
+                ruleDeployment.checking++;
+            }
+        }
+    }
+
+    ruleDeployment.duration = starttimeRef.elapsed() - ruleDeployment.startTime;
+
+    if (ruleDeployment.pending == 0)
+    {
+        DBG_Printf(DBG_INFO, "rule deployment finished after %d ms\n", (int)ruleDeployment.duration);
+        ruleDeployment.active = false;
+    }
+}
+
+/*! GET, POST /api/<apikey>/rules/deployment
+    \return REQ_READY_SEND
+            REQ_NOT_HANDLED
+ */
+int DeRestPluginPrivate::handleRuleDeploymentApi(const ApiRequest &req, ApiResponse &rsp)
+{
+    if (req.hdr.method() == "POST")
+    {
+        if (!isInNetwork())
+        {
+            rsp.list.append(errorToMap(ERR_NOT_CONNECTED, QString("/rules/deployment"), QString("Not connected")));
+            rsp.httpStatus = HttpStatusServiceUnavailable;
+            return REQ_READY_SEND;
+        }
+
+        QVariantMap rspItem;
+        QVariantMap rspItemState;
+        rspItemState["/rules/deployment/bindings"] = planRuleDeployment();
+        rspItem["success"] = rspItemState;
+        rsp.list.append(rspItem);
+        rsp.httpStatus = HttpStatusOk;
+        return REQ_READY_SEND;
+    }
+    else if (req.hdr.method() != "GET")
+    {
+        return REQ_NOT_HANDLED;
+    }
+
+    updateRuleDeployment();
+
+    const RuleDeployment &d = ruleDeployment;
+    const int total = d.tasks.size();
+
+    rsp.map["state"] = d.active ? QLatin1String("running") : QLatin1String("idle");
+    rsp.map["rules"] = (double)d.rules;
+    rsp.map["bindings"] = (double)total;
+    rsp.map["shared"] = (double)(d.requested - total);
+    rsp.map["devices"] = (double)d.devices;
+    rsp.map["pending"] = (double)d.pending;
+    rsp.map["checking"] = (double)d.checking;
+    rsp.map["done"] = (double)(total - d.pending);
+    rsp.map["progress"] = total > 0 ? (double)((total - d.pending) * 100 / total) : (double)100;
+    rsp.map["duration"] = (double)(d.duration / 1000);
+    rsp.httpStatus = HttpStatusOk;
+    return REQ_READY_SEND;
 }
 
 /*! Triggers actions of a rule if needed.
@@ -1344,11 +1610,13 @@ void DeRestPluginPrivate::triggerRuleIfNeeded(Rule &rule)
             { // check if value is fresh enough
                 NodeValue &val = sensor->getZclValue(ILLUMINANCE_MEASUREMENT_CLUSTER_ID, 0x0000);
 
-                if (!val.timestamp.isValid() ||
-                     val.timestamp.elapsed() > MAX_RULE_ILLUMINANCE_VALUE_AGE_MS)
+                const qint64 now = clockMonotonicMs();
+
+                if (val.timestamp < 0 ||
+                     (now - val.timestamp) > MAX_RULE_ILLUMINANCE_VALUE_AGE_MS)
                 {
-                    if (val.timestampLastReadRequest.isValid() &&
-                        val.timestampLastReadRequest.elapsed() < (MAX_RULE_ILLUMINANCE_VALUE_AGE_MS / 2))
+                    if (val.timestampLastReadRequest >= 0 &&
+                        (now - val.timestampLastReadRequest) < (MAX_RULE_ILLUMINANCE_VALUE_AGE_MS / 2))
                     {
                         return;
                     }
@@ -1358,7 +1626,7 @@ void DeRestPluginPrivate::triggerRuleIfNeeded(Rule &rule)
                     DBG_Printf(DBG_INFO, "force read illuminance value of 0x%016llX\n", sensor->address().ext());
                     if (readAttributes(sensor, sensor->fingerPrint().endpoint, ILLUMINANCE_MEASUREMENT_CLUSTER_ID, attrs))
                     {
-                        val.timestampLastReadRequest.start();
+                        val.timestampLastReadRequest = now;
                     }
 
                     return;
@@ -1447,7 +1715,7 @@ void DeRestPluginPrivate::triggerRuleIfNeeded(Rule &rule)
 
     if (triggered)
     {
-        rule.setLastTriggered(QDateTime::currentDateTimeUtc().toString("yyyy-MM-ddTHH:mm:ss"));
+        rule.setLastTriggered(clockTimestamp());
         rule.setTimesTriggered(rule.timesTriggered() + 1);
     }
 }
@@ -1475,20 +1743,17 @@ void DeRestPluginPrivate::verifyRuleBindingsTimerFired()
 
     triggerRuleIfNeeded(rule);
 
-    if (bindingQueue.size() < 16)
+    if (ruleDeployment.active)
     {
-        if (rule.state() == Rule::StateNormal)
-        {
-            if ((rule.lastVerify + Rule::MaxVerifyDelay) < idleTotalCounter)
-            {
-                rule.lastVerify = idleTotalCounter;
-                queueCheckRuleBindings(rule);
-            }
-        }
+        updateRuleDeployment();
     }
-    else
+    else if (rule.state() == Rule::StateNormal)
     {
-        DBG_Printf(DBG_INFO, "");
+        // verify the whole rule set at once
+        if ((rule.lastVerify + Rule::MaxVerifyDelay) < idleTotalCounter)
+        {
+            planRuleDeployment();
+        }
     }
 
     verifyRuleIter++;
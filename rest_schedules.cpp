@@ -493,6 +493,7 @@ int DeRestPluginPrivate::setScheduleAttributes(const ApiRequest &req, ApiRespons
 
             i->jsonMap["etag"] = i->etag.remove('"'); // no quotes allowed in string;
             i->jsonString = deCONZ::jsonStringFromMap(i->jsonMap);
+            i->changes.set(Schedule::FieldJson);
             queSaveDb(DB_SCHEDULES, DB_SHORT_SAVE_DELAY);
 
             return REQ_READY_SEND;
@@ -791,7 +792,7 @@ void DeRestPluginPrivate::scheduleTimerFired()
     std::vector<Schedule>::iterator i = schedules.begin();
     std::vector<Schedule>::iterator end = schedules.end();
 
-    QDateTime now = QDateTime::currentDateTimeUtc();
+    const QDateTime now = clockNowUtc();
 
     for (; i != end; ++i)
     {
@@ -830,6 +831,7 @@ void DeRestPluginPrivate::scheduleTimerFired()
                         i->status = "disabled";
                         i->jsonMap["status"] = "disabled";
                         i->jsonString = deCONZ::jsonStringFromMap(i->jsonMap);
+                        i->changes.set(Schedule::FieldJson);
                     }
                     queSaveDb(DB_SCHEDULES, DB_SHORT_SAVE_DELAY);
                 }
@@ -939,6 +941,7 @@ void DeRestPluginPrivate::scheduleTimerFired()
                         i->status = "disabled";
                         i->jsonMap["status"] = "disabled";
                         i->jsonString = deCONZ::jsonStringFromMap(i->jsonMap);
+                        i->changes.set(Schedule::FieldJson);
                     }
                     queSaveDb(DB_SCHEDULES, DB_SHORT_SAVE_DELAY);
                 }
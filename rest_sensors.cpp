@@ -98,8 +98,8 @@ int DeRestPluginPrivate::getAllSensors(const ApiRequest &req, ApiResponse &rsp)
     Q_UNUSED(req);
     rsp.httpStatus = HttpStatusOk;
 
-    std::vector<Sensor>::iterator i = sensors.begin();
-    std::vector<Sensor>::iterator end = sensors.end();
+    std::vector<Sensor>::const_iterator i = sensors.begin();
+    std::vector<Sensor>::const_iterator end = sensors.end();
 
     for (; i != end; ++i)
     {
@@ -110,112 +110,10 @@ int DeRestPluginPrivate::getAllSensors(const ApiRequest &req, ApiResponse &rsp)
         }
 
         QVariantMap sensor;
-        QVariantMap state;
-        QVariantMap config;
-
-        //state
-        state["lastupdated"] = i->state().lastupdated();
-
-        if (i->state().flag() != "")
-        {
-            state["flag"] = (i->state().flag() == "true")?true:false;
-        }
-        if (i->state().status() != "")
-        {
-            state["status"] = i->state().status().toInt();
-        }
-        if (i->state().open() != "")
-        {
-            state["open"] = (i->state().open() == "true")?true:false;
-        }
-        if (i->state().buttonevent() >= 0)
-        {
-            state["buttonevent"] = (double)i->state().buttonevent();
-        }
-        if (i->state().temperature() != "")
-        {
-            state["temperature"] = i->state().temperature().toInt();
-        }
-        if (i->state().humidity() != "")
-        {
-            state["humidity"] = i->state().humidity().toInt();
-        }
-        if (i->state().daylight() != "")
-        {
-            state["daylight"] = (i->state().daylight() == "true")?true:false;
-        }
-
-        if (i->type() == "ZHALight")
-        {
-            state["lux"] = (double)i->state().lux();
-        }
-        else if (i->type() == "ZHAPresence")
-        {
-            if (i->state().presence() != "")
-            {
-                state["presence"] = (i->state().presence() == "true")?true:false;
-            }
-
-            if (i->config().duration() >= 0)
-            {
-                config["duration"] = (double)i->config().duration();
-            }
-        }
-
-        //config
-        config["on"] = i->config().on();
-
-        if (i->type() != "ZGPSwitch")
-        {
-            config["reachable"] = i->config().reachable();
-        }
-
-        if (i->config().battery() <= 100) // valid value?
-        {
-            config["battery"] = (double)i->config().battery();
-        }
-
-        if (i->config().url() != "" )
-        {
-            config["url"] = i->config().url();
-        }
-        if (i->config().longitude() != "" )
-        {
-            config["long"] = i->config().longitude();
-        }
-        if (i->config().lat() != "" )
-        {
-            config["lat"] = i->config().lat();
-        }
-        if (i->config().sunriseoffset() != "" )
-        {
-            config["sunriseoffset"] = i->config().sunriseoffset().toInt();
-        }
-        if (i->config().sunsetoffset() != "" )
-        {
-            config["sunsetoffset"] = i->config().sunsetoffset().toInt();
-        }
-
-
-        //sensor
-        sensor["name"] = i->name();
-        sensor["type"] = i->type();
-        sensor["modelid"] = i->modelId();
-        if (i->swVersion() != "")
+        if (sensorToMap(&(*i), sensor))
         {
-            sensor["swversion"] = i->swVersion();
+            rsp.map[i->id()] = sensor;
         }
-        sensor["uniqueid"] = i->uniqueId();
-        sensor["ep"] = i->fingerPrint().endpoint;
-        sensor["manufacturername"] = i->manufacturer();
-        sensor["state"] = state;
-        sensor["config"] = config;
-
-        QString etag = i->etag;
-        etag.remove('"'); // no quotes allowed in string
-        sensor["etag"] = etag;
-
-        rsp.map[i->id()] = sensor;
     }
 
     if (rsp.map.isEmpty())
@@ -251,114 +149,7 @@ int DeRestPluginPrivate::getSensor(const ApiRequest &req, ApiResponse &rsp)
     }
 
     rsp.httpStatus = HttpStatusOk;
-
-    QVariantMap state;
-    QVariantMap config;
-
-    //state
-    state["lastupdated"] = sensor->state().lastupdated();
-
-    if (sensor->state().flag() != "")
-    {
-        state["flag"] = (sensor->state().flag() == "true")?true:false;
-    }
-    if (sensor->state().status() != "")
-    {
-        state["status"] = sensor->state().status().toInt();
-    }
-    if (sensor->state().open() != "")
-    {
-        state["open"] = (sensor->state().open() == "true")?true:false;
-    }
-    if (sensor->state().buttonevent() >= 0)
-    {
-        state["buttonevent"] = (double)sensor->state().buttonevent();
-    }
-    if (sensor->state().temperature() != "")
-    {
-        state["temperature"] = sensor->state().temperature().toInt();
-    }
-    if (sensor->state().humidity() != "")
-    {
-        state["humidity"] = sensor->state().humidity().toInt();
-    }
-    if (sensor->state().daylight() != "")
-    {
-        state["daylight"] = (sensor->state().daylight() == "true")?true:false;
-    }
-
-    if (sensor->type() == "ZHALight")
-    {
-        state["lux"] = (double)sensor->state().lux();
-    }
-    else if (sensor->type() == "ZHAPresence")
-    {
-        if (sensor->state().presence() != "")
-        {
-            state["presence"] = (sensor->state().presence() == "true")?true:false;
-        }
-
-        if (sensor->config().duration() >= 0)
-        {
-            config["duration"] = sensor->config().duration();
-        }
-    }
-
-    //config
-    config["on"] = sensor->config().on();
-
-    if (sensor->type() != "ZGPSwitch")
-    {
-        config["reachable"] = sensor->config().reachable();
-    }
-
-    if (sensor->config().battery() <= 100) // valid value?
-    {
-        config["battery"] = (double)sensor->config().battery();
-    }
-
-    if (sensor->config().url() != "" )
-    {
-        config["url"] = sensor->config().url();
-    }
-    if (sensor->config().longitude() != "" )
-    {
-        config["long"] = sensor->config().longitude();
-    }
-    if (sensor->config().lat() != "" )
-    {
-        config["lat"] = sensor->config().lat();
-    }
-    if (sensor->config().sunriseoffset() != "" )
-    {
-        config["sunriseoffset"] = sensor->config().sunriseoffset().toInt();
-    }
-    if (sensor->config().sunsetoffset() != "" )
-    {
-        config["sunsetoffset"] = sensor->config().sunsetoffset().toInt();
-    }
-
-    //sensor
-    rsp.map["name"] = sensor->name();
-    rsp.map["type"] = sensor->type();
-    rsp.map["modelid"] = sensor->modelId();
-    if (sensor->swVersion() != "")
-    {
-        rsp.map["swversion"] = sensor->swVersion();
-    }
-    if (sensor->modelId() == "Lighting Switch")
-    {
-        rsp.map["mode"] = sensor->mode();
-    }
-    rsp.map["uniqueid"] = sensor->uniqueId();
-    rsp.map["ep"] = sensor->fingerPrint().endpoint;
-    rsp.map["manufacturername"] = sensor->manufacturer();
-    rsp.map["state"] = state;
-    rsp.map["config"] = config;
-
-    QString etag = sensor->etag;
-    etag.remove('"'); // no quotes allowed in string
-    rsp.map["etag"] = etag;
+    sensorToMap(sensor, rsp.map);
 
     return REQ_READY_SEND;
 }
@@ -653,6 +444,7 @@ int DeRestPluginPrivate::createSensor(const ApiRequest &req, ApiResponse &rsp)
         updateEtag(sensor.etag);
         updateEtag(gwConfigEtag);
         sensors.push_back(sensor);
+        indexSensor(sensors.size() - 1);
         queSaveDb(DB_SENSORS, DB_SHORT_SAVE_DELAY);
 
         rspItemState["id"] = sensor.id();
@@ -880,7 +672,8 @@ int DeRestPluginPrivate::changeSensorConfig(const ApiRequest &req, ApiResponse &
     for (; pi != pend; ++pi)
     {
         if(!((pi.key() == "duration") || (pi.key() == "battery") || (pi.key() == "url") || (pi.key() == "on") || (pi.key() == "reachable") || (pi.key() == "long")
-            || (pi.key() == "lat") || (pi.key() == "sunriseoffset") || (pi.key() == "sunsetoffset")))
+            || (pi.key() == "lat") || (pi.key() == "sunriseoffset") || (pi.key() == "sunsetoffset")
+            || (pi.key() == "delta") || (pi.key() == "hysteresis") || (pi.key() == "minpublish") || (pi.key() == "maxpublish")))
         {
             rsp.list.append(errorToMap(ERR_PARAMETER_NOT_AVAILABLE, QString("/sensors/config/%2").arg(pi.key()), QString("parameter, %1, not available").arg(pi.key())));
             rsp.httpStatus = HttpStatusBadRequest;
@@ -955,6 +748,14 @@ int DeRestPluginPrivate::changeSensorConfig(const ApiRequest &req, ApiResponse &
             rsp.list.append(errorToMap(ERR_PARAMETER_NOT_AVAILABLE, QString("/sensors/%1/config").arg(id), QString("parameter, sunriseoffset, not modifiable")));
         }
     }
+    if (map.contains("delta") || map.contains("hysteresis") || map.contains("minpublish") || map.contains("maxpublish"))
+    {
+        if (!Sensor::hasSignificanceDefaults(sensor->type()))
+        {
+            error = true;
+            rsp.list.append(errorToMap(ERR_PARAMETER_NOT_AVAILABLE, QString("/sensors/%1/config").arg(id), QString("parameter, significance, not modifiable")));
+        }
+    }
     if (error)
     {
         rsp.httpStatus = HttpStatusBadRequest;
@@ -1053,12 +854,44 @@ int DeRestPluginPrivate::changeSensorConfig(const ApiRequest &req, ApiResponse &
             config.setDuration(duration);
             DBG_Printf(DBG_INFO, "Force read/write of occupaction delay for sensor %s\n", qPrintable(sensor->address().toStringExt()));
             sensor->enableRead(WRITE_OCCUPANCY_CONFIG);
-            sensor->setNextReadTime(QTime::currentTime());
+            sensor->setNextReadTime(clockMonotonicMs());
             Q_Q(DeRestPlugin);
             q->startZclAttributeTimer(0);
         }
     }
 
+    // significance of measured values, -1 restores the default of the sensor type
+    const char *significanceKeys[] = { "delta", "hysteresis", "minpublish", "maxpublish" };
+    const int significanceMax[] = { 0xFFFF, 0xFFFF, 3600, 86400 };
+
+    for (int n = 0; n < 4; n++)
+    {
+        const QString key = QLatin1String(significanceKeys[n]);
+
+        if (!map.contains(key))
+        {
+            continue;
+        }
+
+        int val = map[key].toInt(&ok);
+        if (!ok || (map[key].type() != QVariant::Double) || (val < -1) || (val > significanceMax[n]))
+        {
+            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/sensors/%1/config").arg(id), QString("invalid value, %1, for parameter %2").arg(map[key].toString()).arg(key)));
+            rsp.httpStatus = HttpStatusBadRequest;
+            return REQ_READY_SEND;
+        }
+        rspItemState[QString("/sensors/%1/config/%2").arg(id).arg(key)] = map[key];
+        rspItem["success"] = rspItemState;
+
+        switch (n)
+        {
+        case 0: config.setDelta(val); break;
+        case 1: config.setHysteresis(val); break;
+        case 2: config.setMinPublish(val); break;
+        default: config.setMaxPublish(val); break;
+        }
+    }
+
     sensor->setConfig(config);
     rsp.list.append(rspItem);
     updateEtag(sensor->etag);
@@ -1352,7 +1185,7 @@ int DeRestPluginPrivate::findNewSensors(const ApiRequest &req, ApiResponse &rsp)
         return REQ_READY_SEND;
     }
 
-    lastscan = QDateTime::currentDateTimeUtc().toString("yyyy-MM-ddTHH:mm:ss");
+    lastscan = clockTimestamp();
 
     QVariantMap rspItem;
     rspItem["success"] = QString("/sensors\": \"Searching for new devices");
@@ -1377,6 +1210,8 @@ int DeRestPluginPrivate::getNewSensors(const ApiRequest &req, ApiResponse &rsp)
 }
 
 /*! Put all sensor parameters in a map.
+    The state, config and attributes are cached per sensor and only rebuilt
+    if one of their fields has changed since the last call.
     \return true - on success
             false - on error
  */
@@ -1387,107 +1222,142 @@ bool DeRestPluginPrivate::sensorToMap(const Sensor *sensor, QVariantMap &map)
         return false;
     }
 
-    QVariantMap state;
-    QVariantMap config;
-
-    //state
-    state["lastupdated"] = sensor->state().lastupdated();
+    RestMapCache uncached;
+    RestMapCache *cache = &uncached;
+    quint32 changed = 0xFFFFFFFFUL;
 
-    if (sensor->state().flag() != "")
-    {
-        state["flag"] = (sensor->state().flag() == "true") ? true : false;
-    }
-    if (sensor->state().status() != "")
-    {
-        state["status"] = sensor->state().status().toInt();
-    }
-    if (sensor->state().open() != "")
-    {
-        state["open"] = (sensor->state().open() == "true")?true:false;
-    }
-    if (sensor->state().buttonevent() >= 0)
-    {
-        state["buttonevent"] = (double)sensor->state().buttonevent();
-    }
-    if (sensor->state().temperature() != "")
-    {
-        state["temperature"] = sensor->state().temperature().toInt();
-    }
-    if (sensor->state().humidity() != "")
+    if (sensor->handle() != 0)
     {
-        state["humidity"] = sensor->state().humidity().toInt();
-    }
-    if (sensor->state().daylight() != "")
-    {
-        state["daylight"] = (sensor->state().daylight() == "true") ? true : false;
+        cache = &sensorMapCache[sensor->handle()];
+        changed = sensor->changes.pending(ChangeConsumerRest);
+        sensor->changes.clear(ChangeConsumerRest);
     }
 
-    if (sensor->type() == "ZHALight")
-    {
-        state["lux"] = (double)sensor->state().lux();
-    }
-    else if (sensor->type() == "ZHAPresence")
+    //state
+    if (changed & Sensor::FieldsRestState)
     {
-        if (sensor->state().presence() != "")
+        QVariantMap &state = cache->state;
+        state.clear();
+        state["lastupdated"] = sensor->state().lastupdated();
+
+        if (sensor->state().flag() != "")
+        {
+            state["flag"] = (sensor->state().flag() == "true") ? true : false;
+        }
+        if (sensor->state().status() != "")
+        {
+            state["status"] = sensor->state().status().toInt();
+        }
+        if (sensor->state().open() != "")
+        {
+            state["open"] = (sensor->state().open() == "true")?true:false;
+        }
+        if (sensor->state().buttonevent() >= 0)
         {
-            state["presence"] = (sensor->state().presence() == "true") ? true : false;
+            state["buttonevent"] = (double)sensor->state().buttonevent();
+        }
+        if (sensor->state().temperature() != "")
+        {
+            state["temperature"] = sensor->state().temperature().toInt();
+        }
+        if (sensor->state().humidity() != "")
+        {
+            state["humidity"] = sensor->state().humidity().toInt();
+        }
+        if (sensor->state().daylight() != "")
+        {
+            state["daylight"] = (sensor->state().daylight() == "true") ? true : false;
         }
 
-        if (sensor->config().duration() >= 0)
+        if (sensor->type() == "ZHALight")
         {
-            config["duration"] = sensor->config().duration();
+            state["lux"] = (double)sensor->state().lux();
+        }
+        else if (sensor->type() == "ZHAPresence")
+        {
+            if (sensor->state().presence() != "")
+            {
+                state["presence"] = (sensor->state().presence() == "true") ? true : false;
+            }
         }
     }
 
     //config
-    config["on"] = sensor->config().on();
-
-    if (sensor->type() != "ZGPSwitch")
+    if (changed & Sensor::FieldsRestConfig)
     {
-        config["reachable"] = sensor->config().reachable();
-    }
+        QVariantMap &config = cache->config;
+        config.clear();
 
-    if (sensor->config().battery() <= 100)
-    {
-        config["battery"] = (double)sensor->config().battery();
-    }
-    if (sensor->config().url() != "" )
-    {
-        config["url"] = sensor->config().url();
-    }
-    if (sensor->config().longitude() != "" )
-    {
-        config["long"] = sensor->config().longitude();
-    }
-    if (sensor->config().lat() != "" )
-    {
-        config["lat"] = sensor->config().lat();
-    }
-    if (sensor->config().sunriseoffset() != "" )
-    {
-        config["sunriseoffset"] = sensor->config().sunriseoffset().toInt();
-    }
-    if (sensor->config().sunsetoffset() != "" )
-    {
-        config["sunsetoffset"] = sensor->config().sunsetoffset().toInt();
+        if (sensor->type() == "ZHAPresence" && sensor->config().duration() >= 0)
+        {
+            config["duration"] = (double)sensor->config().duration();
+        }
+
+        config["on"] = sensor->config().on();
+
+        if (sensor->type() != "ZGPSwitch")
+        {
+            config["reachable"] = sensor->config().reachable();
+        }
+
+        if (sensor->config().battery() <= 100) // valid value?
+        {
+            config["battery"] = (double)sensor->config().battery();
+        }
+        if (sensor->config().url() != "" )
+        {
+            config["url"] = sensor->config().url();
+        }
+        if (sensor->config().longitude() != "" )
+        {
+            config["long"] = sensor->config().longitude();
+        }
+        if (sensor->config().lat() != "" )
+        {
+            config["lat"] = sensor->config().lat();
+        }
+        if (sensor->config().sunriseoffset() != "" )
+        {
+            config["sunriseoffset"] = sensor->config().sunriseoffset().toInt();
+        }
+        if (sensor->config().sunsetoffset() != "" )
+        {
+            config["sunsetoffset"] = sensor->config().sunsetoffset().toInt();
+        }
+        if (Sensor::hasSignificanceDefaults(sensor->type()))
+        {
+            const ValueSignificance sig = sensor->significance();
+            config["delta"] = (double)sig.delta;
+            config["hysteresis"] = (double)sig.hysteresis;
+            config["minpublish"] = (double)sig.minInterval;
+            config["maxpublish"] = (double)sig.maxInterval;
+        }
     }
 
     //sensor
-    map["name"] = sensor->name();
-    map["type"] = sensor->type();
-    map["modelid"] = sensor->modelId();
-    if (sensor->swVersion() != "")
-    {
-        map["swversion"] = sensor->swVersion();
-    }
-    if (sensor->modelId() == "Lighting Switch")
+    if (changed & Sensor::FieldsRestAttr)
     {
-        map["mode"] = sensor->mode();
+        QVariantMap &attr = cache->attr;
+        attr.clear();
+        attr["name"] = sensor->name();
+        attr["type"] = sensor->type();
+        attr["modelid"] = sensor->modelId();
+        if (sensor->swVersion() != "")
+        {
+            attr["swversion"] = sensor->swVersion();
+        }
+        if (sensor->modelId() == "Lighting Switch")
+        {
+            attr["mode"] = sensor->mode();
+        }
+        attr["uniqueid"] = sensor->uniqueId();
+        attr["ep"] = sensor->fingerPrint().endpoint;
+        attr["manufacturername"] = sensor->manufacturer();
     }
-    map["uniqueid"] = sensor->uniqueId();
-    map["manufacturername"] = sensor->manufacturer();
-    map["state"] = state;
-    map["config"] = config;
+
+    map = cache->attr;
+    map["state"] = cache->state;
+    map["config"] = cache->config;
 
     QString etag = sensor->etag;
     etag.remove('"'); // no quotes allowed in string
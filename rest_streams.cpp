@@ -0,0 +1,767 @@
+/*
+ * Copyright (c) 2016 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <QFile>
+#include <QString>
+#include <QUdpSocket>
+#include <QVariantMap>
+#include "de_web_plugin.h"
+#include "de_web_plugin_private.h"
+#include "json.h"
+
+// transition time of streamed commands in 1/10 seconds
+#define STREAM_TRANSITION_TIME 1
+
+/*! Returns a token for a new stream.
+    The token authenticates the UDP frames, it is taken from the system
+    random source; qrand() is only used where /dev/urandom isn't available.
+ */
+static quint32 streamRandomToken()
+{
+    quint32 token = 0;
+    QFile f("/dev/urandom");
+
+    if (f.open(QIODevice::ReadOnly) &&
+        f.read(reinterpret_cast<char*>(&token), sizeof(token)) == sizeof(token))
+    {
+        return token;
+    }
+
+    return (quint32)qrand() ^ ((quint32)qrand() << 16);
+}
+
+/*! Inits the real-time light streaming.
+
+    A stream is created for a group and maps the lights of the group to
+    channels. Clients send frames with the brightness and color of the
+    channels to the stream UDP port (little-endian):
+
+    1    u8   version (STREAM_VERSION)
+    1    u8   stream id
+    4    u32  token of the stream
+    2    u16  sequence number
+    6*n       channel records
+         u8   channel index
+         u8   brightness
+         u16  x (0 .. 65279)
+         u16  y (0 .. 65279)
+
+    Only the latest values of a channel are kept. Every STREAM_TICK the
+    changed values are sent without APS acknowledgement; if all channels
+    have the same values a single groupcast is sent, otherwise up to
+    STREAM_MAX_SENDS unicast commands in round robin order.
+
+    The stream port only listens on the loopback interface unless the
+    gateway is started with --stream-public=1.
+ */
+void DeRestPluginPrivate::initStreams()
+{
+    streamSock = 0;
+    streamTimer = new QTimer(this);
+    streamTimer->setSingleShot(true);
+    connect(streamTimer, SIGNAL(timeout()),
+            this, SLOT(streamTimerFired()));
+}
+
+/*! Streams REST API broker.
+    \param req - request data
+    \param rsp - response data
+    \return REQ_READY_SEND
+            REQ_NOT_HANDLED
+ */
+int DeRestPluginPrivate::handleStreamsApi(ApiRequest &req, ApiResponse &rsp)
+{
+    if (req.path[2] != "streams")
+    {
+        return REQ_NOT_HANDLED;
+    }
+
+    if (!checkApikeyAuthentification(req, rsp))
+    {
+        return REQ_READY_SEND;
+    }
+
+    // GET /api/<apikey>/streams
+    if ((req.path.size() == 3) && (req.hdr.method() == "GET"))
+    {
+        return getAllStreams(req, rsp);
+    }
+    // POST /api/<apikey>/streams
+    else if ((req.path.size() == 3) && (req.hdr.method() == "POST"))
+    {
+        return createStream(req, rsp);
+    }
+    // GET /api/<apikey>/streams/<id>
+    else if ((req.path.size() == 4) && (req.hdr.method() == "GET"))
+    {
+        return getStream(req, rsp);
+    }
+    // DELETE /api/<apikey>/streams/<id>
+    else if ((req.path.size() == 4) && (req.hdr.method() == "DELETE"))
+    {
+        return deleteStream(req, rsp);
+    }
+
+    return REQ_NOT_HANDLED;
+}
+
+/*! POST /api/<apikey>/streams
+    \return REQ_READY_SEND
+            REQ_NOT_HANDLED
+ */
+int DeRestPluginPrivate::createStream(const ApiRequest &req, ApiResponse &rsp)
+{
+    bool ok;
+    QVariant var = Json::parse(req.content, ok);
+    QVariantMap map = var.toMap();
+
+    rsp.httpStatus = HttpStatusOk;
+
+    userActivity();
+
+    if (!ok || map.isEmpty())
+    {
+        rsp.list.append(errorToMap(ERR_INVALID_JSON, QString("/streams"), QString("body contains invalid JSON")));
+        rsp.httpStatus = HttpStatusBadRequest;
+        return REQ_READY_SEND;
+    }
+
+    if (!map.contains("group") || map["group"].type() != QVariant::String)
+    {
+        rsp.list.append(errorToMap(ERR_MISSING_PARAMETER, QString("/streams"), QString("invalid/missing parameters in body")));
+        rsp.httpStatus = HttpStatusBadRequest;
+        return REQ_READY_SEND;
+    }
+
+    const QString gid = map["group"].toString();
+    Group *group = getGroupForId(gid);
+
+    if (!group || group->state() != Group::StateNormal)
+    {
+        rsp.list.append(errorToMap(ERR_RESOURCE_NOT_AVAILABLE, QString("/groups/%1").arg(gid), QString("resource, /groups/%1, not available").arg(gid)));
+        rsp.httpStatus = HttpStatusNotFound;
+        return REQ_READY_SEND;
+    }
+
+    if (streams.size() >= STREAM_MAX_STREAMS)
+    {
+        rsp.list.append(errorToMap(ERR_TOO_MANY_ITEMS, QString("/streams"), QString("maximum number of streams reached")));
+        rsp.httpStatus = HttpStatusForbidden;
+        return REQ_READY_SEND;
+    }
+
+    LightStream stream;
+    stream.groupAddress = group->address();
+    stream.groupId = group->id();
+
+    {
+        std::vector<LightNode>::iterator i = nodes.begin();
+        std::vector<LightNode>::iterator end = nodes.end();
+
+        for (; i != end && stream.channels.size() < STREAM_MAX_CHANNELS; ++i)
+        {
+            if (!i->isAvailable() || !isLightNodeInGroup(&*i, stream.groupAddress))
+            {
+                continue;
+            }
+
+            StreamChannel channel;
+            channel.lightId = i->id();
+            channel.extAddr = i->address().ext();
+            channel.nwkAddr = i->address().nwk();
+            channel.endpoint = i->haEndpoint().endpoint();
+            channel.hasColor = i->hasColor();
+            stream.channels.push_back(channel);
+        }
+    }
+
+    if (stream.channels.empty())
+    {
+        rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/streams/group"), QString("group %1 has no available lights").arg(gid)));
+        rsp.httpStatus = HttpStatusBadRequest;
+        return REQ_READY_SEND;
+    }
+
+    if (!streamSock)
+    {
+        const quint16 port = deCONZ::appArgumentNumeric("--stream-port", STREAM_UDP_PORT);
+        const bool isPublic = deCONZ::appArgumentNumeric("--stream-public", 0) == 1;
+        streamSock = new QUdpSocket(this);
+
+        if (!streamSock->bind(isPublic ? QHostAddress(QHostAddress::Any) : QHostAddress(QHostAddress::LocalHost), port))
+        {
+            DBG_Printf(DBG_ERROR, "stream UDP port %u error %s\n", port, qPrintable(streamSock->errorString()));
+            delete streamSock;
+            streamSock = 0;
+            rsp.list.append(errorToMap(ERR_INTERNAL_ERROR, QString("/streams"), QString("stream port not available")));
+            rsp.httpStatus = HttpStatusServiceUnavailable;
+            return REQ_READY_SEND;
+        }
+
+        connect(streamSock, SIGNAL(readyRead()),
+                this, SLOT(streamReadyRead()));
+    }
+
+    // lowest free id
+    for (stream.id = 1; getStreamForId(QString::number(stream.id)); stream.id++)
+    { }
+
+    stream.token = streamRandomToken();
+    stream.windowStart = clockMonotonicMs();
+    streams.push_back(stream);
+
+    DBG_Printf(DBG_INFO, "stream %u created for group %s with %u channels\n",
+               stream.id, qPrintable(stream.groupId), (uint)stream.channels.size());
+
+    QVariantList channels;
+    for (size_t i = 0; i < stream.channels.size(); i++)
+    {
+        channels.append(stream.channels[i].lightId);
+    }
+
+    QVariantMap rspItem;
+    QVariantMap rspItemState;
+    rspItemState["id"] = QString::number(stream.id);
+    rspItemState["token"] = (double)stream.token;
+    rspItemState["port"] = (double)streamSock->localPort();
+    rspItemState["channels"] = channels;
+    rspItem["success"] = rspItemState;
+    rsp.list.append(rspItem);
+
+    return REQ_READY_SEND;
+}
+
+/*! GET /api/<apikey>/streams
+    \return REQ_READY_SEND
+            REQ_NOT_HANDLED
+ */
+int DeRestPluginPrivate::getAllStreams(const ApiRequest &req, ApiResponse &rsp)
+{
+    Q_UNUSED(req);
+
+    std::vector<LightStream>::const_iterator i = streams.begin();
+    std::vector<LightStream>::const_iterator end = streams.end();
+
+    for (; i != end; ++i)
+    {
+        rsp.map[QString::number(i->id)] = streamToMap(*i);
+    }
+
+    if (rsp.map.isEmpty())
+    {
+        rsp.str = "{}"; // return empty object
+    }
+
+    rsp.httpStatus = HttpStatusOk;
+    return REQ_READY_SEND;
+}
+
+/*! GET /api/<apikey>/streams/<id>
+    \return REQ_READY_SEND
+            REQ_NOT_HANDLED
+ */
+int DeRestPluginPrivate::getStream(const ApiRequest &req, ApiResponse &rsp)
+{
+    const QString &id = req.path[3];
+    LightStream *stream = getStreamForId(id);
+
+    if (!stream)
+    {
+        rsp.list.append(errorToMap(ERR_RESOURCE_NOT_AVAILABLE, QString("/streams/%1").arg(id), QString("resource, /streams/%1, not available").arg(id)));
+        rsp.httpStatus = HttpStatusNotFound;
+        return REQ_READY_SEND;
+    }
+
+    rsp.map = streamToMap(*stream);
+    rsp.httpStatus = HttpStatusOk;
+    return REQ_READY_SEND;
+}
+
+/*! DELETE /api/<apikey>/streams/<id>
+    \return REQ_READY_SEND
+            REQ_NOT_HANDLED
+ */
+int DeRestPluginPrivate::deleteStream(const ApiRequest &req, ApiResponse &rsp)
+{
+    const QString &id = req.path[3];
+    std::vector<LightStream>::iterator i = streams.begin();
+    std::vector<LightStream>::iterator end = streams.end();
+
+    userActivity();
+
+    for (; i != end; ++i)
+    {
+        if (QString::number(i->id) == id)
+        {
+            break;
+        }
+    }
+
+    if (i == end)
+    {
+        rsp.list.append(errorToMap(ERR_RESOURCE_NOT_AVAILABLE, QString("/streams/%1").arg(id), QString("resource, /streams/%1, not available").arg(id)));
+        rsp.httpStatus = HttpStatusNotFound;
+        return REQ_READY_SEND;
+    }
+
+    DBG_Printf(DBG_INFO, "stream %u deleted\n", i->id);
+    streams.erase(i);
+
+    if (streams.empty() && streamSock)
+    {
+        streamSock->close();
+        streamSock->deleteLater();
+        streamSock = 0;
+    }
+
+    QVariantMap rspItem;
+    QVariantMap rspItemState;
+    rspItemState["id"] = id;
+    rspItem["success"] = rspItemState;
+    rsp.list.append(rspItem);
+    rsp.httpStatus = HttpStatusOk;
+
+    return REQ_READY_SEND;
+}
+
+/*! Returns the REST representation of a stream.
+ */
+QVariantMap DeRestPluginPrivate::streamToMap(const LightStream &stream)
+{
+    QVariantMap map;
+    QVariantList channels;
+
+    for (size_t i = 0; i < stream.channels.size(); i++)
+    {
+        channels.append(stream.channels[i].lightId);
+    }
+
+    const qint64 now = clockMonotonicMs();
+    const bool active = stream.lastRx >= 0 && (now - stream.lastRx) < STREAM_IDLE_TIMEOUT;
+
+    map["group"] = stream.groupId;
+    map["channels"] = channels;
+    map["active"] = active;
+    map["fps"] = active ? stream.frameRate : 0.0;
+    map["sendrate"] = active ? stream.sendRate : 0.0;
+    map["frames"] = (double)stream.frames;
+    map["dropped"] = (double)stream.dropped;
+    map["coalesced"] = (double)stream.coalesced;
+    map["groupcasts"] = (double)stream.groupcasts;
+    map["unicasts"] = (double)stream.unicasts;
+
+    return map;
+}
+
+/*! Returns the stream for a given \p id or 0 if not found.
+ */
+LightStream *DeRestPluginPrivate::getStreamForId(const QString &id)
+{
+    std::vector<LightStream>::iterator i = streams.begin();
+    std::vector<LightStream>::iterator end = streams.end();
+
+    for (; i != end; ++i)
+    {
+        if (QString::number(i->id) == id)
+        {
+            return &*i;
+        }
+    }
+
+    return 0;
+}
+
+/*! Reads the pending datagrams of the stream port.
+ */
+void DeRestPluginPrivate::streamReadyRead()
+{
+    while (streamSock && streamSock->hasPendingDatagrams())
+    {
+        QByteArray datagram;
+        datagram.resize(streamSock->pendingDatagramSize());
+        streamSock->readDatagram(datagram.data(), datagram.size());
+        streamFrame(datagram);
+    }
+}
+
+/*! Takes over the channel values of a received stream frame.
+    Values which weren't sent yet are overwritten, latest wins.
+ */
+void DeRestPluginPrivate::streamFrame(const QByteArray &datagram)
+{
+    FrameReader reader(datagram);
+
+    const quint8 version = reader.readU8();
+    const quint8 id = reader.readU8();
+    const quint32 token = reader.readU32();
+    const quint16 seq = reader.readU16();
+
+    if (!reader.isOk() || version != STREAM_VERSION)
+    {
+        return;
+    }
+
+    std::vector<LightStream>::iterator stream = streams.begin();
+    std::vector<LightStream>::iterator end = streams.end();
+
+    for (; stream != end; ++stream)
+    {
+        if (stream->id == id)
+        {
+            break;
+        }
+    }
+
+    if (stream == end || stream->token != token)
+    {
+        return;
+    }
+
+    if (stream->hasSeq && (qint16)(seq - stream->lastSeq) <= 0)
+    {
+        stream->dropped++; // duplicate or reordered
+        return;
+    }
+
+    while (reader.remaining() >= 6)
+    {
+        const quint8 index = reader.readU8();
+        const quint8 bri = reader.readU8();
+        const quint16 x = reader.readU16();
+        const quint16 y = reader.readU16();
+
+        if (index >= stream->channels.size())
+        {
+            continue;
+        }
+
+        StreamChannel &channel = stream->channels[index];
+
+        if (channel.dirty)
+        {
+            stream->coalesced++;
+        }
+
+        channel.bri = bri;
+        channel.x = x;
+        channel.y = y;
+        channel.dirty = 0;
+
+        if (!channel.hasSent || channel.sentBri != bri)
+        {
+            channel.dirty |= StreamChannel::DirtyLevel;
+        }
+
+        if (channel.hasColor && (!channel.hasSent || channel.sentX != x || channel.sentY != y))
+        {
+            channel.dirty |= StreamChannel::DirtyColor;
+        }
+    }
+
+    stream->hasSeq = true;
+    stream->lastSeq = seq;
+    stream->lastRx = clockMonotonicMs();
+    stream->frames++;
+    stream->windowFrames++;
+
+    if (!streamTimer->isActive())
+    {
+        streamTimer->start(STREAM_TICK);
+    }
+}
+
+/*! Sends the changed values of a channel as Move to level and Move to color commands.
+    \param addr the light or the group
+    \param dirty bitmap of StreamChannel::Dirty values to send
+    \return bitmap of StreamChannel::Dirty values which were sent
+ */
+quint8 DeRestPluginPrivate::streamSend(LightStream &stream, const deCONZ::Address &addr, deCONZ::ApsAddressMode mode, quint8 dstEndpoint, quint8 dirty, const StreamChannel &values)
+{
+    quint8 sent = 0;
+
+    if (!apsCtrl)
+    {
+        return sent;
+    }
+
+    const quint8 parts[] = { StreamChannel::DirtyLevel, StreamChannel::DirtyColor };
+
+    for (size_t p = 0; p < sizeof(parts); p++)
+    {
+        if (!(dirty & parts[p]))
+        {
+            continue;
+        }
+
+        deCONZ::ApsDataRequest req;
+        deCONZ::ZclFrame zclFrame;
+
+        req.setDstAddressMode(mode);
+        req.dstAddress() = addr;
+        req.setDstEndpoint(dstEndpoint);
+        req.setSrcEndpoint(endpoint());
+        req.setProfileId(HA_PROFILE_ID);
+        req.setTxOptions(0); // no APS retries, the next frame supersedes the values
+        req.setRadius(0);
+
+        zclFrame.setSequenceNumber(zclSeq++);
+        zclFrame.setFrameControl(deCONZ::ZclFCClusterCommand |
+                                 deCONZ::ZclFCDirectionClientToServer |
+                                 deCONZ::ZclFCDisableDefaultResponse);
+
+        { // payload
+            QDataStream payloadStream(&zclFrame.payload(), QIODevice::WriteOnly);
+            payloadStream.setByteOrder(QDataStream::LittleEndian);
+
+            if (parts[p] == StreamChannel::DirtyLevel)
+            {
+                req.setClusterId(LEVEL_CLUSTER_ID);
+                zclFrame.setCommandId(0x00); // Move to level
+                payloadStream << values.bri;
+            }
+            else
+            {
+                req.setClusterId(COLOR_CLUSTER_ID);
+                zclFrame.setCommandId(0x07); // Move to color
+                payloadStream << values.x;
+                payloadStream << values.y;
+            }
+
+            payloadStream << (quint16)STREAM_TRANSITION_TIME;
+        }
+
+        { // ZCL frame
+            QDataStream asduStream(&req.asdu(), QIODevice::WriteOnly);
+            asduStream.setByteOrder(QDataStream::LittleEndian);
+            zclFrame.writeToStream(asduStream);
+        }
+
+        if (apsCtrl->apsdeDataRequest(req) != deCONZ::Success)
+        {
+            break; // queue full, retry on next tick
+        }
+
+        if (mode == deCONZ::ApsGroupAddress)
+        {
+            airtimeAccountBroadcast(req.asdu().size());
+            stream.groupcasts++;
+        }
+        else
+        {
+            airtimeAccount(addr, req.asdu().size());
+            stream.unicasts++;
+        }
+
+        stream.windowSends++;
+        sent |= parts[p];
+    }
+
+    return sent;
+}
+
+/*! Marks the \p sent parts of a channel as sent with \p values.
+ */
+static void streamMarkSent(StreamChannel &channel, quint8 sent, const StreamChannel &values)
+{
+    if (sent & StreamChannel::DirtyLevel)
+    {
+        channel.sentBri = values.bri;
+    }
+
+    if (sent & StreamChannel::DirtyColor)
+    {
+        channel.sentX = values.x;
+        channel.sentY = values.y;
+    }
+
+    channel.dirty &= ~sent;
+    channel.hasSent = true;
+}
+
+/*! Takes the \p sent values of \p channel over into the state of its light.
+ */
+void DeRestPluginPrivate::streamUpdateLight(const StreamChannel &channel, quint8 sent, const StreamChannel &values)
+{
+    LightNode *lightNode = getLightNodeForId(channel.lightId);
+
+    if (!lightNode || !sent)
+    {
+        return;
+    }
+
+    bool changed = false;
+
+    if ((sent & StreamChannel::DirtyLevel) && lightNode->level() != values.bri)
+    {
+        lightNode->setLevel(values.bri);
+        setAttributeLevel(lightNode);
+        changed = true;
+    }
+
+    if ((sent & StreamChannel::DirtyColor) &&
+        (lightNode->colorX() != values.x || lightNode->colorY() != values.y || lightNode->colorMode() != QLatin1String("xy")))
+    {
+        lightNode->setColorXY(values.x, values.y);
+        lightNode->setColorMode("xy");
+        setAttributeColorXy(lightNode);
+        changed = true;
+    }
+
+    if (changed)
+    {
+        updateEtag(lightNode->etag);
+    }
+}
+
+/*! Sends the changed channel values of a stream.
+    \param now clockMonotonicMs()
+ */
+void DeRestPluginPrivate::streamProcess(LightStream &stream, qint64 now)
+{
+    if ((now - stream.windowStart) >= STREAM_STATS_WINDOW)
+    {
+        const double secs = (now - stream.windowStart) / 1000.0;
+        stream.frameRate = stream.windowFrames / secs;
+        stream.sendRate = stream.windowSends / secs;
+        stream.windowFrames = 0;
+        stream.windowSends = 0;
+        stream.windowStart = now;
+    }
+
+    const StreamChannel *first = 0;
+    quint8 dirty = 0;
+    size_t dirtyCount = 0;
+    bool equal = true;
+
+    std::vector<StreamChannel>::iterator i = stream.channels.begin();
+    std::vector<StreamChannel>::iterator end = stream.channels.end();
+
+    for (; i != end; ++i)
+    {
+        if (!i->dirty)
+        {
+            continue;
+        }
+
+        dirty |= i->dirty;
+        dirtyCount++;
+
+        if (!first)
+        {
+            first = &*i;
+        }
+        else if (qAbs(i->bri - first->bri) > STREAM_EQUAL_BRI ||
+                 (i->hasColor && (qAbs(i->x - first->x) > STREAM_EQUAL_XY || qAbs(i->y - first->y) > STREAM_EQUAL_XY)))
+        {
+            equal = false;
+        }
+    }
+
+    if (dirtyCount == 0)
+    {
+        return;
+    }
+
+    // all lights change to the same values, one groupcast replaces the unicasts
+    if (equal && dirtyCount > 1 && dirtyCount == stream.channels.size())
+    {
+        Group *group = getGroupForId(stream.groupAddress);
+
+        if (group && (now - group->sendTime) <= gwGroupSendDelay)
+        {
+            return; // wait, the values might still change
+        }
+
+        deCONZ::Address addr;
+        addr.setGroup(stream.groupAddress);
+        const StreamChannel values = *first;
+        const quint8 sent = streamSend(stream, addr, deCONZ::ApsGroupAddress, 0xFF, dirty, values);
+
+        if (sent && group)
+        {
+            group->sendTime = now;
+        }
+
+        for (i = stream.channels.begin(); sent && i != end; ++i)
+        {
+            streamMarkSent(*i, sent, values);
+            streamUpdateLight(*i, sent, values);
+        }
+
+        return;
+    }
+
+    quint8 sends = 0;
+
+    for (size_t n = 0; n < stream.channels.size() && sends < STREAM_MAX_SENDS; n++)
+    {
+        if (stream.nextChannel >= stream.channels.size())
+        {
+            stream.nextChannel = 0;
+        }
+
+        StreamChannel &channel = stream.channels[stream.nextChannel];
+
+        if (!channel.dirty)
+        {
+            stream.nextChannel++;
+            continue;
+        }
+
+        deCONZ::Address addr;
+        addr.setExt(channel.extAddr);
+        addr.setNwk(channel.nwkAddr);
+
+        const quint8 sent = streamSend(stream, addr, deCONZ::ApsNwkAddress, channel.endpoint, channel.dirty, channel);
+
+        if (!sent)
+        {
+            break;
+        }
+
+        sends += (sent & StreamChannel::DirtyLevel) ? 1 : 0;
+        sends += (sent & StreamChannel::DirtyColor) ? 1 : 0;
+
+        streamMarkSent(channel, sent, channel);
+        streamUpdateLight(channel, sent, channel);
+
+        if (!channel.dirty)
+        {
+            stream.nextChannel++;
+        }
+    }
+}
+
+/*! Sends the pending values of all active streams, runs every STREAM_TICK.
+ */
+void DeRestPluginPrivate::streamTimerFired()
+{
+    const qint64 now = clockMonotonicMs();
+    bool active = false;
+
+    std::vector<LightStream>::iterator i = streams.begin();
+    std::vector<LightStream>::iterator end = streams.end();
+
+    for (; i != end; ++i)
+    {
+        if (i->lastRx < 0 || (now - i->lastRx) >= STREAM_IDLE_TIMEOUT)
+        {
+            continue;
+        }
+
+        streamProcess(*i, now);
+        active = true;
+    }
+
+    if (active)
+    {
+        streamTimer->start(STREAM_TICK);
+    }
+}
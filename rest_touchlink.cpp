@@ -724,54 +724,19 @@ void DeRestPluginPrivate::interpanDataIndication(const QByteArray &data)
         return;
     }
 
-    QDataStream stream(data);
-    stream.setByteOrder(QDataStream::LittleEndian);
-
-    uint16_t srcPanId;
-    quint64 srcAddress;
-    uint16_t dstPanId;
-    uint8_t  dstAddressMode;
-    quint64 dstExtAddress; // if dstAddressMode is 0x3
-    uint16_t dstNwkAddress; // if dstAddressMode is 0x2 or 0x01
-    uint16_t profileId;
-    uint16_t clusterId;
-    uint8_t asduLength;
-    //uint8_t asdu[asduLength];
-    uint8_t lqi;
-    int8_t rssi;
-
-    stream >> srcPanId;
-    stream >> srcAddress;
-    stream >> dstPanId;
-    stream >> dstAddressMode;
-
-    if (dstAddressMode == 0x03)
-    {
-        stream >> dstExtAddress;
-    }
-    else
-    {
-        stream >> dstNwkAddress;
-    }
+    FrameReader reader(data);
+    InterpanFrame frame;
 
-    stream >> profileId;
-    stream >> clusterId;
-    stream >> asduLength;
-
-    QByteArray asdu;
-
-    for (uint i = 0; i < asduLength; i++)
+    if (!decodeInterpanFrame(reader, frame))
     {
-        uint8_t byte;
-        stream >> byte;
-        asdu.append(byte);
+        DBG_Printf(DBG_TLINK, "invalid interpan frame\n");
+        return;
     }
 
-    stream >> lqi;
-    stream >> rssi;
+    const QByteArray &asdu = frame.asdu;
 
     // check if ZLL specific
-    if ((profileId == ZLL_PROFILE_ID) && (clusterId == 0x1000) && (asdu.size() >= 3))
+    if ((frame.profileId == ZLL_PROFILE_ID) && (frame.clusterId == 0x1000) && (asdu.size() >= 3))
     {
 //        uint8_t frameControl = asdu[0];
 //        uint8_t seq = asdu[1];
@@ -779,17 +744,17 @@ void DeRestPluginPrivate::interpanDataIndication(const QByteArray &data)
 
         ScanResponse scanResponse;
 
-        if (cmd == TL_CMD_SCAN_RSP)
+        if (cmd == TL_CMD_SCAN_RSP && asdu.size() >= 10)
         {
             scanResponse.id = QString::number(touchlinkScanResponses.size() + 1);
-            scanResponse.address.setExt(srcAddress);
+            scanResponse.address.setExt(frame.srcAddress);
             scanResponse.factoryNew = ((asdu[9] & FACTORY_NEW_FLAG) != 0);
             scanResponse.channel = touchlinkChannel;
-            scanResponse.panid = srcPanId;
+            scanResponse.panid = frame.srcPanId;
             scanResponse.transactionId = touchlinkReq.transactionId();
-            scanResponse.rssi = rssi;
+            scanResponse.rssi = frame.rssi;
 
-            DBG_Printf(DBG_TLINK, "scan response %s, fn=%u, channel=%u rssi=%d\n", qPrintable(scanResponse.address.toStringExt()), scanResponse.factoryNew, touchlinkChannel, rssi);
+            DBG_Printf(DBG_TLINK, "scan response %s, fn=%u, channel=%u rssi=%d\n", qPrintable(scanResponse.address.toStringExt()), scanResponse.factoryNew, touchlinkChannel, frame.rssi);
 
             if (touchlinkAction == TouchlinkScan)
             {
@@ -801,7 +766,7 @@ void DeRestPluginPrivate::interpanDataIndication(const QByteArray &data)
                     // check if already known
                     for (; i != end; ++i)
                     {
-                        if (i->address.ext() == srcAddress)
+                        if (i->address.ext() == frame.srcAddress)
                         {
                             // update transaction id
                             i->transactionId = touchlinkReq.transactionId();
@@ -0,0 +1,761 @@
+/*
+ * Copyright (c) 2016 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <QString>
+#include <QTimer>
+#include <QVariantMap>
+#include "de_web_plugin.h"
+#include "de_web_plugin_private.h"
+#include "json.h"
+
+/*! Returns the id of a created resource from a Hue style success response,
+    e.g. [{"success":{"id":"5"}}].
+ */
+static QString createdIdFromResult(const QVariant &result)
+{
+    QVariantList ls = result.toList();
+    QVariantList::const_iterator i = ls.begin();
+    QVariantList::const_iterator end = ls.end();
+
+    for (; i != end; ++i)
+    {
+        QVariantMap success = i->toMap()["success"].toMap();
+        if (success.contains("id"))
+        {
+            return success["id"].toString();
+        }
+    }
+
+    QVariantMap map = result.toMap();
+    if (map.contains("id"))
+    {
+        return map["id"].toString();
+    }
+
+    return QString();
+}
+
+/*! Returns true if a response of a single operation contains an error.
+ */
+static bool resultHasError(const ApiResponse &rsp)
+{
+    if (rsp.httpStatus != HttpStatusOk)
+    {
+        return true;
+    }
+
+    QVariantList::const_iterator i = rsp.list.begin();
+    QVariantList::const_iterator end = rsp.list.end();
+
+    for (; i != end; ++i)
+    {
+        if (i->toMap().contains("error"))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*! Checks a single transaction operation against the current model.
+    References like "$0" to resources created by earlier operations are accepted.
+    \param ops - all operations of the transaction
+    \param index - index of the operation to check
+    \param apikey - apikey of the transaction request
+    \param path - the resolved path /api/<apikey>/...
+    \param rsp - error response
+    \return true if the operation is valid
+ */
+bool DeRestPluginPrivate::validateTransactionOperation(const QVariantList &ops, int index, const QString &apikey, QStringList &path, ApiResponse &rsp)
+{
+    const QString resource = QString("/transaction/%1").arg(index);
+    QVariantMap op = ops[index].toMap();
+
+    if (!op.contains("method") || !op.contains("address"))
+    {
+        rsp.list.append(errorToMap(ERR_MISSING_PARAMETER, resource, QString("invalid operation, method and address are required")));
+        return false;
+    }
+
+    const QString method = op["method"].toString();
+
+    if (method != "PUT" && method != "POST" && method != "DELETE")
+    {
+        rsp.list.append(errorToMap(ERR_INVALID_VALUE, resource + "/method", QString("invalid value, %1, for parameter, method").arg(method)));
+        return false;
+    }
+
+    if (op.contains("body") && (op["body"].type() != QVariant::Map))
+    {
+        rsp.list.append(errorToMap(ERR_INVALID_VALUE, resource + "/body", QString("invalid value for parameter, body")));
+        return false;
+    }
+
+    path = op["address"].toString().split('/', QString::SkipEmptyParts);
+
+    // addresses may be given as /api/<apikey>/lights/.. or short as /lights/..
+    if (path.size() > 1 && path[0] == "api")
+    {
+        if (path[1] != apikey)
+        {
+            rsp.list.append(errorToMap(ERR_UNAUTHORIZED_USER, resource + "/address", QString("unauthorized user")));
+            return false;
+        }
+    }
+    else
+    {
+        path.prepend(apikey);
+        path.prepend(QLatin1String("api"));
+    }
+
+    if (path.size() < 3 ||
+        (path[2] != "lights" && path[2] != "groups" && path[2] != "schedules" &&
+         path[2] != "sensors" && path[2] != "rules"))
+    {
+        rsp.list.append(errorToMap(ERR_INVALID_VALUE, resource + "/address", QString("invalid value, %1, for parameter, address").arg(op["address"].toString())));
+        return false;
+    }
+
+    // references to resources created by earlier operations
+    for (int j = 3; j < path.size(); j++)
+    {
+        if (!path[j].startsWith('$'))
+        {
+            continue;
+        }
+
+        bool ok;
+        int ref = path[j].mid(1).toInt(&ok);
+
+        if (!ok || ref < 0 || ref >= index || ops[ref].toMap()["method"].toString() != "POST")
+        {
+            rsp.list.append(errorToMap(ERR_INVALID_VALUE, resource + "/address", QString("invalid reference, %1, in address").arg(path[j])));
+            return false;
+        }
+    }
+
+    if (path.size() < 4 || path[3].startsWith('$'))
+    {
+        return true;
+    }
+
+    // referenced resource must exist
+    const QString &id = path[3];
+    bool found = false;
+
+    if (path[2] == "lights")
+    {
+        LightNode *lightNode = getLightNodeForId(id);
+        found = lightNode && lightNode->state() != LightNode::StateDeleted;
+    }
+    else if (path[2] == "groups")
+    {
+        Group *group = getGroupForId(id);
+        found = group && group->state() == Group::StateNormal;
+    }
+    else if (path[2] == "sensors")
+    {
+        Sensor *sensor = getSensorNodeForId(id);
+        found = sensor && sensor->deletedState() != Sensor::StateDeleted;
+    }
+    else if (path[2] == "rules")
+    {
+        Rule *rule = getRuleForId(id);
+        found = rule && rule->state() != Rule::StateDeleted;
+    }
+    else if (path[2] == "schedules")
+    {
+        std::vector<Schedule>::const_iterator i = schedules.begin();
+        std::vector<Schedule>::const_iterator end = schedules.end();
+
+        for (; i != end; ++i)
+        {
+            if (i->id == id && i->state == Schedule::StateNormal)
+            {
+                found = true;
+                break;
+            }
+        }
+    }
+
+    if (!found)
+    {
+        rsp.list.append(errorToMap(ERR_RESOURCE_NOT_AVAILABLE, resource + "/address", QString("resource, /%1/%2, not available").arg(path[2]).arg(id)));
+        return false;
+    }
+
+    return true;
+}
+
+/*! Copies \p lightNode and the cached parts of its REST representation
+    into \p snap, unless already done.
+ */
+void DeRestPluginPrivate::transactionSnapshotLight(TransactionSnapshot &snap, LightNode *lightNode)
+{
+    if (!lightNode)
+    {
+        return;
+    }
+
+    const size_t index = lightNode - &nodes[0];
+
+    if (snap.nodes.find(index) != snap.nodes.end())
+    {
+        return;
+    }
+
+    snap.nodes.insert(std::make_pair(index, *lightNode));
+
+    std::map<quint32, RestMapCache>::const_iterator c = lightMapCache.find(lightNode->handle());
+    if (c != lightMapCache.end())
+    {
+        snap.lightMapCache.insert(*c);
+    }
+}
+
+/*! Copies \p group and its member lights into \p snap, unless already done.
+ */
+void DeRestPluginPrivate::transactionSnapshotGroup(TransactionSnapshot &snap, Group *group)
+{
+    if (!group)
+    {
+        return;
+    }
+
+    if (!snap.allGroups)
+    {
+        const size_t index = group - &groups[0];
+
+        if (snap.groups.find(index) != snap.groups.end())
+        {
+            return;
+        }
+
+        snap.groups.insert(std::make_pair(index, *group));
+    }
+
+    std::vector<LightNode>::iterator i = nodes.begin();
+    std::vector<LightNode>::iterator end = nodes.end();
+
+    for (; i != end; ++i)
+    {
+        if (group->address() == 0) // all lights
+        {
+            transactionSnapshotLight(snap, &(*i));
+            continue;
+        }
+
+        std::vector<GroupInfo>::const_iterator g = i->groups().begin();
+        std::vector<GroupInfo>::const_iterator gend = i->groups().end();
+
+        for (; g != gend; ++g)
+        {
+            if (g->id == group->address())
+            {
+                transactionSnapshotLight(snap, &(*i));
+                break;
+            }
+        }
+    }
+}
+
+/*! Copies the resources which an operation may change into \p snap.
+    Called for all operations before the first one is applied.
+    \param snap - the snapshot of the transaction
+    \param path - the resolved path /api/<apikey>/... of the operation
+    \param op - the operation
+ */
+void DeRestPluginPrivate::transactionSnapshot(TransactionSnapshot &snap, const QStringList &path, const QVariantMap &op)
+{
+    const bool hasId = path.size() > 3 && !path[3].startsWith('$');
+
+    if (path[2] == "lights")
+    {
+        LightNode *lightNode = hasId ? getLightNodeForId(path[3]) : 0;
+
+        if (lightNode)
+        {
+            transactionSnapshotLight(snap, lightNode);
+
+            // deleting a light or its groups and scenes changes the groups
+            std::vector<GroupInfo>::const_iterator g = lightNode->groups().begin();
+            std::vector<GroupInfo>::const_iterator gend = lightNode->groups().end();
+
+            for (; g != gend; ++g)
+            {
+                transactionSnapshotGroup(snap, getGroupForId(g->id));
+            }
+        }
+    }
+    else if (path[2] == "groups")
+    {
+        if (path.size() == 3 && !snap.allGroups)
+        {
+            // createGroup() may replace a deleted group
+            snap.groups.clear();
+
+            for (size_t j = 0; j < groups.size(); j++)
+            {
+                snap.groups.insert(std::make_pair(j, groups[j]));
+            }
+
+            snap.allGroups = true;
+        }
+
+        transactionSnapshotGroup(snap, hasId ? getGroupForId(path[3]) : 0);
+
+        // lights which are added to or removed from the group
+        QVariantList ls = op["body"].toMap()["lights"].toList();
+        QVariantList::const_iterator l = ls.begin();
+        QVariantList::const_iterator lend = ls.end();
+
+        for (; l != lend; ++l)
+        {
+            transactionSnapshotLight(snap, getLightNodeForId(l->toString()));
+        }
+    }
+    else if (path[2] == "sensors")
+    {
+        Sensor *sensor = hasId ? getSensorNodeForId(path[3]) : 0;
+
+        if (sensor)
+        {
+            const size_t index = sensor - &sensors[0];
+
+            if (snap.sensors.find(index) == snap.sensors.end())
+            {
+                snap.sensors.insert(std::make_pair(index, *sensor));
+
+                std::map<quint32, RestMapCache>::const_iterator c = sensorMapCache.find(sensor->handle());
+                if (c != sensorMapCache.end())
+                {
+                    snap.sensorMapCache.insert(*c);
+                }
+            }
+        }
+    }
+    else if (path[2] == "rules")
+    {
+        Rule *rule = hasId ? getRuleForId(path[3]) : 0;
+
+        if (rule)
+        {
+            const size_t index = rule - &rules[0];
+
+            if (snap.rules.find(index) == snap.rules.end())
+            {
+                snap.rules.insert(std::make_pair(index, *rule));
+            }
+        }
+
+        if (!snap.hasBindings)
+        {
+            snap.bindingQueue = bindingQueue;
+            snap.bindingToRuleQueue = bindingToRuleQueue;
+            snap.hasBindings = true;
+        }
+    }
+    else if (path[2] == "schedules" && hasId)
+    {
+        for (size_t i = 0; i < schedules.size(); i++)
+        {
+            if (schedules[i].id == path[3])
+            {
+                if (snap.schedules.find(i) == snap.schedules.end())
+                {
+                    snap.schedules.insert(std::make_pair(i, schedules[i]));
+                }
+                break;
+            }
+        }
+    }
+
+    // light state which is kept beside the lights and groups
+    if ((path[2] == "lights" || path[2] == "groups") && !snap.hasGroupState)
+    {
+        snap.groupStatePlans = groupStatePlans;
+        snap.groupPlanScenes = groupPlanScenes;
+        snap.groupVerifications = groupVerifications;
+        snap.groupVerifyFallbacks = groupVerifyFallbacks;
+        snap.mailboxes = mailboxes;
+        snap.hasGroupState = true;
+    }
+}
+
+/*! Restores the resources copied into \p snap and removes the created ones.
+ */
+void DeRestPluginPrivate::transactionRestore(TransactionSnapshot &snap)
+{
+    // created resources
+    for (size_t i = snap.sensorCount; i < sensors.size(); i++)
+    {
+        sensorMapCache.erase(sensors[i].handle());
+    }
+
+    for (size_t i = snap.nodeCount; i < nodes.size(); i++)
+    {
+        lightMapCache.erase(nodes[i].handle());
+    }
+
+    nodes.erase(nodes.begin() + snap.nodeCount, nodes.end());
+    sensors.erase(sensors.begin() + snap.sensorCount, sensors.end());
+    rules.erase(rules.begin() + snap.ruleCount, rules.end());
+    schedules.erase(schedules.begin() + snap.scheduleCount, schedules.end());
+
+    if (snap.allGroups)
+    {
+        groups.clear();
+    }
+
+    // changed resources
+    {
+        std::map<size_t, LightNode>::const_iterator i = snap.nodes.begin();
+        std::map<size_t, LightNode>::const_iterator end = snap.nodes.end();
+
+        for (; i != end; ++i)
+        {
+            nodes[i->first] = i->second;
+
+            std::map<quint32, RestMapCache>::const_iterator c = snap.lightMapCache.find(i->second.handle());
+            if (c != snap.lightMapCache.end())
+            {
+                lightMapCache[c->first] = c->second;
+            }
+            else
+            {
+                lightMapCache.erase(i->second.handle());
+            }
+        }
+    }
+
+    {
+        std::map<size_t, Sensor>::const_iterator i = snap.sensors.begin();
+        std::map<size_t, Sensor>::const_iterator end = snap.sensors.end();
+
+        for (; i != end; ++i)
+        {
+            sensors[i->first] = i->second;
+
+            std::map<quint32, RestMapCache>::const_iterator c = snap.sensorMapCache.find(i->second.handle());
+            if (c != snap.sensorMapCache.end())
+            {
+                sensorMapCache[c->first] = c->second;
+            }
+            else
+            {
+                sensorMapCache.erase(i->second.handle());
+            }
+        }
+    }
+
+    {
+        std::map<size_t, Rule>::const_iterator i = snap.rules.begin();
+        std::map<size_t, Rule>::const_iterator end = snap.rules.end();
+
+        for (; i != end; ++i)
+        {
+            rules[i->first] = i->second;
+        }
+    }
+
+    {
+        std::map<size_t, Schedule>::const_iterator i = snap.schedules.begin();
+        std::map<size_t, Schedule>::const_iterator end = snap.schedules.end();
+
+        for (; i != end; ++i)
+        {
+            schedules[i->first] = i->second;
+        }
+    }
+
+    {
+        std::map<size_t, Group>::const_iterator i = snap.groups.begin();
+        std::map<size_t, Group>::const_iterator end = snap.groups.end();
+
+        for (; i != end; ++i)
+        {
+            if (snap.allGroups)
+            {
+                groups.push_back(i->second); // keys are 0..n-1 in order
+            }
+            else
+            {
+                groups[i->first] = i->second;
+            }
+        }
+    }
+
+    if (snap.hasGroupState)
+    {
+        groupStatePlans = snap.groupStatePlans;
+        groupPlanScenes = snap.groupPlanScenes;
+        groupVerifications = snap.groupVerifications;
+        groupVerifyFallbacks = snap.groupVerifyFallbacks;
+        mailboxes = snap.mailboxes;
+    }
+
+    if (snap.hasBindings)
+    {
+        bindingQueue = snap.bindingQueue;
+        bindingToRuleQueue = snap.bindingToRuleQueue;
+    }
+
+    saveDatabaseItems = snap.saveDatabaseItems;
+    gwConfigEtag = snap.gwConfigEtag;
+    rebuildResourceIndexes();
+}
+
+/*! POST /api/<apikey>/transaction
+
+    Applies an ordered list of operations as one unit:
+
+    { "operations": [ { "method": "POST", "address": "/groups", "body": { "name": "Floor 2" } },
+                      { "method": "PUT", "address": "/groups/$0", "body": { "lights": ["1", "2"] } } ] }
+
+    The addresses of all operations are checked before anything is changed,
+    the parameters are checked by the handlers of the single requests. Before
+    the first operation is applied the resources which the operations may
+    change are copied, see transactionSnapshot(). If one operation fails they
+    are restored, timers started by the operations are stopped again and the
+    collected ZigBee commands are dropped. On success the database is saved
+    once and the collected ZigBee commands are passed through addTask(), see
+    queueTransactionTasks().
+
+    With "dryrun": true the operations are applied and always restored, the
+    response contains the results the transaction would have.
+
+    \return REQ_READY_SEND
+            REQ_NOT_HANDLED
+ */
+int DeRestPluginPrivate::handleTransactionApi(const ApiRequest &req, ApiResponse &rsp)
+{
+    if (req.path.size() != 3 || req.path[2] != "transaction")
+    {
+        return REQ_NOT_HANDLED;
+    }
+
+    if (!checkApikeyAuthentification(req, rsp))
+    {
+        return REQ_READY_SEND;
+    }
+
+    if (req.hdr.method() != "POST")
+    {
+        rsp.httpStatus = HttpStatusNotFound;
+        rsp.list.append(errorToMap(ERR_METHOD_NOT_AVAILABLE, "/transaction", QString("method, %1, not available for resource, /transaction").arg(req.hdr.method())));
+        return REQ_READY_SEND;
+    }
+
+    bool ok;
+    QVariant var = Json::parse(req.content, ok);
+    QVariantMap map = var.toMap();
+
+    if (!ok || map.isEmpty())
+    {
+        rsp.httpStatus = HttpStatusBadRequest;
+        rsp.list.append(errorToMap(ERR_INVALID_JSON, "/transaction", "body contains invalid JSON"));
+        return REQ_READY_SEND;
+    }
+
+    if (map["operations"].type() != QVariant::List || map["operations"].toList().isEmpty())
+    {
+        rsp.httpStatus = HttpStatusBadRequest;
+        rsp.list.append(errorToMap(ERR_MISSING_PARAMETER, "/transaction", "missing parameters in body"));
+        return REQ_READY_SEND;
+    }
+
+    const QVariantList ops = map["operations"].toList();
+
+    if (ops.size() > TRANSACTION_MAX_OPERATIONS)
+    {
+        rsp.httpStatus = HttpStatusBadRequest;
+        rsp.list.append(errorToMap(ERR_TOO_MANY_ITEMS, "/transaction", QString("too many operations, max. %1").arg(TRANSACTION_MAX_OPERATIONS)));
+        return REQ_READY_SEND;
+    }
+
+    if (transactionActive)
+    {
+        rsp.httpStatus = HttpStatusServiceUnavailable;
+        rsp.list.append(errorToMap(ERR_BRIDGE_BUSY, "/transaction", "another transaction is in progress"));
+        return REQ_READY_SEND;
+    }
+
+    // validate all operations before anything is touched
+    std::vector<QStringList> paths(ops.size());
+
+    for (int i = 0; i < ops.size(); i++)
+    {
+        if (!validateTransactionOperation(ops, i, req.apikey(), paths[i], rsp))
+        {
+            rsp.httpStatus = HttpStatusBadRequest;
+            return REQ_READY_SEND;
+        }
+    }
+
+    const bool dryRun = map.contains("dryrun") && map["dryrun"].toBool();
+
+    // copies of the resources the operations may change
+    TransactionSnapshot snap;
+    snap.nodeCount = nodes.size();
+    snap.sensorCount = sensors.size();
+    snap.ruleCount = rules.size();
+    snap.scheduleCount = schedules.size();
+    snap.saveDatabaseItems = saveDatabaseItems;
+    snap.gwConfigEtag = gwConfigEtag;
+
+    for (int i = 0; i < ops.size(); i++)
+    {
+        transactionSnapshot(snap, paths[i], ops[i].toMap());
+    }
+
+    // timers which the handlers may start
+    QTimer *timers[] = { verifyRulesTimer, bindingTimer, bindingToRuleTimer,
+                         bindingTableReaderTimer, saveCurrentRuleInDbTimer };
+    const size_t timerCount = sizeof(timers) / sizeof(timers[0]);
+    bool timersActive[timerCount];
+
+    for (size_t t = 0; t < timerCount; t++)
+    {
+        timersActive[t] = timers[t]->isActive();
+    }
+
+    DBG_Assert(transactionTasks.empty());
+    transactionActive = true;
+    transactionSaveDelay = 0;
+
+    QVariantList results;
+    int failed = -1;
+    ApiResponse failedRsp;
+
+    for (int i = 0; i < ops.size(); i++)
+    {
+        QVariantMap op = ops[i].toMap();
+        QStringList path = paths[i];
+
+        // resolve references to created resources
+        for (int j = 3; j < path.size(); j++)
+        {
+            if (path[j].startsWith('$'))
+            {
+                path[j] = createdIdFromResult(results[path[j].mid(1).toInt()]);
+            }
+        }
+
+        const QString content = op.contains("body") ? deCONZ::jsonStringFromMap(op["body"].toMap()) : QString();
+        QHttpRequestHeader hdr(op["method"].toString(), QLatin1Char('/') + path.join(QLatin1String("/")));
+        ApiRequest opReq(hdr, path, req.sock, content);
+        ApiResponse opRsp;
+
+        opRsp.httpStatus = HttpStatusNotFound;
+        opRsp.contentType = HttpContentHtml;
+
+        int ret = REQ_NOT_HANDLED;
+
+        if (path[2] == "lights")         { ret = handleLightsApi(opReq, opRsp); }
+        else if (path[2] == "groups")    { ret = handleGroupsApi(opReq, opRsp); }
+        else if (path[2] == "schedules") { ret = handleSchedulesApi(opReq, opRsp); }
+        else if (path[2] == "sensors")   { ret = handleSensorsApi(opReq, opRsp); }
+        else if (path[2] == "rules")     { ret = handleRulesApi(opReq, opRsp); }
+
+        if (ret != REQ_READY_SEND || resultHasError(opRsp))
+        {
+            failed = i;
+            failedRsp = opRsp;
+            break;
+        }
+
+        if (!opRsp.map.isEmpty())
+        {
+            results.append(opRsp.map);
+        }
+        else
+        {
+            results.append(opRsp.list);
+        }
+    }
+
+    transactionActive = false;
+
+    if (failed != -1 || dryRun)
+    {
+        if (failed != -1)
+        {
+            DBG_Printf(DBG_INFO, "transaction failed at operation %d, rollback\n", failed);
+        }
+
+        transactionRestore(snap);
+        releaseAllTasks(transactionTasks);
+        transactionSaveDelay = 0;
+
+        for (size_t t = 0; t < timerCount; t++)
+        {
+            if (!timersActive[t])
+            {
+                timers[t]->stop();
+            }
+        }
+    }
+
+    if (failed != -1)
+    {
+        rsp.httpStatus = (failedRsp.httpStatus && failedRsp.httpStatus != HttpStatusOk) ? failedRsp.httpStatus : HttpStatusBadRequest;
+        rsp.list.append(errorToMap(ERR_INTERNAL_ERROR, QString("/transaction/%1").arg(failed), QString("operation failed, transaction rolled back")));
+        rsp.list.append(failedRsp.list);
+        return REQ_READY_SEND;
+    }
+
+    if (dryRun)
+    {
+        rsp.httpStatus = HttpStatusOk;
+        rsp.list = results;
+        return REQ_READY_SEND;
+    }
+
+    // commit
+    DBG_Printf(DBG_INFO, "transaction applied %d operations, %d tasks\n", ops.size(), (int)transactionTasks.size());
+
+    transactionBacklog.splice(transactionBacklog.end(), transactionTasks);
+    queueTransactionTasks();
+
+    if (transactionSaveDelay > 0)
+    {
+        queSaveDb(0, transactionSaveDelay);
+        transactionSaveDelay = 0;
+    }
+
+    rsp.httpStatus = HttpStatusOk;
+    rsp.list = results;
+    return REQ_READY_SEND;
+}
+
+/*! Hands the tasks of committed transactions to the queue.
+    Each task passes the checks of addTaskToQueue(), duplicates are merged, commands
+    for sleepy end-devices go to their mailbox and the queue limit applies.
+    Tasks which don't fit yet stay in the backlog, in order, and are retried
+    by processTasks().
+ */
+void DeRestPluginPrivate::queueTransactionTasks()
+{
+    while (!transactionBacklog.empty())
+    {
+        if (!addTaskToQueue(transactionBacklog.front()))
+        {
+            break; // queue full
+        }
+
+        releaseTask(transactionBacklog, transactionBacklog.begin());
+    }
+
+    if (!transactionBacklog.empty())
+    {
+        DBG_Printf(DBG_INFO_L2, "%d committed transaction tasks wait for the queue\n", (int)transactionBacklog.size());
+    }
+}
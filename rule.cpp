@@ -9,12 +9,14 @@
  */
 
 #include "rule.h"
+#include "rest_node_base.h"
 
 /*! Constructor. */
 Rule::Rule() :
     lastVerify(0),
     m_state(StateNormal),
     m_id("notSet"),
+    m_handle(0),
     m_name("notSet"),
     m_lastTriggered("none"),
     m_creationtime("notSet"),
@@ -37,6 +39,10 @@ Rule::State Rule::state() const
  */
 void Rule::setState(State state)
 {
+    if (m_state != state)
+    {
+        changes.set(FieldState);
+    }
     m_state = state;
 }
 
@@ -52,7 +58,19 @@ const QString &Rule::id() const
  */
 void Rule::setId(const QString &id)
 {
+    if (m_id != id)
+    {
+        changes.set(FieldId);
+    }
     m_id = id;
+    m_handle = idToHandle(id);
+}
+
+/*! Returns the compact rule handle, unique per id, 0 if the id isn't set.
+ */
+quint32 Rule::handle() const
+{
+    return m_handle;
 }
 
 /*! Returns the rule name.
@@ -67,6 +85,10 @@ const QString &Rule::name() const
  */
 void Rule::setName(const QString &name)
 {
+    if (m_name != name)
+    {
+        changes.set(FieldName);
+    }
     m_name = name;
 }
 
@@ -83,12 +105,13 @@ const QString &Rule::lastTriggered() const
 void Rule::setLastTriggered(const QString &lastTriggered)
 {
     m_lastTriggered = lastTriggered;
+    changes.set(FieldLastTriggered);
     m_lastTriggeredTime.start();
 }
 
 /*! Returns the timestamp the rule was last triggered.
  */
-const QTime &Rule::lastTriggeredTime() const
+const QElapsedTimer &Rule::lastTriggeredTime() const
 {
     return m_lastTriggeredTime;
 }
@@ -105,6 +128,10 @@ const QString &Rule::creationtime() const
  */
 void Rule::setCreationtime(const QString &creationtime)
 {
+    if (this->m_creationtime != creationtime)
+    {
+        changes.set(FieldCreationTime);
+    }
     this->m_creationtime = creationtime;
 }
 
@@ -120,6 +147,10 @@ const quint32 &Rule::timesTriggered() const
  */
 void Rule::setTimesTriggered(const quint32 &timesTriggered)
 {
+    if (this->m_timesTriggered != timesTriggered)
+    {
+        changes.set(FieldTimesTriggered);
+    }
     this->m_timesTriggered = timesTriggered;
 }
 
@@ -135,6 +166,10 @@ int Rule::triggerPeriodic() const
 
 void Rule::setTriggerPeriodic(int ms)
 {
+    if (m_triggerPeriodic != ms)
+    {
+        changes.set(FieldPeriodic);
+    }
     m_triggerPeriodic = ms;
 }
 
@@ -150,6 +185,10 @@ const QString &Rule::owner() const
  */
 void Rule::setOwner(const QString &owner)
 {
+    if (this->m_owner != owner)
+    {
+        changes.set(FieldOwner);
+    }
     this->m_owner = owner;
 }
 
@@ -165,6 +204,10 @@ const QString &Rule::status() const
  */
 void Rule::setStatus(const QString &status)
 {
+    if (this->m_status != status)
+    {
+        changes.set(FieldStatus);
+    }
     this->m_status = status;
 }
 
@@ -181,6 +224,7 @@ const std::vector<RuleCondition> &Rule::conditions() const
 void Rule::setConditions(const std::vector<RuleCondition> &conditions)
 {
     this->m_conditions = conditions;
+    changes.set(FieldConditions);
 }
 
 /*! Returns the rule actions.
@@ -196,6 +240,7 @@ const std::vector<RuleAction> &Rule::actions() const
 void Rule::setActions(const std::vector<RuleAction> &actions)
 {
     this->m_actions = actions;
+    changes.set(FieldActions);
 }
 
 /*! Transfers actions into JSONString.
@@ -15,9 +15,11 @@
 #include <QString>
 #include <vector>
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <deconz.h>
 #include "bindings.h"
 #include "json.h"
+#include "change_mask.h"
 
 class RuleCondition;
 class RuleAction;
@@ -52,6 +54,8 @@ public:
         state(StateCheck),
         timeout(BindingTask::Timeout),
         retries(BindingTask::Retries),
+        held(0),
+        airtimeDeferred(false),
         restNode(0)
     {
     }
@@ -65,6 +69,8 @@ public:
     quint8 zdpSeqNum;
     int timeout; // seconds
     int retries;
+    int held; // seconds waited for a sleepy source device to wake up
+    bool airtimeDeferred; // counted as deferred by the airtime accounting
     RestNodeBase *restNode;
 
     Binding binding;
@@ -90,15 +96,32 @@ public:
         MaxVerifyDelay = 300
     };
 
+    /*! Change mask bits of the rule fields, all of them are stored in the database. */
+    enum Field
+    {
+        FieldState          = 0x0001,
+        FieldId             = 0x0002,
+        FieldName           = 0x0004,
+        FieldLastTriggered  = 0x0008,
+        FieldCreationTime   = 0x0010,
+        FieldTimesTriggered = 0x0020,
+        FieldPeriodic       = 0x0040,
+        FieldOwner          = 0x0080,
+        FieldStatus         = 0x0100,
+        FieldConditions     = 0x0200,
+        FieldActions        = 0x0400
+    };
+
     State state() const;
     void setState(State state);
     const QString &id() const;
     void setId(const QString &id);
+    quint32 handle() const;
     const QString &name() const;
     void setName(const QString &name);
     const QString &lastTriggered() const;
     void setLastTriggered(const QString &lastTriggered);
-    const QTime &lastTriggeredTime() const;
+    const QElapsedTimer &lastTriggeredTime() const;
     const QString &creationtime() const;
     void setCreationtime(const QString &creationtime);
     const quint32 &timesTriggered() const;
@@ -122,12 +145,14 @@ public:
 
     QString etag;
     int lastVerify; // copy of idleTotalCounter at last verification
+    ChangeMask changes;
 
 private:
     State m_state;
     QString m_id;
+    quint32 m_handle; // see idToHandle()
     QString m_name;
-    QTime m_lastTriggeredTime;
+    QElapsedTimer m_lastTriggeredTime;
     QString m_lastTriggered;
     QString m_creationtime;
     quint32 m_timesTriggered;
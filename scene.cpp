@@ -9,6 +9,7 @@
  */
 
 #include "scene.h"
+#include "rest_node_base.h"
 
 /*! Constructor.
  */
@@ -66,17 +67,22 @@ void Scene::addLight(const LightState &light)
 }
 
 /*! removes a light from the lights of the scene if present.
-    \param lid the lightId that should be removed
+    \param lightHandle the handle of the light that should be removed
     \return true if light was found and removed
  */
-bool Scene::deleteLight(const QString &lid)
+bool Scene::deleteLight(quint32 lightHandle)
 {
+    if (lightHandle == 0)
+    {
+        return false; // light without id
+    }
+
     std::vector<LightState>::const_iterator l = m_lights.begin();
     std::vector<LightState>::const_iterator lend = m_lights.end();
     int position = 0;
     for (; l != lend; ++l)
     {
-        if (l->lid() == lid)
+        if (l->lightHandle() == lightHandle)
         {
             m_lights.erase(m_lights.begin() + position);
             return true;
@@ -154,6 +160,7 @@ std::vector<LightState> Scene::jsonToLights(const QString &json)
  */
 LightState::LightState() :
     m_lid(""),
+    m_lightHandle(0),
     m_on(false),
     m_bri(0),
     m_x(0),
@@ -180,6 +187,14 @@ const QString &LightState::lid() const
 void LightState::setLid(const QString &lid)
 {
     m_lid = lid;
+    m_lightHandle = idToHandle(lid);
+}
+
+/*! Returns the compact handle of the light of the scene.
+ */
+quint32 LightState::lightHandle() const
+{
+    return m_lightHandle;
 }
 
 /*! Returns the on status of the light of the scene.
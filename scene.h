@@ -45,7 +45,7 @@ public:
     const std::vector<LightState> &lights() const;
     void setLights(const std::vector<LightState> &lights);
     void addLight(const LightState &light);
-    bool deleteLight(const QString &lid);
+    bool deleteLight(quint32 lightHandle);
 
     static QString lightsToString(const std::vector<LightState> &lights);
     static std::vector<LightState> jsonToLights(const QString &json);
@@ -68,6 +68,7 @@ public:
 
     const QString &lid() const;
     void setLid(const QString &lid);
+    quint32 lightHandle() const;
     const bool &on() const;
     void setOn(const bool &on);
     const uint8_t &bri() const;
@@ -92,6 +93,7 @@ public:
 
 private:
     QString m_lid;
+    quint32 m_lightHandle; // see idToHandle()
     bool m_on;
     uint8_t m_bri;
     uint16_t m_x;
@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2016 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <algorithm>
+#include "de_web_plugin.h"
+#include "de_web_plugin_private.h"
+
+/*! Returns true if \p scene has a stored state of \p lightNode.
+    Storing the scene again overwrites the entry and needs no free slot.
+ */
+static bool placementHasLight(const Scene *scene, const LightNode *lightNode)
+{
+    if (!scene)
+    {
+        return false;
+    }
+
+    std::vector<LightState>::const_iterator i = scene->lights().begin();
+    std::vector<LightState>::const_iterator end = scene->lights().end();
+
+    for (; i != end; ++i)
+    {
+        if (i->lightHandle() == lightNode->handle())
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*! Returns the scene \p sceneId of group \p groupId or 0 if not found.
+ */
+static Scene *placementScene(Group *group, uint8_t sceneId)
+{
+    if (!group)
+    {
+        return 0;
+    }
+
+    std::vector<Scene>::iterator i = group->scenes.begin();
+    std::vector<Scene>::iterator end = group->scenes.end();
+
+    for (; i != end; ++i)
+    {
+        if (i->id == sceneId)
+        {
+            return &(*i);
+        }
+    }
+
+    return 0;
+}
+
+/*! Returns true if a store of scene \p sceneId in group \p groupId to \p lightNode is queued or running.
+ */
+static bool placementStoreInFlight(const std::list<TaskItem> &tasks, const LightNode *lightNode, uint16_t groupId, uint8_t sceneId)
+{
+    std::list<TaskItem>::const_iterator i = tasks.begin();
+    std::list<TaskItem>::const_iterator end = tasks.end();
+
+    for (; i != end; ++i)
+    {
+        if (i->taskType != TaskStoreScene || i->lightNode != lightNode)
+        {
+            continue;
+        }
+
+        const QByteArray &pl = i->zclFrame.payload();
+
+        if (pl.size() >= 3 &&
+            (uint8_t)pl[0] == (groupId & 0xFF) &&
+            (uint8_t)pl[1] == (groupId >> 8) &&
+            (uint8_t)pl[2] == sceneId)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*! Returns the remaining scene table slots of \p lightNode.
+
+    The capacity reported by the device only changes when a store or remove
+    is confirmed, so pending stores of scenes the light doesn't hold yet are
+    reserved here and pending removes are counted as free, they are sent first.
+    A negative result means the pending stores already exceed the table.
+ */
+int DeRestPluginPrivate::sceneSlotsFree(const LightNode *lightNode)
+{
+    int free = lightNode->sceneCapacity();
+
+    std::vector<GroupInfo>::const_iterator i = lightNode->groups().begin();
+    std::vector<GroupInfo>::const_iterator end = lightNode->groups().end();
+
+    for (; i != end; ++i)
+    {
+        Group *group = getGroupForId(i->id);
+
+        if (i->actions & GroupInfo::ActionRemoveAllScenes)
+        {
+            free += i->sceneCount();
+        }
+        else
+        {
+            std::vector<uint8_t>::const_iterator r = i->removeScenes.begin();
+            std::vector<uint8_t>::const_iterator rend = i->removeScenes.end();
+
+            for (; r != rend; ++r)
+            {
+                if (placementScene(group, *r))
+                {
+                    free++;
+                }
+            }
+        }
+
+        std::vector<uint8_t>::const_iterator a = i->addScenes.begin();
+        std::vector<uint8_t>::const_iterator aend = i->addScenes.end();
+
+        for (; a != aend; ++a)
+        {
+            if (!placementHasLight(placementScene(group, *a), lightNode))
+            {
+                free--;
+            }
+        }
+    }
+
+    return free;
+}
+
+/*! Returns true if scene \p sceneId of group \p groupId fits into the scene table of \p lightNode.
+ */
+bool DeRestPluginPrivate::canPlaceScene(LightNode *lightNode, uint16_t groupId, uint8_t sceneId)
+{
+    const GroupInfo *groupInfo = getGroupInfo(lightNode, groupId);
+
+    if (!groupInfo)
+    {
+        return false;
+    }
+
+    if (std::find(groupInfo->addScenes.begin(), groupInfo->addScenes.end(), sceneId) != groupInfo->addScenes.end())
+    {
+        return true; // slot is reserved already
+    }
+
+    if (placementHasLight(placementScene(getGroupForId(groupId), sceneId), lightNode))
+    {
+        return true;
+    }
+
+    return sceneSlotsFree(lightNode) > 0;
+}
+
+/*! Returns true if \p lightNode has a free group table slot for group \p groupId.
+    Pending adds of other groups are reserved like pending scene stores.
+ */
+bool DeRestPluginPrivate::canPlaceInGroup(const LightNode *lightNode, uint16_t groupId)
+{
+    if (lightNode->groupCapacity() == 0 && lightNode->groupCount() == 0) // xxx workaround, capacity not known yet
+    {
+        return true;
+    }
+
+    int free = lightNode->groupCapacity();
+
+    std::vector<GroupInfo>::const_iterator i = lightNode->groups().begin();
+    std::vector<GroupInfo>::const_iterator end = lightNode->groups().end();
+
+    for (; i != end; ++i)
+    {
+        if (i->reported == GroupInfo::ReportedInGroup)
+        {
+            if (i->id == groupId)
+            {
+                return true; // already member
+            }
+        }
+        else if (i->id != groupId && (i->actions & GroupInfo::ActionAddToGroup))
+        {
+            free--;
+        }
+    }
+
+    return free > 0;
+}
+
+/*! Checks which available members of \p group can take scene \p sceneId.
+    For each member without free scene table space an error is appended to \p rsp.
+    \param rejected set to the number of members without space
+    \return the number of members which can take the scene
+ */
+int DeRestPluginPrivate::checkScenePlacement(Group *group, uint8_t sceneId, ApiResponse &rsp, int &rejected)
+{
+    int placed = 0;
+    rejected = 0;
+
+    std::vector<LightNode>::iterator i = nodes.begin();
+    std::vector<LightNode>::iterator end = nodes.end();
+
+    for (; i != end; ++i)
+    {
+        LightNode *lightNode = &(*i);
+
+        if (!lightNode->isAvailable() || !isLightNodeInGroup(lightNode, group->address()))
+        {
+            continue;
+        }
+
+        if (canPlaceScene(lightNode, group->address(), sceneId))
+        {
+            placed++;
+        }
+        else
+        {
+            rejected++;
+            rsp.list.append(errorToMap(ERR_DEVICE_SCENES_TABLE_FULL, QString("/groups/%1/scenes/lights/%2").arg(group->id()).arg(lightNode->id()), QString("Could not set scene for %1. Scene capacity of the device is reached.").arg(qPrintable(lightNode->name()))));
+        }
+    }
+
+    return placed;
+}
+
+/*! Queues the pending scene stores of the light of \p task.
+
+    Up to SCENE_PLACE_BATCH stores are kept in flight per light, so a large
+    set of scenes is written without waiting for each response, and a store
+    which is already queued or running isn't sent again.
+
+    \return true if at least one store was queued
+ */
+bool DeRestPluginPrivate::addTaskStoreScenes(TaskItem &task)
+{
+    LightNode *lightNode = task.lightNode;
+    int inFlight = 0;
+    bool queued = false;
+
+    std::list<TaskItem>::const_iterator t = tasks.begin();
+    std::list<TaskItem>::const_iterator tend = tasks.end();
+
+    for (; t != tend; ++t)
+    {
+        if (t->taskType == TaskStoreScene && t->lightNode == lightNode) { inFlight++; }
+    }
+
+    for (t = runningTasks.begin(), tend = runningTasks.end(); t != tend; ++t)
+    {
+        if (t->taskType == TaskStoreScene && t->lightNode == lightNode) { inFlight++; }
+    }
+
+    std::vector<GroupInfo>::const_iterator i = lightNode->groups().begin();
+    std::vector<GroupInfo>::const_iterator end = lightNode->groups().end();
+
+    for (; i != end && inFlight < SCENE_PLACE_BATCH; ++i)
+    {
+        // scene commands wait until the group membership is confirmed
+        if (i->actions & (GroupInfo::ActionAddToGroup | GroupInfo::ActionRemoveFromGroup | GroupInfo::ActionRemoveAllScenes))
+        {
+            continue;
+        }
+
+        if (!i->removeScenes.empty())
+        {
+            continue; // wait for the freed slots
+        }
+
+        std::vector<uint8_t>::const_iterator s = i->addScenes.begin();
+        std::vector<uint8_t>::const_iterator send = i->addScenes.end();
+
+        for (; s != send && inFlight < SCENE_PLACE_BATCH; ++s)
+        {
+            if (placementStoreInFlight(tasks, lightNode, i->id, *s) ||
+                placementStoreInFlight(runningTasks, lightNode, i->id, *s))
+            {
+                continue;
+            }
+
+            if (!addTaskStoreScene(task, i->id, *s))
+            {
+                return queued;
+            }
+
+            inFlight++;
+            queued = true;
+        }
+    }
+
+    return queued;
+}
+
+/*! Drops the pending stores of scenes which \p lightNode doesn't hold yet.
+    Called after the light answered a store with insufficient space, the
+    remaining stores would fail too. The scene table is read again to get
+    the actual capacity.
+ */
+void DeRestPluginPrivate::rejectScenePlacements(LightNode *lightNode)
+{
+    lightNode->setSceneCapacity(0);
+
+    std::vector<GroupInfo>::iterator i = lightNode->groups().begin();
+    std::vector<GroupInfo>::iterator end = lightNode->groups().end();
+
+    for (; i != end; ++i)
+    {
+        Group *group = getGroupForId(i->id);
+        std::vector<uint8_t>::iterator s = i->addScenes.begin();
+
+        while (s != i->addScenes.end())
+        {
+            if (placementHasLight(placementScene(group, *s), lightNode))
+            {
+                ++s;
+                continue;
+            }
+
+            DBG_Printf(DBG_INFO, "drop store of scene %u group 0x%04X for light %s, scene table full\n", *s, i->id, qPrintable(lightNode->id()));
+            s = i->addScenes.erase(s);
+        }
+    }
+
+    lightNode->enableRead(READ_SCENES);
+}
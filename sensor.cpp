@@ -8,6 +8,7 @@
  *
  */
 
+#include "clock.h"
 #include "sensor.h"
 
 /*! Returns a fingerprint as JSON string. */
@@ -150,6 +151,10 @@ Sensor::DeletedState Sensor::deletedState() const
  */
 void Sensor::setDeletedState(DeletedState deletedstate)
 {
+    if (m_deletedstate != deletedstate)
+    {
+        changes.set(FieldDeleted);
+    }
     m_deletedstate = deletedstate;
 }
 
@@ -165,6 +170,10 @@ const QString &Sensor::name() const
  */
 void Sensor::setName(const QString &name)
 {
+    if (m_name != name)
+    {
+        changes.set(FieldName);
+    }
     m_name = name;
 }
 
@@ -186,6 +195,10 @@ const uint8_t &Sensor::mode() const
  */
 void Sensor::setMode(const uint8_t &mode)
 {
+    if (m_mode != mode)
+    {
+        changes.set(FieldMode);
+    }
     m_mode = mode;
 }
 
@@ -201,6 +214,10 @@ const QString &Sensor::type() const
  */
 void Sensor::setType(const QString &type)
 {
+    if (m_type != type)
+    {
+        changes.set(FieldType);
+    }
     m_type = type;
 }
 
@@ -216,7 +233,12 @@ const QString &Sensor::modelId() const
  */
 void Sensor::setModelId(const QString &mid)
 {
-    m_modelid = mid.trimmed();
+    if (m_modelid != mid.trimmed())
+    {
+        m_modelid = mid.trimmed();
+        changes.set(FieldInfo);
+        resetDeviceProfile();
+    }
 }
 
 /*! Returns the sensor manufacturer.
@@ -231,7 +253,24 @@ const QString &Sensor::manufacturer() const
  */
 void Sensor::setManufacturer(const QString &manufacturer)
 {
-    m_manufacturer = manufacturer;
+    if (m_manufacturer != manufacturer)
+    {
+        m_manufacturer = manufacturer;
+        changes.set(FieldInfo);
+        resetDeviceProfile();
+    }
+}
+
+/*! Compiles the sensor capabilities from the matching profiles.
+    The manufacturer code comes from the node descriptor, without node
+    the result is used but resolved again later.
+ */
+bool Sensor::compileDeviceProfile(const DeviceProfileDatabase &db, CompiledDeviceProfile &profile) const
+{
+    const deCONZ::Node *node = this->node();
+    const quint16 manufacturerCode = node ? node->nodeDescriptor().manufacturerCode() : 0;
+    profile = db.compile(m_modelid, m_manufacturer, manufacturerCode, 0);
+    return node != 0;
 }
 
 /*! Returns the sensor software version.
@@ -247,10 +286,15 @@ const QString &Sensor::swVersion() const
  */
 void Sensor::setSwVersion(const QString &swversion)
 {
+    if (m_swversion != swversion)
+    {
+        changes.set(FieldInfo);
+    }
     m_swversion = swversion;
 }
 
-/*! Returns the sensor state.
+/*! Returns the modifiable sensor state.
+    Callers which change the state mark FieldState as changed.
  */
 SensorState &Sensor::state()
 {
@@ -270,6 +314,7 @@ const SensorState &Sensor::state() const
 void Sensor::setState(const SensorState &state)
 {
     m_state = state;
+    changes.set(FieldState);
 }
 
 /*! Returns the sensor config.
@@ -285,6 +330,7 @@ const SensorConfig &Sensor::config() const
 void Sensor::setConfig(const SensorConfig &config)
 {
     m_config = config;
+    changes.set(FieldConfig);
 }
 
 /*! Transfers state into JSONString.
@@ -311,7 +357,7 @@ QString Sensor::stateToString(const SensorState &state)
  */
 QString Sensor::configToString(const SensorConfig &config)
 {
-    QString jsonString = QString("{\"on\": %1,\"reachable\": %2,\"battery\":\"%3\",\"url\":\"%4\",\"long\":\"%5\",\"lat\":\"%6\",\"sunriseoffset\":\"%7\",\"sunsetoffset\":\"%8\"}")
+    QString jsonString = QString("{\"on\": %1,\"reachable\": %2,\"battery\":\"%3\",\"url\":\"%4\",\"long\":\"%5\",\"lat\":\"%6\",\"sunriseoffset\":\"%7\",\"sunsetoffset\":\"%8\",\"delta\": %9,\"hysteresis\": %10,\"minpublish\": %11,\"maxpublish\": %12}")
             .arg(config.on())
             .arg(config.reachable())
             .arg(config.battery())
@@ -319,7 +365,11 @@ QString Sensor::configToString(const SensorConfig &config)
             .arg(config.longitude())
             .arg(config.lat())
             .arg(config.sunriseoffset())
-            .arg(config.sunsetoffset());
+            .arg(config.sunsetoffset())
+            .arg(config.delta())
+            .arg(config.hysteresis())
+            .arg(config.minPublish())
+            .arg(config.maxPublish());
 
     return jsonString;
 }
@@ -372,10 +422,22 @@ SensorConfig Sensor::jsonToConfig(const QString &json)
     config.setSunriseoffset(map["sunriseoffset"].toString());
     config.setSunsetoffset(map["sunsetoffset"].toString());
 
+    // significance, missing in older databases
+    int val = map.contains("delta") ? map["delta"].toInt(&ok) : -1;
+    config.setDelta(ok ? val : -1);
+    val = map.contains("hysteresis") ? map["hysteresis"].toInt(&ok) : -1;
+    config.setHysteresis(ok ? val : -1);
+    val = map.contains("minpublish") ? map["minpublish"].toInt(&ok) : -1;
+    config.setMinPublish(ok ? val : -1);
+    val = map.contains("maxpublish") ? map["maxpublish"].toInt(&ok) : -1;
+    config.setMaxPublish(ok ? val : -1);
+
     return config;
 }
 
-/*! Returns the sensor fingerprint. */
+/*! Returns the modifiable sensor fingerprint.
+    Callers which change the fingerprint mark FieldFingerprint as changed.
+ */
 SensorFingerprint &Sensor::fingerPrint()
 {
     return m_fingerPrint;
@@ -387,6 +449,63 @@ const SensorFingerprint &Sensor::fingerPrint() const
     return m_fingerPrint;
 }
 
+/*! Default significance of measured values per sensor type.
+ */
+static const struct SignificanceDefaults
+{
+    const char *type;
+    ValueSignificance sig;
+} significanceDefaults[] = {
+    // illuminance is 10000 * log10(lux) + 1, a delta of 200 is about 5 %
+    { "ZHALight", { 200, 100, 5, 300 } },
+    { 0, { 0, 0, 0, 0 } }
+};
+
+/*! Returns true if measured values of sensors of \p type are filtered by significance. */
+bool Sensor::hasSignificanceDefaults(const QString &type)
+{
+    for (int i = 0; significanceDefaults[i].type; i++)
+    {
+        if (type == QLatin1String(significanceDefaults[i].type))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*! Returns the significance of measured values, the defaults of the type
+    overridden by the sensor config. Types without defaults publish every change.
+ */
+ValueSignificance Sensor::significance() const
+{
+    ValueSignificance sig = { 1, 0, 0, 0 };
+
+    for (int i = 0; significanceDefaults[i].type; i++)
+    {
+        if (m_type == QLatin1String(significanceDefaults[i].type))
+        {
+            sig = significanceDefaults[i].sig;
+            break;
+        }
+    }
+
+    if (m_config.delta() >= 0)      { sig.delta = m_config.delta(); }
+    if (m_config.hysteresis() >= 0) { sig.hysteresis = m_config.hysteresis(); }
+    if (m_config.minPublish() >= 0) { sig.minInterval = m_config.minPublish(); }
+    if (m_config.maxPublish() >= 0) { sig.maxInterval = m_config.maxPublish(); }
+
+    return sig;
+}
+
+/*! Returns the significance filter of measured values.
+    The filter state isn't part of the sensor resource and not marked as changed.
+ */
+ValueFilter &Sensor::valueFilter()
+{
+    return m_valueFilter;
+}
+
 // Sensor state
 /*! Constructor. */
 SensorState::SensorState() :
@@ -578,8 +697,7 @@ void SensorState::setLux(quint32 lux)
  */
 void SensorState::updateTime()
 {
-    QDateTime datetime = QDateTime::currentDateTimeUtc();
-    m_lastupdated = datetime.toString("yyyy-MM-ddTHH:mm:ss"); // ISO 8601
+    m_lastupdated = clockTimestamp(); // ISO 8601
 }
 
 // Sensor Config
@@ -593,7 +711,11 @@ SensorConfig::SensorConfig() :
     m_long(""),
     m_lat(""),
     m_sunriseoffset(""),
-    m_sunsetoffset("")
+    m_sunsetoffset(""),
+    m_delta(-1),
+    m_hysteresis(-1),
+    m_minPublish(-1),
+    m_maxPublish(-1)
 {
 }
 
@@ -753,3 +875,170 @@ void SensorConfig::setSunsetoffset(const QString &sunsetoffset)
 {
     m_sunsetoffset = sunsetoffset;
 }
+
+/*! Returns the min. significant change of measured values, -1 for the default.
+    Sensortypes: ZHALight
+ */
+int SensorConfig::delta() const
+{
+    return m_delta;
+}
+
+/*! Sets the min. significant change of measured values.
+    Sensortypes: ZHALight
+    \param delta in units of the ZCL attribute, -1 for the default
+ */
+void SensorConfig::setDelta(int delta)
+{
+    m_delta = delta;
+}
+
+/*! Returns the hysteresis of measured values, -1 for the default.
+    Sensortypes: ZHALight
+ */
+int SensorConfig::hysteresis() const
+{
+    return m_hysteresis;
+}
+
+/*! Sets the hysteresis of measured values.
+    Sensortypes: ZHALight
+    \param hysteresis in units of the ZCL attribute, -1 for the default
+ */
+void SensorConfig::setHysteresis(int hysteresis)
+{
+    m_hysteresis = hysteresis;
+}
+
+/*! Returns the min. interval between published values, -1 for the default.
+    Sensortypes: ZHALight
+ */
+int SensorConfig::minPublish() const
+{
+    return m_minPublish;
+}
+
+/*! Sets the min. interval between published values.
+    Sensortypes: ZHALight
+    \param seconds the interval, -1 for the default
+ */
+void SensorConfig::setMinPublish(int seconds)
+{
+    m_minPublish = seconds;
+}
+
+/*! Returns the interval after which a value is published regardless, -1 for the default.
+    Sensortypes: ZHALight
+ */
+int SensorConfig::maxPublish() const
+{
+    return m_maxPublish;
+}
+
+/*! Sets the interval after which a value is published regardless.
+    Sensortypes: ZHALight
+    \param seconds the interval, 0 for never, -1 for the default
+ */
+void SensorConfig::setMaxPublish(int seconds)
+{
+    m_maxPublish = seconds;
+}
+
+/*! Constructor. */
+ValueFilter::ValueFilter() :
+    m_value(0),
+    m_time(-1),
+    m_direction(0),
+    m_pending(false),
+    m_pendingValue(0),
+    m_pendingRaw(0)
+{
+}
+
+/*! Checks if \p value is significant and remembers it as published.
+    A significant value within the minimum interval is kept as pending.
+    \param value the measured value on the scale of the thresholds
+    \param raw the unfiltered value, returned by takePending()
+    \param now clockMonotonicMs()
+    \param sig the thresholds of the sensor
+    \return true if the value shall be published
+ */
+bool ValueFilter::accept(int value, int raw, qint64 now, const ValueSignificance &sig)
+{
+    if (m_time >= 0)
+    {
+        const qint64 elapsed = now - m_time;
+        const bool maxExpired = sig.maxInterval > 0 && elapsed >= (qint64)sig.maxInterval * 1000;
+
+        if (!maxExpired && !isSignificant(value, sig))
+        {
+            m_pending = false; // back near the published value
+            return false;
+        }
+
+        if (elapsed < (qint64)sig.minInterval * 1000)
+        {
+            m_pending = true;
+            m_pendingValue = value;
+            m_pendingRaw = raw;
+            return false;
+        }
+    }
+
+    publish(value, now);
+    return true;
+}
+
+/*! Returns true if a significant value waits for the minimum interval.
+ */
+bool ValueFilter::hasPending() const
+{
+    return m_pending;
+}
+
+/*! Publishes the pending value once the minimum interval has passed.
+    \param now clockMonotonicMs()
+    \param sig the thresholds of the sensor
+    \param raw set to the unfiltered pending value
+    \return true if the value shall be published
+ */
+bool ValueFilter::takePending(qint64 now, const ValueSignificance &sig, int *raw)
+{
+    if (!m_pending || (now - m_time) < (qint64)sig.minInterval * 1000)
+    {
+        return false;
+    }
+
+    *raw = m_pendingRaw;
+    publish(m_pendingValue, now);
+    return true;
+}
+
+/*! Returns true if \p value differs enough from the last published value.
+ */
+bool ValueFilter::isSignificant(int value, const ValueSignificance &sig) const
+{
+    const int diff = value - m_value;
+    const int direction = diff > 0 ? 1 : -1;
+    int needed = sig.delta;
+
+    if (m_direction != 0 && direction != m_direction)
+    {
+        needed += sig.hysteresis;
+    }
+
+    return diff != 0 && qAbs(diff) >= needed;
+}
+
+/*! Remembers \p value as published.
+ */
+void ValueFilter::publish(int value, qint64 now)
+{
+    if (m_time >= 0 && value != m_value)
+    {
+        m_direction = value > m_value ? 1 : -1;
+    }
+    m_value = value;
+    m_time = now;
+    m_pending = false;
+}
@@ -84,6 +84,14 @@ public:
     void setSunriseoffset(const QString &sunriseoffset);
     const QString &sunsetoffset() const;
     void setSunsetoffset(const QString &sunsetoffset);
+    int delta() const;
+    void setDelta(int delta);
+    int hysteresis() const;
+    void setHysteresis(int hysteresis);
+    int minPublish() const;
+    void setMinPublish(int seconds);
+    int maxPublish() const;
+    void setMaxPublish(int seconds);
 
 private:
     bool m_on;
@@ -95,6 +103,57 @@ private:
     QString m_lat;
     QString m_sunriseoffset;//int8
     QString m_sunsetoffset; //int8
+    int m_delta; // -1 for the default of the sensor type
+    int m_hysteresis; // -1 for the default of the sensor type
+    int m_minPublish; // -1 for the default of the sensor type
+    int m_maxPublish; // -1 for the default of the sensor type
+};
+
+/*! Thresholds which decide if a measured value is significant.
+    Values are in units of the ZCL attribute, intervals in seconds.
+    Illuminance is always compared on the log scale of the attribute,
+    also for devices which report lux.
+ */
+struct ValueSignificance
+{
+    int delta; // min. change to the last published value
+    int hysteresis; // added to delta if the direction of change reverses
+    int minInterval; // min. time between two published values
+    int maxInterval; // a value is published regardless after this time, 0 for never
+};
+
+/*! \class ValueFilter
+
+    Significance filter for the measured values of a sensor.
+
+    A value is published if it differs by at least delta from the last
+    published value and the minimum interval has passed. After the direction
+    of change reversed, the value must move by delta plus hysteresis, so noise
+    around a level isn't published back and forth. After the maximum interval
+    the next value is published in any case.
+
+    A significant value which arrives within the minimum interval is kept as
+    pending and published by takePending() once the interval has passed,
+    unless a later value makes it insignificant again.
+ */
+class ValueFilter
+{
+public:
+    ValueFilter();
+    bool accept(int value, int raw, qint64 now, const ValueSignificance &sig);
+    bool hasPending() const;
+    bool takePending(qint64 now, const ValueSignificance &sig, int *raw);
+
+private:
+    bool isSignificant(int value, const ValueSignificance &sig) const;
+    void publish(int value, qint64 now);
+
+    int m_value; // last published value
+    qint64 m_time; // clockMonotonicMs() of the last published value, -1 if none
+    int m_direction; // of the last published change: -1, 0, 1
+    bool m_pending; // a significant value waits for the minimum interval
+    int m_pendingValue;
+    int m_pendingRaw; // unfiltered value to publish
 };
 
 struct SensorFingerprint
@@ -131,6 +190,29 @@ public:
         StateDeleted
     };
 
+    /*! Change mask bits of the sensor fields. */
+    enum Field
+    {
+        FieldDeleted     = 0x0001,
+        FieldName        = 0x0002,
+        FieldType        = 0x0004,
+        FieldInfo        = 0x0008, // manufacturer, model id and sw version
+        FieldMode        = 0x0010,
+        FieldState       = 0x0020,
+        FieldConfig      = 0x0040,
+        FieldFingerprint = 0x0080,
+
+        // fields which are stored in the database
+        FieldsDb = FieldId | FieldUniqueId | FieldDeleted | FieldName | FieldType | FieldInfo |
+                   FieldMode | FieldState | FieldConfig | FieldFingerprint,
+        // fields which appear in the REST state object
+        FieldsRestState = FieldType | FieldState | FieldConfig,
+        // fields which appear in the REST config object
+        FieldsRestConfig = FieldType | FieldConfig,
+        // fields which appear as REST attributes
+        FieldsRestAttr = FieldUniqueId | FieldName | FieldType | FieldInfo | FieldMode | FieldFingerprint
+    };
+
     Sensor();
 
     DeletedState deletedState() const;
@@ -160,10 +242,16 @@ public:
     static SensorConfig jsonToConfig(const QString &json);
     SensorFingerprint &fingerPrint();
     const SensorFingerprint &fingerPrint() const;
+    ValueSignificance significance() const;
+    static bool hasSignificanceDefaults(const QString &type);
+    ValueFilter &valueFilter();
 
     QVector<QString> sensorTypes;
     QString etag;
 
+protected:
+    bool compileDeviceProfile(const DeviceProfileDatabase &db, CompiledDeviceProfile &profile) const;
+
 private:
     DeletedState m_deletedstate;
     QString m_name;
@@ -175,6 +263,7 @@ private:
     SensorConfig m_config;
     SensorFingerprint m_fingerPrint;
     uint8_t m_mode;
+    ValueFilter m_valueFilter; // not persisted
 };
 
 #endif // SENSOR_H
@@ -0,0 +1,565 @@
+/*
+ * Copyright (c) 2016 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <algorithm>
+#include <QString>
+#include <QVariantMap>
+#include "de_web_plugin.h"
+#include "de_web_plugin_private.h"
+
+/*! Inits the simulated devices.
+
+    For load tests the plugin can host virtual lights and switches in
+    addition to the real network:
+
+    --sim-lights=<n>           number of virtual color lights
+    --sim-switches=<n>         number of virtual switches
+    --sim-latency=<ms>         mean latency per hop (default 30)
+    --sim-loss=<percent>       lost transmissions (default 0)
+    --sim-event-interval=<ms>  mean interval of switch events (default 60000)
+
+    Virtual devices use the extended address range SIM_EXT_PREFIX and
+    REST ids starting at SIM_ID_BASE, they aren't stored in the database.
+    Requests of the task queue to virtual devices are answered here with
+    APS confirms and ZCL responses after a latency which depends on the
+    number of hops; groupcasts are applied to the virtual members as well.
+    Switches send On/Off toggle commands to the gateway.
+
+    The simulation doesn't need a ZigBee network, if the gateway isn't
+    connected only the requests to virtual devices are processed.
+
+    The simulation is only part of builds with CONFIG+=simulation.
+ */
+void DeRestPluginPrivate::initSimulation()
+{
+    simTimer = 0;
+    simRequests = 0;
+    simLost = 0;
+    simIndications = 0;
+    simLatencySum = 0;
+
+    const int lights = deCONZ::appArgumentNumeric("--sim-lights", 0);
+    const int switches = deCONZ::appArgumentNumeric("--sim-switches", 0);
+
+    if (lights <= 0 && switches <= 0)
+    {
+        return;
+    }
+
+    simLatency = qMax(1, deCONZ::appArgumentNumeric("--sim-latency", SIM_DEFAULT_LATENCY));
+    simLoss = qBound(0, deCONZ::appArgumentNumeric("--sim-loss", 0), 100);
+    simEventInterval = qMax(100, deCONZ::appArgumentNumeric("--sim-event-interval", SIM_DEFAULT_EVENT_INTERVAL));
+
+    const qint64 now = clockMonotonicMs();
+    const int count = qMax(0, lights) + qMax(0, switches);
+    simDevices.reserve(count);
+    nodes.reserve(nodes.size() + qMax(0, lights));
+    sensors.reserve(sensors.size() + qMax(0, switches));
+
+    for (int n = 0; n < count; n++)
+    {
+        SimDevice dev;
+        dev.extAddr = SIM_EXT_PREFIX | (quint64)n;
+        dev.nwkAddr = SIM_NWK_BASE + n;
+        dev.hops = 1 + (n % SIM_MAX_HOPS);
+        dev.isSwitch = n >= lights;
+
+        union _a
+        {
+            quint8 bytes[8];
+            quint64 mac;
+        } a;
+        a.mac = dev.extAddr;
+
+        QString uid;
+        uid.sprintf("%02X:%02X:%02X:%02X:%02X:%02X:%02X:%02X-%02X",
+                    a.bytes[7], a.bytes[6], a.bytes[5], a.bytes[4],
+                    a.bytes[3], a.bytes[2], a.bytes[1], a.bytes[0],
+                    dev.isSwitch ? 0x01 : SIM_ENDPOINT);
+
+        if (!dev.isSwitch)
+        {
+            deCONZ::SimpleDescriptor sd;
+            sd.setEndpoint(SIM_ENDPOINT);
+            sd.setProfileId(HA_PROFILE_ID);
+            sd.setDeviceId(DEV_ID_HA_COLOR_DIMMABLE_LIGHT);
+
+            LightNode lightNode;
+            lightNode.setNode(0);
+            lightNode.address().setExt(dev.extAddr);
+            lightNode.address().setNwk(dev.nwkAddr);
+            lightNode.setHaEndpoint(sd);
+            lightNode.setId(QString::number(SIM_ID_BASE + n));
+            lightNode.setUniqueId(uid);
+            lightNode.setName(QString("Sim light %1").arg(n + 1));
+            lightNode.setManufacturerName("dresden elektronik");
+            lightNode.setModelId("SimLight");
+            lightNode.setSwBuildId("1.0");
+            lightNode.setIsAvailable(true);
+            lightNode.setLastRead(idleTotalCounter);
+            updateEtag(lightNode.etag);
+            nodes.push_back(lightNode);
+            indexLight(nodes.size() - 1);
+        }
+        else
+        {
+            Sensor sensor;
+            sensor.setNode(0);
+            sensor.address().setExt(dev.extAddr);
+            sensor.address().setNwk(dev.nwkAddr);
+            sensor.setId(QString::number(SIM_ID_BASE + n));
+            sensor.setUniqueId(uid + "-0006");
+            sensor.setType("ZHASwitch");
+            sensor.setName(QString("Sim switch %1").arg(n - lights + 1));
+            sensor.setManufacturer("dresden elektronik");
+            sensor.setModelId("SimSwitch");
+            sensor.setSwVersion("1.0");
+            sensor.fingerPrint().endpoint = 0x01;
+            sensor.fingerPrint().profileId = HA_PROFILE_ID;
+            sensor.fingerPrint().deviceId = DEV_ID_ONOFF_SWITCH;
+            sensor.fingerPrint().outClusters.push_back(ONOFF_CLUSTER_ID);
+            sensor.setIsAvailable(true);
+            updateEtag(sensor.etag);
+            sensors.push_back(sensor);
+            indexSensor(sensors.size() - 1);
+
+            dev.nextEvent = now + (qrand() % simEventInterval);
+        }
+
+        simDevices.push_back(dev);
+    }
+
+    DBG_Printf(DBG_INFO, "simulation with %d lights and %d switches, latency %d ms/hop, loss %d%%\n",
+               qMax(0, lights), qMax(0, switches), simLatency, simLoss);
+
+    simTimer = new QTimer(this);
+    simTimer->setSingleShot(true);
+    connect(simTimer, SIGNAL(timeout()),
+            this, SLOT(simTimerFired()));
+    simTimer->start(SIM_TICK);
+}
+
+/*! Returns true if \p extAddr belongs to a virtual device.
+ */
+bool DeRestPluginPrivate::simIsVirtual(quint64 extAddr) const
+{
+    return !simDevices.empty() && (extAddr & SIM_EXT_MASK) == SIM_EXT_PREFIX;
+}
+
+/*! Releases the tasks of \p list which aren't addressed to virtual devices or groups.
+    Used when the gateway isn't in a network, the simulation continues then.
+ */
+void DeRestPluginPrivate::simReleaseRealTasks(std::list<TaskItem> &list)
+{
+    std::list<TaskItem>::iterator i = list.begin();
+
+    while (i != list.end())
+    {
+        const deCONZ::ApsDataRequest &req = i->req;
+
+        if (req.dstAddressMode() == deCONZ::ApsGroupAddress ||
+            (req.dstAddress().hasExt() && simIsVirtual(req.dstAddress().ext())))
+        {
+            ++i;
+            continue;
+        }
+
+        std::list<TaskItem>::iterator next = i;
+        ++next;
+        releaseTask(list, i);
+        i = next;
+    }
+}
+
+/*! Returns a random delay of one transmission to \p dev.
+ */
+qint64 DeRestPluginPrivate::simHopDelay(const SimDevice &dev)
+{
+    // each hop takes between 0.5 and 1.5 times the configured latency
+    return dev.hops * (simLatency / 2 + (qrand() % (simLatency + 1)));
+}
+
+/*! Takes over an APS request to virtual devices.
+    Groupcasts are applied to the virtual members, the caller sends them
+    to the real network as well.
+    \return true if the request was addressed to a virtual device
+ */
+bool DeRestPluginPrivate::simApsdeDataRequest(const deCONZ::ApsDataRequest &req)
+{
+    if (simDevices.empty())
+    {
+        return false;
+    }
+
+    const qint64 now = clockMonotonicMs();
+
+    if (req.dstAddressMode() == deCONZ::ApsGroupAddress)
+    {
+        std::vector<LightNode>::iterator i = nodes.begin();
+        std::vector<LightNode>::iterator end = nodes.end();
+
+        for (; i != end; ++i)
+        {
+            if (!simIsVirtual(i->address().ext()) || !isLightNodeInGroup(&*i, req.dstAddress().group()))
+            {
+                continue;
+            }
+
+            SimDevice &dev = simDevices[i->address().ext() & ~SIM_EXT_MASK];
+
+            if ((qrand() % 100) >= simLoss) // groupcasts aren't acknowledged
+            {
+                QByteArray rsp;
+                simHandleZcl(dev, req, rsp); // no responses to groupcasts
+            }
+        }
+
+        return false;
+    }
+
+    if (!req.dstAddress().hasExt() || !simIsVirtual(req.dstAddress().ext()))
+    {
+        return false;
+    }
+
+    const size_t idx = req.dstAddress().ext() & ~SIM_EXT_MASK;
+
+    if (idx >= simDevices.size())
+    {
+        return false;
+    }
+
+    SimDevice &dev = simDevices[idx];
+    const bool acked = (req.txOptions() & deCONZ::ApsTxAcknowledgedTransmission);
+    bool delivered = false;
+    qint64 delay = 0;
+
+    simRequests++;
+
+    // APS retries until acknowledged
+    for (int attempt = 0; attempt <= (acked ? SIM_APS_RETRIES : 0); attempt++)
+    {
+        delay += simHopDelay(dev) * (acked ? 2 : 1);
+
+        if ((qrand() % 100) >= simLoss)
+        {
+            delivered = true;
+            break;
+        }
+    }
+
+    SimEvent conf;
+    conf.type = SimEvent::TypeConfirm;
+    conf.apsId = req.id();
+    conf.status = (delivered || !acked) ? deCONZ::ApsSuccessStatus : deCONZ::ApsNoAckStatus;
+    simEvents.insert(std::make_pair(now + (acked ? delay : 1), conf));
+
+    if (!delivered)
+    {
+        simLost++;
+        return true;
+    }
+
+    simLatencySum += delay;
+
+    QByteArray rsp;
+
+    if (simHandleZcl(dev, req, rsp))
+    {
+        simQueueIndication(idx, req.clusterId(), rsp, now + delay + simHopDelay(dev));
+    }
+
+    return true;
+}
+
+/*! Applies a ZCL command to a virtual light.
+    \param rsp the ZCL response frame if any
+    \return true if \p rsp shall be sent
+ */
+bool DeRestPluginPrivate::simHandleZcl(SimDevice &dev, const deCONZ::ApsDataRequest &req, QByteArray &rsp)
+{
+    if (dev.isSwitch || (req.profileId() != HA_PROFILE_ID && req.profileId() != ZLL_PROFILE_ID))
+    {
+        return false;
+    }
+
+    FrameReader reader(req.asdu());
+    const quint8 frameControl = reader.readU8();
+
+    if (frameControl & 0x04) // manufacturer specific
+    {
+        reader.readU16();
+    }
+
+    const quint8 seq = reader.readU8();
+    const quint8 commandId = reader.readU8();
+
+    if (!reader.isOk())
+    {
+        return false;
+    }
+
+    deCONZ::ZclFrame zclFrame;
+    zclFrame.setSequenceNumber(seq);
+    zclFrame.setFrameControl(deCONZ::ZclFCProfileCommand |
+                             deCONZ::ZclFCDirectionServerToClient |
+                             deCONZ::ZclFCDisableDefaultResponse);
+
+    QDataStream stream(&zclFrame.payload(), QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    if ((frameControl & 0x03) == deCONZ::ZclFCProfileCommand)
+    {
+        if (commandId != deCONZ::ZclReadAttributesId)
+        {
+            return false;
+        }
+
+        zclFrame.setCommandId(deCONZ::ZclReadAttributesResponseId);
+
+        while (reader.remaining() >= 2)
+        {
+            const quint16 attrId = reader.readU16();
+            stream << attrId;
+
+            if (req.clusterId() == ONOFF_CLUSTER_ID && attrId == 0x0000)
+            {
+                stream << (quint8)deCONZ::ZclSuccessStatus << (quint8)deCONZ::ZclBoolean << (quint8)dev.on;
+            }
+            else if (req.clusterId() == LEVEL_CLUSTER_ID && attrId == 0x0000)
+            {
+                stream << (quint8)deCONZ::ZclSuccessStatus << (quint8)deCONZ::Zcl8BitUint << dev.level;
+            }
+            else if (req.clusterId() == COLOR_CLUSTER_ID && (attrId == 0x0003 || attrId == 0x0004))
+            {
+                stream << (quint8)deCONZ::ZclSuccessStatus << (quint8)deCONZ::Zcl16BitUint << (attrId == 0x0003 ? dev.x : dev.y);
+            }
+            else
+            {
+                stream << (quint8)0x86; // unsupported attribute
+            }
+        }
+    }
+    else
+    {
+        switch (req.clusterId())
+        {
+        case ONOFF_CLUSTER_ID:
+            if (commandId == 0x00 || commandId == 0x40) { dev.on = false; }
+            else if (commandId == 0x01) { dev.on = true; }
+            else if (commandId == 0x02) { dev.on = !dev.on; }
+            break;
+
+        case LEVEL_CLUSTER_ID:
+            if (commandId == 0x00 || commandId == 0x04) // Move to level (with on/off)
+            {
+                dev.level = reader.readU8();
+                if (commandId == 0x04)
+                {
+                    dev.on = dev.level > 0;
+                }
+            }
+            break;
+
+        case COLOR_CLUSTER_ID:
+            if (commandId == 0x07) // Move to color
+            {
+                dev.x = reader.readU16();
+                dev.y = reader.readU16();
+            }
+            break;
+
+        case GROUP_CLUSTER_ID:
+            if (commandId == 0x00 || commandId == 0x03) // Add group, Remove group
+            {
+                const quint16 groupId = reader.readU16();
+                std::vector<quint16>::iterator g = std::find(dev.groups.begin(), dev.groups.end(), groupId);
+                quint8 status = deCONZ::ZclSuccessStatus;
+
+                if (commandId == 0x00 && g == dev.groups.end())
+                {
+                    if (dev.groups.size() < SIM_GROUP_CAPACITY) { dev.groups.push_back(groupId); }
+                    else { status = 0x89; } // insufficient space
+                }
+                else if (commandId == 0x03)
+                {
+                    if (g != dev.groups.end()) { dev.groups.erase(g); }
+                    else { status = 0x8B; } // not found
+                }
+
+                zclFrame.setFrameControl(deCONZ::ZclFCClusterCommand |
+                                         deCONZ::ZclFCDirectionServerToClient |
+                                         deCONZ::ZclFCDisableDefaultResponse);
+                zclFrame.setCommandId(commandId);
+                stream << status;
+                stream << groupId;
+            }
+            else if (commandId == 0x02) // Get group membership
+            {
+                zclFrame.setFrameControl(deCONZ::ZclFCClusterCommand |
+                                         deCONZ::ZclFCDirectionServerToClient |
+                                         deCONZ::ZclFCDisableDefaultResponse);
+                zclFrame.setCommandId(0x02);
+                stream << (quint8)(SIM_GROUP_CAPACITY - dev.groups.size());
+                stream << (quint8)dev.groups.size();
+                for (size_t g = 0; g < dev.groups.size(); g++)
+                {
+                    stream << dev.groups[g];
+                }
+            }
+            else if (commandId == 0x04) // Remove all groups
+            {
+                dev.groups.clear();
+            }
+            break;
+
+        default:
+            break;
+        }
+
+        if (req.clusterId() == GROUP_CLUSTER_ID && (commandId == 0x00 || commandId == 0x02 || commandId == 0x03))
+        {
+            // cluster specific response
+        }
+        else if (frameControl & deCONZ::ZclFCDisableDefaultResponse)
+        {
+            return false;
+        }
+
+        zclFrame.setCommandId(deCONZ::ZclDefaultResponseId);
+        stream << commandId;
+        stream << (quint8)deCONZ::ZclSuccessStatus;
+    }
+
+    QDataStream out(&rsp, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+    zclFrame.writeToStream(out);
+    return true;
+}
+
+/*! Queues an indication from a virtual device to the gateway.
+    \param due clockMonotonicMs() when the indication is delivered
+ */
+void DeRestPluginPrivate::simQueueIndication(size_t device, quint16 clusterId, const QByteArray &asdu, qint64 due)
+{
+    SimEvent ind;
+    ind.type = SimEvent::TypeIndication;
+    ind.device = device;
+    ind.srcEndpoint = simDevices[device].isSwitch ? 0x01 : SIM_ENDPOINT;
+    ind.profileId = HA_PROFILE_ID;
+    ind.clusterId = clusterId;
+    ind.asdu = asdu;
+    simEvents.insert(std::make_pair(due, ind));
+}
+
+/*! Delivers the due confirms and indications and creates switch events.
+ */
+void DeRestPluginPrivate::simTimerFired()
+{
+    const qint64 now = clockMonotonicMs();
+
+    // switch events
+    for (size_t n = 0; n < simDevices.size(); n++)
+    {
+        SimDevice &dev = simDevices[n];
+
+        if (!dev.isSwitch || dev.nextEvent > now)
+        {
+            continue;
+        }
+
+        dev.nextEvent = now + simEventInterval / 2 + (qrand() % simEventInterval);
+
+        deCONZ::ZclFrame zclFrame;
+        zclFrame.setSequenceNumber(zclSeq++);
+        zclFrame.setCommandId(0x02); // Toggle
+        zclFrame.setFrameControl(deCONZ::ZclFCClusterCommand |
+                                 deCONZ::ZclFCDirectionClientToServer |
+                                 deCONZ::ZclFCDisableDefaultResponse);
+
+        QByteArray asdu;
+        QDataStream stream(&asdu, QIODevice::WriteOnly);
+        stream.setByteOrder(QDataStream::LittleEndian);
+        zclFrame.writeToStream(stream);
+
+        simQueueIndication(n, ONOFF_CLUSTER_ID, asdu, now + simHopDelay(dev));
+    }
+
+    // deliver, the handlers might queue new events
+    while (!simEvents.empty() && simEvents.begin()->first <= now)
+    {
+        const SimEvent ev = simEvents.begin()->second;
+        simEvents.erase(simEvents.begin());
+
+        if (ev.type == SimEvent::TypeConfirm)
+        {
+            handleTaskConfirm(ev.apsId, ev.status);
+            continue;
+        }
+
+        const SimDevice &dev = simDevices[ev.device];
+        deCONZ::ApsDataIndication ind;
+        ind.setSrcAddressMode(deCONZ::ApsNwkAddress);
+        ind.srcAddress().setExt(dev.extAddr);
+        ind.srcAddress().setNwk(dev.nwkAddr);
+        ind.setSrcEndpoint(ev.srcEndpoint);
+        ind.setDstAddressMode(deCONZ::ApsNwkAddress);
+        ind.dstAddress().setNwk(0x0000);
+        ind.setDstEndpoint(endpoint());
+        ind.setProfileId(ev.profileId);
+        ind.setClusterId(ev.clusterId);
+        ind.setAsdu(ev.asdu);
+        ind.setLinkQuality(255 - dev.hops * 30);
+
+        simIndications++;
+        apsdeDataIndication(ind);
+    }
+
+    simTimer->start(SIM_TICK);
+}
+
+/*! GET /api/<apikey>/config/simulation
+    \return REQ_READY_SEND
+ */
+int DeRestPluginPrivate::getSimulation(const ApiRequest &req, ApiResponse &rsp)
+{
+    Q_UNUSED(req);
+
+    int switches = 0;
+
+    for (size_t i = 0; i < simDevices.size(); i++)
+    {
+        if (simDevices[i].isSwitch)
+        {
+            switches++;
+        }
+    }
+
+    rsp.map["active"] = !simDevices.empty();
+    rsp.map["lights"] = (double)(simDevices.size() - switches);
+    rsp.map["switches"] = (double)switches;
+
+    if (!simDevices.empty())
+    {
+        const qint64 delivered = simRequests - simLost;
+        rsp.map["latency"] = (double)simLatency;
+        rsp.map["loss"] = (double)simLoss;
+        rsp.map["requests"] = (double)simRequests;
+        rsp.map["lost"] = (double)simLost;
+        rsp.map["indications"] = (double)simIndications;
+        rsp.map["pending"] = (double)simEvents.size();
+        rsp.map["avgdelay"] = delivered > 0 ? (double)(simLatencySum / delivered) : 0.0;
+        rsp.map["runningtasks"] = (double)runningTasks.size();
+        rsp.map["queuedtasks"] = (double)tasks.size();
+    }
+
+    rsp.httpStatus = HttpStatusOk;
+    return REQ_READY_SEND;
+}
@@ -0,0 +1,316 @@
+/*
+ * Copyright (c) 2016 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include "de_web_plugin.h"
+#include "de_web_plugin_private.h"
+
+/*! Returns the attribute id a profile wide ZCL command refers to.
+    \return the attribute id or -1 if the command doesn't carry one
+ */
+static int mailboxAttributeId(const TaskItem &task)
+{
+    const QByteArray &payload = task.zclFrame.payload();
+    int offset = -1;
+
+    if (task.zclFrame.commandId() == deCONZ::ZclWriteAttributesId)
+    {
+        offset = 0; // attribute id, type, value
+    }
+    else if (task.zclFrame.commandId() == deCONZ::ZclConfigureReportingId)
+    {
+        offset = 1; // direction, attribute id, ...
+    }
+
+    if (offset < 0 || payload.size() < offset + 2)
+    {
+        return -1;
+    }
+
+    return (quint8)payload[offset] | ((quint8)payload[offset + 1] << 8);
+}
+
+/*! Returns true if task \p b makes the held back task \p a obsolete.
+ */
+static bool mailboxSupersedes(const TaskItem &a, const TaskItem &b)
+{
+    if (a.taskType != b.taskType ||
+        a.req.dstEndpoint() != b.req.dstEndpoint() ||
+        a.req.profileId() != b.req.profileId() ||
+        a.req.clusterId() != b.req.clusterId() ||
+        a.zclFrame.isProfileWideCommand() != b.zclFrame.isProfileWideCommand() ||
+        a.zclFrame.commandId() != b.zclFrame.commandId())
+    {
+        return false;
+    }
+
+    if (!a.zclFrame.isProfileWideCommand())
+    {
+        return true; // newer cluster command of same kind
+    }
+
+    if (a.zclFrame.commandId() == deCONZ::ZclReadAttributesId)
+    {
+        return a.zclFrame.payload() == b.zclFrame.payload();
+    }
+
+    const int attrId = mailboxAttributeId(a);
+    return attrId != -1 && attrId == mailboxAttributeId(b);
+}
+
+/*! Stores \p task in \p item without references to external objects.
+    Lights and nodes might be removed while the task is held back.
+ */
+static void mailboxStoreTask(MailboxItem &item, const TaskItem &task)
+{
+    item.task = task;
+    item.lightHandle = task.lightNode ? task.lightNode->handle() : 0;
+    item.task.client = 0;
+    item.task.node = 0;
+    item.task.lightNode = 0;
+    item.task.cluster = 0;
+}
+
+/*! Returns true if \p node doesn't receive while idle.
+ */
+bool DeRestPluginPrivate::isSleepyEndDevice(const deCONZ::Node *node)
+{
+    if (!node || !node->isEndDevice())
+    {
+        return false;
+    }
+
+    if (node->nodeDescriptor().isNull())
+    {
+        return true; // assume the worst for end-devices
+    }
+
+    return !node->nodeDescriptor().receiverOnWhenIdle();
+}
+
+/*! Returns the mailbox of a device or 0 if it has none.
+ */
+DeviceMailbox *DeRestPluginPrivate::getMailbox(quint64 extAddr)
+{
+    std::vector<DeviceMailbox>::iterator i = mailboxes.begin();
+    std::vector<DeviceMailbox>::iterator end = mailboxes.end();
+
+    for (; i != end; ++i)
+    {
+        if (i->extAddr == extAddr)
+        {
+            return &(*i);
+        }
+    }
+
+    return 0;
+}
+
+/*! Returns true if a sleepy device can't be reached right now.
+    A sleepy device polls its parent shortly after it has sent something,
+    during this window commands are delivered directly.
+    \param extAddr the address of the device
+ */
+bool DeRestPluginPrivate::isMailboxDeviceAsleep(quint64 extAddr)
+{
+    deCONZ::Node *node = getNodeForAddress(extAddr);
+
+    if (!isSleepyEndDevice(node))
+    {
+        return false;
+    }
+
+    DeviceMailbox *mb = getMailbox(extAddr);
+
+    if (!mb)
+    {
+        DeviceMailbox m;
+        m.extAddr = extAddr;
+        m.nwkAddr = node->address().nwk();
+        mailboxes.push_back(m);
+        return true;
+    }
+
+    mb->nwkAddr = node->address().nwk(); // might change after rejoin
+
+    if (mb->lastRx < 0)
+    {
+        return true;
+    }
+
+    return (starttimeRef.elapsed() - mb->lastRx) > MAILBOX_AWAKE_WINDOW;
+}
+
+/*! Holds back a task for a sleepy end-device until it wakes up.
+    A held back task which is superseded by \p task is replaced.
+    \param task the task which should be sent
+    \return true if the task was put in the mailbox
+ */
+bool DeRestPluginPrivate::mailboxHoldTask(const TaskItem &task)
+{
+    if (task.req.dstAddressMode() != deCONZ::ApsExtAddress || !task.req.dstAddress().hasExt())
+    {
+        return false;
+    }
+
+    const quint64 extAddr = task.req.dstAddress().ext();
+
+    if (!isMailboxDeviceAsleep(extAddr))
+    {
+        return false;
+    }
+
+    DeviceMailbox *mb = getMailbox(extAddr);
+    DBG_Assert(mb != 0);
+    if (!mb)
+    {
+        return false;
+    }
+
+    const qint64 now = starttimeRef.elapsed();
+    mailboxPurgeExpired(*mb, now);
+
+    std::list<MailboxItem>::iterator i = mb->items.begin();
+    std::list<MailboxItem>::iterator end = mb->items.end();
+
+    for (; i != end; ++i)
+    {
+        if (mailboxSupersedes(i->task, task))
+        {
+            DBG_Printf(DBG_INFO, "mailbox 0x%016llX replace held command cluster 0x%04X\n", extAddr, task.req.clusterId());
+            mailboxStoreTask(*i, task);
+            i->expires = now + MAILBOX_EXPIRY_TIME;
+            return true;
+        }
+    }
+
+    if (mb->items.size() >= MAILBOX_MAX_ITEMS)
+    {
+        DBG_Printf(DBG_INFO, "mailbox 0x%016llX full\n", extAddr);
+        return false;
+    }
+
+    MailboxItem item;
+    item.expires = now + MAILBOX_EXPIRY_TIME;
+    mailboxStoreTask(item, task);
+    mb->items.push_back(item);
+
+    DBG_Printf(DBG_INFO, "mailbox 0x%016llX hold command cluster 0x%04X (%u held)\n", extAddr, task.req.clusterId(), (uint)mb->items.size());
+
+    return true;
+}
+
+/*! Drops commands from mailbox \p mb which are held back too long.
+ */
+void DeRestPluginPrivate::mailboxPurgeExpired(DeviceMailbox &mb, qint64 now)
+{
+    std::list<MailboxItem>::iterator i = mb.items.begin();
+
+    while (i != mb.items.end())
+    {
+        if (i->expires < now)
+        {
+            DBG_Printf(DBG_INFO, "mailbox 0x%016llX drop expired command cluster 0x%04X\n", mb.extAddr, i->task.req.clusterId());
+            i = mb.items.erase(i);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
+
+/*! Looks up the light and node of the held back task in \p item.
+    \return false if the light was removed meanwhile
+ */
+bool DeRestPluginPrivate::mailboxRestoreTask(const DeviceMailbox &mb, MailboxItem &item)
+{
+    item.task.node = getNodeForAddress(mb.extAddr);
+
+    if (item.lightHandle == 0)
+    {
+        return true;
+    }
+
+    item.task.lightNode = getLightNodeForHandle(item.lightHandle);
+
+    if (!item.task.lightNode || item.task.lightNode->state() == LightNode::StateDeleted)
+    {
+        DBG_Printf(DBG_INFO, "mailbox 0x%016llX drop command cluster 0x%04X, light removed\n", mb.extAddr, item.task.req.clusterId());
+        return false;
+    }
+
+    return true;
+}
+
+/*! Notes that a device is awake and delivers its held back commands in one burst.
+    Called for every received indication, a report, check-in or Device Announce.
+    \param ind the indication from the device
+ */
+void DeRestPluginPrivate::mailboxIndication(const deCONZ::ApsDataIndication &ind)
+{
+    if (mailboxes.empty())
+    {
+        return;
+    }
+
+    std::vector<DeviceMailbox>::iterator mb = mailboxes.begin();
+    std::vector<DeviceMailbox>::iterator end = mailboxes.end();
+
+    for (; mb != end; ++mb)
+    {
+        if (ind.srcAddress().hasExt())
+        {
+            if (mb->extAddr == ind.srcAddress().ext())
+            {
+                break;
+            }
+        }
+        else if (mb->nwkAddr == ind.srcAddress().nwk())
+        {
+            break;
+        }
+    }
+
+    if (mb == end)
+    {
+        return;
+    }
+
+    const qint64 now = starttimeRef.elapsed();
+    mb->lastRx = now;
+    mailboxPurgeExpired(*mb, now);
+
+    if (mb->items.empty())
+    {
+        return;
+    }
+
+    DBG_Printf(DBG_INFO, "mailbox 0x%016llX device awake, deliver %u commands\n", mb->extAddr, (uint)mb->items.size());
+
+    std::list<MailboxItem>::iterator i = mb->items.begin();
+
+    while (i != mb->items.end())
+    {
+        if (!mailboxRestoreTask(*mb, *i))
+        {
+            i = mb->items.erase(i);
+        }
+        else if (addTask(i->task))
+        {
+            i = mb->items.erase(i);
+        }
+        else
+        {
+            break; // task queue full, keep the rest for the next wake up
+        }
+    }
+
+    processTasks();
+}
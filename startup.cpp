@@ -0,0 +1,352 @@
+/*
+ * Copyright (c) 2016 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include "de_web_plugin.h"
+#include "de_web_plugin_private.h"
+
+#define STARTUP_TICK            1000 // ms
+#define STARTUP_STAGE_TIMEOUT   (120 * 1000) // ms
+#define STARTUP_BUDGET_CRITICAL   8 // lights with pending reads at a time
+#define STARTUP_BUDGET_MEMBERSHIP 4
+#define STARTUP_BUDGET_BINDINGS   2
+
+/*! Inits the startup pipeline.
+
+    After a restart the state of the network is read in stages, so that the
+    most important information arrives first:
+
+    1. load: database and node cache are loaded, the network is up
+    2. reachability: availability of the lights is taken from the node cache
+    3. state: on/off, brightness and color of all lights
+    4. membership: groups and scenes
+    5. bindings: binding tables
+    6. ready: the regular idle processing takes over
+
+    Each read stage only keeps a limited number of lights busy at a time.
+ */
+void DeRestPluginPrivate::initStartup()
+{
+    startupStage = StartupLoadDb;
+    startupIter = 0;
+    startupNodeCount = -1;
+
+    startupStages[StartupCriticalState].budget = STARTUP_BUDGET_CRITICAL;
+    startupStages[StartupMembership].budget = STARTUP_BUDGET_MEMBERSHIP;
+    startupStages[StartupBindings].budget = STARTUP_BUDGET_BINDINGS;
+    startupStages[StartupLoadDb].startTime = 0; // started with the plugin
+
+    startupTimer = new QTimer(this);
+    startupTimer->setSingleShot(true);
+    connect(startupTimer, SIGNAL(timeout()),
+            this, SLOT(startupTimerFired()));
+    startupTimer->start(STARTUP_TICK);
+}
+
+/*! Returns true if the startup pipeline has finished.
+ */
+bool DeRestPluginPrivate::isStartupReady() const
+{
+    return startupStage == StartupReady;
+}
+
+/*! Returns the READ_* flags which are read by a stage.
+ */
+uint32_t DeRestPluginPrivate::startupStageReadFlags(StartupStage stage)
+{
+    switch (stage)
+    {
+    case StartupCriticalState: return READ_ON_OFF | READ_LEVEL | READ_COLOR;
+    case StartupMembership:    return READ_GROUPS | READ_SCENES | READ_SCENE_DETAILS;
+    case StartupBindings:      return READ_BINDING_TABLE;
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+/*! Returns the READ_* flags which may be processed right now.
+    Reads which belong to a later stage are held back.
+ */
+uint32_t DeRestPluginPrivate::startupAllowedReads() const
+{
+    uint32_t allowed = 0xFFFFFFFFUL;
+
+    for (int stage = startupStage + 1; stage < StartupReady; stage++)
+    {
+        allowed &= ~startupStageReadFlags(static_cast<StartupStage>(stage));
+    }
+
+    return allowed;
+}
+
+/*! Returns the name of a stage as used in the readiness endpoint.
+ */
+const char *DeRestPluginPrivate::startupStageToString(StartupStage stage)
+{
+    switch (stage)
+    {
+    case StartupLoadDb:        return "load";
+    case StartupReachability:  return "reachability";
+    case StartupCriticalState: return "state";
+    case StartupMembership:    return "membership";
+    case StartupBindings:      return "bindings";
+    case StartupReady:         return "ready";
+    default:
+        break;
+    }
+
+    return "unknown";
+}
+
+/*! Returns the READ_* flags of \p lightNode which the current stage still waits for.
+ */
+uint32_t DeRestPluginPrivate::startupPendingReads(LightNode *lightNode)
+{
+    const uint32_t flags = startupStageReadFlags(startupStage);
+    uint32_t pending = 0;
+
+    for (uint32_t bit = 1; bit != 0 && bit <= flags; bit <<= 1)
+    {
+        if ((flags & bit) && lightNode->mustRead(bit))
+        {
+            pending |= bit;
+        }
+    }
+
+    if (lightNode->groups().empty())
+    {
+        pending &= ~(READ_SCENES | READ_SCENE_DETAILS); // won't be read without groups
+    }
+
+    return pending;
+}
+
+/*! Finishes the current stage and starts the next one.
+ */
+void DeRestPluginPrivate::startupNextStage(bool timedOut)
+{
+    const qint64 now = starttimeRef.elapsed();
+    StartupStageInfo &info = startupStages[startupStage];
+
+    info.duration = now - info.startTime;
+    info.timedOut = timedOut;
+
+    DBG_Printf(DBG_INFO, "startup stage %s %s after %d ms (%d items)\n", startupStageToString(startupStage),
+               timedOut ? "timed out" : "done", (int)info.duration, info.items);
+
+    startupStage = static_cast<StartupStage>(startupStage + 1);
+    startupIter = 0;
+    startupStages[startupStage].startTime = now;
+
+    // reads of this stage which were requested earlier are driven by the budget
+    const uint32_t flags = startupStageReadFlags(startupStage);
+
+    if (flags != 0)
+    {
+        std::vector<LightNode>::iterator i = nodes.begin();
+        std::vector<LightNode>::iterator end = nodes.end();
+
+        for (; i != end; ++i)
+        {
+            i->clearRead(flags);
+        }
+    }
+
+    if (startupStage == StartupReady)
+    {
+        startupStages[StartupReady].duration = 0;
+
+        // everything was just read, the idle timer can start over
+        std::vector<LightNode>::iterator i = nodes.begin();
+        std::vector<LightNode>::iterator end = nodes.end();
+
+        for (; i != end; ++i)
+        {
+            i->setLastRead(idleTotalCounter);
+        }
+
+        DBG_Printf(DBG_INFO, "startup ready after %d ms\n", (int)now);
+        updateEtag(gwConfigEtag);
+    }
+}
+
+/*! Drives the startup pipeline.
+ */
+void DeRestPluginPrivate::startupTimerFired()
+{
+    Q_Q(DeRestPlugin);
+    StartupStageInfo &info = startupStages[startupStage];
+    const qint64 now = starttimeRef.elapsed();
+
+    if (startupStage == StartupReady)
+    {
+        return;
+    }
+
+    if (startupStage == StartupLoadDb)
+    {
+        // the database was read on construction, nodes of the node cache
+        // are added as they are reported, wait until the number settles
+        const int count = (int)(nodes.size() + sensors.size());
+
+        if (isInNetwork() && count == startupNodeCount)
+        {
+            info.items = count;
+            startupNextStage(false);
+        }
+        else if ((now - info.startTime) > STARTUP_STAGE_TIMEOUT)
+        {
+            // not in network or the node cache keeps growing, don't hold back the lights forever
+            info.items = count;
+            startupNextStage(true);
+        }
+        startupNodeCount = count;
+    }
+    else if (startupStage == StartupReachability)
+    {
+        std::vector<LightNode>::iterator i = nodes.begin();
+        std::vector<LightNode>::iterator end = nodes.end();
+
+        for (; i != end; ++i)
+        {
+            if (i->node())
+            {
+                nodeZombieStateChanged(i->node());
+            }
+
+            if (i->isAvailable())
+            {
+                info.items++;
+            }
+        }
+
+        startupNextStage(false);
+    }
+    else
+    {
+        const uint32_t flags = startupStageReadFlags(startupStage);
+        int pending = 0;
+
+        std::vector<LightNode>::iterator i = nodes.begin();
+        std::vector<LightNode>::iterator end = nodes.end();
+
+        for (; i != end; ++i)
+        {
+            if (i->isAvailable() && startupPendingReads(&*i) != 0)
+            {
+                pending++;
+            }
+        }
+
+        // hand out reads within the budget of the stage
+        while (pending < info.budget && startupIter < nodes.size())
+        {
+            LightNode *lightNode = &nodes[startupIter];
+            startupIter++;
+
+            if (!lightNode->isAvailable() || lightNode->state() == LightNode::StateDeleted)
+            {
+                continue;
+            }
+
+            uint32_t readFlags = flags;
+
+            if (startupStage == StartupMembership)
+            {
+                readFlags &= ~READ_SCENE_DETAILS; // follows the scene membership
+            }
+            else if (startupStage == StartupBindings && !lightNode->mgmtBindSupported())
+            {
+                continue;
+            }
+
+            lightNode->enableRead(readFlags);
+            lightNode->setNextReadTime(clockMonotonicMs());
+            info.items++;
+
+            if (startupPendingReads(lightNode) != 0)
+            {
+                pending++;
+            }
+        }
+
+        if (pending > 0)
+        {
+            q->startZclAttributeTimer(0);
+        }
+
+        if (pending == 0 && startupIter >= nodes.size())
+        {
+            startupNextStage(false);
+        }
+        else if ((now - info.startTime) > STARTUP_STAGE_TIMEOUT)
+        {
+            startupNextStage(true);
+        }
+    }
+
+    if (startupStage != StartupReady)
+    {
+        startupTimer->start(STARTUP_TICK);
+    }
+}
+
+/*! GET /api/<apikey>/config/readiness
+    Returns the progress of the startup pipeline.
+    \return REQ_READY_SEND
+ */
+int DeRestPluginPrivate::getStartupReadiness(const ApiRequest &req, ApiResponse &rsp)
+{
+    Q_UNUSED(req);
+
+    QVariantMap stages;
+
+    for (int s = StartupLoadDb; s <= StartupReady; s++)
+    {
+        const StartupStageInfo &info = startupStages[s];
+        QVariantMap stage;
+
+        if (s < startupStage || (s == StartupReady && isStartupReady()))
+        {
+            stage["state"] = info.timedOut ? QLatin1String("timeout") : QLatin1String("done");
+            stage["duration"] = (double)info.duration;
+        }
+        else if (s == startupStage)
+        {
+            stage["state"] = QLatin1String("active");
+            stage["duration"] = (double)(starttimeRef.elapsed() - info.startTime);
+        }
+        else
+        {
+            stage["state"] = QLatin1String("pending");
+        }
+
+        if (s != StartupReady)
+        {
+            stage["items"] = (double)info.items;
+        }
+
+        if (info.budget > 0)
+        {
+            stage["budget"] = (double)info.budget;
+        }
+
+        stages[startupStageToString(static_cast<StartupStage>(s))] = stage;
+    }
+
+    rsp.map["ready"] = isStartupReady();
+    rsp.map["stage"] = startupStageToString(startupStage);
+    rsp.map["uptime"] = (double)starttimeRef.elapsed();
+    rsp.map["stages"] = stages;
+    rsp.httpStatus = HttpStatusOk;
+
+    return REQ_READY_SEND;
+}
@@ -223,10 +223,11 @@ bool DeRestPluginPrivate::addTaskSetColorTemperature(TaskItem &task, uint16_t ct
 {
     // Workaround for interim FLS-H
     // which does not support the color temperature ZCL command
-    if (task.lightNode && (task.lightNode->manufacturerCode() == VENDOR_ATMEL) && (task.lightNode->modelId() == "FLS-H"))
+    if (task.lightNode && task.lightNode->hasQuirk(QuirkCtAsSaturation))
     {
-        float ctMin = 153;
-        float ctMax = 500;
+        const CompiledDeviceProfile &profile = task.lightNode->deviceProfile();
+        float ctMin = profile.ctMin;
+        float ctMax = profile.ctMax;
         float sat = ((float)ct - ctMin) / (ctMax - ctMin) * 254;
         if (sat > 254)
         {
@@ -554,7 +555,7 @@ bool DeRestPluginPrivate::addTaskSetXyColor(TaskItem &task, double x, double y)
 
         // convert xy coordinates to hue and saturation
         // due the lights itself don't support this mode yet
-        if (task.lightNode->manufacturerCode() == VENDOR_ATMEL)
+        if (task.lightNode->hasQuirk(QuirkNoColorXy))
         {
             task.lightNode->setColorXY(task.colorX, task.colorY); // update here
             return addTaskSetXyColorAsHueAndSaturation(task, x, y);
@@ -853,7 +854,7 @@ bool DeRestPluginPrivate::addTaskStoreScene(TaskItem &task, uint16_t groupId, ui
    \return true - on success
            false - on error
  */
-bool DeRestPluginPrivate::addTaskAddScene(TaskItem &task, uint16_t groupId, uint8_t sceneId, QString lightId)
+bool DeRestPluginPrivate::addTaskAddScene(TaskItem &task, uint16_t groupId, uint8_t sceneId, quint32 lightHandle)
 {
     Group *group = getGroupForId(groupId);
 
@@ -869,7 +870,7 @@ bool DeRestPluginPrivate::addTaskAddScene(TaskItem &task, uint16_t groupId, uint
 
             for ( ;l != lend; ++l)
             {
-                if (l->lid() == lightId)
+                if (l->lightHandle() == lightHandle)
                 {
                     task.taskType = TaskAddScene;
 
@@ -963,3 +964,241 @@ bool DeRestPluginPrivate::addTaskRemoveScene(TaskItem &task, uint16_t groupId, u
 
     return addTask(task);
 }
+
+/*! Adds a remove all scenes task to the queue.
+
+   \param task - the task item
+   \param groupId - the group of which all scenes shall be removed
+   \return true - on success
+           false - on error
+ */
+bool DeRestPluginPrivate::addTaskRemoveAllScenes(TaskItem &task, uint16_t groupId)
+{
+    task.taskType = TaskRemoveAllScenes;
+
+    task.req.setClusterId(SCENE_CLUSTER_ID);
+    task.req.setProfileId(HA_PROFILE_ID);
+
+    task.zclFrame.payload().clear();
+    task.zclFrame.setSequenceNumber(zclSeq++);
+    task.zclFrame.setCommandId(0x03); // remove all scenes
+    task.zclFrame.setFrameControl(deCONZ::ZclFCClusterCommand |
+                             deCONZ::ZclFCDirectionClientToServer |
+                             deCONZ::ZclFCDisableDefaultResponse);
+
+    { // payload
+        QDataStream stream(&task.zclFrame.payload(), QIODevice::WriteOnly);
+        stream.setByteOrder(QDataStream::LittleEndian);
+
+        stream << groupId;
+    }
+
+    { // ZCL frame
+        task.req.asdu().clear(); // cleanup old request data if there is any
+        QDataStream stream(&task.req.asdu(), QIODevice::WriteOnly);
+        stream.setByteOrder(QDataStream::LittleEndian);
+        task.zclFrame.writeToStream(stream);
+    }
+
+    return addTask(task);
+}
+
+/*! Returns the READ_* flags of the light state attributes which are changed by \p task.
+    Commands whose resulting state can't be predicted, like move or stop, return 0.
+ */
+uint32_t DeRestPluginPrivate::taskStateFlags(const TaskItem &task)
+{
+    switch (task.taskType)
+    {
+    case TaskSendOnOffToggle:
+        return READ_ON_OFF;
+
+    case TaskSetLevel:
+        if (task.zclFrame.commandId() == 0x04) // Move to level (with on/off)
+        {
+            return READ_LEVEL | READ_ON_OFF;
+        }
+        return READ_LEVEL;
+
+    case TaskSetHue:
+    case TaskSetEnhancedHue:
+    case TaskSetSat:
+    case TaskSetHueAndSaturation:
+    case TaskSetXyColor:
+    case TaskSetColorTemperature:
+    case TaskSetColorLoop:
+        return READ_COLOR;
+
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+/*! Decides right before \p task is sent if it requests a default response.
+    Unicast state commands to lights request one, so the new state is confirmed
+    by the device and doesn't need to be read back. Groupcasts never get one.
+    The destination is final only now, the command is built without it.
+ */
+void DeRestPluginPrivate::setStateConfirmMode(TaskItem &task)
+{
+    if (!task.lightNode ||
+        task.req.dstAddressMode() == deCONZ::ApsGroupAddress ||
+        taskStateFlags(task) == 0)
+    {
+        return;
+    }
+
+    const quint8 frameControl = task.zclFrame.frameControl() & ~deCONZ::ZclFCDisableDefaultResponse;
+
+    if (frameControl == task.zclFrame.frameControl())
+    {
+        return;
+    }
+
+    task.zclFrame.setFrameControl(frameControl);
+
+    task.req.asdu().clear();
+    QDataStream stream(&task.req.asdu(), QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    task.zclFrame.writeToStream(stream);
+}
+
+/*! Remembers a sent unicast state command until its default response arrives.
+    \param task the task which was sent
+ */
+void DeRestPluginPrivate::expectStateConfirmation(const TaskItem &task)
+{
+    if (!task.lightNode || (task.zclFrame.frameControl() & deCONZ::ZclFCDisableDefaultResponse))
+    {
+        return;
+    }
+
+    const uint32_t readFlags = taskStateFlags(task);
+
+    if (readFlags == 0)
+    {
+        return;
+    }
+
+    if (stateConfirmations.size() >= STATE_CONFIRM_MAX_ITEMS)
+    {
+        // oldest one won't be confirmed, fall back to read it
+        LightNode *lightNode = getLightNodeForAddress(stateConfirmations.front().extAddr, stateConfirmations.front().endpoint);
+        if (lightNode)
+        {
+            lightNode->enableRead(stateConfirmations.front().readFlags);
+            lightNode->setNextReadTime(clockMonotonicMs());
+            Q_Q(DeRestPlugin);
+            q->startZclAttributeTimer(0);
+        }
+        stateConfirmations.pop_front();
+    }
+
+    StateConfirmation conf;
+    conf.extAddr = task.lightNode->address().ext();
+    conf.nwkAddr = task.lightNode->address().nwk();
+    conf.endpoint = task.lightNode->haEndpoint().endpoint();
+    conf.clusterId = task.req.clusterId();
+    conf.zclSeq = task.zclFrame.sequenceNumber();
+    conf.commandId = task.zclFrame.commandId();
+    conf.readFlags = readFlags;
+    conf.timeout = idleTotalCounter + STATE_CONFIRM_TIMEOUT;
+    stateConfirmations.push_back(conf);
+
+    task.lightNode->setStateUnconfirmed(readFlags);
+}
+
+/*! Handles the default response to a unicast state command.
+    The response isn't consumed, other handlers get it as well.
+    \return true if the default response belonged to a state command
+ */
+bool DeRestPluginPrivate::handleStateConfirmation(const deCONZ::ApsDataIndication &ind, const deCONZ::ZclFrame &zclFrame)
+{
+    if (stateConfirmations.empty() || zclFrame.payload().size() < 2)
+    {
+        return false;
+    }
+
+    const quint8 commandId = zclFrame.payload().at(0);
+    const quint8 status = zclFrame.payload().at(1);
+
+    std::list<StateConfirmation>::iterator i = stateConfirmations.begin();
+    std::list<StateConfirmation>::iterator end = stateConfirmations.end();
+
+    for (; i != end; ++i)
+    {
+        if (i->zclSeq != zclFrame.sequenceNumber() ||
+            i->commandId != commandId ||
+            i->clusterId != ind.clusterId())
+        {
+            continue;
+        }
+
+        if (ind.srcAddress().hasExt() ? (i->extAddr != ind.srcAddress().ext())
+                                      : (i->nwkAddr != ind.srcAddress().nwk()))
+        {
+            continue;
+        }
+
+        LightNode *lightNode = getLightNodeForAddress(i->extAddr, i->endpoint);
+
+        if (lightNode)
+        {
+            if (status == deCONZ::ZclSuccessStatus)
+            {
+                lightNode->setStateConfirmed(i->readFlags);
+            }
+            else
+            {
+                DBG_Printf(DBG_INFO, "0x%016llX state command 0x%02X cluster 0x%04X failed with status 0x%02X, read back\n", i->extAddr, commandId, i->clusterId, status);
+                lightNode->enableRead(i->readFlags);
+                lightNode->setNextReadTime(clockMonotonicMs());
+                Q_Q(DeRestPlugin);
+                q->startZclAttributeTimer(0);
+            }
+        }
+
+        stateConfirmations.erase(i);
+        return true;
+    }
+
+    return false;
+}
+
+/*! Reads back the state attributes of commands which weren't confirmed in time.
+    Called every second by the idle timer.
+ */
+void DeRestPluginPrivate::checkStateConfirmations()
+{
+    bool readBack = false;
+    std::list<StateConfirmation>::iterator i = stateConfirmations.begin();
+
+    while (i != stateConfirmations.end())
+    {
+        if (i->timeout > idleTotalCounter)
+        {
+            ++i;
+            continue;
+        }
+
+        LightNode *lightNode = getLightNodeForAddress(i->extAddr, i->endpoint);
+
+        if (lightNode && lightNode->isAvailable())
+        {
+            DBG_Printf(DBG_INFO_L2, "0x%016llX state command 0x%02X not confirmed, read back\n", i->extAddr, i->commandId);
+            lightNode->enableRead(i->readFlags);
+            lightNode->setNextReadTime(clockMonotonicMs());
+            readBack = true;
+        }
+
+        i = stateConfirmations.erase(i);
+    }
+
+    if (readBack)
+    {
+        Q_Q(DeRestPlugin);
+        q->startZclAttributeTimer(0);
+    }
+}